@@ -8,15 +8,50 @@ LOCAL_CATEGORY_PATH := libs
 LOCAL_DESCRIPTION := Audio definitions library
 LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/include
 LOCAL_CFLAGS := -DADEF_API_EXPORTS -fvisibility=hidden -std=gnu11 -D_GNU_SOURCE
+
+# Hot path statistics counters (see adef_stats_snapshot()), enabled by
+# building with LIBAUDIODEFS_STATS=1
+ifeq ("$(LIBAUDIODEFS_STATS)","1")
+LOCAL_CFLAGS += -DADEF_STATS
+endif
+
 LOCAL_SRC_FILES := \
+	src/adefs_adts.c \
+	src/adefs_caps.c \
+	src/adefs_clock.c \
+	src/adefs_engine.c \
 	src/adefs_formats.c \
+	src/adefs_frame.c \
+	src/adefs_frame_recorder.c \
 	src/adefs_json.c \
+	src/adefs_pcm.c \
+	src/adefs_pcm_alloc.c \
+	src/adefs_pcm_biquad.c \
+	src/adefs_pcm_convert.c \
+	src/adefs_pcm_dither.c \
+	src/adefs_pcm_gain.c \
+	src/adefs_pcm_kernels_avx2.c \
+	src/adefs_pcm_kernels_baseline.c \
+	src/adefs_pcm_kernels_scalar.c \
+	src/adefs_pcm_loudness.c \
+	src/adefs_pcm_meter.c \
+	src/adefs_pcm_mixer.c \
+	src/adefs_pcm_rechunk.c \
+	src/adefs_pcm_sanitize.c \
+	src/adefs_pcm_simd.c \
+	src/adefs_registry.c \
+	src/adefs_stats.c \
+	src/adefs_wav.c \
 	src/adefs.c
 
 # Public API headers - top level headers first
 # This header list is currently used to generate a python binding
 LOCAL_EXPORT_CUSTOM_VARIABLES := LIBAUDIODEFS_HEADERS=$\
-	$(LOCAL_PATH)/include/audio-defs/adefs.h;
+	$(LOCAL_PATH)/include/audio-defs/adefs.h;$\
+	$(LOCAL_PATH)/include/audio-defs/adefs_adts.h;$\
+	$(LOCAL_PATH)/include/audio-defs/adefs_engine.h;$\
+	$(LOCAL_PATH)/include/audio-defs/adefs_pcm.h;$\
+	$(LOCAL_PATH)/include/audio-defs/adefs_wav.h;
 
 LOCAL_PUBLIC_LIBRARIES :=
 
@@ -24,6 +59,8 @@ LOCAL_PRIVATE_LIBRARIES := \
 	json \
 	libulog
 
+LOCAL_LDLIBS := -lm -lpthread
+
 include $(BUILD_LIBRARY)
 
 
@@ -36,11 +73,33 @@ LOCAL_LIBRARIES := \
 	libcunit\
 	libulog \
 	libaudio-defs
-LOCAL_CFLAGS := -std=gnu11
+LOCAL_CONLYFLAGS := -std=gnu11
+LOCAL_CXXFLAGS := -std=gnu++14
+LOCAL_LDLIBS := -lm -lpthread
 LOCAL_SRC_FILES := \
 	tests/adefs_test.c \
+	tests/adefs_test_adts.c \
+	tests/adefs_test_alloc.c \
+	tests/adefs_test_biquad.c \
+	tests/adefs_test_caps.c \
+	tests/adefs_test_clock.c \
+	tests/adefs_test_convert.c \
+	tests/adefs_test_cpp.cpp \
+	tests/adefs_test_dither.c \
+	tests/adefs_test_engine.c \
+	tests/adefs_test_float.c \
 	tests/adefs_test_format.c \
-	tests/adefs_test_str.c
+	tests/adefs_test_frame.c \
+	tests/adefs_test_gain.c \
+	tests/adefs_test_loudness.c \
+	tests/adefs_test_meter.c \
+	tests/adefs_test_mixer.c \
+	tests/adefs_test_rechunk.c \
+	tests/adefs_test_registry.c \
+	tests/adefs_test_simd.c \
+	tests/adefs_test_stats.c \
+	tests/adefs_test_str.c \
+	tests/adefs_test_wav.c
 
 include $(BUILD_EXECUTABLE)
 
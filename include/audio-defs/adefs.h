@@ -117,6 +117,77 @@ enum adef_wave_format {
 };
 
 
+/* Channel positions, used as bits of a channel layout mask; the bit order
+ * matches the WAVE_FORMAT_EXTENSIBLE dwChannelMask field */
+enum adef_channel {
+	/* Front left */
+	ADEF_CHANNEL_FRONT_LEFT = (1 << 0),
+
+	/* Front right */
+	ADEF_CHANNEL_FRONT_RIGHT = (1 << 1),
+
+	/* Front center */
+	ADEF_CHANNEL_FRONT_CENTER = (1 << 2),
+
+	/* Low frequency effects */
+	ADEF_CHANNEL_LOW_FREQUENCY = (1 << 3),
+
+	/* Back left */
+	ADEF_CHANNEL_BACK_LEFT = (1 << 4),
+
+	/* Back right */
+	ADEF_CHANNEL_BACK_RIGHT = (1 << 5),
+
+	/* Front left of center */
+	ADEF_CHANNEL_FRONT_LEFT_OF_CENTER = (1 << 6),
+
+	/* Front right of center */
+	ADEF_CHANNEL_FRONT_RIGHT_OF_CENTER = (1 << 7),
+
+	/* Back center */
+	ADEF_CHANNEL_BACK_CENTER = (1 << 8),
+
+	/* Side left */
+	ADEF_CHANNEL_SIDE_LEFT = (1 << 9),
+
+	/* Side right */
+	ADEF_CHANNEL_SIDE_RIGHT = (1 << 10),
+};
+
+
+/* Channel layouts (masks of enum adef_channel values); the channels of a
+ * stream are ordered by increasing bit position in the mask */
+
+/* Unspecified layout (independent or unknown channels) */
+#define ADEF_CHANNEL_LAYOUT_UNSPECIFIED 0
+
+/* Mono (1.0) */
+#define ADEF_CHANNEL_LAYOUT_MONO (ADEF_CHANNEL_FRONT_CENTER)
+
+/* Stereo (2.0) */
+#define ADEF_CHANNEL_LAYOUT_STEREO                                             \
+	(ADEF_CHANNEL_FRONT_LEFT | ADEF_CHANNEL_FRONT_RIGHT)
+
+/* 2.1 */
+#define ADEF_CHANNEL_LAYOUT_2_1                                                \
+	(ADEF_CHANNEL_LAYOUT_STEREO | ADEF_CHANNEL_LOW_FREQUENCY)
+
+/* Quadraphonic (4.0) */
+#define ADEF_CHANNEL_LAYOUT_QUAD                                               \
+	(ADEF_CHANNEL_LAYOUT_STEREO | ADEF_CHANNEL_BACK_LEFT |                 \
+	 ADEF_CHANNEL_BACK_RIGHT)
+
+/* 5.1 */
+#define ADEF_CHANNEL_LAYOUT_5_1                                                \
+	(ADEF_CHANNEL_LAYOUT_QUAD | ADEF_CHANNEL_FRONT_CENTER |                \
+	 ADEF_CHANNEL_LOW_FREQUENCY)
+
+/* 7.1 */
+#define ADEF_CHANNEL_LAYOUT_7_1                                                \
+	(ADEF_CHANNEL_LAYOUT_5_1 | ADEF_CHANNEL_SIDE_LEFT |                    \
+	 ADEF_CHANNEL_SIDE_RIGHT)
+
+
 /* Audio format */
 struct adef_format {
 	/* Audio encoding */
@@ -143,6 +214,18 @@ struct adef_format {
 
 		/* Endianness: true is little-endian, false is big-endian */
 		bool little_endian;
+
+		/* Sample container width in bits: 0 for packed samples (the
+		 * bit depth rounded up to a multiple of 8), otherwise a
+		 * multiple of 8 not lower than the bit depth; the samples are
+		 * stored in the least significant bits of the container
+		 * (sign-extended for signed values) */
+		unsigned int container_width;
+
+		/* Sample type: true for IEEE 754 floating-point values
+		 * (nominal range [-1.0, 1.0], 32-bit only; signed_val is then
+		 * ignored), false for integer values */
+		bool float_val;
 	} pcm;
 
 	/* AAC format parameters (only significant for ADEF_ENCODING_AAC_LC
@@ -151,6 +234,12 @@ struct adef_format {
 		/* AAC data format (transport type) */
 		enum adef_aac_data_format data_format;
 	} aac;
+
+	/* Channel layout: mask of enum adef_channel values, or
+	 * ADEF_CHANNEL_LAYOUT_UNSPECIFIED (the default layout of the channel
+	 * count, see adef_channel_layout_default()); when specified, the
+	 * number of bits set must be equal to the channel count */
+	uint32_t channel_layout;
 };
 
 
@@ -180,6 +269,31 @@ extern ADEF_API const struct adef_format adef_pcm_16b_88200hz_mono;
 extern ADEF_API const struct adef_format adef_pcm_16b_88200hz_stereo;
 extern ADEF_API const struct adef_format adef_pcm_16b_96000hz_mono;
 extern ADEF_API const struct adef_format adef_pcm_16b_96000hz_stereo;
+/* Floating-point PCM formats (32-bit, little-endian, interleaved) */
+extern ADEF_API const struct adef_format adef_pcm_f32_8000hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_8000hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_11025hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_11025hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_12000hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_12000hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_16000hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_16000hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_22050hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_22050hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_24000hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_24000hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_32000hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_32000hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_44100hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_44100hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_48000hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_48000hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_64000hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_64000hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_88200hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_88200hz_stereo;
+extern ADEF_API const struct adef_format adef_pcm_f32_96000hz_mono;
+extern ADEF_API const struct adef_format adef_pcm_f32_96000hz_stereo;
 /* AAC profile (Low Complexity) formats */
 extern ADEF_API const struct adef_format adef_aac_lc_16b_8000hz_mono_raw;
 extern ADEF_API const struct adef_format adef_aac_lc_16b_8000hz_stereo_raw;
@@ -258,6 +372,212 @@ struct adef_frame {
 };
 
 
+/* Frame discontinuity event type */
+enum adef_frame_event_type {
+	/* Timestamp after the expected timestamp (missing frames) */
+	ADEF_FRAME_EVENT_GAP = 0,
+
+	/* Timestamp before the expected timestamp (repeated or overlapping
+	 * frames) */
+	ADEF_FRAME_EVENT_OVERLAP,
+
+	/* Index different from the previous index plus one */
+	ADEF_FRAME_EVENT_INDEX_JUMP,
+
+	/* Time scale different from the previous time scale */
+	ADEF_FRAME_EVENT_TIMESCALE_CHANGE,
+
+	/* Enum values count (invalid value) */
+	ADEF_FRAME_EVENT_MAX,
+};
+
+
+/* Frame discontinuity event */
+struct adef_frame_event {
+	/* Event type */
+	enum adef_frame_event_type type;
+
+	/* Offset of the frame in the analyzed stream (number of frames
+	 * before it) */
+	uint64_t offset;
+
+	/* Event value: for a gap or an overlap, the difference between the
+	 * frame timestamp and the expected timestamp in units of the frame
+	 * time scale; for an index jump, the difference between the frame
+	 * index and the expected index; for a time scale change, the new
+	 * time scale */
+	int64_t value;
+};
+
+
+/* Frame discontinuity analyzer; the content is private except for the
+ * event counters, but the structure can be allocated anywhere (no dynamic
+ * allocation) */
+struct adef_frame_analyzer {
+	/* Nominal frame duration and tolerance, in units of the current
+	 * time scale (0 duration: not known yet) */
+	uint64_t duration;
+	uint64_t tolerance;
+
+	/* True if the first frame has been analyzed */
+	bool started;
+
+	/* Last analyzed frame */
+	struct adef_frame_info last;
+
+	/* Offset of the next frame in the stream */
+	uint64_t offset;
+
+	/* Event counts, indexed by enum adef_frame_event_type */
+	uint64_t counts[ADEF_FRAME_EVENT_MAX];
+};
+
+
+/* Default frame information recorder block size in records */
+#define ADEF_FRAME_RECORDER_DEFAULT_BLOCK_SIZE 1024
+
+
+/* Frame information recorder (opaque structure): compact columnar
+ * encoding of frame information records, see adef_frame_recorder_new() */
+struct adef_frame_recorder;
+
+
+/* Media clock to monotonic clock mapper: running linear fit between the
+ * frame timestamps and the capture timestamps; the content is private
+ * except for the statistics, but the structure can be allocated anywhere
+ * (no dynamic allocation) */
+struct adef_clock_mapper {
+	/* Forgetting factor of the fit */
+	double lambda;
+
+	/* Minimum outlier threshold in microseconds */
+	double tolerance;
+
+	/* Reference points (first sample of the fit) in microseconds */
+	uint64_t media_ref;
+	uint64_t monotonic_ref;
+
+	/* Fit state, relative to the reference points */
+	double weight;
+	double mean_media;
+	double mean_monotonic;
+	double cov_media;
+	double cov_cross;
+
+	/* Mean absolute residual of the accepted samples in microseconds */
+	double deviation;
+
+	/* Current model (monotonic = intercept + slope * media, relative to
+	 * the reference points) */
+	double intercept;
+	double slope;
+	double inv_slope;
+
+	/* Accepted samples count since the start of the fit */
+	uint64_t count;
+
+	/* Consecutive outliers count */
+	unsigned int outliers;
+
+	/* Statistics: accepted samples, rejected samples, and fit restarts
+	 * (after too many consecutive outliers, e.g. on a clock step) */
+	uint64_t accepted;
+	uint64_t rejected;
+	uint64_t restarts;
+};
+
+
+/* Maximum number of values or ranges in a caps expression field */
+#define ADEF_CAPS_MAX_RANGES 8
+
+
+/* Number of fields in a caps expression (the fields of the generic format
+ * string form) */
+#define ADEF_CAPS_FIELD_COUNT 10
+
+
+/* Caps expression field; the content is private */
+struct adef_caps_field {
+	/* True if any value is allowed */
+	bool any;
+
+	/* Allowed values lower than 64, as a bit mask */
+	uint64_t mask;
+
+	/* Allowed values or ranges, in preference order */
+	unsigned int count;
+	struct {
+		uint32_t min;
+		uint32_t max;
+	} ranges[ADEF_CAPS_MAX_RANGES];
+};
+
+
+/* Compiled caps expression; the content is private, but the structure can
+ * be allocated anywhere (no dynamic allocation) */
+struct adef_caps {
+	struct adef_caps_field fields[ADEF_CAPS_FIELD_COUNT];
+};
+
+
+/* Hot path statistics counters (only available when the library is built
+ * with ADEF_STATS defined); cycle counters are time stamp counter ticks,
+ * or nanoseconds on architectures without a user-space cycle counter */
+enum adef_stat {
+	/* adef_format_from_str() calls */
+	ADEF_STAT_FORMAT_FROM_STR = 0,
+
+	/* adef_format_from_str() built-in format name hits */
+	ADEF_STAT_FORMAT_FROM_STR_BUILTIN,
+
+	/* adef_format_from_str() registered format name hits */
+	ADEF_STAT_FORMAT_FROM_STR_REGISTRY,
+
+	/* adef_format_from_str() generic form fallbacks */
+	ADEF_STAT_FORMAT_FROM_STR_GENERIC,
+
+	/* adef_format_from_str() failures */
+	ADEF_STAT_FORMAT_FROM_STR_ERROR,
+
+	/* adef_format_from_str() cycles */
+	ADEF_STAT_FORMAT_FROM_STR_CYCLES,
+
+	/* adef_encoding_from_str() calls */
+	ADEF_STAT_ENCODING_FROM_STR,
+
+	/* adef_encoding_from_str() unknown encodings */
+	ADEF_STAT_ENCODING_UNKNOWN,
+
+	/* adef_format_intersect() calls */
+	ADEF_STAT_FORMAT_INTERSECT,
+
+	/* adef_format_intersect() calls returning true */
+	ADEF_STAT_FORMAT_INTERSECT_MATCH,
+
+	/* Capabilities compared by adef_format_intersect() (scan length) */
+	ADEF_STAT_FORMAT_INTERSECT_SCANNED,
+
+	/* adef_format_intersect() cycles */
+	ADEF_STAT_FORMAT_INTERSECT_CYCLES,
+
+	/* JSON functions calls */
+	ADEF_STAT_JSON,
+
+	/* JSON functions cycles */
+	ADEF_STAT_JSON_CYCLES,
+
+	/* Enum values count (invalid value) */
+	ADEF_STAT_MAX,
+};
+
+
+/* Hot path statistics snapshot */
+struct adef_stats {
+	/* Counters, indexed by enum adef_stat */
+	uint64_t counters[ADEF_STAT_MAX];
+};
+
+
 /**
  * Check the validity of a format.
  * @param format: format
@@ -266,10 +586,30 @@ struct adef_frame {
 ADEF_API bool adef_is_format_valid(const struct adef_format *format);
 
 
+/**
+ * Get the number of channels in a channel layout.
+ * @param channel_layout: channel layout mask
+ * @return the number of channels (bits set) in the layout
+ */
+ADEF_API unsigned int adef_channel_layout_get_count(uint32_t channel_layout);
+
+
+/**
+ * Get the default channel layout for a channel count.
+ * @param channel_count: channel count
+ * @return the predefined channel layout for the given channel count
+ *         (mono, stereo, quad, 5.1 or 7.1), or
+ *         ADEF_CHANNEL_LAYOUT_UNSPECIFIED if there is none
+ */
+ADEF_API uint32_t adef_channel_layout_default(unsigned int channel_count);
+
+
 /**
  * Compare two adef_format structs.
  * The components of both formats are compared and if one of them is
- * different, the function will return false.
+ * different, the function will return false. An unspecified channel
+ * layout is equal to the default layout of the channel count (see
+ * adef_channel_layout_default()).
  * @param f1: the first format to compare
  * @param f2: the second format to compare
  * @return true if both format are identical, false otherwise
@@ -292,20 +632,27 @@ ADEF_API bool adef_format_intersect(const struct adef_format *format,
 
 /* Helper macros for printing a format as a string from a struct
  * adef_format */
-#define ADEF_FORMAT_TO_STR_FMT "%s/%u/%u/%u/%s/%s/%s/%s"
+#define ADEF_FORMAT_TO_STR_FMT "%s/%u/%u/%u/%s/%s/%s/%s/0x%x/%u"
 /* codecheck_ignore[COMPLEX_MACRO] */
 #define ADEF_FORMAT_TO_STR_ARG(_format)                                        \
 	adef_encoding_to_str((_format)->encoding), (_format)->channel_count,   \
 		(_format)->bit_depth, (_format)->sample_rate,                  \
 		(_format)->pcm.interleaved ? "INTERLEAVED" : "PLANAR",         \
-		(_format)->pcm.signed_val ? "SIGNED" : "UNSIGNED",             \
+		(_format)->pcm.float_val                                       \
+			? "FLOAT"                                              \
+			: ((_format)->pcm.signed_val ? "SIGNED" : "UNSIGNED"), \
 		(_format)->pcm.little_endian ? "LE" : "BE",                    \
-		adef_aac_data_format_to_str((_format)->aac.data_format)
+		adef_aac_data_format_to_str((_format)->aac.data_format),       \
+		(_format)->channel_layout, (_format)->pcm.container_width
 
 
 /**
  * Fill a struct adef_format from a string.
- * The case is ignored.
+ * The case is ignored. In the generic form, the channel layout field can
+ * be either a numeric mask or a layout name (see
+ * adef_channel_layout_from_str()); it can be omitted, in which case the
+ * layout is unspecified. The trailing container width field can also be
+ * omitted, in which case the samples are packed.
  * @param str: format name to convert
  * @param format: format to fill
  * @return 0 on success, negative errno value in case of error
@@ -313,6 +660,56 @@ ADEF_API bool adef_format_intersect(const struct adef_format *format,
 ADEF_API int adef_format_from_str(const char *str, struct adef_format *format);
 
 
+/**
+ * Compile a caps expression.
+ * The expression uses the generic string form of adef_format_from_str(),
+ * where each field can also be '*' (any value), or a comma-separated list
+ * of values or (for numeric fields except the channel layout) ranges,
+ * e.g. 'PCM/1-2/16/8000-48000/INTERLEAVED/SIGNED/LE'; the list order is
+ * the preference order used by adef_caps_fixate(). Trailing fields can be
+ * omitted, in which case they allow any value; a container width of 0
+ * matches packed samples, and an unspecified channel layout (0) matches
+ * the default layout of the channel count, as in adef_format_cmp() (and
+ * conversely). The case is ignored.
+ * @param str: caps expression
+ * @param caps: compiled caps (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_caps_from_str(const char *str, struct adef_caps *caps);
+
+
+/**
+ * Check the intersection of a format against compiled caps.
+ * The check takes a constant time, whatever the caps expression.
+ * @param format: format
+ * @param caps: compiled caps
+ * @return true if the format is valid and allowed by the caps, or false
+ *         otherwise
+ */
+ADEF_API bool adef_caps_intersect(const struct adef_format *format,
+				  const struct adef_caps *caps);
+
+
+/**
+ * Fixate a format from compiled caps.
+ * Each field takes the value of the preferred format if the caps allow
+ * it, or otherwise the allowed value nearest to it in the first value or
+ * range of the field. Without a preferred format, the preferred values
+ * are those of adef_pcm_16b_48000hz_stereo (unspecified channel layout,
+ * packed samples, RAW AAC data format). In all cases, the preferred
+ * channel count is the channel count of a fixed channel layout, and the
+ * preferred bit depth is 32 for floating-point samples.
+ * @param caps: compiled caps
+ * @param preferred: preferred format (optional, can be NULL)
+ * @param format: fixed format (output)
+ * @return 0 on success, -EINVAL if the caps cannot produce a valid format,
+ *         negative errno value in case of error
+ */
+ADEF_API int adef_caps_fixate(const struct adef_caps *caps,
+			      const struct adef_format *preferred,
+			      struct adef_format *format);
+
+
 /**
  * Get a string from a struct enum adef_format.
  * @param format: format to convert
@@ -322,6 +719,31 @@ ADEF_API int adef_format_from_str(const char *str, struct adef_format *format);
 ADEF_API char *adef_format_to_str(const struct adef_format *format);
 
 
+/**
+ * Register a custom named format.
+ * Once registered, the name is understood by adef_format_from_str() and
+ * returned by adef_format_to_str() for formats which are not built-in.
+ * Registration can happen at any time; lookups from other threads never
+ * block nor wait on a concurrent registration.
+ * @param name: format name (must not contain '/' and must not be the name
+ *              of a built-in or already registered format)
+ * @param format: format to register (must be valid)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_format_register(const char *name,
+				  const struct adef_format *format);
+
+
+/**
+ * Unregister a custom named format.
+ * The case is ignored.
+ * @param name: name of the format to unregister
+ * @return 0 on success, -ENOENT if the format is not registered, negative
+ *         errno value in case of error
+ */
+ADEF_API int adef_format_unregister(const char *name);
+
+
 /**
  * Get an enum adef_encoding value from a string.
  * Valid strings are only the suffix of the encoding name (eg. 'AAC_LC').
@@ -362,6 +784,253 @@ ADEF_API const char *
 adef_aac_data_format_to_str(enum adef_aac_data_format data_format);
 
 
+/**
+ * Get a channel layout from a string.
+ * Valid strings are only the suffix of the predefined layout name
+ * (eg. 'STEREO', '5_1'). The case is ignored.
+ * @param str: channel layout name to convert
+ * @return the channel layout mask or ADEF_CHANNEL_LAYOUT_UNSPECIFIED
+ *         if unknown
+ */
+ADEF_API uint32_t adef_channel_layout_from_str(const char *str);
+
+
+/**
+ * Get a string from a channel layout.
+ * @param channel_layout: channel layout mask to convert
+ * @return a string description of the channel layout, or "CUSTOM" if the
+ *         mask is not one of the predefined layouts
+ */
+ADEF_API const char *adef_channel_layout_to_str(uint32_t channel_layout);
+
+
+/**
+ * Get a string from an enum adef_frame_event_type value.
+ * @param type: event type value to convert
+ * @return a string description of the event type
+ */
+ADEF_API const char *
+adef_frame_event_type_to_str(enum adef_frame_event_type type);
+
+
+/**
+ * Initialize or reset a frame discontinuity analyzer.
+ * @param analyzer: analyzer
+ * @param duration: nominal frame duration in units of the time scale of
+ *                  the first frame, or 0 to use the first timestamp
+ *                  increment of the stream (with the same time scale)
+ * @param tolerance: timestamp jitter tolerance in units of the time scale
+ *                   of the first frame (the duration and tolerance are
+ *                   rescaled on time scale changes)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_frame_analyzer_init(struct adef_frame_analyzer *analyzer,
+				      uint64_t duration,
+				      uint64_t tolerance);
+
+
+/**
+ * Analyze frame information records.
+ * The records are the continuation of the records given in the previous
+ * calls since the initialization. Gaps, overlaps, index jumps and time
+ * scale changes are reported in the events array (up to max_events
+ * events, the following events being only counted), and counted in the
+ * analyzer counts field. Timestamps are not checked on frames with a time
+ * scale of 0.
+ * @param analyzer: analyzer
+ * @param infos: frame information records array
+ * @param count: records count
+ * @param events: events array (output, optional if max_events is 0)
+ * @param max_events: events array size
+ * @param event_count: number of events written to the array (output,
+ *                     optional)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_frame_analyzer_process(struct adef_frame_analyzer *analyzer,
+					 const struct adef_frame_info *infos,
+					 size_t count,
+					 struct adef_frame_event *events,
+					 size_t max_events,
+					 size_t *event_count);
+
+
+/**
+ * Create a frame information recorder.
+ * The records are stored by blocks of block_size records; in each block,
+ * the timestamp, time scale, capture timestamp and index fields are
+ * stored as separate columns of delta (time scale) or delta-of-delta
+ * (other fields) values, bit-packed by groups of 32 values with the
+ * smallest width holding the group. A regular stream takes around one
+ * byte per record, mostly for the capture timestamp jitter.
+ * @param block_size: block size in records (0:
+ *                    ADEF_FRAME_RECORDER_DEFAULT_BLOCK_SIZE)
+ * @param ret_obj: recorder handle (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_frame_recorder_new(unsigned int block_size,
+				     struct adef_frame_recorder **ret_obj);
+
+
+/**
+ * Destroy a frame information recorder.
+ * The records not yet flushed and the recorded data are discarded.
+ * @param recorder: recorder handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_frame_recorder_destroy(struct adef_frame_recorder *recorder);
+
+
+/**
+ * Append frame information records to a recorder.
+ * Each complete block is encoded and appended to the recorded data.
+ * @param recorder: recorder handle
+ * @param infos: frame information records array
+ * @param count: records count
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_frame_recorder_append(struct adef_frame_recorder *recorder,
+					const struct adef_frame_info *infos,
+					size_t count);
+
+
+/**
+ * Encode the pending records of a recorder as a (short) block, so that all
+ * the appended records are part of the recorded data.
+ * @param recorder: recorder handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_frame_recorder_flush(struct adef_frame_recorder *recorder);
+
+
+/**
+ * Get the data recorded since the creation or the last call to
+ * adef_frame_recorder_clear().
+ * The data is a sequence of self-contained blocks, which can be
+ * concatenated with the data of other calls and decoded with
+ * adef_frame_info_decode(). The pointer is valid until the next call to
+ * any other function of the recorder.
+ * @param recorder: recorder handle
+ * @param data: recorded data (output)
+ * @param size: recorded data size in bytes (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_frame_recorder_get_data(struct adef_frame_recorder *recorder,
+					  const void **data,
+					  size_t *size);
+
+
+/**
+ * Discard the recorded data (e.g. after it has been archived); the
+ * pending records are kept.
+ * @param recorder: recorder handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_frame_recorder_clear(struct adef_frame_recorder *recorder);
+
+
+/**
+ * Get the number of frame information records in recorded data, without
+ * decoding it.
+ * @param data: recorded data (see adef_frame_recorder_get_data())
+ * @param size: recorded data size in bytes
+ * @param count: records count (output)
+ * @return 0 on success, -EPROTO if the data is invalid, negative errno
+ *         value in case of error
+ */
+ADEF_API int adef_frame_info_decode_count(const void *data,
+					  size_t size,
+					  size_t *count);
+
+
+/**
+ * Decode frame information records from recorded data.
+ * @param data: recorded data (see adef_frame_recorder_get_data())
+ * @param size: recorded data size in bytes
+ * @param infos: frame information records array (output)
+ * @param max_count: records array size
+ * @param count: number of decoded records (output)
+ * @return 0 on success, -ENOBUFS if the array is too small (see
+ *         adef_frame_info_decode_count()), -EPROTO if the data is invalid,
+ *         negative errno value in case of error
+ */
+ADEF_API int adef_frame_info_decode(const void *data,
+				    size_t size,
+				    struct adef_frame_info *infos,
+				    size_t max_count,
+				    size_t *count);
+
+
+/**
+ * Initialize or reset a media clock to monotonic clock mapper.
+ * @param mapper: mapper
+ * @param window: fit window, as an equivalent number of samples (older
+ *                samples weights decrease exponentially), must be at
+ *                least 2
+ * @param tolerance: minimum outlier threshold in microseconds; samples
+ *                   whose residual exceeds both the tolerance and 4 times
+ *                   the mean absolute residual are rejected
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_clock_mapper_init(struct adef_clock_mapper *mapper,
+				    unsigned int window,
+				    uint64_t tolerance);
+
+
+/**
+ * Update a media clock to monotonic clock mapper with a new sample.
+ * The sample is the frame timestamp and the frame capture timestamp
+ * (monotonic clock, in microseconds) of a frame information structure.
+ * @param mapper: mapper
+ * @param info: frame information, with non-zero time scale and capture
+ *              timestamp
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_clock_mapper_update(struct adef_clock_mapper *mapper,
+				      const struct adef_frame_info *info);
+
+
+/**
+ * Convert a media timestamp to a monotonic clock timestamp.
+ * @param mapper: mapper
+ * @param timestamp: media timestamp in units of time scale
+ * @param timescale: time scale (non-zero)
+ * @param monotonic: monotonic clock timestamp in microseconds (output)
+ * @return 0 on success, negative errno value in case of error (-EAGAIN if
+ *         the mapper has no samples, -ERANGE if the result is negative)
+ */
+ADEF_API int
+adef_clock_mapper_to_monotonic(const struct adef_clock_mapper *mapper,
+			       uint64_t timestamp,
+			       uint32_t timescale,
+			       uint64_t *monotonic);
+
+
+/**
+ * Convert a monotonic clock timestamp to a media timestamp.
+ * @param mapper: mapper
+ * @param monotonic: monotonic clock timestamp in microseconds
+ * @param timescale: time scale (non-zero)
+ * @param timestamp: media timestamp in units of time scale (output)
+ * @return 0 on success, negative errno value in case of error (-EAGAIN if
+ *         the mapper has no samples, -ERANGE if the result is negative)
+ */
+ADEF_API int adef_clock_mapper_to_media(const struct adef_clock_mapper *mapper,
+					uint64_t monotonic,
+					uint32_t timescale,
+					uint64_t *timestamp);
+
+
+/**
+ * Get a snapshot of the hot path statistics counters.
+ * The counters are the sums of the counters of all threads (including
+ * the terminated threads) since the library was loaded.
+ * @param stats: statistics snapshot (output)
+ * @return 0 on success, -ENOTSUP if the library is built without
+ *         statistics, negative errno value in case of error
+ */
+ADEF_API int adef_stats_snapshot(struct adef_stats *stats);
+
+
 /**
  * Write a frame information structure to a JSON object.
  * The jobj JSON object must have been previously allocated.
@@ -388,6 +1057,32 @@ int adef_format_to_json(const struct adef_format *format,
 			struct json_object *jobj);
 
 
+/**
+ * Write the state of a media clock to monotonic clock mapper to a JSON
+ * object.
+ * The jobj JSON object must have been previously allocated.
+ * The ownership of the JSON object stays with the caller.
+ * @param mapper: pointer to an adef_clock_mapper structure
+ * @param jobj: pointer to the JSON object to write to (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API
+int adef_clock_mapper_to_json(const struct adef_clock_mapper *mapper,
+			      struct json_object *jobj);
+
+
+/**
+ * Write a snapshot of the hot path statistics counters to a JSON object.
+ * The jobj JSON object must have been previously allocated.
+ * The ownership of the JSON object stays with the caller.
+ * @param jobj: pointer to the JSON object to write to (output)
+ * @return 0 on success, -ENOTSUP if the library is built without
+ *         statistics, negative errno value in case of error
+ */
+ADEF_API
+int adef_stats_to_json(struct json_object *jobj);
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,1329 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ADEFS_HPP_
+#define _ADEFS_HPP_
+
+#if __cplusplus < 201402L
+#	error "adefs.hpp requires C++14"
+#endif
+
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <audio-defs/adefs.h>
+#include <audio-defs/adefs_pcm.h>
+
+/* Header-only C++ layer over the C API:
+ * - constexpr format builders and builtin formats;
+ * - sample type traits (bit depth, container size, sign, endianness) and
+ *   layout traits (interleaving);
+ * - conversion and metering loops specialized at compile time for the
+ *   sample types, either called directly when the types are known, or
+ *   selected once per buffer from a runtime struct adef_format. */
+
+namespace adef {
+
+
+/**
+ * Build a PCM format.
+ * @param channel_count: channel count
+ * @param bit_depth: bit depth
+ * @param sample_rate: sample rate
+ * @param channel_layout: channel layout
+ * @param interleaved: true for interleaved channels
+ * @param signed_val: true for signed values
+ * @param float_val: true for floating-point values
+ * @param little_endian: true for little-endian values
+ * @param container_width: sample container width in bits (0: packed)
+ * @return the format
+ */
+constexpr struct adef_format
+pcm_format(unsigned int channel_count,
+	   unsigned int bit_depth,
+	   unsigned int sample_rate,
+	   uint32_t channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED,
+	   bool interleaved = true,
+	   bool signed_val = true,
+	   bool float_val = false,
+	   bool little_endian = true,
+	   unsigned int container_width = 0)
+{
+	struct adef_format format{};
+	format.encoding = ADEF_ENCODING_PCM;
+	format.channel_count = channel_count;
+	format.channel_layout = channel_layout;
+	format.bit_depth = bit_depth;
+	format.sample_rate = sample_rate;
+	format.pcm.interleaved = interleaved;
+	format.pcm.signed_val = signed_val;
+	format.pcm.float_val = float_val;
+	format.pcm.little_endian = little_endian;
+	format.pcm.container_width = container_width;
+	return format;
+}
+
+
+/**
+ * Build an AAC LC format.
+ * @param channel_count: channel count
+ * @param sample_rate: sample rate
+ * @param data_format: AAC data format
+ * @param channel_layout: channel layout
+ * @return the format
+ */
+constexpr struct adef_format
+aac_lc_format(unsigned int channel_count,
+	      unsigned int sample_rate,
+	      enum adef_aac_data_format data_format,
+	      uint32_t channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED)
+{
+	struct adef_format format{};
+	format.encoding = ADEF_ENCODING_AAC_LC;
+	format.channel_count = channel_count;
+	format.channel_layout = channel_layout;
+	format.bit_depth = 16;
+	format.sample_rate = sample_rate;
+	format.aac.data_format = data_format;
+	return format;
+}
+
+
+/**
+ * Get the default channel layout for a channel count (constexpr
+ * equivalent of adef_channel_layout_default()).
+ * @param channel_count: channel count
+ * @return the predefined channel layout for the given channel count, or
+ *         ADEF_CHANNEL_LAYOUT_UNSPECIFIED if there is none
+ */
+constexpr uint32_t channel_layout_default(unsigned int channel_count)
+{
+	return channel_count == 1   ? ADEF_CHANNEL_LAYOUT_MONO
+	       : channel_count == 2 ? ADEF_CHANNEL_LAYOUT_STEREO
+	       : channel_count == 4 ? ADEF_CHANNEL_LAYOUT_QUAD
+	       : channel_count == 6 ? ADEF_CHANNEL_LAYOUT_5_1
+	       : channel_count == 8 ? ADEF_CHANNEL_LAYOUT_7_1
+				    : ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+}
+
+
+/**
+ * Compare two formats (constexpr equivalent of adef_format_cmp()).
+ * @param f1: first format
+ * @param f2: second format
+ * @return true if the formats are equal
+ */
+constexpr bool format_equal(const struct adef_format &f1,
+			    const struct adef_format &f2)
+{
+	bool ret = f1.encoding == f2.encoding &&
+		   f1.channel_count == f2.channel_count &&
+		   (f1.channel_layout ? f1.channel_layout
+				      : channel_layout_default(
+						f1.channel_count)) ==
+			   (f2.channel_layout ? f2.channel_layout
+					      : channel_layout_default(
+							f2.channel_count)) &&
+		   f1.bit_depth == f2.bit_depth &&
+		   f1.sample_rate == f2.sample_rate;
+	if (f1.encoding == ADEF_ENCODING_PCM) {
+		unsigned int w1 = f1.pcm.container_width
+					  ? f1.pcm.container_width
+					  : (f1.bit_depth + 7) / 8 * 8;
+		unsigned int w2 = f2.pcm.container_width
+					  ? f2.pcm.container_width
+					  : (f2.bit_depth + 7) / 8 * 8;
+		ret = ret && f1.pcm.interleaved == f2.pcm.interleaved &&
+		      f1.pcm.float_val == f2.pcm.float_val &&
+		      (f1.pcm.float_val ||
+		       f1.pcm.signed_val == f2.pcm.signed_val) &&
+		      f1.pcm.little_endian == f2.pcm.little_endian && w1 == w2;
+	}
+	if (f1.encoding == ADEF_ENCODING_AAC_LC)
+		ret = ret && f1.aac.data_format == f2.aac.data_format;
+	return ret;
+}
+
+
+/* Builtin formats, identical to the adef_xxx C constants (see adefs.h) */
+namespace formats {
+
+#define ADEF_HPP_BUILTIN_FORMATS(_rate)                                        \
+	constexpr struct adef_format pcm_16b_##_rate##hz_mono =                \
+		pcm_format(1, 16, _rate, ADEF_CHANNEL_LAYOUT_MONO);            \
+	constexpr struct adef_format pcm_16b_##_rate##hz_stereo =              \
+		pcm_format(2, 16, _rate, ADEF_CHANNEL_LAYOUT_STEREO);          \
+	constexpr struct adef_format pcm_f32_##_rate##hz_mono = pcm_format(    \
+		1, 32, _rate, ADEF_CHANNEL_LAYOUT_MONO, true, true, true);     \
+	constexpr struct adef_format pcm_f32_##_rate##hz_stereo = pcm_format(  \
+		2, 32, _rate, ADEF_CHANNEL_LAYOUT_STEREO, true, true, true);   \
+	constexpr struct adef_format aac_lc_16b_##_rate##hz_mono_raw =         \
+		aac_lc_format(1,                                               \
+			      _rate,                                           \
+			      ADEF_AAC_DATA_FORMAT_RAW,                        \
+			      ADEF_CHANNEL_LAYOUT_MONO);                       \
+	constexpr struct adef_format aac_lc_16b_##_rate##hz_stereo_raw =       \
+		aac_lc_format(2,                                               \
+			      _rate,                                           \
+			      ADEF_AAC_DATA_FORMAT_RAW,                        \
+			      ADEF_CHANNEL_LAYOUT_STEREO);                     \
+	constexpr struct adef_format aac_lc_16b_##_rate##hz_mono_adts =        \
+		aac_lc_format(1,                                               \
+			      _rate,                                           \
+			      ADEF_AAC_DATA_FORMAT_ADTS,                       \
+			      ADEF_CHANNEL_LAYOUT_MONO);                       \
+	constexpr struct adef_format aac_lc_16b_##_rate##hz_stereo_adts =      \
+		aac_lc_format(2,                                               \
+			      _rate,                                           \
+			      ADEF_AAC_DATA_FORMAT_ADTS,                       \
+			      ADEF_CHANNEL_LAYOUT_STEREO);
+
+ADEF_HPP_BUILTIN_FORMATS(8000)
+ADEF_HPP_BUILTIN_FORMATS(11025)
+ADEF_HPP_BUILTIN_FORMATS(12000)
+ADEF_HPP_BUILTIN_FORMATS(16000)
+ADEF_HPP_BUILTIN_FORMATS(22050)
+ADEF_HPP_BUILTIN_FORMATS(24000)
+ADEF_HPP_BUILTIN_FORMATS(32000)
+ADEF_HPP_BUILTIN_FORMATS(44100)
+ADEF_HPP_BUILTIN_FORMATS(48000)
+ADEF_HPP_BUILTIN_FORMATS(64000)
+ADEF_HPP_BUILTIN_FORMATS(88200)
+ADEF_HPP_BUILTIN_FORMATS(96000)
+
+#undef ADEF_HPP_BUILTIN_FORMATS
+
+} /* namespace formats */
+
+
+/**
+ * Check the validity of a format (constexpr equivalent of
+ * adef_is_format_valid()).
+ * @param format: format to check
+ * @return true if the format is valid
+ */
+constexpr bool format_valid(const struct adef_format &format)
+{
+	unsigned int layout_count = 0;
+
+	switch (format.encoding) {
+	case ADEF_ENCODING_PCM:
+		break;
+	case ADEF_ENCODING_AAC_LC:
+		if (format.aac.data_format == ADEF_AAC_DATA_FORMAT_UNKNOWN ||
+		    format.aac.data_format >= ADEF_AAC_DATA_FORMAT_MAX)
+			return false;
+		break;
+	default:
+		return false;
+	}
+	if (!format.channel_count || !format.bit_depth || !format.sample_rate)
+		return false;
+	if (format.encoding == ADEF_ENCODING_PCM && format.pcm.float_val &&
+	    (format.bit_depth != 32 || (format.pcm.container_width != 0 &&
+					format.pcm.container_width != 32)))
+		return false;
+	if (format.encoding == ADEF_ENCODING_PCM &&
+	    format.pcm.container_width != 0 &&
+	    (format.pcm.container_width % 8 != 0 ||
+	     format.pcm.container_width < format.bit_depth))
+		return false;
+	for (uint32_t m = format.channel_layout; m != 0; m &= m - 1)
+		layout_count++;
+	if (format.channel_layout != ADEF_CHANNEL_LAYOUT_UNSPECIFIED &&
+	    layout_count != format.channel_count)
+		return false;
+	return true;
+}
+
+
+namespace detail {
+
+
+/* Format string token (not null-terminated) */
+struct token {
+	const char *str;
+	size_t len;
+};
+
+
+constexpr char to_lower(char c)
+{
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+
+/* Token comparison, as strcmp() or strcasecmp() */
+constexpr bool token_equal(struct token tok, const char *ref, bool icase)
+{
+	size_t i = 0;
+	for (; i < tok.len; i++) {
+		if (ref[i] == '\0')
+			return false;
+		if (icase ? to_lower(tok.str[i]) != to_lower(ref[i])
+			  : tok.str[i] != ref[i])
+			return false;
+	}
+	return ref[i] == '\0';
+}
+
+
+/* Next token, as strtok_r() with a "/" delimiter: empty tokens are
+ * skipped; returns false if there are no more tokens */
+constexpr bool next_token(const char *str, size_t len, size_t &pos, token &tok)
+{
+	while (pos < len && str[pos] == '/')
+		pos++;
+	if (pos == len)
+		return false;
+	tok.str = str + pos;
+	tok.len = 0;
+	while (pos < len && str[pos] != '/') {
+		pos++;
+		tok.len++;
+	}
+	if (pos < len)
+		pos++;
+	return true;
+}
+
+
+constexpr int digit_value(char c)
+{
+	return c >= '0' && c <= '9'   ? c - '0'
+	       : c >= 'a' && c <= 'z' ? c - 'a' + 10
+	       : c >= 'A' && c <= 'Z' ? c - 'A' + 10
+				      : 36;
+}
+
+
+/* Whole token number parsing, as strtoul() followed by a check of the end
+ * pointer and errno: leading white space and sign are accepted, base 0
+ * selects the base from the prefix; returns -EINVAL on error */
+constexpr int parse_ulong(struct token tok, int base, unsigned long &value)
+{
+	size_t i = 0;
+	bool neg = false, overflow = false;
+	size_t digits_start = 0;
+	unsigned long v = 0;
+
+	/* Leading white space, as isspace() in the C locale */
+	while (i < tok.len && (tok.str[i] == ' ' ||
+			       (tok.str[i] >= '\t' && tok.str[i] <= '\r')))
+		i++;
+	if (i < tok.len && (tok.str[i] == '+' || tok.str[i] == '-')) {
+		neg = tok.str[i] == '-';
+		i++;
+	}
+	if (base == 0) {
+		if (i + 2 < tok.len && tok.str[i] == '0' &&
+		    to_lower(tok.str[i + 1]) == 'x' &&
+		    digit_value(tok.str[i + 2]) < 16) {
+			base = 16;
+			i += 2;
+		} else {
+			base = i < tok.len && tok.str[i] == '0' ? 8 : 10;
+		}
+	}
+	digits_start = i;
+	for (; i < tok.len && digit_value(tok.str[i]) < base; i++) {
+		unsigned long d = digit_value(tok.str[i]);
+		if (v > (~0UL - d) / base)
+			overflow = true;
+		v = v * base + d;
+	}
+	if (i == digits_start || i != tok.len || overflow)
+		return -EINVAL;
+	value = neg ? -v : v;
+	return 0;
+}
+
+
+constexpr int parse_unsigned_int(struct token tok, unsigned int &num)
+{
+	unsigned long parsed = 0;
+	int ret = parse_ulong(tok, 10, parsed);
+	if (ret < 0)
+		return ret;
+	if (parsed > ~0U)
+		return -E2BIG;
+	num = (unsigned int)parsed;
+	return 0;
+}
+
+
+constexpr int parse_channel_layout(struct token tok, uint32_t &channel_layout)
+{
+	constexpr struct {
+		uint32_t channel_layout;
+		const char *str;
+	} map[] = {
+		{ADEF_CHANNEL_LAYOUT_UNSPECIFIED, "UNSPECIFIED"},
+		{ADEF_CHANNEL_LAYOUT_MONO, "MONO"},
+		{ADEF_CHANNEL_LAYOUT_STEREO, "STEREO"},
+		{ADEF_CHANNEL_LAYOUT_2_1, "2_1"},
+		{ADEF_CHANNEL_LAYOUT_QUAD, "QUAD"},
+		{ADEF_CHANNEL_LAYOUT_5_1, "5_1"},
+		{ADEF_CHANNEL_LAYOUT_7_1, "7_1"},
+	};
+	unsigned long parsed = 0;
+	int ret = 0;
+
+	for (const auto &entry : map) {
+		if (token_equal(tok, entry.str, true)) {
+			channel_layout = entry.channel_layout;
+			return 0;
+		}
+	}
+	ret = parse_ulong(tok, 0, parsed);
+	if (ret < 0)
+		return ret;
+	if (parsed > UINT32_MAX)
+		return -E2BIG;
+	channel_layout = (uint32_t)parsed;
+	return 0;
+}
+
+
+constexpr enum adef_encoding encoding_from_token(struct token tok)
+{
+	return token_equal(tok, "PCM", true)	  ? ADEF_ENCODING_PCM
+	       : token_equal(tok, "AAC_LC", true) ? ADEF_ENCODING_AAC_LC
+						  : ADEF_ENCODING_UNKNOWN;
+}
+
+
+constexpr enum adef_aac_data_format aac_data_format_from_token(struct token tok)
+{
+	return token_equal(tok, "RAW", true)	? ADEF_AAC_DATA_FORMAT_RAW
+	       : token_equal(tok, "ADIF", true) ? ADEF_AAC_DATA_FORMAT_ADIF
+	       : token_equal(tok, "ADTS", true) ? ADEF_AAC_DATA_FORMAT_ADTS
+						: ADEF_AAC_DATA_FORMAT_UNKNOWN;
+}
+
+
+struct builtin_format {
+	const char *name;
+	struct adef_format format;
+};
+
+
+#define ADEF_HPP_BUILTIN_NAMES(_rate)                                          \
+	{"pcm_16b_" #_rate "hz_mono", formats::pcm_16b_##_rate##hz_mono},      \
+		{"pcm_16b_" #_rate "hz_stereo",                                \
+		 formats::pcm_16b_##_rate##hz_stereo},                         \
+		{"pcm_f32_" #_rate "hz_mono",                                  \
+		 formats::pcm_f32_##_rate##hz_mono},                           \
+		{"pcm_f32_" #_rate "hz_stereo",                                \
+		 formats::pcm_f32_##_rate##hz_stereo},                         \
+		{"aac_lc_16b_" #_rate "hz_mono_raw",                           \
+		 formats::aac_lc_16b_##_rate##hz_mono_raw},                    \
+		{"aac_lc_16b_" #_rate "hz_stereo_raw",                         \
+		 formats::aac_lc_16b_##_rate##hz_stereo_raw},                  \
+		{"aac_lc_16b_" #_rate "hz_mono_adts",                          \
+		 formats::aac_lc_16b_##_rate##hz_mono_adts},                   \
+		{"aac_lc_16b_" #_rate "hz_stereo_adts",                        \
+		 formats::aac_lc_16b_##_rate##hz_stereo_adts}
+
+constexpr struct builtin_format builtin_formats[] = {
+	ADEF_HPP_BUILTIN_NAMES(8000),
+	ADEF_HPP_BUILTIN_NAMES(11025),
+	ADEF_HPP_BUILTIN_NAMES(12000),
+	ADEF_HPP_BUILTIN_NAMES(16000),
+	ADEF_HPP_BUILTIN_NAMES(22050),
+	ADEF_HPP_BUILTIN_NAMES(24000),
+	ADEF_HPP_BUILTIN_NAMES(32000),
+	ADEF_HPP_BUILTIN_NAMES(44100),
+	ADEF_HPP_BUILTIN_NAMES(48000),
+	ADEF_HPP_BUILTIN_NAMES(64000),
+	ADEF_HPP_BUILTIN_NAMES(88200),
+	ADEF_HPP_BUILTIN_NAMES(96000),
+};
+
+#undef ADEF_HPP_BUILTIN_NAMES
+
+
+} /* namespace detail */
+
+
+/**
+ * Fill a struct adef_format from a string (constexpr equivalent of
+ * adef_format_from_str()).
+ * The results are identical to those of the C parser, except that the
+ * formats registered at runtime (see adef_registry_add()) are not known.
+ * The string ends at the first null character or after len characters.
+ * @param str: format name to convert
+ * @param len: string length
+ * @param format: format to fill
+ * @return 0 on success, negative errno value in case of error
+ */
+constexpr int
+parse_format(const char *str, size_t len, struct adef_format &format)
+{
+	size_t pos = 0, end = 0;
+	detail::token tok{};
+	int ret = 0;
+
+	if (str == nullptr)
+		return -EINVAL;
+	while (end < len && str[end] != '\0')
+		end++;
+
+	/* First find in builtin formats */
+	for (const auto &entry : detail::builtin_formats) {
+		if (detail::token_equal({str, end}, entry.name, true)) {
+			format = entry.format;
+			return 0;
+		}
+	}
+
+	/* Encoding, channel count, bit depth, sample rate */
+	if (!detail::next_token(str, end, pos, tok))
+		return -EINVAL;
+	format.encoding = detail::encoding_from_token(tok);
+	if (!detail::next_token(str, end, pos, tok))
+		return -EINVAL;
+	ret = detail::parse_unsigned_int(tok, format.channel_count);
+	if (ret < 0)
+		return -EINVAL;
+	if (!detail::next_token(str, end, pos, tok))
+		return -EINVAL;
+	ret = detail::parse_unsigned_int(tok, format.bit_depth);
+	if (ret < 0)
+		return -EINVAL;
+	if (!detail::next_token(str, end, pos, tok))
+		return -EINVAL;
+	ret = detail::parse_unsigned_int(tok, format.sample_rate);
+	if (ret < 0)
+		return -EINVAL;
+
+	/* Interleaving, sign, endianness (case sensitive) */
+	if (!detail::next_token(str, end, pos, tok))
+		return -EINVAL;
+	format.pcm.interleaved = detail::token_equal(tok, "INTERLEAVED", false);
+	if (!detail::next_token(str, end, pos, tok))
+		return -EINVAL;
+	format.pcm.float_val = detail::token_equal(tok, "FLOAT", false);
+	format.pcm.signed_val = format.pcm.float_val ||
+				detail::token_equal(tok, "SIGNED", false);
+	if (!detail::next_token(str, end, pos, tok))
+		return -EINVAL;
+	format.pcm.little_endian = detail::token_equal(tok, "LE", false);
+
+	/* AAC data format */
+	if (!detail::next_token(str, end, pos, tok))
+		return -EINVAL;
+	format.aac.data_format = detail::aac_data_format_from_token(tok);
+
+	/* Channel layout and container width (optional) */
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	if (detail::next_token(str, end, pos, tok)) {
+		ret = detail::parse_channel_layout(tok, format.channel_layout);
+		if (ret < 0)
+			return -EINVAL;
+	}
+	format.pcm.container_width = 0;
+	if (detail::next_token(str, end, pos, tok)) {
+		ret = detail::parse_unsigned_int(tok,
+						 format.pcm.container_width);
+		if (ret < 0)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+
+namespace detail {
+
+
+/* Parse the characters of a format literal; an invalid string gives a
+ * zeroed (invalid) format */
+template <class C, C... S>
+constexpr struct adef_format parse_format_literal()
+{
+	const char str[] = {S..., '\0'};
+	struct adef_format format{};
+	if (parse_format(str, sizeof...(S), format) < 0)
+		return {};
+	return format;
+}
+
+
+} /* namespace detail */
+
+
+namespace literals {
+
+
+#if defined(__clang__)
+#	pragma clang diagnostic push
+#	pragma clang diagnostic ignored "-Wgnu-string-literal-operator-template"
+#elif defined(__GNUC__)
+#	pragma GCC diagnostic push
+#	pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+
+/**
+ * Format string literal, e.g. "pcm_16b_48000hz_stereo"_adef or
+ * "PCM/2/24/48000/PLANAR/SIGNED/LE/UNKNOWN/STEREO/32"_adef.
+ * The string is parsed by parse_format() at compile time, in every
+ * context, and an invalid string fails the compilation (this is a string
+ * literal operator template, a GNU extension supported by GCC and Clang).
+ * Strings only known at runtime are parsed with parse_format().
+ * @return the format
+ */
+template <class C, C... S>
+constexpr struct adef_format operator""_adef()
+{
+	static_assert(std::is_same<C, char>::value,
+		      "format literals must be narrow strings");
+	constexpr struct adef_format format =
+		detail::parse_format_literal<C, S...>();
+	static_assert(format_valid(format), "invalid format string");
+	return format;
+}
+
+
+#if defined(__clang__)
+#	pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#	pragma GCC diagnostic pop
+#endif
+
+
+} /* namespace literals */
+
+
+namespace detail {
+
+
+/* Read a raw container of Bytes bytes */
+template <unsigned int Bytes, bool LittleEndian>
+inline uint32_t read_raw(const uint8_t *p)
+{
+	uint32_t v = 0;
+	for (unsigned int i = 0; i < Bytes; i++)
+		v |= (uint32_t)p[i] << (LittleEndian ? 8 * i
+						     : 8 * (Bytes - 1 - i));
+	return v;
+}
+
+
+/* Write a raw container of Bytes bytes */
+template <unsigned int Bytes, bool LittleEndian>
+inline void write_raw(uint8_t *p, uint32_t v)
+{
+	for (unsigned int i = 0; i < Bytes; i++)
+		p[i] = (uint8_t)(v >> (LittleEndian ? 8 * i
+						    : 8 * (Bytes - 1 - i)));
+}
+
+
+/* Convert a float sample to a signed value of Bits bits, with rounding
+ * and saturation (same as the C library) */
+template <unsigned int Bits>
+inline int32_t f32_to_int(float f)
+{
+	const float scale = (float)(1u << (Bits - 1));
+	const float hi = Bits < 25 ? scale - 1.f : 2147483520.f;
+	float v = f * scale;
+	v = v < -scale ? -scale : v;
+	v = v > hi ? hi : v;
+	return (int32_t)(v + (v >= 0.f ? 0.5f : -0.5f));
+}
+
+
+} /* namespace detail */
+
+
+/**
+ * Integer sample type traits.
+ * Samples are loaded as left-justified signed 32-bit values or as
+ * normalized floats, and stored from them, with the same rounding as the
+ * C library.
+ * @param BitDepth: bit depth (8, 16, 24 or 32)
+ * @param Size: container size in bytes
+ * @param Signed: true for signed values
+ * @param LittleEndian: true for little-endian values
+ */
+template <unsigned int BitDepth,
+	  unsigned int Size,
+	  bool Signed,
+	  bool LittleEndian>
+struct int_sample {
+	static_assert(BitDepth == 8 || BitDepth == 16 || BitDepth == 24 ||
+			      BitDepth == 32,
+		      "unsupported bit depth");
+	static_assert(Size * 8 >= BitDepth && Size <= 4,
+		      "unsupported container size");
+
+	static constexpr unsigned int bit_depth = BitDepth;
+	static constexpr unsigned int size = Size;
+	static constexpr bool signed_val = Signed;
+	static constexpr bool float_val = false;
+	static constexpr bool little_endian = LittleEndian;
+	static constexpr unsigned int container_width =
+		Size * 8 == BitDepth ? 0 : Size * 8;
+
+	static inline int32_t load_s32(const uint8_t *p)
+	{
+		uint32_t v = detail::read_raw<Size, LittleEndian>(p)
+			     << (32 - BitDepth);
+		if (!Signed)
+			v ^= 0x80000000u;
+		return (int32_t)v;
+	}
+
+	static inline void store_s32(uint8_t *p, int32_t s)
+	{
+		uint32_t v = Signed ? (uint32_t)(s >> (32 - BitDepth))
+				    : ((uint32_t)s ^ 0x80000000u) >>
+					      (32 - BitDepth);
+		detail::write_raw<Size, LittleEndian>(p, v);
+	}
+
+	static inline float load_f32(const uint8_t *p)
+	{
+		return (float)load_s32(p) * (1.f / 2147483648.f);
+	}
+
+	static inline void store_f32(uint8_t *p, float f)
+	{
+		uint32_t v = (uint32_t)detail::f32_to_int<BitDepth>(f);
+		if (!Signed)
+			v = (v ^ (1u << (BitDepth - 1))) &
+			    (0xffffffffu >> (32 - BitDepth));
+		detail::write_raw<Size, LittleEndian>(p, v);
+	}
+};
+
+
+/**
+ * 32-bit floating-point sample type traits.
+ * Integer loads are saturated, NaN values are loaded as 0.
+ * @param LittleEndian: true for little-endian values
+ */
+template <bool LittleEndian>
+struct float_sample {
+	static constexpr unsigned int bit_depth = 32;
+	static constexpr unsigned int size = 4;
+	static constexpr bool signed_val = true;
+	static constexpr bool float_val = true;
+	static constexpr bool little_endian = LittleEndian;
+	static constexpr unsigned int container_width = 0;
+
+	static inline float load_f32(const uint8_t *p)
+	{
+		uint32_t raw = detail::read_raw<4, LittleEndian>(p);
+		float f;
+		std::memcpy(&f, &raw, sizeof(f));
+		return f;
+	}
+
+	static inline void store_f32(uint8_t *p, float f)
+	{
+		uint32_t raw;
+		std::memcpy(&raw, &f, sizeof(raw));
+		detail::write_raw<4, LittleEndian>(p, raw);
+	}
+
+	static inline int32_t load_s32(const uint8_t *p)
+	{
+		float f = load_f32(p);
+		return detail::f32_to_int<32>(f == f ? f : 0.f);
+	}
+
+	static inline void store_s32(uint8_t *p, int32_t s)
+	{
+		store_f32(p, (float)s * (1.f / 2147483648.f));
+	}
+};
+
+
+/* Sample types */
+using u8 = int_sample<8, 1, false, true>;
+using s8 = int_sample<8, 1, true, true>;
+using u16le = int_sample<16, 2, false, true>;
+using u16be = int_sample<16, 2, false, false>;
+using s16le = int_sample<16, 2, true, true>;
+using s16be = int_sample<16, 2, true, false>;
+using u24le = int_sample<24, 3, false, true>;
+using u24be = int_sample<24, 3, false, false>;
+using s24le = int_sample<24, 3, true, true>;
+using s24be = int_sample<24, 3, true, false>;
+using u24le4 = int_sample<24, 4, false, true>;
+using u24be4 = int_sample<24, 4, false, false>;
+using s24le4 = int_sample<24, 4, true, true>;
+using s24be4 = int_sample<24, 4, true, false>;
+using u32le = int_sample<32, 4, false, true>;
+using u32be = int_sample<32, 4, false, false>;
+using s32le = int_sample<32, 4, true, true>;
+using s32be = int_sample<32, 4, true, false>;
+using f32le = float_sample<true>;
+using f32be = float_sample<false>;
+
+
+/**
+ * PCM layout traits: sample type and interleaving.
+ * @param Sample: sample type
+ * @param Interleaved: true for interleaved channels
+ */
+template <class Sample, bool Interleaved>
+struct pcm_layout {
+	using sample = Sample;
+	static constexpr bool interleaved = Interleaved;
+
+	/**
+	 * Build the format of this layout.
+	 * @param channel_count: channel count
+	 * @param sample_rate: sample rate
+	 * @param channel_layout: channel layout
+	 * @return the format
+	 */
+	static constexpr struct adef_format
+	format(unsigned int channel_count,
+	       unsigned int sample_rate,
+	       uint32_t channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED)
+	{
+		return pcm_format(channel_count,
+				  Sample::bit_depth,
+				  sample_rate,
+				  channel_layout,
+				  Interleaved,
+				  Sample::signed_val,
+				  Sample::float_val,
+				  Sample::little_endian,
+				  Sample::container_width);
+	}
+
+	/**
+	 * Get the first sample of a channel of a buffer.
+	 * @param buf: PCM buffer
+	 * @param channel_count: channel count
+	 * @param channel: channel index
+	 * @param stride: offset between two samples of the channel (output)
+	 * @return the address of the first sample of the channel
+	 */
+	static inline uint8_t *channel(const struct adef_pcm_buffer &buf,
+				       unsigned int channel_count,
+				       unsigned int channel,
+				       size_t &stride)
+	{
+		uint8_t *data = static_cast<uint8_t *>(buf.data);
+		if (Interleaved) {
+			stride = Sample::size * channel_count;
+			return data + channel * Sample::size;
+		}
+		stride = Sample::size;
+		return data + channel * (buf.plane_stride
+						 ? buf.plane_stride
+						 : buf.frames * Sample::size);
+	}
+};
+
+
+template <class Sample>
+using interleaved = pcm_layout<Sample, true>;
+template <class Sample>
+using planar = pcm_layout<Sample, false>;
+
+
+namespace detail {
+
+
+/* Frame count processed per channel and per block */
+constexpr size_t block_frames = 256;
+
+
+/* Block loader and storer, selected once per buffer by the runtime
+ * dispatch */
+template <class Sample>
+struct block_codec {
+	static void
+	load(const uint8_t *src, size_t stride, int32_t *dst, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+			dst[i] = Sample::load_s32(src + i * stride);
+	}
+	static void
+	store(const int32_t *src, uint8_t *dst, size_t stride, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+			Sample::store_s32(dst + i * stride, src[i]);
+	}
+	static void
+	load_f32(const uint8_t *src, size_t stride, float *dst, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+			dst[i] = Sample::load_f32(src + i * stride);
+	}
+	static void
+	store_f32(const float *src, uint8_t *dst, size_t stride, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+			Sample::store_f32(dst + i * stride, src[i]);
+	}
+};
+
+
+struct block_fn {
+	void (*load)(const uint8_t *src, size_t stride, int32_t *dst, size_t n);
+	void (*store)(const int32_t *src,
+		      uint8_t *dst,
+		      size_t stride,
+		      size_t n);
+	void (*load_f32)(const uint8_t *src,
+			 size_t stride,
+			 float *dst,
+			 size_t n);
+	void (*store_f32)(const float *src,
+			  uint8_t *dst,
+			  size_t stride,
+			  size_t n);
+	size_t size;
+};
+
+
+template <class Sample>
+inline block_fn get_block_fn(Sample)
+{
+	return {&block_codec<Sample>::load,
+		&block_codec<Sample>::store,
+		&block_codec<Sample>::load_f32,
+		&block_codec<Sample>::store_f32,
+		Sample::size};
+}
+
+
+/* Repack a sample as the REPACK stage of the C library: samples go
+ * through floats when either side is floating-point (keeping the values
+ * above full scale, with the rounding of the float to integer stores),
+ * otherwise through left-justified 32-bit values */
+template <class S, class D>
+inline void repack_sample(uint8_t *dst, const uint8_t *src)
+{
+	if (S::float_val || D::float_val)
+		D::store_f32(dst, S::load_f32(src));
+	else
+		D::store_s32(dst, S::load_s32(src));
+}
+
+
+} /* namespace detail */
+
+
+/**
+ * Call a function with the sample type of a PCM format.
+ * The function is called with a default-constructed sample type value,
+ * e.g. with a generic lambda: [](auto sample) { using S =
+ * decltype(sample); ... }.
+ * @param format: PCM format
+ * @param f: function to call
+ * @param ret: value returned by the function (output)
+ * @return 0 on success, -ENOTSUP if the sample type is not supported,
+ *         -EINVAL if the format is not a valid PCM format
+ */
+template <class F, class R>
+inline int visit_sample(const struct adef_format &format, F &&f, R &ret)
+{
+	unsigned int width;
+	bool s, le;
+
+	if (format.encoding != ADEF_ENCODING_PCM ||
+	    !adef_is_format_valid(&format))
+		return -EINVAL;
+	if (format.pcm.float_val) {
+		ret = format.pcm.little_endian ? f(f32le()) : f(f32be());
+		return 0;
+	}
+
+	width = format.pcm.container_width ? format.pcm.container_width
+					   : (format.bit_depth + 7) / 8 * 8;
+	s = format.pcm.signed_val;
+	le = format.pcm.little_endian;
+	switch ((format.bit_depth << 8) | width) {
+	case (8 << 8) | 8:
+		ret = s ? f(s8()) : f(u8());
+		return 0;
+	case (16 << 8) | 16:
+		ret = s ? (le ? f(s16le()) : f(s16be()))
+			: (le ? f(u16le()) : f(u16be()));
+		return 0;
+	case (24 << 8) | 24:
+		ret = s ? (le ? f(s24le()) : f(s24be()))
+			: (le ? f(u24le()) : f(u24be()));
+		return 0;
+	case (24 << 8) | 32:
+		ret = s ? (le ? f(s24le4()) : f(s24be4()))
+			: (le ? f(u24le4()) : f(u24be4()));
+		return 0;
+	case (32 << 8) | 32:
+		ret = s ? (le ? f(s32le()) : f(s32be()))
+			: (le ? f(u32le()) : f(u32be()));
+		return 0;
+	default:
+		return -ENOTSUP;
+	}
+}
+
+
+/**
+ * Convert PCM samples between two layouts known at compile time.
+ * The channel count is the same on both sides; all input frames are
+ * converted, the output buffer must have at least as many frames. The
+ * samples go through left-justified 32-bit values (floats when either
+ * layout is floating-point), so that the results are identical to those of
+ * adef_pcm_convert_process() (REPACK stage). All
+ * channels of a block are processed together so that interleaved buffers
+ * are only read once from memory.
+ * @param in: input buffer (in the Src layout)
+ * @param out: output buffer (in the Dst layout)
+ * @param channel_count: channel count
+ */
+template <class Src, class Dst>
+inline void convert(const struct adef_pcm_buffer &in,
+		    const struct adef_pcm_buffer &out,
+		    unsigned int channel_count)
+{
+	using S = typename Src::sample;
+	using D = typename Dst::sample;
+
+	for (size_t f = 0; f < in.frames; f += detail::block_frames) {
+		size_t n = in.frames - f;
+		if (n > detail::block_frames)
+			n = detail::block_frames;
+		for (unsigned int c = 0; c < channel_count; c++) {
+			size_t ss, ds;
+			const uint8_t *src =
+				Src::channel(in, channel_count, c, ss);
+			uint8_t *dst = Dst::channel(out, channel_count, c, ds);
+			src += f * ss;
+			dst += f * ds;
+			for (size_t i = 0; i < n; i++)
+				detail::repack_sample<S, D>(dst + i * ds,
+							    src + i * ss);
+		}
+	}
+}
+
+
+/**
+ * Convert PCM samples between two runtime formats with the same sample
+ * rate and channels.
+ * The sample types are dispatched once per buffer, and the samples are
+ * converted block by block with loops specialized for each sample type;
+ * the results are identical to those of adef_pcm_convert_process() (REPACK
+ * stage), which is still needed for resampling or remixing.
+ * @param src: source format
+ * @param dst: destination format
+ * @param in: input buffer (in the source format)
+ * @param out: output buffer (in the destination format); its frame count
+ *             is its capacity
+ * @return 0 on success, -ENOBUFS if the output buffer is too small,
+ *         -ENOTSUP if the formats differ by more than their sample types
+ *         and interleaving, negative errno value in case of error
+ */
+inline int convert(const struct adef_format &src,
+		   const struct adef_format &dst,
+		   const struct adef_pcm_buffer &in,
+		   const struct adef_pcm_buffer &out)
+{
+	int ret;
+	detail::block_fn src_fn, dst_fn;
+	int32_t tmp[detail::block_frames];
+	float ftmp[detail::block_frames];
+	bool use_f32;
+	const uint8_t *s[ADEF_PCM_MAX_CHANNELS];
+	uint8_t *d[ADEF_PCM_MAX_CHANNELS];
+	size_t ss, ds;
+
+	if (in.data == nullptr && in.frames != 0)
+		return -EINVAL;
+	if (out.data == nullptr && in.frames != 0)
+		return -EINVAL;
+	if (src.channel_count != dst.channel_count ||
+	    src.sample_rate != dst.sample_rate ||
+	    (src.channel_layout != dst.channel_layout &&
+	     src.channel_layout != ADEF_CHANNEL_LAYOUT_UNSPECIFIED &&
+	     dst.channel_layout != ADEF_CHANNEL_LAYOUT_UNSPECIFIED) ||
+	    src.channel_count > ADEF_PCM_MAX_CHANNELS)
+		return -ENOTSUP;
+	if (out.frames < in.frames)
+		return -ENOBUFS;
+
+	/* Dispatch once per buffer */
+	auto get_fn = [](auto sample) { return detail::get_block_fn(sample); };
+	ret = visit_sample(src, get_fn, src_fn);
+	if (ret < 0)
+		return ret;
+	ret = visit_sample(dst, get_fn, dst_fn);
+	if (ret < 0)
+		return ret;
+	use_f32 = src.pcm.float_val || dst.pcm.float_val;
+
+	ss = src.pcm.interleaved ? src_fn.size * src.channel_count
+				 : src_fn.size;
+	ds = dst.pcm.interleaved ? dst_fn.size * dst.channel_count
+				 : dst_fn.size;
+	for (unsigned int c = 0; c < src.channel_count; c++) {
+		s[c] = static_cast<const uint8_t *>(in.data);
+		d[c] = static_cast<uint8_t *>(out.data);
+		if (src.pcm.interleaved)
+			s[c] += c * src_fn.size;
+		else
+			s[c] += c * (in.plane_stride ? in.plane_stride
+						     : in.frames * src_fn.size);
+		if (dst.pcm.interleaved)
+			d[c] += c * dst_fn.size;
+		else
+			d[c] += c * (out.plane_stride
+					     ? out.plane_stride
+					     : out.frames * dst_fn.size);
+	}
+
+	/* Single pass over blocks, all channels of a block together */
+	for (size_t f = 0; f < in.frames; f += detail::block_frames) {
+		size_t n = in.frames - f;
+		if (n > detail::block_frames)
+			n = detail::block_frames;
+		for (unsigned int c = 0; c < src.channel_count; c++) {
+			if (use_f32) {
+				src_fn.load_f32(s[c] + f * ss, ss, ftmp, n);
+				dst_fn.store_f32(ftmp, d[c] + f * ds, ds, n);
+			} else {
+				src_fn.load(s[c] + f * ss, ss, tmp, n);
+				dst_fn.store(tmp, d[c] + f * ds, ds, n);
+			}
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * Level meter accumulator with loops specialized for the sample types.
+ * The levels are the same as those of struct adef_pcm_meter.
+ */
+class meter {
+public:
+	meter() : m_update(nullptr), m_format(), m_frames(0), m_channels() {}
+
+	/**
+	 * Initialize or reset the accumulator; the sample type is
+	 * dispatched here, once.
+	 * @param format: PCM format of the buffers to meter
+	 * @return 0 on success, negative errno value in case of error
+	 */
+	int reset(const struct adef_format &format)
+	{
+		int ret;
+		bool dummy;
+
+		if (format.channel_count > ADEF_PCM_MAX_CHANNELS)
+			return -ENOTSUP;
+		auto select = [&](auto sample) {
+			using S = decltype(sample);
+			if (format.pcm.interleaved)
+				m_update = &meter::update_fn<interleaved<S>>;
+			else
+				m_update = &meter::update_fn<planar<S>>;
+			return true;
+		};
+		ret = visit_sample(format, select, dummy);
+		if (ret < 0)
+			return ret;
+		m_format = format;
+		clear();
+		return 0;
+	}
+
+	/**
+	 * Accumulate the levels of a buffer.
+	 * @param buf: PCM buffer (in the format given to reset())
+	 * @return 0 on success, negative errno value in case of error
+	 */
+	int update(const struct adef_pcm_buffer &buf)
+	{
+		if (m_update == nullptr)
+			return -EPROTO;
+		if (buf.data == nullptr && buf.frames != 0)
+			return -EINVAL;
+		m_update(*this, buf);
+		return 0;
+	}
+
+	/**
+	 * Accumulate the levels of a buffer with a layout known at compile
+	 * time; the layout must match the format given to reset().
+	 * @param buf: PCM buffer
+	 */
+	template <class Layout>
+	void update(const struct adef_pcm_buffer &buf)
+	{
+		using S = typename Layout::sample;
+		const uint8_t *src[ADEF_PCM_MAX_CHANNELS];
+		size_t stride = 0;
+
+		for (unsigned int c = 0; c < m_format.channel_count; c++) {
+			src[c] = Layout::channel(
+				buf, m_format.channel_count, c, stride);
+		}
+
+		/* Single pass over blocks, all channels of a block together
+		 * (and the same block sums as the C meter) */
+		for (size_t f = 0; f < buf.frames; f += detail::block_frames) {
+			size_t n = buf.frames - f;
+			if (n > detail::block_frames)
+				n = detail::block_frames;
+			for (unsigned int c = 0; c < m_format.channel_count;
+			     c++) {
+				const uint8_t *p = src[c] + f * stride;
+				if (S::float_val)
+					update_float<S>(p, stride, n, c);
+				else
+					update_int<S>(p, stride, n, c);
+			}
+		}
+		m_frames += buf.frames;
+	}
+
+
+	/**
+	 * Get the levels accumulated since the last reset.
+	 * @param levels: per-channel levels array (output)
+	 * @param count: levels array size (at most the channel count is
+	 *               filled)
+	 * @return 0 on success, negative errno value in case of error
+	 */
+	int get_levels(struct adef_pcm_level *levels, unsigned int count) const
+	{
+		if (levels == nullptr && count != 0)
+			return -EINVAL;
+		if (count > m_format.channel_count)
+			count = m_format.channel_count;
+		for (unsigned int c = 0; c < count; c++) {
+			levels[c].peak =
+				m_format.pcm.float_val
+					? m_channels[c].float_peak
+					: (float)m_channels[c].peak /
+						  2147483648.f;
+			double sum_sq = m_channels[c].sum_sq;
+			levels[c].rms = m_frames == 0
+						? 0.f
+						: (float)std::sqrt(sum_sq /
+								   m_frames);
+			levels[c].clip_count = m_channels[c].clip_count;
+		}
+		return 0;
+	}
+
+private:
+	/* Meter a block of integer samples of a channel */
+	template <class S>
+	void update_int(const uint8_t *src,
+			size_t stride,
+			size_t frames,
+			unsigned int c)
+	{
+		const int32_t clip_hi = (int32_t)(
+			0x7fffffffu & ~((1u << (32 - S::bit_depth)) - 1));
+		const float k = 1.f / 2147483648.f;
+		uint32_t peak = m_channels[c].peak;
+		uint64_t clip = 0;
+		float sum = 0.f;
+
+		for (size_t i = 0; i < frames; i++) {
+			int32_t s = S::load_s32(src + i * stride);
+			uint32_t a = (uint32_t)(s ^ (s >> 31));
+			float v = (float)s * k;
+			peak = a > peak ? a : peak;
+			sum += v * v;
+			clip += s >= clip_hi || s == INT32_MIN;
+		}
+		m_channels[c].peak = peak;
+		m_channels[c].sum_sq += sum;
+		m_channels[c].clip_count += clip;
+	}
+
+	/* Meter a block of floating-point samples of a channel, on the
+	 * float values (not clamped, NaN values count as 0) */
+	template <class S>
+	void update_float(const uint8_t *src,
+			  size_t stride,
+			  size_t frames,
+			  unsigned int c)
+	{
+		float peak = m_channels[c].float_peak;
+		uint64_t clip = 0;
+		float sum = 0.f;
+
+		for (size_t i = 0; i < frames; i++) {
+			float v = S::load_f32(src + i * stride);
+			v = v == v ? v : 0.f;
+			float a = std::fabs(v);
+			peak = a > peak ? a : peak;
+			sum += v * v;
+			clip += a >= 1.f;
+		}
+		m_channels[c].float_peak = peak;
+		m_channels[c].sum_sq += sum;
+		m_channels[c].clip_count += clip;
+	}
+
+	template <class Layout>
+	static void update_fn(meter &self, const struct adef_pcm_buffer &buf)
+	{
+		self.update<Layout>(buf);
+	}
+
+	void clear()
+	{
+		m_frames = 0;
+		for (auto &ch : m_channels)
+			ch = {};
+	}
+
+	void (*m_update)(meter &self, const struct adef_pcm_buffer &buf);
+	struct adef_format m_format;
+	uint64_t m_frames;
+	struct {
+		uint32_t peak;
+		double sum_sq;
+		uint64_t clip_count;
+		float float_peak;
+	} m_channels[ADEF_PCM_MAX_CHANNELS];
+};
+
+
+} /* namespace adef */
+
+#endif /* !_ADEFS_HPP_ */
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ADEFS_ADTS_H_
+#define _ADEFS_ADTS_H_
+
+#include <stdint.h>
+
+#include <audio-defs/adefs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+/* ADTS frame location in a file */
+struct adef_adts_frame {
+	/* Offset of the frame (ADTS header) in the file, in bytes */
+	uint64_t offset;
+
+	/* Size in bytes up to the next indexed frame (the frame length of
+	 * the ADTS header, plus any skipped invalid data) */
+	uint32_t size;
+
+	/* Timestamp of the first sample of the frame, in samples */
+	uint64_t timestamp;
+
+	/* Sample count of the frame */
+	uint32_t samples;
+};
+
+
+/* ADTS seek index (opaque structure) */
+struct adef_adts_index;
+
+
+/**
+ * Build the seek index of an ADTS file.
+ * The file is memory-mapped and its scan is split across threads; each
+ * thread synchronizes on a chain of consistent ADTS headers and the
+ * results are stitched together (the parts where a thread did not
+ * synchronize on the frames found by the previous thread are scanned
+ * again). Invalid data between frames is skipped. The index file stores
+ * the frame offsets and cumulative timestamps, and can then be opened with
+ * adef_adts_index_open().
+ * @param path: ADTS file path
+ * @param index_path: index file path (created or replaced)
+ * @param thread_count: number of scan threads, or 0 for the number of
+ *                      online CPUs
+ * @return 0 on success, -EPROTO if the file contains no ADTS frames or
+ *         frames of different sampling rates or channel configurations,
+ *         negative errno value in case of error
+ */
+ADEF_API int adef_adts_index_build(const char *path,
+				   const char *index_path,
+				   unsigned int thread_count);
+
+
+/**
+ * Open an ADTS seek index.
+ * Only the index header is read; the entries are memory-mapped and
+ * loaded on demand by the seeks.
+ * @param index_path: index file path
+ * @param path: ADTS file path (optional, can be NULL); if given, the file
+ *              size is checked against the indexed file size
+ * @param ret_obj: index handle (output)
+ * @return 0 on success, -EPROTO if the index file is invalid, -ESTALE if
+ *         the ADTS file does not match the index, negative errno value in
+ *         case of error
+ */
+ADEF_API int adef_adts_index_open(const char *index_path,
+				  const char *path,
+				  struct adef_adts_index **ret_obj);
+
+
+/**
+ * Close an ADTS seek index.
+ * @param index: index handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_adts_index_destroy(struct adef_adts_index *index);
+
+
+/**
+ * Get the properties of an indexed ADTS file.
+ * @param index: index handle
+ * @param format: audio format (output, optional)
+ * @param frame_count: frame count (output, optional)
+ * @param duration: duration in samples (output, optional)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_adts_index_get_info(struct adef_adts_index *index,
+				      struct adef_format *format,
+				      uint64_t *frame_count,
+				      uint64_t *duration);
+
+
+/**
+ * Find the frame containing a sample (binary search in the index).
+ * The frame can then be read with a single read of frame->size bytes at
+ * frame->offset in the ADTS file.
+ * @param index: index handle
+ * @param timestamp: sample timestamp, in samples
+ * @param frame: frame location (output)
+ * @return 0 on success, -ERANGE if the timestamp is after the end of the
+ *         file, negative errno value in case of error
+ */
+ADEF_API int adef_adts_index_seek(struct adef_adts_index *index,
+				  uint64_t timestamp,
+				  struct adef_adts_frame *frame);
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !_ADEFS_ADTS_H_ */
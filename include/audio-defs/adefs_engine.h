@@ -0,0 +1,224 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ADEFS_ENGINE_H_
+#define _ADEFS_ENGINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <audio-defs/adefs.h>
+#include <audio-defs/adefs_pcm.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+/* Default maximum stream count of an engine */
+#define ADEF_ENGINE_DEFAULT_MAX_STREAMS 64
+
+/* Default maximum number of pending jobs of a stream */
+#define ADEF_ENGINE_DEFAULT_STREAM_QUEUE_SIZE 16
+
+
+/* Engine configuration */
+struct adef_engine_config {
+	/* Worker thread count (0: number of online CPUs) */
+	unsigned int thread_count;
+
+	/* Maximum stream count (0: ADEF_ENGINE_DEFAULT_MAX_STREAMS) */
+	unsigned int max_streams;
+
+	/* Maximum number of submitted and not completed jobs per stream
+	 * (0: ADEF_ENGINE_DEFAULT_STREAM_QUEUE_SIZE) */
+	unsigned int stream_queue_size;
+
+	/* If true, each worker thread is bound to one CPU of the process
+	 * affinity mask (round robin) */
+	bool affinity;
+};
+
+
+/* Engine job: processing of one buffer of a stream */
+struct adef_engine_job {
+	/* Format of the input buffer */
+	struct adef_format format;
+
+	/* Input and output buffers (owned by the submitter, they must stay
+	 * valid until the job is completed) */
+	struct adef_pcm_buffer in;
+	struct adef_pcm_buffer out;
+
+	/* Information of the first frame of the input buffer */
+	struct adef_frame_info info;
+
+	/* Job private data */
+	void *userdata;
+};
+
+
+/* Engine statistics; the latencies are measured on the monotonic clock */
+struct adef_engine_stats {
+	/* Completed jobs, and jobs whose processing function failed */
+	uint64_t jobs;
+	uint64_t errors;
+
+	/* Submitted and not completed jobs, and maximum of this count */
+	unsigned int queue_depth;
+	unsigned int max_queue_depth;
+
+	/* Sums of the times from submission to the start of the processing
+	 * and from submission to completion, in nanoseconds */
+	uint64_t wait_time;
+	uint64_t latency;
+
+	/* Maximum time from submission to completion, in nanoseconds */
+	uint64_t max_latency;
+
+	/* Number of scheduling tasks taken from the queue of another worker
+	 * (engine statistics only) */
+	uint64_t steals;
+};
+
+
+/* Engine (opaque structure) */
+struct adef_engine;
+
+/* Engine stream (opaque structure) */
+struct adef_engine_stream;
+
+
+/**
+ * Job processing function.
+ * The jobs of a stream are processed in submission order, one at a time
+ * (but not always on the same thread).
+ * @param stream: stream handle
+ * @param job: job to process
+ * @param userdata: stream user data
+ * @return 0 on success, negative errno value in case of error (counted in
+ *         the statistics)
+ */
+typedef int (*adef_engine_process_t)(struct adef_engine_stream *stream,
+				     const struct adef_engine_job *job,
+				     void *userdata);
+
+
+/**
+ * Create a multi-stream processing engine.
+ * The jobs of all the streams are processed by a fixed pool of worker
+ * threads: each worker has a work-stealing queue of streams to process,
+ * and idle workers steal streams from the other workers.
+ * @param config: engine configuration (optional, can be NULL)
+ * @param ret_obj: engine handle (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_engine_new(const struct adef_engine_config *config,
+			     struct adef_engine **ret_obj);
+
+
+/**
+ * Destroy a multi-stream processing engine.
+ * The submitted jobs are completed and the remaining streams are
+ * destroyed.
+ * @param engine: engine handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_engine_destroy(struct adef_engine *engine);
+
+
+/**
+ * Get the statistics of an engine (all streams).
+ * @param engine: engine handle
+ * @param stats: statistics (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_engine_get_stats(struct adef_engine *engine,
+				   struct adef_engine_stats *stats);
+
+
+/**
+ * Create an engine stream.
+ * @param engine: engine handle
+ * @param process: job processing function
+ * @param userdata: user data passed to the processing function
+ * @param ret_obj: stream handle (output)
+ * @return 0 on success, -ENOSPC if the maximum stream count is reached,
+ *         negative errno value in case of error
+ */
+ADEF_API int adef_engine_stream_new(struct adef_engine *engine,
+				    adef_engine_process_t process,
+				    void *userdata,
+				    struct adef_engine_stream **ret_obj);
+
+
+/**
+ * Destroy an engine stream, after the completion of its submitted jobs.
+ * This function must not be called from a processing function.
+ * @param stream: stream handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_engine_stream_destroy(struct adef_engine_stream *stream);
+
+
+/**
+ * Submit a job to an engine stream.
+ * The job structure is copied. This function can be called from any
+ * thread, including from processing functions (which must then not wait
+ * for room in a full queue, as this could block all the workers).
+ * @param stream: stream handle
+ * @param job: job to submit
+ * @return 0 on success, -EAGAIN if the stream queue is full, negative
+ *         errno value in case of error
+ */
+ADEF_API int adef_engine_stream_submit(struct adef_engine_stream *stream,
+				       const struct adef_engine_job *job);
+
+
+/**
+ * Wait for the completion of the submitted jobs of an engine stream.
+ * This function must not be called from a processing function.
+ * @param stream: stream handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_engine_stream_wait(struct adef_engine_stream *stream);
+
+
+/**
+ * Get the statistics of an engine stream.
+ * @param stream: stream handle
+ * @param stats: statistics (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_engine_stream_get_stats(struct adef_engine_stream *stream,
+					  struct adef_engine_stats *stats);
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !_ADEFS_ENGINE_H_ */
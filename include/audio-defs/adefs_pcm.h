@@ -0,0 +1,1101 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ADEFS_PCM_H_
+#define _ADEFS_PCM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <audio-defs/adefs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+/* Maximum channel count supported by the PCM processing functions (one
+ * channel per bit of a channel layout mask) */
+#define ADEF_PCM_MAX_CHANNELS 32
+
+
+/* PCM buffer: memory holding samples described by a struct adef_format */
+struct adef_pcm_buffer {
+	/* Sample data; for interleaved formats, frames of channel_count
+	 * samples; for planar formats, the first sample of the first plane */
+	void *data;
+
+	/* Frame count (number of samples per channel) */
+	size_t frames;
+
+	/* Planar formats only: offset in bytes between the start of two
+	 * consecutive planes, or 0 if the planes are contiguous (i.e. the
+	 * offset is frames * sample size) */
+	size_t plane_stride;
+};
+
+
+/* Alignment in bytes of the planes of the buffers allocated by
+ * adef_pcm_buffer_alloc() (cache line size) */
+#define ADEF_PCM_BUFFER_ALIGN 64
+
+/* Minimum number of readable and writable padding bytes after the last
+ * sample of each plane of the buffers allocated by adef_pcm_buffer_alloc()
+ * (largest vector size) */
+#define ADEF_PCM_BUFFER_PADDING 64
+
+
+/* PCM buffer allocation flags */
+enum adef_pcm_alloc_flags {
+	/* Back the buffer with huge pages if possible (explicit huge pages,
+	 * or transparent huge pages otherwise), to reduce the TLB misses on
+	 * long buffers such as ring buffers; ignored for buffers smaller than
+	 * a huge page */
+	ADEF_PCM_ALLOC_HUGE_PAGES = (1 << 0),
+};
+
+
+/* Array description of a PCM buffer, following the NumPy array interface
+ * (__array_interface__), so that language bindings can expose the buffer
+ * memory as a 2-dimensional array indexed by [frame, channel] without
+ * copy */
+struct adef_pcm_array {
+	/* Array interface type string: byte order ('<' or '>', '|' for
+	 * 8-bit samples), kind ('i', 'u' or 'f') and item size in bytes,
+	 * e.g. "<i2" */
+	char typestr[4];
+
+	/* Address of the first sample of the first channel */
+	void *data;
+
+	/* Array dimensions: frame count, channel count */
+	size_t shape[2];
+
+	/* Offsets in bytes between two consecutive frames and between two
+	 * consecutive channels */
+	size_t strides[2];
+
+	/* Size in bytes of the memory spanned by the array */
+	size_t size;
+};
+
+
+/* Conversion stages */
+enum adef_pcm_stage {
+	/* Plain copy (identical formats) */
+	ADEF_PCM_STAGE_COPY = 0,
+
+	/* Integer sample repacking: endianness, sign, bit depth and
+	 * interleaving in one pass, without intermediate buffer */
+	ADEF_PCM_STAGE_REPACK,
+
+	/* Decoding to normalized floating point samples: endianness, sign,
+	 * bit depth and deinterleaving */
+	ADEF_PCM_STAGE_DECODE,
+
+	/* Channel remixing */
+	ADEF_PCM_STAGE_REMIX,
+
+	/* Sample rate conversion */
+	ADEF_PCM_STAGE_RESAMPLE,
+
+	/* Encoding from normalized floating point samples: bit depth, sign,
+	 * endianness and interleaving */
+	ADEF_PCM_STAGE_ENCODE,
+
+	/* Enum values count (invalid value) */
+	ADEF_PCM_STAGE_MAX,
+};
+
+
+/* Channel level */
+struct adef_pcm_level {
+	/* Peak absolute value, normalized to full scale (0.0 to 1.0, above
+	 * 1.0 for floating-point samples over full scale) */
+	float peak;
+
+	/* Root mean square value, normalized to full scale (0.0 to 1.0, above
+	 * 1.0 for floating-point samples over full scale) */
+	float rms;
+
+	/* Number of clipped samples (samples at the minimum or maximum
+	 * value of the format, or floating-point samples with an absolute
+	 * value of at least 1.0) */
+	uint64_t clip_count;
+};
+
+
+/* Level meter accumulator, to measure levels over windows spanning several
+ * buffers; the content is private, but the structure can be allocated
+ * anywhere (no dynamic allocation) */
+struct adef_pcm_meter {
+	/* Format of the metered buffers */
+	struct adef_format format;
+
+	/* Frame count since the last reset */
+	uint64_t frames;
+
+	/* Per-channel accumulators */
+	struct {
+		uint32_t peak;
+		double sum_sq;
+		uint64_t clip_count;
+		float float_peak;
+	} channels[ADEF_PCM_MAX_CHANNELS];
+};
+
+
+/* Requantization dither */
+enum adef_pcm_dither {
+	/* No dither: rounding to the nearest value */
+	ADEF_PCM_DITHER_NONE = 0,
+
+	/* Triangular probability density function dither of +/- 1 LSB */
+	ADEF_PCM_DITHER_TPDF,
+
+	/* Enum values count (invalid value) */
+	ADEF_PCM_DITHER_MAX,
+};
+
+
+/* Requantizer: bit depth reduction state of a stream; the content is
+ * private, but the structure can be allocated anywhere (no dynamic
+ * allocation) */
+struct adef_pcm_requantize {
+	/* Source and destination formats */
+	struct adef_format src;
+	struct adef_format dst;
+
+	/* Dither and noise shaping */
+	enum adef_pcm_dither dither;
+	bool noise_shaping;
+
+	/* Random number generator state (one per vector lane) */
+	uint32_t rng[8];
+
+	/* Noise shaping error feedback, in destination LSB */
+	float error[ADEF_PCM_MAX_CHANNELS];
+};
+
+
+/* Maximum input count of a mixer */
+#define ADEF_PCM_MIXER_MAX_INPUTS 16
+
+
+/* Mixer input */
+struct adef_pcm_mixer_input {
+	/* Input buffer */
+	struct adef_pcm_buffer buf;
+
+	/* Information of the first frame of the buffer; if the time scale is
+	 * 0, the input is aligned on the start of the output */
+	struct adef_frame_info info;
+
+	/* Linear gain */
+	float gain;
+};
+
+
+/* Mixer state; the content is private, but the structure can be
+ * allocated anywhere (no dynamic allocation) */
+struct adef_pcm_mixer {
+	/* Format of the inputs and output */
+	struct adef_format format;
+
+	/* True once the output timeline is set */
+	bool started;
+
+	/* Position of the next output frame, in samples */
+	uint64_t position;
+
+	/* Index of the next output frame */
+	uint32_t index;
+};
+
+
+/* Gain ramp shape */
+enum adef_pcm_ramp {
+	/* Linear ramp of the gain */
+	ADEF_PCM_RAMP_LINEAR = 0,
+
+	/* Exponential ramp of the gain (linear in dB); a gain of 0 is reached
+	 * from (or left to) -80 dB */
+	ADEF_PCM_RAMP_EXPONENTIAL,
+
+	/* Enum values count (invalid value) */
+	ADEF_PCM_RAMP_MAX,
+};
+
+
+/* Gain state; the content is private, but the structure can be allocated
+ * anywhere (no dynamic allocation) */
+struct adef_pcm_gain {
+	/* Format of the buffers */
+	struct adef_format format;
+
+	/* Ramp shape */
+	enum adef_pcm_ramp shape;
+
+	/* Gain before the ramp */
+	float from;
+
+	/* Gain after the ramp */
+	float to;
+
+	/* Ramp start and end positions, in samples */
+	uint64_t start;
+	uint64_t end;
+
+	/* True if the ramp starts on the next processed frame */
+	bool start_pending;
+
+	/* Position of the next frame to process, in samples */
+	uint64_t position;
+};
+
+
+/* Biquad filter types (see adef_pcm_biquad_design()) */
+enum adef_pcm_biquad_type {
+	/* DC blocker: first order high-pass filter with a zero at DC; the
+	 * frequency is the cutoff frequency, the quality factor and gain
+	 * are ignored */
+	ADEF_PCM_BIQUAD_DC_BLOCKER = 0,
+
+	/* Second order low-pass filter */
+	ADEF_PCM_BIQUAD_LOW_PASS,
+
+	/* Second order high-pass filter */
+	ADEF_PCM_BIQUAD_HIGH_PASS,
+
+	/* Peaking equalizer: gain at the center frequency, the quality
+	 * factor sets the bandwidth */
+	ADEF_PCM_BIQUAD_PEAKING,
+
+	/* Low shelf equalizer: gain below the corner frequency */
+	ADEF_PCM_BIQUAD_LOW_SHELF,
+
+	/* High shelf equalizer: gain above the corner frequency */
+	ADEF_PCM_BIQUAD_HIGH_SHELF,
+
+	/* Enum values count (invalid value) */
+	ADEF_PCM_BIQUAD_MAX,
+};
+
+
+/* Biquad filter coefficients, normalized so that a0 = 1:
+ * y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2] */
+struct adef_pcm_biquad_coefs {
+	float b0;
+	float b1;
+	float b2;
+	float a1;
+	float a2;
+};
+
+
+/* Maximum stage count of a biquad filter cascade */
+#define ADEF_PCM_BIQUAD_MAX_STAGES 8
+
+
+/* Loudness values (ITU-R BS.1770, EBU R128); the momentary and short-term
+ * values are updated every 100 ms, a loudness value is -INFINITY when
+ * undefined (silence or fully gated signal) */
+struct adef_pcm_loudness_values {
+	/* Momentary loudness (400 ms window), in LUFS */
+	float momentary;
+
+	/* Maximum momentary loudness since the last reset, in LUFS */
+	float momentary_max;
+
+	/* Short-term loudness (3 s window), in LUFS */
+	float short_term;
+
+	/* Maximum short-term loudness since the last reset, in LUFS */
+	float short_term_max;
+
+	/* Integrated (gated) loudness since the last reset, in LUFS */
+	float integrated;
+
+	/* Loudness range (EBU Tech 3342) since the last reset, in LU */
+	float range;
+
+	/* Maximum true peak level of all channels since the last reset,
+	 * in dBTP */
+	float true_peak;
+
+	/* Frame count since the last reset */
+	uint64_t frames;
+};
+
+
+/* Instruction set levels of the PCM processing kernels (see
+ * adef_pcm_simd_get()); the integer results of the kernels (saturating
+ * stores, 24-bit packing, requantization, peaks and clip counts) are
+ * identical at all levels, the floating-point results can differ in the
+ * last bits where the compiler contracts multiplications and additions.
+ * The loads and stores of the sample formats (including the native s16,
+ * s32 and f32 formats) are not dispatched: they are compiled once, for the
+ * instruction set of the build, and the processing functions which use
+ * them (conversion, meter, mixer, gain, biquad, loudness and
+ * requantization) only run their inner kernels at the selected level */
+enum adef_pcm_simd {
+	/* Plain C reference kernels */
+	ADEF_PCM_SIMD_SCALAR = 0,
+
+	/* Vector kernels for the instruction set of the build (e.g. SSE2 on
+	 * x86-64, NEON on ARMv8) */
+	ADEF_PCM_SIMD_BASELINE,
+
+	/* Vector kernels using AVX2 (x86 only) */
+	ADEF_PCM_SIMD_AVX2,
+
+	/* Enum values count (invalid value) */
+	ADEF_PCM_SIMD_MAX,
+};
+
+
+/* Environment variable forcing the level of the PCM processing kernels
+ * at load time (level name, see adef_pcm_simd_from_str()) */
+#define ADEF_PCM_SIMD_ENV "ADEF_PCM_SIMD"
+
+
+/* Forward declarations */
+struct adef_pcm_biquad;
+struct adef_pcm_convert;
+struct adef_pcm_loudness;
+struct adef_pcm_rechunk;
+
+
+/**
+ * Get the size in bytes of one sample of a PCM format.
+ * This is the size of the sample container (see the container_width field
+ * of struct adef_format).
+ * @param format: PCM format
+ * @return the sample size in bytes, or 0 if the format is not a supported
+ *         PCM format
+ */
+ADEF_API size_t adef_pcm_get_sample_size(const struct adef_format *format);
+
+
+/**
+ * Describe the memory of a PCM buffer as an array (see struct
+ * adef_pcm_array), without copy.
+ * Both interleaved and planar buffers are described as arrays indexed by
+ * [frame, channel]; only the strides differ. Samples in containers wider
+ * than the bit depth are described as container-sized integers. Packed
+ * 24-bit samples have no array item type and are not supported.
+ * @param format: PCM format of the buffer
+ * @param buf: PCM buffer
+ * @param array: array description (output)
+ * @return 0 on success, -ENOTSUP if the format has no array item type,
+ *         negative errno value in case of error
+ */
+ADEF_API int adef_pcm_buffer_to_array(const struct adef_format *format,
+				      const struct adef_pcm_buffer *buf,
+				      struct adef_pcm_array *array);
+
+
+/**
+ * Allocate a PCM buffer.
+ * The buffer is a single zero-filled memory block. Each plane (the only
+ * plane for interleaved formats) starts on an ADEF_PCM_BUFFER_ALIGN
+ * boundary and is followed by at least ADEF_PCM_BUFFER_PADDING padding
+ * bytes, so that planes never share a cache line and vector loads and
+ * stores can run past the last sample. For planar formats, the
+ * plane_stride field is set accordingly.
+ * @param format: PCM format
+ * @param frames: frame count (samples per channel)
+ * @param flags: allocation flags (see enum adef_pcm_alloc_flags)
+ * @param buf: allocated buffer (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_buffer_alloc(const struct adef_format *format,
+				   size_t frames,
+				   unsigned int flags,
+				   struct adef_pcm_buffer *buf);
+
+
+/**
+ * Resize a PCM buffer allocated by adef_pcm_buffer_alloc().
+ * The samples of the first frames (up to the smallest of the old and new
+ * frame counts) are kept, the other samples are zero-filled. The buffer
+ * is reallocated with the same flags, and its fields are updated.
+ * @param format: PCM format given at allocation
+ * @param frames: new frame count (samples per channel)
+ * @param buf: buffer to resize
+ * @return 0 on success, negative errno value in case of error (the buffer
+ *         is then unchanged)
+ */
+ADEF_API int adef_pcm_buffer_resize(const struct adef_format *format,
+				    size_t frames,
+				    struct adef_pcm_buffer *buf);
+
+
+/**
+ * Free a PCM buffer allocated by adef_pcm_buffer_alloc().
+ * The buffer fields are reset.
+ * @param buf: buffer to free
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_buffer_free(struct adef_pcm_buffer *buf);
+
+
+/**
+ * Unpack 24-bit little-endian samples from packed 3-byte containers to
+ * 4-byte little-endian containers (least significant bits).
+ * The buffers must not overlap.
+ * @param src: source samples (3 bytes each)
+ * @param dst: destination samples (4 bytes each)
+ * @param count: sample count
+ * @param signed_val: true to sign-extend the samples, false to zero-extend
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int
+adef_pcm_unpack_24le(const void *src, void *dst, size_t count, bool signed_val);
+
+
+/**
+ * Pack 24-bit little-endian samples from 4-byte little-endian containers
+ * (least significant bits) to packed 3-byte containers.
+ * The buffers must not overlap.
+ * @param src: source samples (4 bytes each)
+ * @param dst: destination samples (3 bytes each)
+ * @param count: sample count
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_pack_24le(const void *src, void *dst, size_t count);
+
+
+/**
+ * Create a PCM conversion plan.
+ * The planner compares both formats and selects the fewest stages needed
+ * (see enum adef_pcm_stage). When more than one stage is needed, all stages
+ * are run block by block on cache-sized blocks so that the input and output
+ * buffers are only accessed once. All memory is allocated here: processing
+ * with the plan never allocates.
+ * Channel remixing follows the channel layouts when they are specified
+ * (downmixing folds the missing positions into the remaining ones, LFE is
+ * dropped); sample rate conversion uses linear interpolation.
+ * @param src: source format
+ * @param dst: destination format
+ * @param ret_obj: conversion plan handle (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_convert_new(const struct adef_format *src,
+				  const struct adef_format *dst,
+				  struct adef_pcm_convert **ret_obj);
+
+
+/**
+ * Destroy a PCM conversion plan.
+ * @param conv: conversion plan handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_convert_destroy(struct adef_pcm_convert *conv);
+
+
+/**
+ * Reset the state of a PCM conversion plan (sample rate conversion
+ * history), e.g. after a discontinuity.
+ * @param conv: conversion plan handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_convert_reset(struct adef_pcm_convert *conv);
+
+
+/**
+ * Get the maximum number of output frames for a given number of input
+ * frames.
+ * @param conv: conversion plan handle
+ * @param in_frames: input frame count
+ * @return the maximum output frame count, or 0 in case of error
+ */
+ADEF_API size_t adef_pcm_convert_get_max_output(struct adef_pcm_convert *conv,
+						size_t in_frames);
+
+
+/**
+ * Convert PCM samples.
+ * All input frames are consumed. The output buffer frame count is its
+ * capacity; it must be at least adef_pcm_convert_get_max_output() frames.
+ * @param conv: conversion plan handle
+ * @param in: input buffer (in the source format)
+ * @param out: output buffer (in the destination format)
+ * @param out_frames: number of frames written to the output buffer (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_convert_process(struct adef_pcm_convert *conv,
+				      const struct adef_pcm_buffer *in,
+				      const struct adef_pcm_buffer *out,
+				      size_t *out_frames);
+
+
+/**
+ * Convert a whole PCM buffer in one call.
+ * This is a shorthand for adef_pcm_convert_new(),
+ * adef_pcm_convert_process() and adef_pcm_convert_destroy(), e.g. to
+ * convert a complete file from a language binding.
+ * @param src: source format
+ * @param dst: destination format
+ * @param in: input buffer (in the source format)
+ * @param out: output buffer (in the destination format); its frame count
+ *             is its capacity
+ * @param out_frames: number of frames written to the output buffer (output)
+ * @return 0 on success, -ENOBUFS if the output buffer is too small,
+ *         negative errno value in case of error
+ */
+ADEF_API int adef_pcm_convert_buffer(const struct adef_format *src,
+				     const struct adef_format *dst,
+				     const struct adef_pcm_buffer *in,
+				     const struct adef_pcm_buffer *out,
+				     size_t *out_frames);
+
+
+/**
+ * Get the planned stage list of a PCM conversion plan, in execution order.
+ * @param conv: conversion plan handle
+ * @param stages: stages array (output)
+ * @param count: stages array size on input, stage count on output
+ * @return 0 on success, -ENOBUFS if the array is too small, negative errno
+ *         value in case of error
+ */
+ADEF_API int adef_pcm_convert_get_stages(struct adef_pcm_convert *conv,
+					 enum adef_pcm_stage *stages,
+					 unsigned int *count);
+
+
+/**
+ * Get a string from an enum adef_pcm_stage value.
+ * @param stage: stage value to convert
+ * @return a string description of the stage
+ */
+ADEF_API const char *adef_pcm_stage_to_str(enum adef_pcm_stage stage);
+
+
+/**
+ * Initialize or reset a level meter accumulator.
+ * @param meter: level meter accumulator
+ * @param format: PCM format of the buffers to meter
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_meter_reset(struct adef_pcm_meter *meter,
+				  const struct adef_format *format);
+
+
+/**
+ * Accumulate the levels of a PCM buffer.
+ * All channels are processed in a single pass over the buffer.
+ * @param meter: level meter accumulator
+ * @param buf: PCM buffer (in the format given to adef_pcm_meter_reset())
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_meter_update(struct adef_pcm_meter *meter,
+				   const struct adef_pcm_buffer *buf);
+
+
+/**
+ * Get the levels accumulated since the last reset.
+ * @param meter: level meter accumulator
+ * @param levels: per-channel levels array (output)
+ * @param count: levels array size (at most the channel count is filled)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_meter_get_levels(const struct adef_pcm_meter *meter,
+				       struct adef_pcm_level *levels,
+				       unsigned int count);
+
+
+/**
+ * Get the per-channel levels of a PCM buffer.
+ * This is a shorthand for adef_pcm_meter_reset(), adef_pcm_meter_update()
+ * and adef_pcm_meter_get_levels().
+ * @param format: PCM format of the buffer
+ * @param buf: PCM buffer
+ * @param levels: per-channel levels array (output)
+ * @param count: levels array size (at most the channel count is filled)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_get_levels(const struct adef_format *format,
+				 const struct adef_pcm_buffer *buf,
+				 struct adef_pcm_level *levels,
+				 unsigned int count);
+
+
+/**
+ * Get the per-channel levels of consecutive windows of a PCM buffer, e.g.
+ * to get the level envelope of a complete file in one call.
+ * The levels are stored window by window, with channel_count levels per
+ * window; the last window is shorter if the frame count is not a multiple
+ * of the window size.
+ * @param format: PCM format of the buffer
+ * @param buf: PCM buffer
+ * @param window: window size in frames
+ * @param levels: levels array (output)
+ * @param count: levels array size
+ * @param window_count: number of windows (output, also set when the
+ *                      array is too small)
+ * @return 0 on success, -ENOBUFS if the levels array is too small,
+ *         negative errno value in case of error
+ */
+ADEF_API int adef_pcm_get_window_levels(const struct adef_format *format,
+					const struct adef_pcm_buffer *buf,
+					size_t window,
+					struct adef_pcm_level *levels,
+					size_t count,
+					size_t *window_count);
+
+
+/**
+ * Initialize or reset a requantizer.
+ * The formats must only differ by their bit depth, sign, endianness and
+ * interleaving. Samples are rounded to the destination bit depth, after
+ * adding the optional dither; the optional noise shaping is a first order
+ * error feedback which moves the requantization noise towards high
+ * frequencies (note: the noise shaping loop is sequential per channel and
+ * therefore not vectorized).
+ * @param rq: requantizer
+ * @param src: source format
+ * @param dst: destination format
+ * @param dither: dither type
+ * @param noise_shaping: true to enable noise shaping
+ * @param seed: random number generator seed (each stream should have its
+ *              own requantizer and seed)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_requantize_init(struct adef_pcm_requantize *rq,
+				      const struct adef_format *src,
+				      const struct adef_format *dst,
+				      enum adef_pcm_dither dither,
+				      bool noise_shaping,
+				      uint64_t seed);
+
+
+/**
+ * Requantize PCM samples.
+ * @param rq: requantizer
+ * @param in: input buffer (in the source format)
+ * @param out: output buffer (in the destination format, with at least as
+ *             many frames as the input buffer)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_requantize_process(struct adef_pcm_requantize *rq,
+					 const struct adef_pcm_buffer *in,
+					 const struct adef_pcm_buffer *out);
+
+
+/**
+ * Initialize or reset a mixer.
+ * @param mixer: mixer
+ * @param format: PCM format of the inputs and output
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_mixer_init(struct adef_pcm_mixer *mixer,
+				 const struct adef_format *format);
+
+
+/**
+ * Mix PCM inputs into an output buffer.
+ * Each input is scaled by its gain and placed on the output timeline
+ * according to its timestamp; the output is the next out->frames frames
+ * of the timeline (the first call starts the timeline at the earliest
+ * input timestamp). Input frames outside of the output window are ignored
+ * and frames without any input are silent. The sum is saturated to the
+ * range of integer formats (floating-point sums are not clipped). Signed
+ * 16-bit, 32-bit and floating-point native-endian formats have dedicated
+ * vectorized kernels.
+ * @param mixer: mixer
+ * @param inputs: inputs array
+ * @param count: input count (at most ADEF_PCM_MIXER_MAX_INPUTS)
+ * @param out: output buffer
+ * @param out_info: information of the first output frame, with a time
+ *                  scale equal to the sample rate (output, optional)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_mixer_process(struct adef_pcm_mixer *mixer,
+				    const struct adef_pcm_mixer_input *inputs,
+				    unsigned int count,
+				    const struct adef_pcm_buffer *out,
+				    struct adef_frame_info *out_info);
+
+
+/**
+ * Initialize or reset a gain.
+ * @param gain: gain
+ * @param format: PCM format of the buffers
+ * @param value: initial linear gain
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_gain_init(struct adef_pcm_gain *gain,
+				const struct adef_format *format,
+				float value);
+
+
+/**
+ * Schedule a gain ramp (a fade-in, fade-out or volume change).
+ * The ramp goes from the gain at its start position to the target value
+ * over the given duration; it replaces any previously scheduled ramp.
+ * @param gain: gain
+ * @param target: target linear gain (non-negative for an exponential ramp)
+ * @param shape: ramp shape
+ * @param start: information of the frame on which the ramp starts (the
+ *               position is computed from its timestamp, to the sample), or
+ *               NULL to start on the next processed frame
+ * @param duration: ramp duration in frames (0 for an immediate change)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_gain_set_ramp(struct adef_pcm_gain *gain,
+				    float target,
+				    enum adef_pcm_ramp shape,
+				    const struct adef_frame_info *start,
+				    uint32_t duration);
+
+
+/**
+ * Apply the gain to a PCM buffer (in place).
+ * Signed 16-bit and floating-point native-endian samples have dedicated
+ * vectorized kernels, and buffers in a constant unity gain section are
+ * left untouched.
+ * @param gain: gain
+ * @param buf: PCM buffer (in the format given to adef_pcm_gain_init())
+ * @param info: information of the first frame of the buffer, or NULL if
+ *              the buffer follows the previously processed one
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_gain_process(struct adef_pcm_gain *gain,
+				   const struct adef_pcm_buffer *buf,
+				   const struct adef_frame_info *info);
+
+
+/**
+ * Sanitize floating-point PCM samples (in place).
+ * NaN values and denormal values are replaced by 0, and values are clamped
+ * to [-limit, limit] (infinite values included).
+ * @param format: floating-point PCM format, in native endianness
+ * @param buf: PCM buffer
+ * @param limit: clamping limit (positive)
+ * @return the number of modified samples on success, negative errno value
+ *         in case of error
+ */
+ADEF_API int adef_pcm_sanitize(const struct adef_format *format,
+			       const struct adef_pcm_buffer *buf,
+			       float limit);
+
+
+
+/**
+ * Create a PCM re-chunker, which splits and joins input buffers of any
+ * size into output frames of a fixed size (e.g. 1024 samples for an
+ * AAC-LC encoder).
+ * @param format: PCM format of the input and output buffers
+ * @param frame_size: output frame size in frames (samples per channel)
+ * @param ret_obj: re-chunker handle (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_rechunk_new(const struct adef_format *format,
+				  size_t frame_size,
+				  struct adef_pcm_rechunk **ret_obj);
+
+
+/**
+ * Destroy a PCM re-chunker.
+ * @param rechunk: re-chunker handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_rechunk_destroy(struct adef_pcm_rechunk *rechunk);
+
+
+/**
+ * Give an input buffer to a PCM re-chunker.
+ * The buffer is not copied: it must stay valid until it is fully consumed
+ * by adef_pcm_rechunk_pull() (i.e. until it returns -EAGAIN). The input is
+ * considered contiguous with the previous one: time stamps are only used
+ * to compute the information of the output frames starting in this
+ * buffer.
+ * @param rechunk: re-chunker handle
+ * @param in: input buffer
+ * @param info: information of the first frame of the buffer, or NULL if
+ *              the buffer follows the previous one (the information of
+ *              the output frames is then extrapolated)
+ * @return 0 on success, -EBUSY if the previous input buffer is not fully
+ *         consumed, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_rechunk_push(struct adef_pcm_rechunk *rechunk,
+				   const struct adef_pcm_buffer *in,
+				   const struct adef_frame_info *info);
+
+
+/**
+ * Get the next output frame of a PCM re-chunker.
+ * When no samples are pending from previous inputs, the output buffer
+ * points directly to the samples of the input buffer (no copy, valid as
+ * long as the input buffer); otherwise the samples are gathered in an
+ * internal buffer (valid until the next call to this function). The
+ * output frame information has a time scale equal to the sample rate,
+ * and is computed from the information of the input buffer holding the
+ * first sample of the frame; the index counts the output frames.
+ * @param rechunk: re-chunker handle
+ * @param out: output buffer of frame_size frames (output)
+ * @param out_info: information of the output frame (output, optional)
+ * @return 0 on success, -EAGAIN if more input is needed (the remaining
+ *         input samples are then pending in the internal buffer),
+ *         negative errno value in case of error
+ */
+ADEF_API int adef_pcm_rechunk_pull(struct adef_pcm_rechunk *rechunk,
+				   struct adef_pcm_buffer *out,
+				   struct adef_frame_info *out_info);
+
+
+/**
+ * Get the pending samples of a PCM re-chunker as a last output frame
+ * padded with silence (e.g. at the end of a stream).
+ * The output is otherwise the same as for adef_pcm_rechunk_pull().
+ * @param rechunk: re-chunker handle
+ * @param out: output buffer of frame_size frames (output)
+ * @param out_info: information of the output frame (output, optional)
+ * @param valid_frames: number of frames before the padding (output,
+ *                      optional)
+ * @return 0 on success, -EAGAIN if no samples are pending, -EBUSY if the
+ *         input buffer is not fully consumed, negative errno value in case
+ *         of error
+ */
+ADEF_API int adef_pcm_rechunk_flush(struct adef_pcm_rechunk *rechunk,
+				    struct adef_pcm_buffer *out,
+				    struct adef_frame_info *out_info,
+				    size_t *valid_frames);
+
+
+/**
+ * Get an enum adef_pcm_simd value from a string.
+ * Valid strings are only the suffix of the level name (eg. 'AVX2').
+ * The case is ignored.
+ * @param str: level name to convert
+ * @return the enum adef_pcm_simd value or ADEF_PCM_SIMD_MAX if unknown
+ */
+ADEF_API enum adef_pcm_simd adef_pcm_simd_from_str(const char *str);
+
+
+/**
+ * Get a string from an enum adef_pcm_simd value.
+ * @param simd: level value to convert
+ * @return a string description of the level
+ */
+ADEF_API const char *adef_pcm_simd_to_str(enum adef_pcm_simd simd);
+
+
+/**
+ * Check whether a level of the PCM processing kernels is supported by the
+ * library build and the CPU.
+ * @param simd: level to check
+ * @return true if the level is supported, false otherwise
+ */
+ADEF_API bool adef_pcm_simd_is_supported(enum adef_pcm_simd simd);
+
+
+/**
+ * Get the current level of the PCM processing kernels.
+ * The CPU features are probed once at load time and the best supported
+ * level is selected, unless the ADEF_PCM_SIMD_ENV environment variable
+ * forces a supported level. The level only applies to the kernels, not
+ * to the loads and stores of the sample formats (see enum adef_pcm_simd).
+ * @return the current level
+ */
+ADEF_API enum adef_pcm_simd adef_pcm_simd_get(void);
+
+
+/**
+ * Set the level of the PCM processing kernels used by all the PCM
+ * processing functions of the process.
+ * Processing functions running concurrently in other threads use the new
+ * level from their next call.
+ * The level does not apply to the loads and stores of the sample formats,
+ * which are not dispatched (see enum adef_pcm_simd).
+ * @param simd: level to use
+ * @return 0 on success, -ENOTSUP if the level is not supported, negative
+ *         errno value in case of error
+ */
+ADEF_API int adef_pcm_simd_set(enum adef_pcm_simd simd);
+
+
+/**
+ * Check the kernels of all the supported levels against the scalar
+ * reference kernels, on generated samples including edge values: the
+ * integer results must be identical, the floating-point results close.
+ * The loads and stores of the sample formats are not dispatched and are
+ * not checked.
+ * @return 0 on success, -EPROTO if a kernel gives a different result,
+ *         negative errno value in case of error
+ */
+ADEF_API int adef_pcm_simd_self_test(void);
+
+
+/**
+ * Design a biquad filter.
+ * The filters other than the DC blocker follow the Audio EQ Cookbook
+ * formulas (R. Bristow-Johnson).
+ * @param type: filter type
+ * @param sample_rate: sample rate in Hz
+ * @param frequency: cutoff, corner or center frequency in Hz (below half
+ *                   the sample rate)
+ * @param q: quality factor (e.g. 0.7071 for a Butterworth low-pass or
+ *           high-pass filter)
+ * @param gain_db: gain in dB of the peaking and shelf equalizers
+ * @param coefs: filter coefficients (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_biquad_design(enum adef_pcm_biquad_type type,
+				    unsigned int sample_rate,
+				    float frequency,
+				    float q,
+				    float gain_db,
+				    struct adef_pcm_biquad_coefs *coefs);
+
+
+/**
+ * Create a cascade of biquad filters applied to all the channels of a
+ * PCM format.
+ * The channels are filtered in parallel in the lanes of the vector
+ * kernels (in groups of 8 channels), in 32-bit floating-point, with the
+ * filter state kept from one buffer to the next. Integer output samples
+ * are saturated.
+ * @param format: PCM format of the buffers
+ * @param coefs: coefficients of the stages, applied in order
+ * @param count: stage count (1 to ADEF_PCM_BIQUAD_MAX_STAGES)
+ * @param ret_obj: filter handle (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_biquad_new(const struct adef_format *format,
+				 const struct adef_pcm_biquad_coefs *coefs,
+				 unsigned int count,
+				 struct adef_pcm_biquad **ret_obj);
+
+
+/**
+ * Destroy a biquad filter cascade.
+ * @param biquad: filter handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_biquad_destroy(struct adef_pcm_biquad *biquad);
+
+
+/**
+ * Change the coefficients of a biquad filter cascade, e.g. to update an
+ * equalizer while streaming.
+ * The state of the existing stages is kept, new stages start from a
+ * zero state.
+ * @param biquad: filter handle
+ * @param coefs: coefficients of the stages, applied in order
+ * @param count: stage count (1 to ADEF_PCM_BIQUAD_MAX_STAGES)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int
+adef_pcm_biquad_set_coefs(struct adef_pcm_biquad *biquad,
+			  const struct adef_pcm_biquad_coefs *coefs,
+			  unsigned int count);
+
+
+/**
+ * Reset the state of a biquad filter cascade, e.g. after a
+ * discontinuity.
+ * @param biquad: filter handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_biquad_reset(struct adef_pcm_biquad *biquad);
+
+
+/**
+ * Filter PCM samples with a biquad filter cascade.
+ * The input and output buffers can be the same buffer (in-place
+ * filtering).
+ * @param biquad: filter handle
+ * @param in: input buffer
+ * @param out: output buffer (at least as many frames as the input)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_biquad_process(struct adef_pcm_biquad *biquad,
+				     const struct adef_pcm_buffer *in,
+				     const struct adef_pcm_buffer *out);
+
+
+
+/**
+ * Create an incremental loudness meter (ITU-R BS.1770-4 K-weighted
+ * loudness with EBU R128 gating, and true peak level).
+ * The channels are weighted according to the channel layout (low
+ * frequency effects channel ignored, +1.5 dB for the side and back
+ * channels); an unspecified layout is the default layout of the channel
+ * count (see adef_channel_layout_default()), and all the channels have a
+ * unit weight if there is none. The meter uses a constant amount of
+ * memory regardless of the measured duration.
+ * @param format: PCM format of the buffers to measure (sample rate of at
+ *                least 8 kHz)
+ * @param ret_obj: loudness meter handle (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_loudness_new(const struct adef_format *format,
+				   struct adef_pcm_loudness **ret_obj);
+
+
+/**
+ * Destroy a loudness meter.
+ * @param loudness: loudness meter handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_loudness_destroy(struct adef_pcm_loudness *loudness);
+
+
+/**
+ * Reset a loudness meter, e.g. at the start of a new program.
+ * @param loudness: loudness meter handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_loudness_reset(struct adef_pcm_loudness *loudness);
+
+
+/**
+ * Measure the loudness of a PCM buffer, following the previous buffers.
+ * @param loudness: loudness meter handle
+ * @param buf: PCM buffer (in the format given to adef_pcm_loudness_new())
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_pcm_loudness_update(struct adef_pcm_loudness *loudness,
+				      const struct adef_pcm_buffer *buf);
+
+
+/**
+ * Get the loudness values measured since the last reset.
+ * @param loudness: loudness meter handle
+ * @param values: loudness values (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int
+adef_pcm_loudness_get_values(const struct adef_pcm_loudness *loudness,
+			     struct adef_pcm_loudness_values *values);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !_ADEFS_PCM_H_ */
@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ADEFS_WAV_H_
+#define _ADEFS_WAV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <audio-defs/adefs.h>
+#include <audio-defs/adefs_pcm.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+/* Default WAV writer flush threshold in bytes */
+#define ADEF_WAV_WRITER_DEFAULT_FLUSH_SIZE (256 * 1024)
+
+
+/* WAV writer configuration */
+struct adef_wav_writer_config {
+	/* Flush threshold in bytes, rounded up to a multiple of the page
+	 * size (0: ADEF_WAV_WRITER_DEFAULT_FLUSH_SIZE); all writes but the
+	 * last one are multiples of this size at aligned file offsets */
+	size_t flush_size;
+
+	/* Size in bytes to preallocate on the file system at creation, to
+	 * limit fragmentation and allocation stalls (0: no
+	 * preallocation) */
+	uint64_t prealloc_size;
+
+	/* Amount of sample data in bytes after which the header sizes are
+	 * updated and the file is synchronized, so that an interrupted
+	 * recording leaves a playable file (0: only when closing or on
+	 * adef_wav_writer_checkpoint() calls) */
+	uint64_t checkpoint_size;
+};
+
+
+/* WAV writer (opaque structure) */
+struct adef_wav_writer;
+
+
+/**
+ * Create a WAV file writer.
+ * The format must be a little-endian PCM format (integer, signed except
+ * for 8-bit samples, or floating-point); planar buffers are interleaved
+ * when written. The WAVE_FORMAT_EXTENSIBLE header is used for more than
+ * 2 channels, for a specified non-default channel layout, or when the
+ * container width differs from the bit depth.
+ * @param path: file path (created or replaced)
+ * @param format: audio format
+ * @param config: writer configuration (optional, can be NULL)
+ * @param ret_obj: writer handle (output)
+ * @return 0 on success, -ENOTSUP if the format cannot be written to a WAV
+ *         file, negative errno value in case of error
+ */
+ADEF_API int adef_wav_writer_new(const char *path,
+				 const struct adef_format *format,
+				 const struct adef_wav_writer_config *config,
+				 struct adef_wav_writer **ret_obj);
+
+
+/**
+ * Close a WAV file writer.
+ * The buffered data is written, the header sizes are updated, and the
+ * unused preallocated space is released.
+ * @param writer: writer handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_wav_writer_destroy(struct adef_wav_writer *writer);
+
+
+/**
+ * Write samples to a WAV file.
+ * The samples are buffered until the flush threshold is reached; large
+ * interleaved buffers are written directly along with the buffered data
+ * (vectored write), without copy.
+ * @param writer: writer handle
+ * @param buf: PCM buffer in the writer format
+ * @return 0 on success, -EFBIG if the WAV file size limit (4 GiB) is
+ *         reached, negative errno value in case of error
+ */
+ADEF_API int adef_wav_writer_write(struct adef_wav_writer *writer,
+				   const struct adef_pcm_buffer *buf);
+
+
+/**
+ * Write the buffered samples, update the header sizes and synchronize the
+ * file, so that the file is playable up to this point even if the
+ * recording is interrupted (the header counts whole frames and an even
+ * data size: with an odd frame size and an odd frame count, the last frame
+ * is only counted by the next checkpoint or on destruction).
+ * @param writer: writer handle
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_wav_writer_checkpoint(struct adef_wav_writer *writer);
+
+
+/**
+ * Get the number of frames written to a WAV file writer.
+ * @param writer: writer handle
+ * @param frames: frame count, including the buffered frames (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+ADEF_API int adef_wav_writer_get_frames(struct adef_wav_writer *writer,
+					uint64_t *frames);
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !_ADEFS_WAV_H_ */
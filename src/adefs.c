@@ -29,7 +29,7 @@
 #include <stdio.h>
 #include <strings.h>
 
-#include <audio-defs/adefs.h>
+#include "adefs_priv.h"
 
 #define ULOG_TAG adef
 #include <ulog.h>
@@ -52,10 +52,12 @@ enum adef_encoding adef_encoding_from_str(const char *str)
 
 	ULOG_ERRNO_RETURN_VAL_IF(str == NULL, EINVAL, ret);
 
+	ADEF_STATS_ADD(ADEF_STAT_ENCODING_FROM_STR, 1);
 	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(encoding_map); i++) {
 		if (strcasecmp(str, encoding_map[i].str) == 0)
 			return encoding_map[i].encoding;
 	}
+	ADEF_STATS_ADD(ADEF_STAT_ENCODING_UNKNOWN, 1);
 	ULOGW("%s: unknown encoding '%s'", __func__, str);
 	return ret;
 }
@@ -109,6 +111,72 @@ const char *adef_aac_data_format_to_str(enum adef_aac_data_format data_format)
 }
 
 
+static const struct {
+	const uint32_t channel_layout;
+	const char *str;
+} channel_layout_map[] = {
+	{ADEF_CHANNEL_LAYOUT_UNSPECIFIED, "UNSPECIFIED"},
+	{ADEF_CHANNEL_LAYOUT_MONO, "MONO"},
+	{ADEF_CHANNEL_LAYOUT_STEREO, "STEREO"},
+	{ADEF_CHANNEL_LAYOUT_2_1, "2_1"},
+	{ADEF_CHANNEL_LAYOUT_QUAD, "QUAD"},
+	{ADEF_CHANNEL_LAYOUT_5_1, "5_1"},
+	{ADEF_CHANNEL_LAYOUT_7_1, "7_1"},
+};
+
+
+uint32_t adef_channel_layout_from_str(const char *str)
+{
+	uint32_t ret = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+
+	ULOG_ERRNO_RETURN_VAL_IF(str == NULL, EINVAL, ret);
+
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(channel_layout_map);
+	     i++) {
+		if (strcasecmp(str, channel_layout_map[i].str) == 0)
+			return channel_layout_map[i].channel_layout;
+	}
+	ULOGW("%s: unknown channel layout '%s'", __func__, str);
+	return ret;
+}
+
+
+const char *adef_channel_layout_to_str(uint32_t channel_layout)
+{
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(channel_layout_map);
+	     i++) {
+		if (channel_layout == channel_layout_map[i].channel_layout)
+			return channel_layout_map[i].str;
+	}
+	return "CUSTOM";
+}
+
+
+unsigned int adef_channel_layout_get_count(uint32_t channel_layout)
+{
+	return (unsigned int)__builtin_popcount(channel_layout);
+}
+
+
+uint32_t adef_channel_layout_default(unsigned int channel_count)
+{
+	switch (channel_count) {
+	case 1:
+		return ADEF_CHANNEL_LAYOUT_MONO;
+	case 2:
+		return ADEF_CHANNEL_LAYOUT_STEREO;
+	case 4:
+		return ADEF_CHANNEL_LAYOUT_QUAD;
+	case 6:
+		return ADEF_CHANNEL_LAYOUT_5_1;
+	case 8:
+		return ADEF_CHANNEL_LAYOUT_7_1;
+	default:
+		return ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	}
+}
+
+
 bool adef_is_format_valid(const struct adef_format *format)
 {
 	if (!format)
@@ -135,10 +203,48 @@ bool adef_is_format_valid(const struct adef_format *format)
 	    (!format->sample_rate))
 		return false;
 
+	/* Floating-point samples are single precision, unpadded */
+	if (format->encoding == ADEF_ENCODING_PCM && format->pcm.float_val &&
+	    (format->bit_depth != 32 || (format->pcm.container_width != 0 &&
+					 format->pcm.container_width != 32)))
+		return false;
+
+	/* A specified container must hold the samples */
+	if (format->encoding == ADEF_ENCODING_PCM &&
+	    format->pcm.container_width != 0 &&
+	    (format->pcm.container_width % 8 != 0 ||
+	     format->pcm.container_width < format->bit_depth))
+		return false;
+
+	/* A specified layout must describe every channel */
+	if (format->channel_layout != ADEF_CHANNEL_LAYOUT_UNSPECIFIED &&
+	    adef_channel_layout_get_count(format->channel_layout) !=
+		    format->channel_count)
+		return false;
+
 	return true;
 }
 
 
+/* Container width in bits, packed containers being resolved */
+static unsigned int get_container_width(const struct adef_format *format)
+{
+	if (format->pcm.container_width != 0)
+		return format->pcm.container_width;
+	return (format->bit_depth + 7) / 8 * 8;
+}
+
+
+/* Channel layout of a format, the default layout of the channel count if
+ * unspecified */
+static uint32_t get_channel_layout(const struct adef_format *format)
+{
+	if (format->channel_layout != ADEF_CHANNEL_LAYOUT_UNSPECIFIED)
+		return format->channel_layout;
+	return adef_channel_layout_default(format->channel_count);
+}
+
+
 bool adef_format_cmp(const struct adef_format *f1, const struct adef_format *f2)
 {
 	bool ret;
@@ -148,12 +254,17 @@ bool adef_format_cmp(const struct adef_format *f1, const struct adef_format *f2)
 		return false;
 	ret = f1->encoding == f2->encoding &&
 	      f1->channel_count == f2->channel_count &&
+	      get_channel_layout(f1) == get_channel_layout(f2) &&
 	      f1->bit_depth == f2->bit_depth &&
 	      f1->sample_rate == f2->sample_rate;
 	if (f1->encoding == ADEF_ENCODING_PCM)
 		ret = ret && (f1->pcm.interleaved == f2->pcm.interleaved &&
-			      f1->pcm.signed_val == f2->pcm.signed_val &&
-			      f1->pcm.little_endian == f2->pcm.little_endian);
+			      f1->pcm.float_val == f2->pcm.float_val &&
+			      (f1->pcm.float_val ||
+			       f1->pcm.signed_val == f2->pcm.signed_val) &&
+			      f1->pcm.little_endian == f2->pcm.little_endian &&
+			      get_container_width(f1) ==
+				      get_container_width(f2));
 	if (f1->encoding == ADEF_ENCODING_AAC_LC)
 		ret = ret && (f1->aac.data_format == f2->aac.data_format);
 	return ret;
@@ -164,16 +275,29 @@ bool adef_format_intersect(const struct adef_format *format,
 			   const struct adef_format *caps,
 			   unsigned int count)
 {
+	uint64_t start = ADEF_STATS_CYCLES();
+	unsigned int scanned = 0;
+	bool ret = false;
+
 	if (!caps || !adef_is_format_valid(format))
-		return false;
+		goto out;
 
 	while (count--) {
-		if (adef_format_cmp(format, caps))
-			return true;
+		scanned++;
+		if (adef_format_cmp(format, caps)) {
+			ret = true;
+			break;
+		}
 		caps++;
 	}
 
-	return false;
+out:
+	ADEF_STATS_ADD(ADEF_STAT_FORMAT_INTERSECT, 1);
+	ADEF_STATS_ADD(ADEF_STAT_FORMAT_INTERSECT_MATCH, ret);
+	ADEF_STATS_ADD(ADEF_STAT_FORMAT_INTERSECT_SCANNED, scanned);
+	ADEF_STATS_ADD(ADEF_STAT_FORMAT_INTERSECT_CYCLES,
+		       ADEF_STATS_CYCLES() - start);
+	return ret;
 }
 
 
@@ -206,6 +330,31 @@ static const struct {
 	{"pcm_16b_88200hz_stereo", &adef_pcm_16b_88200hz_stereo},
 	{"pcm_16b_96000hz_mono", &adef_pcm_16b_96000hz_mono},
 	{"pcm_16b_96000hz_stereo", &adef_pcm_16b_96000hz_stereo},
+	/* Floating-point PCM formats */
+	{"pcm_f32_8000hz_mono", &adef_pcm_f32_8000hz_mono},
+	{"pcm_f32_8000hz_stereo", &adef_pcm_f32_8000hz_stereo},
+	{"pcm_f32_11025hz_mono", &adef_pcm_f32_11025hz_mono},
+	{"pcm_f32_11025hz_stereo", &adef_pcm_f32_11025hz_stereo},
+	{"pcm_f32_12000hz_mono", &adef_pcm_f32_12000hz_mono},
+	{"pcm_f32_12000hz_stereo", &adef_pcm_f32_12000hz_stereo},
+	{"pcm_f32_16000hz_mono", &adef_pcm_f32_16000hz_mono},
+	{"pcm_f32_16000hz_stereo", &adef_pcm_f32_16000hz_stereo},
+	{"pcm_f32_22050hz_mono", &adef_pcm_f32_22050hz_mono},
+	{"pcm_f32_22050hz_stereo", &adef_pcm_f32_22050hz_stereo},
+	{"pcm_f32_24000hz_mono", &adef_pcm_f32_24000hz_mono},
+	{"pcm_f32_24000hz_stereo", &adef_pcm_f32_24000hz_stereo},
+	{"pcm_f32_32000hz_mono", &adef_pcm_f32_32000hz_mono},
+	{"pcm_f32_32000hz_stereo", &adef_pcm_f32_32000hz_stereo},
+	{"pcm_f32_44100hz_mono", &adef_pcm_f32_44100hz_mono},
+	{"pcm_f32_44100hz_stereo", &adef_pcm_f32_44100hz_stereo},
+	{"pcm_f32_48000hz_mono", &adef_pcm_f32_48000hz_mono},
+	{"pcm_f32_48000hz_stereo", &adef_pcm_f32_48000hz_stereo},
+	{"pcm_f32_64000hz_mono", &adef_pcm_f32_64000hz_mono},
+	{"pcm_f32_64000hz_stereo", &adef_pcm_f32_64000hz_stereo},
+	{"pcm_f32_88200hz_mono", &adef_pcm_f32_88200hz_mono},
+	{"pcm_f32_88200hz_stereo", &adef_pcm_f32_88200hz_stereo},
+	{"pcm_f32_96000hz_mono", &adef_pcm_f32_96000hz_mono},
+	{"pcm_f32_96000hz_stereo", &adef_pcm_f32_96000hz_stereo},
 	/* AAC profile (Low Complexity) formats: RAW */
 	{"aac_lc_16b_8000hz_mono_raw", &adef_aac_lc_16b_8000hz_mono_raw},
 	{"aac_lc_16b_8000hz_stereo_raw", &adef_aac_lc_16b_8000hz_stereo_raw},
@@ -270,6 +419,16 @@ static const struct {
 };
 
 
+bool adef_format_is_builtin(const char *str)
+{
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(format_map); i++) {
+		if (!strcasecmp(format_map[i].str, str))
+			return true;
+	}
+	return false;
+}
+
+
 static int parse_unsigned_int(const char *s, unsigned int *num)
 {
 	unsigned long parsed;
@@ -285,6 +444,32 @@ static int parse_unsigned_int(const char *s, unsigned int *num)
 }
 
 
+static int parse_channel_layout(const char *s, uint32_t *channel_layout)
+{
+	unsigned long parsed;
+	char *endptr;
+
+	/* Layout name */
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(channel_layout_map);
+	     i++) {
+		if (strcasecmp(s, channel_layout_map[i].str) == 0) {
+			*channel_layout = channel_layout_map[i].channel_layout;
+			return 0;
+		}
+	}
+
+	/* Numeric mask */
+	errno = 0;
+	parsed = strtoul(s, &endptr, 0);
+	if (*endptr != '\0' || errno != 0)
+		return -EINVAL;
+	if (parsed > UINT32_MAX)
+		return -E2BIG;
+	*channel_layout = (uint32_t)parsed;
+	return 0;
+}
+
+
 int adef_format_from_str(const char *str, struct adef_format *format)
 {
 	const char *delim = "/";
@@ -293,18 +478,32 @@ int adef_format_from_str(const char *str, struct adef_format *format)
 	char *p;
 	int ret = -EINVAL;
 	int err;
+	uint64_t start = ADEF_STATS_CYCLES();
 
 	if (!str || !format)
 		return -EINVAL;
 
+	ADEF_STATS_ADD(ADEF_STAT_FORMAT_FROM_STR, 1);
+
 	/* First find in registered formats */
 	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(format_map); i++) {
 		if (!strcasecmp(format_map[i].str, str)) {
 			memcpy(format, format_map[i].format, sizeof(*format));
+			ADEF_STATS_ADD(ADEF_STAT_FORMAT_FROM_STR_BUILTIN, 1);
+			ADEF_STATS_ADD(ADEF_STAT_FORMAT_FROM_STR_CYCLES,
+				       ADEF_STATS_CYCLES() - start);
 			return 0;
 		}
 	}
 
+	/* Then in runtime registered formats */
+	if (adef_registry_find_by_name(str, format) == 0) {
+		ADEF_STATS_ADD(ADEF_STAT_FORMAT_FROM_STR_REGISTRY, 1);
+		ADEF_STATS_ADD(ADEF_STAT_FORMAT_FROM_STR_CYCLES,
+			       ADEF_STATS_CYCLES() - start);
+		return 0;
+	}
+
 	/* Copy string for parsing */
 	s = strdup(str);
 
@@ -344,11 +543,13 @@ int adef_format_from_str(const char *str, struct adef_format *format)
 		goto out;
 	format->pcm.interleaved = !strcmp(tok, "INTERLEAVED") ? true : false;
 
-	/* Get signed value */
+	/* Get signed value (or floating-point) */
 	tok = strtok_r(NULL, delim, &p);
 	if (!tok)
 		goto out;
-	format->pcm.signed_val = !strcmp(tok, "SIGNED") ? true : false;
+	format->pcm.float_val = !strcmp(tok, "FLOAT") ? true : false;
+	format->pcm.signed_val =
+		format->pcm.float_val || !strcmp(tok, "SIGNED") ? true : false;
 
 	/* Get little endian */
 	tok = strtok_r(NULL, delim, &p);
@@ -362,6 +563,24 @@ int adef_format_from_str(const char *str, struct adef_format *format)
 		goto out;
 	format->aac.data_format = adef_aac_data_format_from_str(tok);
 
+	/* Get channel layout (optional, either a mask or a layout name) */
+	format->channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	tok = strtok_r(NULL, delim, &p);
+	if (tok) {
+		err = parse_channel_layout(tok, &format->channel_layout);
+		if (err < 0)
+			goto out;
+	}
+
+	/* Get container width (optional) */
+	format->pcm.container_width = 0;
+	tok = strtok_r(NULL, delim, &p);
+	if (tok) {
+		err = parse_unsigned_int(tok, &format->pcm.container_width);
+		if (err < 0)
+			goto out;
+	}
+
 	/* Parsing succeed */
 	ret = 0;
 
@@ -369,6 +588,11 @@ out:
 	/* Free string */
 	free(s);
 
+	ADEF_STATS_ADD(ret == 0 ? ADEF_STAT_FORMAT_FROM_STR_GENERIC
+				: ADEF_STAT_FORMAT_FROM_STR_ERROR,
+		       1);
+	ADEF_STATS_ADD(ADEF_STAT_FORMAT_FROM_STR_CYCLES,
+		       ADEF_STATS_CYCLES() - start);
 	return ret;
 }
 
@@ -386,6 +610,11 @@ char *adef_format_to_str(const struct adef_format *format)
 			return strdup(format_map[i].str);
 	}
 
+	/* Then in runtime registered formats */
+	str = adef_registry_find_by_format(format);
+	if (str != NULL)
+		return str;
+
 	/* Generate generic format name */
 	if (asprintf(&str,
 		     ADEF_FORMAT_TO_STR_FMT,
@@ -0,0 +1,692 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <audio-defs/adefs_adts.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Samples per AAC raw data block */
+#define AAC_BLOCK_SAMPLES 1024
+
+/* ADTS header size without CRC */
+#define ADTS_HEADER_SIZE 7
+
+/* AAC LC profile (audio object type minus one) */
+#define ADTS_PROFILE_LC 1
+
+/* Number of consecutive consistent headers needed to synchronize */
+#define SYNC_FRAMES 3
+
+/* Minimum size of the part of the file scanned by a thread */
+#define MIN_PART_SIZE (256 * 1024)
+
+/* Index file identification */
+#define INDEX_MAGIC "ADTSIDX"
+#define INDEX_VERSION 1
+
+
+/* Index file header (little-endian values), followed by frame_count + 1
+ * frame offsets (uint64_t, the last one being the end of the last frame)
+ * and frame_count + 1 cumulative raw data block counts (uint32_t, the
+ * last one being the total) */
+struct index_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t sample_rate;
+	uint32_t channel_count;
+	uint32_t fixed;
+	uint64_t source_size;
+	uint64_t frame_count;
+};
+
+
+struct adef_adts_index {
+	void *map;
+	size_t map_size;
+	struct adef_format format;
+	uint64_t frame_count;
+	const uint64_t *offsets;
+	const uint32_t *blocks;
+};
+
+
+struct adts_header {
+	/* Fixed header fields (identical in all frames of a stream) */
+	uint32_t fixed;
+
+	/* Frame length, including the header */
+	uint32_t length;
+
+	/* Raw data block count */
+	uint32_t blocks;
+};
+
+
+/* Part of the file scanned by a thread */
+struct scan_part {
+	const uint8_t *data;
+	size_t size;
+
+	/* Scanned range: frames starting in [start, end) */
+	size_t start;
+	size_t end;
+
+	/* Offset of the first frame found, and offset following the last
+	 * frame (or end if no frames were found) */
+	size_t first;
+	size_t next;
+
+	/* Fixed header fields of the frames (0: unknown) */
+	uint32_t fixed;
+
+	/* Frames found */
+	uint64_t *offsets;
+	uint8_t *blocks;
+	size_t count;
+	size_t capacity;
+
+	int err;
+	pthread_t thread;
+	bool thread_created;
+};
+
+
+static const unsigned int sample_rates[] = {
+	96000,
+	88200,
+	64000,
+	48000,
+	44100,
+	32000,
+	24000,
+	22050,
+	16000,
+	12000,
+	11025,
+	8000,
+	7350,
+};
+
+
+static bool
+parse_header(const uint8_t *p, size_t avail, struct adts_header *header)
+{
+	unsigned int sf_index, channel_config, header_size;
+
+	if (avail < ADTS_HEADER_SIZE)
+		return false;
+
+	/* Syncword and layer */
+	if (p[0] != 0xff || (p[1] & 0xf6) != 0xf0)
+		return false;
+	if ((p[2] >> 6) != ADTS_PROFILE_LC)
+		return false;
+	sf_index = (p[2] >> 2) & 0xf;
+	if (sf_index >= ADEF_ARRAY_SIZE(sample_rates))
+		return false;
+	/* Channel configurations defined in-band are not supported */
+	channel_config = ((p[2] & 0x1) << 2) | (p[3] >> 6);
+	if (channel_config == 0)
+		return false;
+
+	header_size = (p[1] & 0x1) ? ADTS_HEADER_SIZE : ADTS_HEADER_SIZE + 2;
+	header->length = ((p[3] & 0x3) << 11) | (p[4] << 3) | (p[5] >> 5);
+	if (header->length <= header_size)
+		return false;
+	header->blocks = (p[6] & 0x3) + 1;
+	/* ID, layer, protection, profile, sampling frequency and channel
+	 * configuration (private bit excluded) */
+	header->fixed = (p[1] << 16) | ((p[2] & 0xfd) << 8) | (p[3] & 0xc0);
+
+	return true;
+}
+
+
+/* Check whether a chain of consistent frames starts at an offset */
+static bool sync_at(const struct scan_part *part, size_t pos, uint32_t *fixed)
+{
+	struct adts_header header;
+
+	for (unsigned int i = 0; i < SYNC_FRAMES; i++) {
+		if (!parse_header(
+			    part->data + pos, part->size - pos, &header) ||
+		    (i > 0 && header.fixed != *fixed))
+			return false;
+		*fixed = header.fixed;
+		/* Truncated frame at the end of the file */
+		if (header.length > part->size - pos)
+			return i > 0;
+		pos += header.length;
+		if (pos == part->size)
+			return true;
+	}
+	return true;
+}
+
+
+/* Find the first chain of consistent frames starting in [pos, end);
+ * returns end if there is none */
+static size_t find_sync(const struct scan_part *part,
+			size_t pos,
+			size_t end,
+			uint32_t *fixed)
+{
+	const uint8_t *p;
+
+	while (pos < end) {
+		p = memchr(part->data + pos, 0xff, end - pos);
+		if (p == NULL)
+			break;
+		pos = p - part->data;
+		if (sync_at(part, pos, fixed))
+			return pos;
+		pos++;
+	}
+	return end;
+}
+
+
+static int add_frame(struct scan_part *part, size_t offset, uint32_t blocks)
+{
+	if (part->count == part->capacity) {
+		size_t capacity = part->capacity ? 2 * part->capacity : 1024;
+		uint64_t *offsets;
+		uint8_t *counts;
+		offsets = realloc(part->offsets, capacity * sizeof(*offsets));
+		if (offsets == NULL)
+			return -ENOMEM;
+		part->offsets = offsets;
+		counts = realloc(part->blocks, capacity * sizeof(*counts));
+		if (counts == NULL)
+			return -ENOMEM;
+		part->blocks = counts;
+		part->capacity = capacity;
+	}
+	part->offsets[part->count] = offset;
+	part->blocks[part->count] = blocks;
+	part->count++;
+	return 0;
+}
+
+
+/* Scan the frames of a part from an offset */
+static void scan(struct scan_part *part, size_t pos)
+{
+	struct adts_header header;
+	uint32_t fixed = part->fixed;
+
+	part->count = 0;
+	part->err = 0;
+	part->first = part->end;
+
+	while (pos < part->end) {
+		if (!parse_header(
+			    part->data + pos, part->size - pos, &header) ||
+		    header.fixed != part->fixed) {
+			/* Resynchronize */
+			pos = find_sync(part,
+					pos + (part->fixed != 0),
+					part->end,
+					&fixed);
+			if (pos >= part->end)
+				break;
+			if (part->fixed != 0 && fixed != part->fixed) {
+				ULOGE("%s: stream parameters change at "
+				      "offset %zu",
+				      __func__,
+				      pos);
+				part->err = -EPROTO;
+				break;
+			}
+			part->fixed = fixed;
+			continue;
+		}
+		/* Truncated frame at the end of the file */
+		if (header.length > part->size - pos)
+			break;
+		if (part->count == 0)
+			part->first = pos;
+		part->err = add_frame(part, pos, header.blocks);
+		if (part->err < 0)
+			break;
+		pos += header.length;
+	}
+
+	part->next = pos;
+}
+
+
+static void *scan_thread(void *userdata)
+{
+	struct scan_part *part = userdata;
+
+	scan(part, part->start);
+
+	return NULL;
+}
+
+
+static int write_full(int fd, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+	ssize_t res;
+
+	while (size > 0) {
+		res = write(fd, p, size);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		p += res;
+		size -= res;
+	}
+	return 0;
+}
+
+
+static int write_index(const char *index_path,
+		       const struct scan_part *parts,
+		       unsigned int part_count,
+		       size_t source_size)
+{
+	int ret = 0, fd = -1;
+	struct index_header header;
+	struct adts_header last;
+	uint64_t count = 0, *offsets = NULL;
+	uint32_t *blocks = NULL;
+	uint64_t total = 0, n = 0;
+	uint32_t fixed = 0;
+
+	for (unsigned int i = 0; i < part_count; i++) {
+		count += parts[i].count;
+		if (parts[i].count > 0)
+			fixed = parts[i].fixed;
+	}
+	if (count == 0) {
+		ULOGE("%s: no ADTS frames found", __func__);
+		return -EPROTO;
+	}
+
+	offsets = malloc((count + 1) * sizeof(*offsets));
+	blocks = malloc((count + 1) * sizeof(*blocks));
+	if (offsets == NULL || blocks == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (unsigned int i = 0; i < part_count; i++) {
+		for (size_t j = 0; j < parts[i].count; j++) {
+			offsets[n] = htole64(parts[i].offsets[j]);
+			blocks[n] = htole32(total);
+			total += parts[i].blocks[j];
+			n++;
+		}
+	}
+	if (total > UINT32_MAX) {
+		ret = -E2BIG;
+		goto out;
+	}
+	parse_header(parts[0].data + le64toh(offsets[count - 1]),
+		     source_size - le64toh(offsets[count - 1]),
+		     &last);
+	offsets[count] = htole64(le64toh(offsets[count - 1]) + last.length);
+	blocks[count] = htole32(total);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+	header.version = htole32(INDEX_VERSION);
+	header.sample_rate = htole32(sample_rates[(fixed >> 10) & 0xf]);
+	header.channel_count =
+		htole32(((fixed >> 6) & 0x7) == 7 ? 8 : ((fixed >> 6) & 0x7));
+	header.fixed = htole32(fixed);
+	header.source_size = htole64(source_size);
+	header.frame_count = htole64(count);
+
+	fd = open(index_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		ret = -errno;
+		ULOG_ERRNO("open('%s')", -ret, index_path);
+		goto out;
+	}
+	ret = write_full(fd, &header, sizeof(header));
+	if (ret == 0)
+		ret = write_full(fd, offsets, (count + 1) * sizeof(*offsets));
+	if (ret == 0)
+		ret = write_full(fd, blocks, (count + 1) * sizeof(*blocks));
+	if (ret < 0)
+		ULOG_ERRNO("write('%s')", -ret, index_path);
+
+out:
+	if (fd >= 0)
+		close(fd);
+	free(offsets);
+	free(blocks);
+	return ret;
+}
+
+
+int adef_adts_index_build(const char *path,
+			  const char *index_path,
+			  unsigned int thread_count)
+{
+	int ret = 0, fd;
+	struct stat st;
+	void *map = MAP_FAILED;
+	size_t size, part_size;
+	struct scan_part *parts = NULL;
+	unsigned int part_count = 0;
+	long cpus;
+
+	ULOG_ERRNO_RETURN_ERR_IF(path == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(index_path == NULL, EINVAL);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		ret = -errno;
+		ULOG_ERRNO("open('%s')", -ret, path);
+		return ret;
+	}
+	if (fstat(fd, &st) < 0) {
+		ret = -errno;
+		ULOG_ERRNO("fstat", -ret);
+		goto out;
+	}
+	size = st.st_size;
+	if (size == 0) {
+		ULOGE("%s: empty file '%s'", __func__, path);
+		ret = -EPROTO;
+		goto out;
+	}
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		ret = -errno;
+		ULOG_ERRNO("mmap", -ret);
+		goto out;
+	}
+	(void)madvise(map, size, MADV_SEQUENTIAL);
+
+	/* Split the file in parts */
+	if (thread_count == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		thread_count = cpus > 0 ? cpus : 1;
+	}
+	part_count = (size + MIN_PART_SIZE - 1) / MIN_PART_SIZE;
+	if (part_count > thread_count)
+		part_count = thread_count;
+	part_size = (size + part_count - 1) / part_count;
+	parts = calloc(part_count, sizeof(*parts));
+	if (parts == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (unsigned int i = 0; i < part_count; i++) {
+		parts[i].data = map;
+		parts[i].size = size;
+		parts[i].start = i * part_size;
+		parts[i].end = i == part_count - 1 ? size : (i + 1) * part_size;
+	}
+
+	/* Scan the parts in parallel (the first one in this thread) */
+	for (unsigned int i = 1; i < part_count; i++) {
+		int res = pthread_create(
+			&parts[i].thread, NULL, &scan_thread, &parts[i]);
+		if (res != 0) {
+			/* Scanned during the stitching */
+			ULOG_ERRNO("pthread_create", res);
+			parts[i].first = SIZE_MAX;
+			continue;
+		}
+		parts[i].thread_created = true;
+	}
+	scan(&parts[0], 0);
+	for (unsigned int i = 1; i < part_count; i++) {
+		if (parts[i].thread_created)
+			pthread_join(parts[i].thread, NULL);
+	}
+
+	/* Stitch the parts: scan again the parts which did not start where
+	 * the previous part ended */
+	for (unsigned int i = 0; i < part_count; i++) {
+		if (i > 0 && (parts[i].first != parts[i - 1].next ||
+			      parts[i].fixed != parts[i - 1].fixed)) {
+			parts[i].fixed = parts[i - 1].fixed;
+			if (parts[i - 1].next < parts[i].end) {
+				scan(&parts[i], parts[i - 1].next);
+			} else {
+				parts[i].count = 0;
+				parts[i].err = 0;
+				parts[i].first = parts[i].next =
+					parts[i - 1].next;
+			}
+		}
+		if (parts[i].err < 0) {
+			ret = parts[i].err;
+			goto out;
+		}
+	}
+
+	ret = write_index(index_path, parts, part_count, size);
+
+out:
+	if (parts != NULL) {
+		for (unsigned int i = 0; i < part_count; i++) {
+			free(parts[i].offsets);
+			free(parts[i].blocks);
+		}
+		free(parts);
+	}
+	if (map != MAP_FAILED)
+		munmap(map, size);
+	close(fd);
+	return ret;
+}
+
+
+int adef_adts_index_open(const char *index_path,
+			 const char *path,
+			 struct adef_adts_index **ret_obj)
+{
+	int ret = 0, fd;
+	struct adef_adts_index *index;
+	struct index_header header;
+	struct stat st;
+	uint64_t count;
+	ssize_t res;
+
+	ULOG_ERRNO_RETURN_ERR_IF(index_path == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	fd = open(index_path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		ret = -errno;
+		ULOG_ERRNO("open('%s')", -ret, index_path);
+		return ret;
+	}
+
+	index = calloc(1, sizeof(*index));
+	if (index == NULL) {
+		ret = -ENOMEM;
+		goto error;
+	}
+	index->map = MAP_FAILED;
+
+	/* Header */
+	res = pread(fd, &header, sizeof(header), 0);
+	if (res < 0) {
+		ret = -errno;
+		ULOG_ERRNO("pread", -ret);
+		goto error;
+	}
+	count = le64toh(header.frame_count);
+	if (fstat(fd, &st) < 0) {
+		ret = -errno;
+		ULOG_ERRNO("fstat", -ret);
+		goto error;
+	}
+	if (res != sizeof(header) ||
+	    memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+	    le32toh(header.version) != INDEX_VERSION || count == 0 ||
+	    count > SIZE_MAX / 16 ||
+	    (uint64_t)st.st_size !=
+		    sizeof(header) + (count + 1) * (sizeof(uint64_t) +
+						    sizeof(uint32_t))) {
+		ULOGE("%s: invalid index file '%s'", __func__, index_path);
+		ret = -EPROTO;
+		goto error;
+	}
+
+	/* Indexed file */
+	if (path != NULL) {
+		if (stat(path, &st) < 0) {
+			ret = -errno;
+			ULOG_ERRNO("stat('%s')", -ret, path);
+			goto error;
+		}
+		if ((uint64_t)st.st_size != le64toh(header.source_size)) {
+			ULOGE("%s: index '%s' does not match '%s'",
+			      __func__,
+			      index_path,
+			      path);
+			ret = -ESTALE;
+			goto error;
+		}
+	}
+
+	/* Entries, loaded on demand */
+	index->map_size = sizeof(header) +
+			  (count + 1) * (sizeof(uint64_t) + sizeof(uint32_t));
+	index->map = mmap(NULL, index->map_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (index->map == MAP_FAILED) {
+		ret = -errno;
+		ULOG_ERRNO("mmap", -ret);
+		goto error;
+	}
+	(void)madvise(index->map, index->map_size, MADV_RANDOM);
+	index->frame_count = count;
+	index->offsets = (const uint64_t *)((const uint8_t *)index->map +
+					    sizeof(header));
+	index->blocks = (const uint32_t *)(index->offsets + count + 1);
+
+	index->format.encoding = ADEF_ENCODING_AAC_LC;
+	index->format.channel_count = le32toh(header.channel_count);
+	index->format.channel_layout =
+		adef_channel_layout_default(index->format.channel_count);
+	index->format.bit_depth = 16;
+	index->format.sample_rate = le32toh(header.sample_rate);
+	index->format.aac.data_format = ADEF_AAC_DATA_FORMAT_ADTS;
+
+	close(fd);
+	*ret_obj = index;
+	return 0;
+
+error:
+	close(fd);
+	adef_adts_index_destroy(index);
+	return ret;
+}
+
+
+int adef_adts_index_destroy(struct adef_adts_index *index)
+{
+	if (index == NULL)
+		return 0;
+
+	if (index->map != MAP_FAILED)
+		munmap(index->map, index->map_size);
+	free(index);
+
+	return 0;
+}
+
+
+int adef_adts_index_get_info(struct adef_adts_index *index,
+			     struct adef_format *format,
+			     uint64_t *frame_count,
+			     uint64_t *duration)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(index == NULL, EINVAL);
+
+	if (format != NULL)
+		*format = index->format;
+	if (frame_count != NULL)
+		*frame_count = index->frame_count;
+	if (duration != NULL) {
+		*duration =
+			(uint64_t)le32toh(index->blocks[index->frame_count]) *
+			AAC_BLOCK_SAMPLES;
+	}
+
+	return 0;
+}
+
+
+int adef_adts_index_seek(struct adef_adts_index *index,
+			 uint64_t timestamp,
+			 struct adef_adts_frame *frame)
+{
+	uint64_t block, lo, hi, mid;
+
+	ULOG_ERRNO_RETURN_ERR_IF(index == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+
+	block = timestamp / AAC_BLOCK_SAMPLES;
+	if (block >= le32toh(index->blocks[index->frame_count]))
+		return -ERANGE;
+
+	/* Last frame starting at or before the block */
+	lo = 0;
+	hi = index->frame_count - 1;
+	while (lo < hi) {
+		mid = lo + (hi - lo + 1) / 2;
+		if (le32toh(index->blocks[mid]) <= block)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	frame->offset = le64toh(index->offsets[lo]);
+	frame->size = le64toh(index->offsets[lo + 1]) - frame->offset;
+	frame->timestamp =
+		(uint64_t)le32toh(index->blocks[lo]) * AAC_BLOCK_SAMPLES;
+	frame->samples = (le32toh(index->blocks[lo + 1]) -
+			  le32toh(index->blocks[lo])) *
+			 AAC_BLOCK_SAMPLES;
+
+	return 0;
+}
@@ -0,0 +1,454 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Caps expression fields, in the generic format string form order */
+enum caps_field_id {
+	CAPS_ENCODING = 0,
+	CAPS_CHANNEL_COUNT,
+	CAPS_BIT_DEPTH,
+	CAPS_SAMPLE_RATE,
+	CAPS_INTERLEAVED,
+	CAPS_SIGN,
+	CAPS_ENDIANNESS,
+	CAPS_AAC_DATA_FORMAT,
+	CAPS_CHANNEL_LAYOUT,
+	CAPS_CONTAINER_WIDTH,
+	CAPS_FIELD_MAX,
+};
+
+_Static_assert(CAPS_FIELD_MAX == ADEF_CAPS_FIELD_COUNT,
+	       "invalid caps field count");
+
+
+/* Sample type field values */
+enum caps_sign {
+	CAPS_SIGN_UNSIGNED = 0,
+	CAPS_SIGN_SIGNED,
+	CAPS_SIGN_FLOAT,
+};
+
+
+/* Preferred values used for fixation when there is no preferred format */
+static const struct adef_format default_format = {
+	.encoding = ADEF_ENCODING_PCM,
+	.channel_count = 2,
+	.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED,
+	.bit_depth = 16,
+	.sample_rate = 48000,
+	.pcm =
+		{
+			.interleaved = true,
+			.signed_val = true,
+			.little_endian = true,
+		},
+	.aac.data_format = ADEF_AAC_DATA_FORMAT_RAW,
+};
+
+
+static bool is_numeric_field(enum caps_field_id id)
+{
+	return id == CAPS_CHANNEL_COUNT || id == CAPS_BIT_DEPTH ||
+	       id == CAPS_SAMPLE_RATE || id == CAPS_CONTAINER_WIDTH;
+}
+
+
+static int parse_number(const char *s, int base, uint32_t *value)
+{
+	unsigned long parsed;
+	char *endptr;
+
+	if (*s == '\0' || *s == '-' || *s == '+')
+		return -EINVAL;
+	errno = 0;
+	parsed = strtoul(s, &endptr, base);
+	if (*endptr != '\0' || errno != 0)
+		return -EINVAL;
+	if (parsed > UINT32_MAX)
+		return -E2BIG;
+	*value = (uint32_t)parsed;
+	return 0;
+}
+
+
+static int parse_value(enum caps_field_id id, const char *s, uint32_t *value)
+{
+	switch (id) {
+	case CAPS_ENCODING:
+		*value = adef_encoding_from_str(s);
+		return *value == ADEF_ENCODING_UNKNOWN ? -EINVAL : 0;
+	case CAPS_INTERLEAVED:
+		if (strcasecmp(s, "INTERLEAVED") == 0)
+			*value = 1;
+		else if (strcasecmp(s, "PLANAR") == 0)
+			*value = 0;
+		else
+			return -EINVAL;
+		return 0;
+	case CAPS_SIGN:
+		if (strcasecmp(s, "UNSIGNED") == 0)
+			*value = CAPS_SIGN_UNSIGNED;
+		else if (strcasecmp(s, "SIGNED") == 0)
+			*value = CAPS_SIGN_SIGNED;
+		else if (strcasecmp(s, "FLOAT") == 0)
+			*value = CAPS_SIGN_FLOAT;
+		else
+			return -EINVAL;
+		return 0;
+	case CAPS_ENDIANNESS:
+		if (strcasecmp(s, "LE") == 0)
+			*value = 1;
+		else if (strcasecmp(s, "BE") == 0)
+			*value = 0;
+		else
+			return -EINVAL;
+		return 0;
+	case CAPS_AAC_DATA_FORMAT:
+		*value = adef_aac_data_format_from_str(s);
+		return *value == ADEF_AAC_DATA_FORMAT_UNKNOWN ? -EINVAL : 0;
+	case CAPS_CHANNEL_LAYOUT:
+		/* Either a numeric mask or a layout name */
+		if (parse_number(s, 0, value) == 0)
+			return 0;
+		*value = adef_channel_layout_from_str(s);
+		if (*value == ADEF_CHANNEL_LAYOUT_UNSPECIFIED &&
+		    strcasecmp(s, "UNSPECIFIED") != 0)
+			return -EINVAL;
+		return 0;
+	default:
+		return parse_number(s, 10, value);
+	}
+}
+
+
+static int parse_field(enum caps_field_id id,
+		       char *tok,
+		       struct adef_caps_field *field)
+{
+	int ret;
+	char *item, *p, *dash;
+	uint32_t min, max;
+
+	memset(field, 0, sizeof(*field));
+
+	if (strcmp(tok, "*") == 0) {
+		field->any = true;
+		field->mask = UINT64_MAX;
+		return 0;
+	}
+
+	for (item = strtok_r(tok, ",", &p); item != NULL;
+	     item = strtok_r(NULL, ",", &p)) {
+		if (field->count >= ADEF_CAPS_MAX_RANGES)
+			return -E2BIG;
+
+		/* Value or range */
+		dash = is_numeric_field(id) ? strchr(item, '-') : NULL;
+		if (dash != NULL)
+			*dash = '\0';
+		ret = parse_value(id, item, &min);
+		if (ret < 0)
+			return ret;
+		max = min;
+		if (dash != NULL) {
+			ret = parse_value(id, dash + 1, &max);
+			if (ret < 0)
+				return ret;
+			if (max < min)
+				return -EINVAL;
+		}
+
+		field->ranges[field->count].min = min;
+		field->ranges[field->count].max = max;
+		field->count++;
+		for (uint64_t v = min; v <= max && v < 64; v++)
+			field->mask |= UINT64_C(1) << v;
+	}
+
+	return field->count > 0 ? 0 : -EINVAL;
+}
+
+
+static inline bool field_match(const struct adef_caps_field *field,
+			       uint32_t value)
+{
+	if (value < 64)
+		return (field->mask >> value) & 1;
+	if (field->any)
+		return true;
+	for (unsigned int i = 0; i < field->count; i++) {
+		if (value >= field->ranges[i].min &&
+		    value <= field->ranges[i].max)
+			return true;
+	}
+	return false;
+}
+
+
+/* Allowed value nearest to the target in the first value or range of the
+ * field, or the target itself if allowed */
+static uint32_t field_fixate(const struct adef_caps_field *field,
+			     uint32_t target)
+{
+	if (field_match(field, target))
+		return target;
+	if (target < field->ranges[0].min)
+		return field->ranges[0].min;
+	if (target > field->ranges[0].max)
+		return field->ranges[0].max;
+	return target;
+}
+
+
+/* Check a channel layout against a caps field: an unspecified layout is
+ * the default layout of the channel count (as in adef_format_cmp()), on
+ * both the caps and the format sides */
+static bool layout_match(const struct adef_caps_field *field,
+			 uint32_t layout,
+			 unsigned int channel_count)
+{
+	uint32_t def = adef_channel_layout_default(channel_count);
+
+	if (layout == ADEF_CHANNEL_LAYOUT_UNSPECIFIED)
+		layout = def;
+	return field_match(field, layout) ||
+	       (layout == def &&
+		field_match(field, ADEF_CHANNEL_LAYOUT_UNSPECIFIED));
+}
+
+
+/* Fixate a channel layout with the same rule as layout_match(): the
+ * preferred layout if allowed, or otherwise its equivalent (unspecified or
+ * default layout of the channel count) if allowed */
+static uint32_t layout_fixate(const struct adef_caps_field *field,
+			      uint32_t layout,
+			      unsigned int channel_count)
+{
+	uint32_t def = adef_channel_layout_default(channel_count);
+
+	if (field_match(field, layout))
+		return layout;
+	if (layout == ADEF_CHANNEL_LAYOUT_UNSPECIFIED &&
+	    field_match(field, def))
+		return def;
+	if (layout == def &&
+	    field_match(field, ADEF_CHANNEL_LAYOUT_UNSPECIFIED))
+		return ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	return field_fixate(field, layout);
+}
+
+
+/* Field values of a format (the container width being resolved) */
+static void format_values(const struct adef_format *format,
+			  uint32_t values[CAPS_FIELD_MAX])
+{
+	values[CAPS_ENCODING] = format->encoding;
+	values[CAPS_CHANNEL_COUNT] = format->channel_count;
+	values[CAPS_BIT_DEPTH] = format->bit_depth;
+	values[CAPS_SAMPLE_RATE] = format->sample_rate;
+	values[CAPS_INTERLEAVED] = format->pcm.interleaved;
+	values[CAPS_SIGN] = format->pcm.float_val   ? CAPS_SIGN_FLOAT
+			    : format->pcm.signed_val ? CAPS_SIGN_SIGNED
+						     : CAPS_SIGN_UNSIGNED;
+	values[CAPS_ENDIANNESS] = format->pcm.little_endian;
+	values[CAPS_AAC_DATA_FORMAT] = format->aac.data_format;
+	values[CAPS_CHANNEL_LAYOUT] = format->channel_layout;
+	values[CAPS_CONTAINER_WIDTH] = format->pcm.container_width;
+	if (values[CAPS_CONTAINER_WIDTH] == 0)
+		values[CAPS_CONTAINER_WIDTH] = (format->bit_depth + 7) / 8 * 8;
+}
+
+
+int adef_caps_from_str(const char *str, struct adef_caps *caps)
+{
+	int ret = 0;
+	char *s, *tok, *p;
+	unsigned int i;
+
+	ULOG_ERRNO_RETURN_ERR_IF(str == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(caps == NULL, EINVAL);
+
+	s = strdup(str);
+	if (s == NULL)
+		return -ENOMEM;
+
+	tok = strtok_r(s, "/", &p);
+	for (i = 0; i < CAPS_FIELD_MAX; i++) {
+		if (tok == NULL) {
+			/* Omitted fields allow any value */
+			if (i == 0) {
+				ret = -EINVAL;
+				goto out;
+			}
+			memset(&caps->fields[i], 0, sizeof(caps->fields[i]));
+			caps->fields[i].any = true;
+			caps->fields[i].mask = UINT64_MAX;
+			continue;
+		}
+		ret = parse_field(i, tok, &caps->fields[i]);
+		if (ret < 0) {
+			ULOGE("%s: invalid caps field %u '%s' in '%s'",
+			      __func__,
+			      i,
+			      tok,
+			      str);
+			goto out;
+		}
+		tok = strtok_r(NULL, "/", &p);
+	}
+	if (tok != NULL)
+		ret = -EINVAL;
+
+out:
+	free(s);
+	return ret;
+}
+
+
+bool adef_caps_intersect(const struct adef_format *format,
+			 const struct adef_caps *caps)
+{
+	uint32_t values[CAPS_FIELD_MAX];
+	const struct adef_caps_field *fields;
+	bool ret;
+
+	if (!caps || !adef_is_format_valid(format))
+		return false;
+
+	fields = caps->fields;
+	format_values(format, values);
+	ret = field_match(&fields[CAPS_ENCODING], values[CAPS_ENCODING]) &&
+	      field_match(&fields[CAPS_CHANNEL_COUNT],
+			  values[CAPS_CHANNEL_COUNT]) &&
+	      field_match(&fields[CAPS_BIT_DEPTH], values[CAPS_BIT_DEPTH]) &&
+	      field_match(&fields[CAPS_SAMPLE_RATE],
+			  values[CAPS_SAMPLE_RATE]) &&
+	      layout_match(&fields[CAPS_CHANNEL_LAYOUT],
+			   values[CAPS_CHANNEL_LAYOUT],
+			   values[CAPS_CHANNEL_COUNT]);
+	if (format->encoding == ADEF_ENCODING_PCM) {
+		ret = ret &&
+		      field_match(&fields[CAPS_INTERLEAVED],
+				  values[CAPS_INTERLEAVED]) &&
+		      field_match(&fields[CAPS_SIGN], values[CAPS_SIGN]) &&
+		      field_match(&fields[CAPS_ENDIANNESS],
+				  values[CAPS_ENDIANNESS]) &&
+		      (field_match(&fields[CAPS_CONTAINER_WIDTH],
+				   values[CAPS_CONTAINER_WIDTH]) ||
+		       (values[CAPS_CONTAINER_WIDTH] ==
+				(format->bit_depth + 7) / 8 * 8 &&
+			field_match(&fields[CAPS_CONTAINER_WIDTH], 0)));
+	}
+	if (format->encoding == ADEF_ENCODING_AAC_LC) {
+		ret = ret && field_match(&fields[CAPS_AAC_DATA_FORMAT],
+					 values[CAPS_AAC_DATA_FORMAT]);
+	}
+	return ret;
+}
+
+
+int adef_caps_fixate(const struct adef_caps *caps,
+		     const struct adef_format *preferred,
+		     struct adef_format *format)
+{
+	uint32_t target[CAPS_FIELD_MAX];
+	const struct adef_caps_field *fields;
+
+	ULOG_ERRNO_RETURN_ERR_IF(caps == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(format == NULL, EINVAL);
+
+	fields = caps->fields;
+	if (preferred == NULL)
+		preferred = &default_format;
+	format_values(preferred, target);
+	target[CAPS_CONTAINER_WIDTH] = preferred->pcm.container_width;
+	if (target[CAPS_AAC_DATA_FORMAT] == ADEF_AAC_DATA_FORMAT_UNKNOWN)
+		target[CAPS_AAC_DATA_FORMAT] = ADEF_AAC_DATA_FORMAT_RAW;
+
+	memset(format, 0, sizeof(*format));
+	format->encoding =
+		field_fixate(&fields[CAPS_ENCODING], target[CAPS_ENCODING]);
+	format->channel_layout = layout_fixate(&fields[CAPS_CHANNEL_LAYOUT],
+					       target[CAPS_CHANNEL_LAYOUT],
+					       target[CAPS_CHANNEL_COUNT]);
+	if (format->channel_layout != ADEF_CHANNEL_LAYOUT_UNSPECIFIED) {
+		target[CAPS_CHANNEL_COUNT] =
+			adef_channel_layout_get_count(format->channel_layout);
+	}
+	format->channel_count = field_fixate(&fields[CAPS_CHANNEL_COUNT],
+					     target[CAPS_CHANNEL_COUNT]);
+	format->sample_rate = field_fixate(&fields[CAPS_SAMPLE_RATE],
+					   target[CAPS_SAMPLE_RATE]);
+
+	switch (format->encoding) {
+	case ADEF_ENCODING_PCM:
+		switch (field_fixate(&fields[CAPS_SIGN], target[CAPS_SIGN])) {
+		case CAPS_SIGN_FLOAT:
+			format->pcm.float_val = true;
+			format->pcm.signed_val = true;
+			target[CAPS_BIT_DEPTH] = 32;
+			break;
+		case CAPS_SIGN_SIGNED:
+			format->pcm.signed_val = true;
+			break;
+		default:
+			break;
+		}
+		format->pcm.interleaved = field_fixate(
+			&fields[CAPS_INTERLEAVED], target[CAPS_INTERLEAVED]);
+		format->pcm.little_endian = field_fixate(
+			&fields[CAPS_ENDIANNESS], target[CAPS_ENDIANNESS]);
+		format->pcm.container_width =
+			field_fixate(&fields[CAPS_CONTAINER_WIDTH],
+				     target[CAPS_CONTAINER_WIDTH]);
+		break;
+	case ADEF_ENCODING_AAC_LC:
+		format->aac.data_format =
+			field_fixate(&fields[CAPS_AAC_DATA_FORMAT],
+				     target[CAPS_AAC_DATA_FORMAT]);
+		break;
+	default:
+		break;
+	}
+	format->bit_depth =
+		field_fixate(&fields[CAPS_BIT_DEPTH], target[CAPS_BIT_DEPTH]);
+
+	if (!adef_caps_intersect(format, caps))
+		return -EINVAL;
+
+	return 0;
+}
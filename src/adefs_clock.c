@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Minimum number of accepted samples before rejecting outliers */
+#define MIN_SAMPLES 4
+
+/* Outlier threshold, as a multiple of the mean absolute residual */
+#define OUTLIER_FACTOR 4.
+
+/* Number of consecutive outliers after which the fit is restarted */
+#define MAX_OUTLIERS 8
+
+
+/* Convert a media timestamp to microseconds, as an integer part and a
+ * fractional part */
+static inline uint64_t
+media_to_us(uint64_t timestamp, uint32_t timescale, double *frac)
+{
+	*frac = (double)(timestamp % timescale * 1000000 % timescale) /
+		timescale;
+	return adef_rescale(timestamp, 1000000, timescale);
+}
+
+
+static void restart(struct adef_clock_mapper *mapper,
+		    uint64_t media_us,
+		    uint64_t monotonic)
+{
+	mapper->media_ref = media_us;
+	mapper->monotonic_ref = monotonic;
+	mapper->weight = 0.;
+	mapper->mean_media = 0.;
+	mapper->mean_monotonic = 0.;
+	mapper->cov_media = 0.;
+	mapper->cov_cross = 0.;
+	mapper->deviation = 0.;
+	mapper->intercept = 0.;
+	mapper->slope = 1.;
+	mapper->inv_slope = 1.;
+	mapper->count = 0;
+	mapper->outliers = 0;
+}
+
+
+int adef_clock_mapper_init(struct adef_clock_mapper *mapper,
+			   unsigned int window,
+			   uint64_t tolerance)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(mapper == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(window < 2, EINVAL);
+
+	memset(mapper, 0, sizeof(*mapper));
+	mapper->lambda = 1. - 1. / window;
+	mapper->tolerance = tolerance;
+	mapper->slope = 1.;
+	mapper->inv_slope = 1.;
+
+	return 0;
+}
+
+
+int adef_clock_mapper_update(struct adef_clock_mapper *mapper,
+			     const struct adef_frame_info *info)
+{
+	uint64_t media_us;
+	double frac, x, y, residual, threshold, w, dx, dy;
+
+	ULOG_ERRNO_RETURN_ERR_IF(mapper == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(info == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(info->timescale == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(info->capture_timestamp == 0, EINVAL);
+
+	media_us = media_to_us(info->timestamp, info->timescale, &frac);
+	if (mapper->count == 0)
+		restart(mapper, media_us, info->capture_timestamp);
+
+	x = (double)(int64_t)(media_us - mapper->media_ref) + frac;
+	y = (double)(int64_t)(info->capture_timestamp - mapper->monotonic_ref);
+	residual = fabs(y - (mapper->intercept + mapper->slope * x));
+
+	/* Outlier rejection */
+	if (mapper->count >= MIN_SAMPLES) {
+		threshold = OUTLIER_FACTOR * mapper->deviation;
+		if (threshold < mapper->tolerance)
+			threshold = mapper->tolerance;
+		if (residual > threshold) {
+			mapper->outliers++;
+			if (mapper->outliers < MAX_OUTLIERS) {
+				mapper->rejected++;
+				return 0;
+			}
+			/* Persistent outliers: the clocks have stepped */
+			mapper->restarts++;
+			restart(mapper, media_us, info->capture_timestamp);
+			x = frac;
+			y = 0.;
+			residual = 0.;
+		}
+	}
+	mapper->outliers = 0;
+
+	/* Mean absolute residual, averaged over the window */
+	if (mapper->count > 0) {
+		w = mapper->weight * mapper->lambda + 1.;
+		mapper->deviation += (residual - mapper->deviation) / w;
+	}
+
+	/* Exponentially weighted incremental least squares */
+	w = mapper->weight * mapper->lambda + 1.;
+	dx = x - mapper->mean_media;
+	dy = y - mapper->mean_monotonic;
+	mapper->mean_media += dx / w;
+	mapper->mean_monotonic += dy / w;
+	mapper->cov_media = mapper->cov_media * mapper->lambda +
+			    dx * (x - mapper->mean_media);
+	mapper->cov_cross = mapper->cov_cross * mapper->lambda +
+			    dx * (y - mapper->mean_monotonic);
+	mapper->weight = w;
+	mapper->count++;
+	mapper->accepted++;
+
+	/* Update the model; keep the nominal slope until the samples span
+	 * some media time */
+	if (mapper->cov_media > 0.)
+		mapper->slope = mapper->cov_cross / mapper->cov_media;
+	if (!(mapper->slope > 0.))
+		mapper->slope = 1.;
+	mapper->inv_slope = 1. / mapper->slope;
+	mapper->intercept =
+		mapper->mean_monotonic - mapper->slope * mapper->mean_media;
+
+	return 0;
+}
+
+
+int adef_clock_mapper_to_monotonic(const struct adef_clock_mapper *mapper,
+				   uint64_t timestamp,
+				   uint32_t timescale,
+				   uint64_t *monotonic)
+{
+	uint64_t media_us;
+	double frac, x;
+	int64_t y;
+
+	ULOG_ERRNO_RETURN_ERR_IF(mapper == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(timescale == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(monotonic == NULL, EINVAL);
+
+	if (mapper->count == 0)
+		return -EAGAIN;
+
+	media_us = media_to_us(timestamp, timescale, &frac);
+	x = (double)(int64_t)(media_us - mapper->media_ref) + frac;
+	y = llround(mapper->intercept + mapper->slope * x);
+	if (y < 0 && (uint64_t)-y > mapper->monotonic_ref)
+		return -ERANGE;
+
+	*monotonic = mapper->monotonic_ref + y;
+	return 0;
+}
+
+
+int adef_clock_mapper_to_media(const struct adef_clock_mapper *mapper,
+			       uint64_t monotonic,
+			       uint32_t timescale,
+			       uint64_t *timestamp)
+{
+	uint64_t base;
+	double y, frac;
+	int64_t x;
+
+	ULOG_ERRNO_RETURN_ERR_IF(mapper == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(timescale == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(timestamp == NULL, EINVAL);
+
+	if (mapper->count == 0)
+		return -EAGAIN;
+
+	/* The reference point is converted exactly to the time scale, only
+	 * the offset from it goes through floating point */
+	y = (double)(int64_t)(monotonic - mapper->monotonic_ref);
+	base = adef_rescale(mapper->media_ref, timescale, 1000000);
+	frac = (double)(mapper->media_ref % 1000000 * timescale % 1000000) /
+	       1000000.;
+	x = llround(frac + (y - mapper->intercept) * mapper->inv_slope *
+				   timescale / 1000000.);
+	if (x < 0 && (uint64_t)-x > base)
+		return -ERANGE;
+
+	*timestamp = base + x;
+	return 0;
+}
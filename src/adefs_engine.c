@@ -0,0 +1,711 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <audio-defs/adefs_engine.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Maximum number of consecutive jobs of a stream processed by a worker
+ * before the stream is rescheduled, so that the streams sharing a worker
+ * are processed in turn */
+#define JOB_BUDGET 4
+
+
+/* Bounded work-stealing deque of streams (Chase-Lev): the owner worker
+ * pushes and pops at the bottom, the other workers steal at the top. The
+ * capacity is the maximum stream count, as a stream is in at most one
+ * queue at a time. */
+struct deque {
+	int64_t top;
+	int64_t bottom;
+	struct adef_engine_stream **tasks;
+	int64_t mask;
+};
+
+
+struct worker {
+	struct adef_engine *engine;
+	unsigned int id;
+	struct deque deque;
+	pthread_t thread;
+	bool thread_created;
+};
+
+
+struct job_entry {
+	struct adef_engine_job job;
+	uint64_t submit_time;
+};
+
+
+struct adef_engine_stream {
+	struct adef_engine *engine;
+	unsigned int slot;
+	adef_engine_process_t process;
+	void *userdata;
+
+	/* Circular queue of the submitted and not completed jobs (the head
+	 * job is being processed if the stream is scheduled), protected by
+	 * the mutex */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct job_entry *jobs;
+	unsigned int head;
+	unsigned int count;
+
+	/* True if the stream is in a queue or being processed */
+	bool scheduled;
+
+	struct adef_engine_stats stats;
+};
+
+
+struct adef_engine {
+	struct adef_engine_config config;
+	struct worker *workers;
+	unsigned int worker_count;
+
+	/* Queue of the streams scheduled from outside of the workers and of
+	 * the rescheduled streams (FIFO), protected by the mutex (the count
+	 * is also read without the mutex to skip an empty queue) */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct adef_engine_stream **inject;
+	unsigned int inject_head;
+	unsigned int inject_count;
+
+	/* Streams, protected by the mutex */
+	struct adef_engine_stream **streams;
+	unsigned int stream_count;
+
+	/* Number of streams in the queues, and number of sleeping workers
+	 * (sequentially consistent accesses: a worker going to sleep either
+	 * sees a new stream, or is seen by the thread scheduling it) */
+	unsigned int ready;
+	unsigned int sleeping;
+	bool stop;
+
+	/* Statistics (atomic accesses) */
+	struct adef_engine_stats stats;
+};
+
+
+/* Worker of the current thread (NULL outside of the workers) */
+static __thread struct worker *s_current_worker;
+
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void atomic_max(unsigned int *ptr, unsigned int value)
+{
+	unsigned int cur = __atomic_load_n(ptr, __ATOMIC_RELAXED);
+
+	while (cur < value &&
+	       !__atomic_compare_exchange_n(ptr,
+					    &cur,
+					    value,
+					    true,
+					    __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED))
+		;
+}
+
+
+static void atomic_max64(uint64_t *ptr, uint64_t value)
+{
+	uint64_t cur = __atomic_load_n(ptr, __ATOMIC_RELAXED);
+
+	while (cur < value &&
+	       !__atomic_compare_exchange_n(ptr,
+					    &cur,
+					    value,
+					    true,
+					    __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED))
+		;
+}
+
+
+static void deque_push(struct deque *deque, struct adef_engine_stream *stream)
+{
+	int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+
+	__atomic_store_n(
+		&deque->tasks[bottom & deque->mask], stream, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+}
+
+
+static struct adef_engine_stream *deque_pop(struct deque *deque)
+{
+	int64_t bottom, top;
+	struct adef_engine_stream *stream;
+
+	bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+	if (top > bottom) {
+		/* Empty */
+		__atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	stream = __atomic_load_n(&deque->tasks[bottom & deque->mask],
+				 __ATOMIC_RELAXED);
+	if (top == bottom) {
+		/* Last stream: race with the thieves */
+		if (!__atomic_compare_exchange_n(&deque->top,
+						 &top,
+						 top + 1,
+						 false,
+						 __ATOMIC_SEQ_CST,
+						 __ATOMIC_RELAXED))
+			stream = NULL;
+		__atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+	}
+	return stream;
+}
+
+
+static struct adef_engine_stream *deque_steal(struct deque *deque)
+{
+	int64_t bottom, top;
+	struct adef_engine_stream *stream;
+
+	top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+	if (top >= bottom)
+		return NULL;
+
+	stream = __atomic_load_n(&deque->tasks[top & deque->mask],
+				 __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&deque->top,
+					 &top,
+					 top + 1,
+					 false,
+					 __ATOMIC_SEQ_CST,
+					 __ATOMIC_RELAXED))
+		return NULL;
+	return stream;
+}
+
+
+/* Put a stream in a queue: the queue of the current worker if called from
+ * a worker of the engine (unless fair is true), the injection queue
+ * otherwise */
+static void schedule(struct adef_engine *engine,
+		     struct adef_engine_stream *stream,
+		     bool fair)
+{
+	struct worker *worker = s_current_worker;
+	unsigned int max_streams = engine->config.max_streams;
+
+	if (!fair && worker != NULL && worker->engine == engine) {
+		deque_push(&worker->deque, stream);
+	} else {
+		pthread_mutex_lock(&engine->mutex);
+		engine->inject[(engine->inject_head + engine->inject_count) %
+			       max_streams] = stream;
+		__atomic_store_n(&engine->inject_count,
+				 engine->inject_count + 1,
+				 __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&engine->mutex);
+	}
+
+	__atomic_add_fetch(&engine->ready, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&engine->sleeping, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&engine->mutex);
+		pthread_cond_signal(&engine->cond);
+		pthread_mutex_unlock(&engine->mutex);
+	}
+}
+
+
+/* Take a stream to process: from the worker queue, then from the
+ * injection queue, then from the other workers queues */
+static struct adef_engine_stream *find_stream(struct worker *worker)
+{
+	struct adef_engine *engine = worker->engine;
+	struct adef_engine_stream *stream;
+	unsigned int victim;
+
+	stream = deque_pop(&worker->deque);
+	if (stream != NULL)
+		goto found;
+
+	if (__atomic_load_n(&engine->inject_count, __ATOMIC_RELAXED) > 0) {
+		pthread_mutex_lock(&engine->mutex);
+		if (engine->inject_count > 0) {
+			stream = engine->inject[engine->inject_head];
+			engine->inject_head = (engine->inject_head + 1) %
+					      engine->config.max_streams;
+			__atomic_store_n(&engine->inject_count,
+					 engine->inject_count - 1,
+					 __ATOMIC_RELAXED);
+		}
+		pthread_mutex_unlock(&engine->mutex);
+		if (stream != NULL)
+			goto found;
+	}
+
+	for (unsigned int i = 1; i < engine->worker_count; i++) {
+		victim = (worker->id + i) % engine->worker_count;
+		stream = deque_steal(&engine->workers[victim].deque);
+		if (stream != NULL) {
+			__atomic_add_fetch(
+				&engine->stats.steals, 1, __ATOMIC_RELAXED);
+			goto found;
+		}
+	}
+	return NULL;
+
+found:
+	__atomic_sub_fetch(&engine->ready, 1, __ATOMIC_SEQ_CST);
+	return stream;
+}
+
+
+static void update_stats(struct adef_engine_stats *stats,
+			 int err,
+			 uint64_t wait_time,
+			 uint64_t latency)
+{
+	__atomic_add_fetch(&stats->jobs, 1, __ATOMIC_RELAXED);
+	if (err < 0)
+		__atomic_add_fetch(&stats->errors, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&stats->queue_depth, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->wait_time, wait_time, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->latency, latency, __ATOMIC_RELAXED);
+	atomic_max64(&stats->max_latency, latency);
+}
+
+
+/* Process jobs of a scheduled stream */
+static void process_stream(struct adef_engine_stream *stream)
+{
+	struct adef_engine *engine = stream->engine;
+	struct job_entry entry;
+	uint64_t start, end;
+	int err;
+
+	for (unsigned int n = 0; n < JOB_BUDGET; n++) {
+		pthread_mutex_lock(&stream->mutex);
+		entry = stream->jobs[stream->head];
+		pthread_mutex_unlock(&stream->mutex);
+
+		start = get_time_ns();
+		err = stream->process(stream, &entry.job, stream->userdata);
+		end = get_time_ns();
+		update_stats(&engine->stats,
+			     err,
+			     start - entry.submit_time,
+			     end - entry.submit_time);
+
+		pthread_mutex_lock(&stream->mutex);
+		update_stats(&stream->stats,
+			     err,
+			     start - entry.submit_time,
+			     end - entry.submit_time);
+		stream->head = (stream->head + 1) %
+			       engine->config.stream_queue_size;
+		stream->count--;
+		if (stream->count == 0) {
+			stream->scheduled = false;
+			pthread_cond_broadcast(&stream->cond);
+			pthread_mutex_unlock(&stream->mutex);
+			return;
+		}
+		pthread_mutex_unlock(&stream->mutex);
+	}
+
+	/* Budget exhausted: let the other streams run first */
+	schedule(engine, stream, true);
+}
+
+
+static void *worker_thread(void *userdata)
+{
+	struct worker *worker = userdata;
+	struct adef_engine *engine = worker->engine;
+	struct adef_engine_stream *stream;
+
+	s_current_worker = worker;
+
+	if (engine->config.affinity) {
+#ifdef __linux__
+		cpu_set_t set;
+		unsigned int cpu, n = 0;
+		if (sched_getaffinity(0, sizeof(set), &set) == 0 &&
+		    CPU_COUNT(&set) > 0) {
+			n = worker->id % CPU_COUNT(&set);
+			for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+				if (CPU_ISSET(cpu, &set) && n-- == 0)
+					break;
+			}
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			if (sched_setaffinity(0, sizeof(set), &set) < 0)
+				ULOG_ERRNO("sched_setaffinity", errno);
+		}
+#else
+		ULOGW("%s: CPU affinity not supported", __func__);
+#endif
+	}
+
+	while (1) {
+		stream = find_stream(worker);
+		if (stream != NULL) {
+			process_stream(stream);
+			continue;
+		}
+
+		pthread_mutex_lock(&engine->mutex);
+		__atomic_add_fetch(&engine->sleeping, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&engine->ready, __ATOMIC_SEQ_CST) == 0 &&
+		       !engine->stop)
+			pthread_cond_wait(&engine->cond, &engine->mutex);
+		__atomic_sub_fetch(&engine->sleeping, 1, __ATOMIC_SEQ_CST);
+		if (engine->stop &&
+		    __atomic_load_n(&engine->ready, __ATOMIC_SEQ_CST) == 0) {
+			pthread_mutex_unlock(&engine->mutex);
+			break;
+		}
+		pthread_mutex_unlock(&engine->mutex);
+	}
+
+	return NULL;
+}
+
+
+static void stream_free(struct adef_engine_stream *stream)
+{
+	pthread_mutex_destroy(&stream->mutex);
+	pthread_cond_destroy(&stream->cond);
+	free(stream->jobs);
+	free(stream);
+}
+
+
+int adef_engine_new(const struct adef_engine_config *config,
+		    struct adef_engine **ret_obj)
+{
+	int ret;
+	struct adef_engine *engine;
+	struct worker *worker;
+	long cpus;
+	size_t capacity = 1;
+
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	engine = calloc(1, sizeof(*engine));
+	if (engine == NULL)
+		return -ENOMEM;
+	if (config != NULL)
+		engine->config = *config;
+	if (engine->config.thread_count == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		engine->config.thread_count = cpus > 0 ? cpus : 1;
+	}
+	if (engine->config.max_streams == 0)
+		engine->config.max_streams = ADEF_ENGINE_DEFAULT_MAX_STREAMS;
+	if (engine->config.stream_queue_size == 0) {
+		engine->config.stream_queue_size =
+			ADEF_ENGINE_DEFAULT_STREAM_QUEUE_SIZE;
+	}
+	while (capacity < engine->config.max_streams)
+		capacity *= 2;
+	pthread_mutex_init(&engine->mutex, NULL);
+	pthread_cond_init(&engine->cond, NULL);
+
+	engine->inject =
+		calloc(engine->config.max_streams, sizeof(*engine->inject));
+	engine->streams =
+		calloc(engine->config.max_streams, sizeof(*engine->streams));
+	engine->workers =
+		calloc(engine->config.thread_count, sizeof(*engine->workers));
+	if (engine->inject == NULL || engine->streams == NULL ||
+	    engine->workers == NULL) {
+		ret = -ENOMEM;
+		goto error;
+	}
+	for (unsigned int i = 0; i < engine->config.thread_count; i++) {
+		worker = &engine->workers[i];
+		worker->engine = engine;
+		worker->id = i;
+		worker->deque.mask = capacity - 1;
+		worker->deque.tasks =
+			calloc(capacity, sizeof(*worker->deque.tasks));
+		if (worker->deque.tasks == NULL) {
+			ret = -ENOMEM;
+			goto error;
+		}
+	}
+	engine->worker_count = engine->config.thread_count;
+
+	for (unsigned int i = 0; i < engine->worker_count; i++) {
+		worker = &engine->workers[i];
+		ret = pthread_create(
+			&worker->thread, NULL, &worker_thread, worker);
+		if (ret != 0) {
+			ULOG_ERRNO("pthread_create", ret);
+			ret = -ret;
+			goto error;
+		}
+		worker->thread_created = true;
+	}
+
+	*ret_obj = engine;
+	return 0;
+
+error:
+	adef_engine_destroy(engine);
+	return ret;
+}
+
+
+int adef_engine_destroy(struct adef_engine *engine)
+{
+	if (engine == NULL)
+		return 0;
+
+	/* Complete the submitted jobs, then stop the workers */
+	for (unsigned int i = 0; i < engine->config.max_streams; i++) {
+		if (engine->streams != NULL && engine->streams[i] != NULL)
+			adef_engine_stream_wait(engine->streams[i]);
+	}
+	pthread_mutex_lock(&engine->mutex);
+	engine->stop = true;
+	pthread_cond_broadcast(&engine->cond);
+	pthread_mutex_unlock(&engine->mutex);
+	for (unsigned int i = 0; i < engine->worker_count; i++) {
+		if (engine->workers[i].thread_created)
+			pthread_join(engine->workers[i].thread, NULL);
+	}
+
+	for (unsigned int i = 0; i < engine->config.max_streams; i++) {
+		if (engine->streams != NULL && engine->streams[i] != NULL)
+			stream_free(engine->streams[i]);
+	}
+	for (unsigned int i = 0; engine->workers != NULL &&
+				 i < engine->config.thread_count;
+	     i++)
+		free(engine->workers[i].deque.tasks);
+	free(engine->workers);
+	free(engine->streams);
+	free(engine->inject);
+	pthread_mutex_destroy(&engine->mutex);
+	pthread_cond_destroy(&engine->cond);
+	free(engine);
+
+	return 0;
+}
+
+
+int adef_engine_get_stats(struct adef_engine *engine,
+			  struct adef_engine_stats *stats)
+{
+	const struct adef_engine_stats *s;
+
+	ULOG_ERRNO_RETURN_ERR_IF(engine == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(stats == NULL, EINVAL);
+
+	s = &engine->stats;
+	stats->jobs = __atomic_load_n(&s->jobs, __ATOMIC_RELAXED);
+	stats->errors = __atomic_load_n(&s->errors, __ATOMIC_RELAXED);
+	stats->queue_depth =
+		__atomic_load_n(&s->queue_depth, __ATOMIC_RELAXED);
+	stats->max_queue_depth =
+		__atomic_load_n(&s->max_queue_depth, __ATOMIC_RELAXED);
+	stats->wait_time = __atomic_load_n(&s->wait_time, __ATOMIC_RELAXED);
+	stats->latency = __atomic_load_n(&s->latency, __ATOMIC_RELAXED);
+	stats->max_latency =
+		__atomic_load_n(&s->max_latency, __ATOMIC_RELAXED);
+	stats->steals = __atomic_load_n(&s->steals, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+
+int adef_engine_stream_new(struct adef_engine *engine,
+			   adef_engine_process_t process,
+			   void *userdata,
+			   struct adef_engine_stream **ret_obj)
+{
+	struct adef_engine_stream *stream;
+	unsigned int slot;
+
+	ULOG_ERRNO_RETURN_ERR_IF(engine == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(process == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	stream = calloc(1, sizeof(*stream));
+	if (stream == NULL)
+		return -ENOMEM;
+	stream->engine = engine;
+	stream->process = process;
+	stream->userdata = userdata;
+	stream->jobs = calloc(engine->config.stream_queue_size,
+			      sizeof(*stream->jobs));
+	if (stream->jobs == NULL) {
+		free(stream);
+		return -ENOMEM;
+	}
+	pthread_mutex_init(&stream->mutex, NULL);
+	pthread_cond_init(&stream->cond, NULL);
+
+	pthread_mutex_lock(&engine->mutex);
+	for (slot = 0; slot < engine->config.max_streams; slot++) {
+		if (engine->streams[slot] == NULL)
+			break;
+	}
+	if (slot == engine->config.max_streams) {
+		pthread_mutex_unlock(&engine->mutex);
+		stream_free(stream);
+		ULOGE("%s: maximum stream count reached", __func__);
+		return -ENOSPC;
+	}
+	stream->slot = slot;
+	engine->streams[slot] = stream;
+	engine->stream_count++;
+	pthread_mutex_unlock(&engine->mutex);
+
+	*ret_obj = stream;
+	return 0;
+}
+
+
+int adef_engine_stream_destroy(struct adef_engine_stream *stream)
+{
+	struct adef_engine *engine;
+
+	if (stream == NULL)
+		return 0;
+
+	engine = stream->engine;
+	adef_engine_stream_wait(stream);
+
+	pthread_mutex_lock(&engine->mutex);
+	engine->streams[stream->slot] = NULL;
+	engine->stream_count--;
+	pthread_mutex_unlock(&engine->mutex);
+	stream_free(stream);
+
+	return 0;
+}
+
+
+int adef_engine_stream_submit(struct adef_engine_stream *stream,
+			      const struct adef_engine_job *job)
+{
+	struct adef_engine *engine;
+	unsigned int queue_size;
+	struct job_entry *entry;
+	bool need_schedule = false;
+
+	ULOG_ERRNO_RETURN_ERR_IF(stream == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(job == NULL, EINVAL);
+
+	engine = stream->engine;
+	queue_size = engine->config.stream_queue_size;
+
+	pthread_mutex_lock(&stream->mutex);
+	if (stream->count == queue_size) {
+		pthread_mutex_unlock(&stream->mutex);
+		return -EAGAIN;
+	}
+	entry = &stream->jobs[(stream->head + stream->count) % queue_size];
+	entry->job = *job;
+	entry->submit_time = get_time_ns();
+	stream->count++;
+	stream->stats.queue_depth++;
+	if (stream->stats.queue_depth > stream->stats.max_queue_depth)
+		stream->stats.max_queue_depth = stream->stats.queue_depth;
+	/* Counted in the engine before the job is visible to the workers
+	 * (stream mutex held), so that its completion cannot decrement the
+	 * engine queue depth first */
+	atomic_max(&engine->stats.max_queue_depth,
+		   __atomic_add_fetch(
+			   &engine->stats.queue_depth, 1, __ATOMIC_RELAXED));
+	if (!stream->scheduled) {
+		stream->scheduled = true;
+		need_schedule = true;
+	}
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (need_schedule)
+		schedule(engine, stream, false);
+
+	return 0;
+}
+
+
+int adef_engine_stream_wait(struct adef_engine_stream *stream)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(stream == NULL, EINVAL);
+
+	pthread_mutex_lock(&stream->mutex);
+	while (stream->count > 0)
+		pthread_cond_wait(&stream->cond, &stream->mutex);
+	pthread_mutex_unlock(&stream->mutex);
+
+	return 0;
+}
+
+
+int adef_engine_stream_get_stats(struct adef_engine_stream *stream,
+				 struct adef_engine_stats *stats)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(stream == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(stats == NULL, EINVAL);
+
+	pthread_mutex_lock(&stream->mutex);
+	*stats = stream->stats;
+	pthread_mutex_unlock(&stream->mutex);
+
+	return 0;
+}
@@ -33,7 +33,7 @@
 
 /* Build a PCM format from:
  * - Encoding
- * - Channel count
+ * - Channel count (MONO or STEREO, also used for the channel layout)
  * - Bit depth
  * - Sample rate
  * - (PCM-specific) Interleaved
@@ -51,6 +51,7 @@
 	const struct adef_format _name = {                                     \
 		.encoding = ADEF_ENCODING_##_encoding,                         \
 		.channel_count = _channel_count,                               \
+		.channel_layout = ADEF_CHANNEL_LAYOUT_##_channel_count,        \
 		.bit_depth = _bit_depth,                                       \
 		.sample_rate = _sample_rate,                                   \
 		.pcm =                                                         \
@@ -260,9 +261,61 @@ ADEF_MAKE_PCM_FORMAT(adef_pcm_16b_96000hz_stereo,
 		     true);
 
 
+/* Build a 32-bit floating-point, little-endian, interleaved PCM format
+ * from:
+ * - Channel count (MONO or STEREO, also used for the channel layout)
+ * - Sample rate
+ */
+#define ADEF_MAKE_PCM_F32_FORMAT(_name, _channel_count, _sample_rate)          \
+	const struct adef_format _name = {                                     \
+		.encoding = ADEF_ENCODING_PCM,                                 \
+		.channel_count = _channel_count,                               \
+		.channel_layout = ADEF_CHANNEL_LAYOUT_##_channel_count,        \
+		.bit_depth = 32,                                               \
+		.sample_rate = _sample_rate,                                   \
+		.pcm =                                                         \
+			{                                                      \
+				.interleaved = true,                           \
+				.signed_val = true,                            \
+				.float_val = true,                             \
+				.little_endian = true,                         \
+			},                                                     \
+		.aac =                                                         \
+			{                                                      \
+				.data_format = ADEF_AAC_DATA_FORMAT_UNKNOWN,   \
+			},                                                     \
+	}
+
+/* Floating-point PCM formats */
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_8000hz_mono, MONO, 8000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_8000hz_stereo, STEREO, 8000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_11025hz_mono, MONO, 11025);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_11025hz_stereo, STEREO, 11025);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_12000hz_mono, MONO, 12000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_12000hz_stereo, STEREO, 12000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_16000hz_mono, MONO, 16000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_16000hz_stereo, STEREO, 16000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_22050hz_mono, MONO, 22050);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_22050hz_stereo, STEREO, 22050);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_24000hz_mono, MONO, 24000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_24000hz_stereo, STEREO, 24000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_32000hz_mono, MONO, 32000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_32000hz_stereo, STEREO, 32000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_44100hz_mono, MONO, 44100);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_44100hz_stereo, STEREO, 44100);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_48000hz_mono, MONO, 48000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_48000hz_stereo, STEREO, 48000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_64000hz_mono, MONO, 64000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_64000hz_stereo, STEREO, 64000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_88200hz_mono, MONO, 88200);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_88200hz_stereo, STEREO, 88200);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_96000hz_mono, MONO, 96000);
+ADEF_MAKE_PCM_F32_FORMAT(adef_pcm_f32_96000hz_stereo, STEREO, 96000);
+
+
 /* Build an AAC_LC format from:
  * - Encoding
- * - Channel count
+ * - Channel count (MONO or STEREO, also used for the channel layout)
  * - Bit depth
  * - Sample rate
  * - (AAC-specific) Data format
@@ -276,6 +329,7 @@ ADEF_MAKE_PCM_FORMAT(adef_pcm_16b_96000hz_stereo,
 	const struct adef_format _name = {                                     \
 		.encoding = ADEF_ENCODING_##_encoding,                         \
 		.channel_count = _channel_count,                               \
+		.channel_layout = ADEF_CHANNEL_LAYOUT_##_channel_count,        \
 		.bit_depth = _bit_depth,                                       \
 		.sample_rate = _sample_rate,                                   \
 		.pcm =                                                         \
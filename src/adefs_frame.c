@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+static const struct {
+	const enum adef_frame_event_type type;
+	const char *str;
+} frame_event_type_map[] = {
+	{ADEF_FRAME_EVENT_GAP, "GAP"},
+	{ADEF_FRAME_EVENT_OVERLAP, "OVERLAP"},
+	{ADEF_FRAME_EVENT_INDEX_JUMP, "INDEX_JUMP"},
+	{ADEF_FRAME_EVENT_TIMESCALE_CHANGE, "TIMESCALE_CHANGE"},
+};
+
+
+const char *adef_frame_event_type_to_str(enum adef_frame_event_type type)
+{
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(frame_event_type_map);
+	     i++) {
+		if (type == frame_event_type_map[i].type)
+			return frame_event_type_map[i].str;
+	}
+	return "UNKNOWN";
+}
+
+
+struct event_output {
+	struct adef_frame_event *events;
+	size_t max_events;
+	size_t count;
+};
+
+
+static void add_event(struct adef_frame_analyzer *analyzer,
+		      struct event_output *out,
+		      enum adef_frame_event_type type,
+		      int64_t value)
+{
+	analyzer->counts[type]++;
+	if (out->count >= out->max_events)
+		return;
+	out->events[out->count].type = type;
+	out->events[out->count].offset = analyzer->offset;
+	out->events[out->count].value = value;
+	out->count++;
+}
+
+
+/* Analyze a frame which does not simply follow the previous one */
+static void analyze_slow(struct adef_frame_analyzer *analyzer,
+			 const struct adef_frame_info *info,
+			 struct event_output *out)
+{
+	const struct adef_frame_info *last = &analyzer->last;
+	uint64_t expected;
+	uint32_t expected_index = last->index + 1;
+	int64_t diff;
+
+	if (info->index != expected_index) {
+		add_event(analyzer,
+			  out,
+			  ADEF_FRAME_EVENT_INDEX_JUMP,
+			  (int32_t)(info->index - expected_index));
+	}
+
+	if (info->timescale != last->timescale) {
+		add_event(analyzer,
+			  out,
+			  ADEF_FRAME_EVENT_TIMESCALE_CHANGE,
+			  info->timescale);
+		if (info->timescale == 0 || last->timescale == 0)
+			return;
+		analyzer->tolerance = adef_rescale(
+			analyzer->tolerance, info->timescale, last->timescale);
+		/* Without a nominal duration the expected timestamp is
+		 * unknown: the duration is learned in the new time scale */
+		if (analyzer->duration == 0)
+			return;
+		expected = adef_rescale(last->timestamp + analyzer->duration,
+					info->timescale,
+					last->timescale);
+		analyzer->duration = adef_rescale(
+			analyzer->duration, info->timescale, last->timescale);
+	} else if (info->timescale == 0) {
+		return;
+	} else if (analyzer->duration == 0) {
+		/* Learn the nominal duration from the first increment */
+		if (info->timestamp > last->timestamp)
+			analyzer->duration = info->timestamp - last->timestamp;
+		return;
+	} else {
+		expected = last->timestamp + analyzer->duration;
+	}
+
+	diff = (int64_t)(info->timestamp - expected);
+	if (diff > (int64_t)analyzer->tolerance)
+		add_event(analyzer, out, ADEF_FRAME_EVENT_GAP, diff);
+	else if (diff < -(int64_t)analyzer->tolerance)
+		add_event(analyzer, out, ADEF_FRAME_EVENT_OVERLAP, diff);
+}
+
+
+int adef_frame_analyzer_init(struct adef_frame_analyzer *analyzer,
+			     uint64_t duration,
+			     uint64_t tolerance)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(analyzer == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(duration > INT64_MAX, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(tolerance > INT64_MAX, EINVAL);
+
+	memset(analyzer, 0, sizeof(*analyzer));
+	analyzer->duration = duration;
+	analyzer->tolerance = tolerance;
+
+	return 0;
+}
+
+
+int adef_frame_analyzer_process(struct adef_frame_analyzer *analyzer,
+				const struct adef_frame_info *infos,
+				size_t count,
+				struct adef_frame_event *events,
+				size_t max_events,
+				size_t *event_count)
+{
+	struct event_output out = {
+		.events = events,
+		.max_events = max_events,
+	};
+	struct adef_frame_info last;
+	uint64_t base, duration, tolerance;
+	size_t i = 0;
+
+	ULOG_ERRNO_RETURN_ERR_IF(analyzer == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(infos == NULL && count != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(events == NULL && max_events != 0, EINVAL);
+
+	base = analyzer->offset;
+	if (count > 0 && !analyzer->started) {
+		analyzer->started = true;
+		analyzer->last = infos[0];
+		i = 1;
+	}
+
+	/* Fast path: a frame which follows the previous one (same non-null
+	 * time scale, next index, timestamp within the tolerance window
+	 * checked with a single unsigned comparison) only updates the last
+	 * frame */
+	last = analyzer->last;
+	duration = analyzer->duration;
+	tolerance = analyzer->tolerance;
+	for (; i < count; i++) {
+		const struct adef_frame_info *info = &infos[i];
+		uint64_t delta = info->timestamp - last.timestamp - duration;
+		if (__builtin_expect(info->timescale == last.timescale &&
+					     info->timescale != 0 &&
+					     info->index == last.index + 1 &&
+					     duration != 0 &&
+					     delta + tolerance <= 2 * tolerance,
+				     1)) {
+			last = *info;
+			continue;
+		}
+
+		/* Slow path */
+		analyzer->last = last;
+		analyzer->offset = base + i;
+		analyze_slow(analyzer, info, &out);
+		last = *info;
+		duration = analyzer->duration;
+		tolerance = analyzer->tolerance;
+	}
+
+	analyzer->offset = base + count;
+	analyzer->last = last;
+	if (event_count != NULL)
+		*event_count = out.count;
+
+	return 0;
+}
@@ -0,0 +1,611 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Encoded data: a sequence of blocks, each made of a header (varint
+ * record count, varint payload size) and a payload holding one column per
+ * field. A column starts with the first value (varint) and, for
+ * delta-of-delta columns, the first delta (zigzag varint); the residuals
+ * of the following records are then stored by groups of up to
+ * GROUP_SIZE values, as a width byte followed by the zigzag residuals
+ * bit-packed LSB first on that width. Integer fields are extended to 64
+ * bits and all the arithmetic wraps around, so that any value round-trips
+ * exactly. */
+
+/* Number of residuals sharing a bit width */
+#define GROUP_SIZE 32
+
+/* Maximum encoded size of a 64-bit varint */
+#define VARINT_MAX_SIZE 10
+
+/* Readable bytes needed after the packed data of a group by the unpacking
+ * 64-bit loads */
+#define UNPACK_PADDING 8
+
+
+enum column {
+	COLUMN_TIMESTAMP = 0,
+	COLUMN_TIMESCALE,
+	COLUMN_CAPTURE_TIMESTAMP,
+	COLUMN_INDEX,
+	COLUMN_COUNT,
+};
+
+
+/* Delta order of the columns: the time scale is mostly constant, the
+ * other fields mostly increase at a constant rate */
+static const unsigned int column_order[COLUMN_COUNT] = {
+	[COLUMN_TIMESTAMP] = 2,
+	[COLUMN_TIMESCALE] = 1,
+	[COLUMN_CAPTURE_TIMESTAMP] = 2,
+	[COLUMN_INDEX] = 2,
+};
+
+
+struct adef_frame_recorder {
+	/* Pending records */
+	struct adef_frame_info *records;
+	unsigned int record_count;
+	unsigned int block_size;
+
+	/* Recorded data */
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+};
+
+
+static inline uint64_t zigzag_encode(uint64_t v)
+{
+	return (v << 1) ^ (uint64_t)((int64_t)v >> 63);
+}
+
+
+static inline uint64_t zigzag_decode(uint64_t v)
+{
+	return (v >> 1) ^ -(v & 1);
+}
+
+
+static inline uint64_t load_le64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+#if ADEF_HOST_LITTLE_ENDIAN
+	return v;
+#else
+	return __builtin_bswap64(v);
+#endif
+}
+
+
+static inline void store_le64(uint8_t *p, uint64_t v)
+{
+#if !ADEF_HOST_LITTLE_ENDIAN
+	v = __builtin_bswap64(v);
+#endif
+	memcpy(p, &v, sizeof(v));
+}
+
+
+static size_t put_varint(uint8_t *p, uint64_t v)
+{
+	size_t len = 0;
+
+	while (v >= 0x80) {
+		p[len++] = (uint8_t)v | 0x80;
+		v >>= 7;
+	}
+	p[len++] = (uint8_t)v;
+	return len;
+}
+
+
+static int get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v)
+{
+	const uint8_t *q = *p;
+	uint64_t value = 0;
+
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		if (q == end)
+			return -EPROTO;
+		value |= (uint64_t)(*q & 0x7f) << shift;
+		if ((*q++ & 0x80) == 0) {
+			*p = q;
+			*v = value;
+			return 0;
+		}
+	}
+	return -EPROTO;
+}
+
+
+static inline uint64_t column_get(const struct adef_frame_info *info,
+				  enum column column)
+{
+	switch (column) {
+	case COLUMN_TIMESTAMP:
+		return info->timestamp;
+	case COLUMN_TIMESCALE:
+		return info->timescale;
+	case COLUMN_CAPTURE_TIMESTAMP:
+		return info->capture_timestamp;
+	case COLUMN_INDEX:
+	default:
+		return info->index;
+	}
+}
+
+
+static inline void column_set(struct adef_frame_info *info,
+			      enum column column,
+			      uint64_t value)
+{
+	switch (column) {
+	case COLUMN_TIMESTAMP:
+		info->timestamp = value;
+		break;
+	case COLUMN_TIMESCALE:
+		info->timescale = (uint32_t)value;
+		break;
+	case COLUMN_CAPTURE_TIMESTAMP:
+		info->capture_timestamp = value;
+		break;
+	case COLUMN_INDEX:
+	default:
+		info->index = (uint32_t)value;
+		break;
+	}
+}
+
+
+/* Worst-case encoded size of a block */
+static size_t block_bound(unsigned int count)
+{
+	size_t groups = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+
+	return 2 * VARINT_MAX_SIZE +
+	       COLUMN_COUNT * (2 * VARINT_MAX_SIZE + groups +
+			       (size_t)count * sizeof(uint64_t));
+}
+
+
+/* Bit-pack values of at most width bits; returns the end of the packed
+ * data (ceil(count * width / 8) bytes) */
+static uint8_t *
+pack_bits(const uint64_t *values, unsigned int count, unsigned int width,
+	  uint8_t *p)
+{
+	uint64_t acc = 0;
+	unsigned int bits = 0;
+
+	if (width == 0)
+		return p;
+
+	for (unsigned int i = 0; i < count; i++) {
+		acc |= values[i] << bits;
+		if (bits + width < 64) {
+			bits += width;
+			continue;
+		}
+		store_le64(p, acc);
+		p += 8;
+		acc = (bits == 0) ? 0 : values[i] >> (64 - bits);
+		bits = bits + width - 64;
+	}
+	for (; bits > 0; bits = (bits > 8) ? bits - 8 : 0) {
+		*p++ = (uint8_t)acc;
+		acc >>= 8;
+	}
+	return p;
+}
+
+
+/* Unpack the value of width bits (1 to 64) at a bit offset;
+ * UNPACK_PADDING bytes must be readable after the packed data */
+static inline uint64_t
+unpack_bits(const uint8_t *p, size_t bit, unsigned int width, uint64_t mask)
+{
+	const uint8_t *q = p + (bit >> 3);
+	unsigned int shift = bit & 7;
+	uint64_t v = load_le64(q) >> shift;
+
+	if (shift + width > 64)
+		v |= (uint64_t)q[8] << (64 - shift);
+	return v & mask;
+}
+
+
+static uint8_t *encode_column(const struct adef_frame_info *records,
+			      unsigned int count,
+			      enum column column,
+			      uint8_t *p)
+{
+	unsigned int order = column_order[column];
+	uint64_t residuals[GROUP_SIZE];
+	uint64_t prev, prev_delta = 0, value, delta, acc;
+	unsigned int i, j, n, width;
+
+	prev = column_get(&records[0], column);
+	p += put_varint(p, prev);
+	if (order == 2) {
+		if (count > 1)
+			prev_delta = column_get(&records[1], column) - prev;
+		p += put_varint(p, zigzag_encode(prev_delta));
+	}
+
+	for (i = 1; i < count; i += n) {
+		n = count - i;
+		if (n > GROUP_SIZE)
+			n = GROUP_SIZE;
+		acc = 0;
+		for (j = 0; j < n; j++) {
+			value = column_get(&records[i + j], column);
+			delta = value - prev;
+			residuals[j] = zigzag_encode(
+				(order == 2) ? delta - prev_delta : delta);
+			acc |= residuals[j];
+			prev = value;
+			prev_delta = delta;
+		}
+		width = (acc == 0) ? 0 : 64 - __builtin_clzll(acc);
+		*p++ = width;
+		p = pack_bits(residuals, n, width, p);
+	}
+
+	return p;
+}
+
+
+/* Always inlined with a constant column, so that the order and the store
+ * loops are resolved at compile time */
+static inline __attribute__((always_inline)) int
+decode_column(const uint8_t **p,
+	      const uint8_t *end,
+	      unsigned int count,
+	      enum column column,
+	      struct adef_frame_info *infos)
+{
+	int ret;
+	unsigned int order = column_order[column];
+	uint8_t padded[GROUP_SIZE * sizeof(uint64_t) + UNPACK_PADDING];
+	uint64_t prev, prev_delta = 0, delta, mask;
+	const uint8_t *q;
+	unsigned int i, j, n, width;
+	size_t len;
+
+	ret = get_varint(p, end, &prev);
+	if (ret < 0)
+		return ret;
+	if (order == 2) {
+		ret = get_varint(p, end, &prev_delta);
+		if (ret < 0)
+			return ret;
+		prev_delta = zigzag_decode(prev_delta);
+	}
+	column_set(&infos[0], column, prev);
+
+	for (i = 1; i < count; i += n) {
+		n = count - i;
+		if (n > GROUP_SIZE)
+			n = GROUP_SIZE;
+		if (*p == end)
+			return -EPROTO;
+		width = *(*p)++;
+		if (width > 64)
+			return -EPROTO;
+		len = ((size_t)n * width + 7) / 8;
+		if ((size_t)(end - *p) < len)
+			return -EPROTO;
+
+		if (width == 0) {
+			/* Constant delta (order 2) or value (order 1) */
+			delta = (order == 2) ? prev_delta : 0;
+			for (j = 0; j < n; j++) {
+				prev += delta;
+				column_set(&infos[i + j], column, prev);
+			}
+		} else {
+			q = *p;
+			if ((size_t)(end - *p) < len + UNPACK_PADDING) {
+				memcpy(padded, *p, len);
+				memset(padded + len, 0, UNPACK_PADDING);
+				q = padded;
+			}
+			mask = (width == 64) ? UINT64_MAX
+					     : (UINT64_C(1) << width) - 1;
+			for (j = 0; j < n; j++) {
+				delta = zigzag_decode(unpack_bits(
+					q, (size_t)j * width, width, mask));
+				if (order == 2)
+					delta += prev_delta;
+				prev += delta;
+				prev_delta = delta;
+				column_set(&infos[i + j], column, prev);
+			}
+		}
+		*p += len;
+	}
+
+	return 0;
+}
+
+
+static int decode_block(const uint8_t **p,
+			const uint8_t *end,
+			unsigned int count,
+			struct adef_frame_info *infos)
+{
+	int ret;
+
+	ret = decode_column(p, end, count, COLUMN_TIMESTAMP, infos);
+	if (ret < 0)
+		return ret;
+	ret = decode_column(p, end, count, COLUMN_TIMESCALE, infos);
+	if (ret < 0)
+		return ret;
+	ret = decode_column(p, end, count, COLUMN_CAPTURE_TIMESTAMP, infos);
+	if (ret < 0)
+		return ret;
+	return decode_column(p, end, count, COLUMN_INDEX, infos);
+}
+
+
+/* Read a block header; the payload is [*p, *p + payload_size[ */
+static int read_block_header(const uint8_t **p,
+			     const uint8_t *end,
+			     uint64_t *count,
+			     uint64_t *payload_size)
+{
+	int ret;
+
+	ret = get_varint(p, end, count);
+	if (ret < 0)
+		return ret;
+	ret = get_varint(p, end, payload_size);
+	if (ret < 0)
+		return ret;
+	if (*count == 0 || *count > UINT_MAX ||
+	    *payload_size > (uint64_t)(end - *p))
+		return -EPROTO;
+	return 0;
+}
+
+
+static int encode_block(struct adef_frame_recorder *recorder)
+{
+	size_t bound = block_bound(recorder->record_count);
+	size_t capacity, header_size;
+	uint8_t header[2 * VARINT_MAX_SIZE];
+	uint8_t *data, *payload, *end;
+
+	if (recorder->record_count == 0)
+		return 0;
+
+	/* Grow the data buffer for the worst case */
+	if (recorder->capacity - recorder->size < bound) {
+		capacity = recorder->capacity;
+		do {
+			capacity = (capacity == 0) ? 4 * bound : 2 * capacity;
+		} while (capacity - recorder->size < bound);
+		data = realloc(recorder->data, capacity);
+		if (data == NULL)
+			return -ENOMEM;
+		recorder->data = data;
+		recorder->capacity = capacity;
+	}
+
+	/* Encode the payload after room for the largest header, then move
+	 * it after the actual header */
+	payload = recorder->data + recorder->size + sizeof(header);
+	end = payload;
+	for (unsigned int c = 0; c < COLUMN_COUNT; c++) {
+		end = encode_column(
+			recorder->records, recorder->record_count, c, end);
+	}
+	header_size = put_varint(header, recorder->record_count);
+	header_size += put_varint(header + header_size, end - payload);
+	memcpy(recorder->data + recorder->size, header, header_size);
+	memmove(recorder->data + recorder->size + header_size,
+		payload,
+		end - payload);
+	recorder->size += header_size + (end - payload);
+	recorder->record_count = 0;
+
+	return 0;
+}
+
+
+int adef_frame_recorder_new(unsigned int block_size,
+			    struct adef_frame_recorder **ret_obj)
+{
+	struct adef_frame_recorder *recorder;
+
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	if (block_size == 0)
+		block_size = ADEF_FRAME_RECORDER_DEFAULT_BLOCK_SIZE;
+
+	recorder = calloc(1, sizeof(*recorder));
+	if (recorder == NULL)
+		return -ENOMEM;
+	recorder->block_size = block_size;
+	recorder->records = calloc(block_size, sizeof(*recorder->records));
+	if (recorder->records == NULL) {
+		free(recorder);
+		return -ENOMEM;
+	}
+
+	*ret_obj = recorder;
+	return 0;
+}
+
+
+int adef_frame_recorder_destroy(struct adef_frame_recorder *recorder)
+{
+	if (recorder == NULL)
+		return 0;
+
+	free(recorder->records);
+	free(recorder->data);
+	free(recorder);
+
+	return 0;
+}
+
+
+int adef_frame_recorder_append(struct adef_frame_recorder *recorder,
+			       const struct adef_frame_info *infos,
+			       size_t count)
+{
+	int ret;
+	size_t n;
+
+	ULOG_ERRNO_RETURN_ERR_IF(recorder == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(infos == NULL && count != 0, EINVAL);
+
+	while (count > 0) {
+		n = recorder->block_size - recorder->record_count;
+		if (n > count)
+			n = count;
+		memcpy(&recorder->records[recorder->record_count],
+		       infos,
+		       n * sizeof(*infos));
+		recorder->record_count += n;
+		infos += n;
+		count -= n;
+		if (recorder->record_count < recorder->block_size)
+			break;
+		ret = encode_block(recorder);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+
+int adef_frame_recorder_flush(struct adef_frame_recorder *recorder)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(recorder == NULL, EINVAL);
+
+	return encode_block(recorder);
+}
+
+
+int adef_frame_recorder_get_data(struct adef_frame_recorder *recorder,
+				 const void **data,
+				 size_t *size)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(recorder == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(data == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(size == NULL, EINVAL);
+
+	*data = recorder->data;
+	*size = recorder->size;
+
+	return 0;
+}
+
+
+int adef_frame_recorder_clear(struct adef_frame_recorder *recorder)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(recorder == NULL, EINVAL);
+
+	recorder->size = 0;
+
+	return 0;
+}
+
+
+int adef_frame_info_decode_count(const void *data, size_t size, size_t *count)
+{
+	int ret;
+	const uint8_t *p = data, *end;
+	uint64_t block_count, payload_size;
+	size_t total = 0;
+
+	ULOG_ERRNO_RETURN_ERR_IF(data == NULL && size != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count == NULL, EINVAL);
+
+	end = p + size;
+	while (p < end) {
+		ret = read_block_header(&p, end, &block_count, &payload_size);
+		if (ret < 0)
+			return ret;
+		p += payload_size;
+		total += block_count;
+	}
+
+	*count = total;
+	return 0;
+}
+
+
+int adef_frame_info_decode(const void *data,
+			   size_t size,
+			   struct adef_frame_info *infos,
+			   size_t max_count,
+			   size_t *count)
+{
+	int ret;
+	const uint8_t *p = data, *end, *block_end;
+	uint64_t block_count, payload_size;
+	size_t total = 0;
+
+	ULOG_ERRNO_RETURN_ERR_IF(data == NULL && size != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(infos == NULL && max_count != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count == NULL, EINVAL);
+
+	end = p + size;
+	while (p < end) {
+		ret = read_block_header(&p, end, &block_count, &payload_size);
+		if (ret < 0)
+			return ret;
+		if (block_count > max_count - total)
+			return -ENOBUFS;
+		block_end = p + payload_size;
+		ret = decode_block(&p, block_end, block_count, &infos[total]);
+		if (ret < 0)
+			return ret;
+		if (p != block_end)
+			return -EPROTO;
+		total += block_count;
+	}
+
+	*count = total;
+	return 0;
+}
@@ -28,13 +28,36 @@
 #include <errno.h>
 #include <json-c/json.h>
 
+#include "adefs_priv.h"
+
 #define ULOG_TAG adef
 #include <ulog.h>
 
 
+/* Hot path statistics JSON keys, indexed by enum adef_stat */
+static const char *const stat_keys[ADEF_STAT_MAX] = {
+	[ADEF_STAT_FORMAT_FROM_STR] = "format_from_str",
+	[ADEF_STAT_FORMAT_FROM_STR_BUILTIN] = "format_from_str_builtin",
+	[ADEF_STAT_FORMAT_FROM_STR_REGISTRY] = "format_from_str_registry",
+	[ADEF_STAT_FORMAT_FROM_STR_GENERIC] = "format_from_str_generic",
+	[ADEF_STAT_FORMAT_FROM_STR_ERROR] = "format_from_str_error",
+	[ADEF_STAT_FORMAT_FROM_STR_CYCLES] = "format_from_str_cycles",
+	[ADEF_STAT_ENCODING_FROM_STR] = "encoding_from_str",
+	[ADEF_STAT_ENCODING_UNKNOWN] = "encoding_unknown",
+	[ADEF_STAT_FORMAT_INTERSECT] = "format_intersect",
+	[ADEF_STAT_FORMAT_INTERSECT_MATCH] = "format_intersect_match",
+	[ADEF_STAT_FORMAT_INTERSECT_SCANNED] = "format_intersect_scanned",
+	[ADEF_STAT_FORMAT_INTERSECT_CYCLES] = "format_intersect_cycles",
+	[ADEF_STAT_JSON] = "json",
+	[ADEF_STAT_JSON_CYCLES] = "json_cycles",
+};
+
+
 int adef_frame_info_to_json(const struct adef_frame_info *info,
 			    struct json_object *jobj)
 {
+	uint64_t start = ADEF_STATS_CYCLES();
+
 	ULOG_ERRNO_RETURN_ERR_IF(info == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(jobj == NULL, EINVAL);
 
@@ -54,6 +77,8 @@ int adef_frame_info_to_json(const struct adef_frame_info *info,
 	/* Frame index */
 	json_object_object_add(jobj, "index", json_object_new_int(info->index));
 
+	ADEF_STATS_ADD(ADEF_STAT_JSON, 1);
+	ADEF_STATS_ADD(ADEF_STAT_JSON_CYCLES, ADEF_STATS_CYCLES() - start);
 	return 0;
 }
 
@@ -61,6 +86,8 @@ int adef_frame_info_to_json(const struct adef_frame_info *info,
 int adef_format_to_json(const struct adef_format *format,
 			struct json_object *jobj)
 {
+	uint64_t start = ADEF_STATS_CYCLES();
+
 	ULOG_ERRNO_RETURN_ERR_IF(format == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(jobj == NULL, EINVAL);
 
@@ -75,6 +102,11 @@ int adef_format_to_json(const struct adef_format *format,
 			       "channel_count",
 			       json_object_new_int(format->channel_count));
 
+	/* Channel layout */
+	json_object_object_add(jobj,
+			       "channel_layout",
+			       json_object_new_int64(format->channel_layout));
+
 	/* Bit depth */
 	json_object_object_add(
 		jobj, "bit_depth", json_object_new_int(format->bit_depth));
@@ -98,11 +130,23 @@ int adef_format_to_json(const struct adef_format *format,
 			"signed_val",
 			json_object_new_boolean(format->pcm.signed_val));
 
+		/* Sample type */
+		json_object_object_add(
+			jobj_pcm,
+			"float_val",
+			json_object_new_boolean(format->pcm.float_val));
+
 		/* Endianness */
 		json_object_object_add(
 			jobj_pcm,
 			"little_endian",
 			json_object_new_boolean(format->pcm.little_endian));
+
+		/* Container width */
+		json_object_object_add(
+			jobj_pcm,
+			"container_width",
+			json_object_new_int(format->pcm.container_width));
 		json_object_object_add(jobj, "pcm", jobj_pcm);
 		break;
 	}
@@ -121,5 +165,87 @@ int adef_format_to_json(const struct adef_format *format,
 		break;
 	}
 
+	ADEF_STATS_ADD(ADEF_STAT_JSON, 1);
+	ADEF_STATS_ADD(ADEF_STAT_JSON_CYCLES, ADEF_STATS_CYCLES() - start);
+	return 0;
+}
+
+
+int adef_clock_mapper_to_json(const struct adef_clock_mapper *mapper,
+			      struct json_object *jobj)
+{
+	uint64_t start = ADEF_STATS_CYCLES();
+
+	ULOG_ERRNO_RETURN_ERR_IF(mapper == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(jobj == NULL, EINVAL);
+
+	/* Fit window, as an equivalent number of samples */
+	json_object_object_add(
+		jobj,
+		"window",
+		json_object_new_int64((int64_t)(1. / (1. - mapper->lambda) +
+						.5)));
+
+	/* Minimum outlier threshold in microseconds */
+	json_object_object_add(
+		jobj, "tolerance", json_object_new_double(mapper->tolerance));
+
+	/* Reference points in microseconds */
+	json_object_object_add(
+		jobj, "media_ref", json_object_new_int64(mapper->media_ref));
+	json_object_object_add(jobj,
+			       "monotonic_ref",
+			       json_object_new_int64(mapper->monotonic_ref));
+
+	/* Model: monotonic = monotonic_ref + intercept + slope * (media -
+	 * media_ref), in microseconds */
+	json_object_object_add(
+		jobj, "intercept", json_object_new_double(mapper->intercept));
+	json_object_object_add(
+		jobj, "slope", json_object_new_double(mapper->slope));
+
+	/* Media clock drift relative to the monotonic clock, in parts per
+	 * million */
+	json_object_object_add(
+		jobj,
+		"drift_ppm",
+		json_object_new_double((mapper->slope - 1.) * 1000000.));
+
+	/* Mean absolute residual in microseconds */
+	json_object_object_add(
+		jobj, "deviation", json_object_new_double(mapper->deviation));
+
+	/* Statistics */
+	json_object_object_add(
+		jobj, "accepted", json_object_new_int64(mapper->accepted));
+	json_object_object_add(
+		jobj, "rejected", json_object_new_int64(mapper->rejected));
+	json_object_object_add(
+		jobj, "restarts", json_object_new_int64(mapper->restarts));
+
+	ADEF_STATS_ADD(ADEF_STAT_JSON, 1);
+	ADEF_STATS_ADD(ADEF_STAT_JSON_CYCLES, ADEF_STATS_CYCLES() - start);
+	return 0;
+}
+
+
+int adef_stats_to_json(struct json_object *jobj)
+{
+	int ret;
+	struct adef_stats stats;
+
+	ULOG_ERRNO_RETURN_ERR_IF(jobj == NULL, EINVAL);
+
+	ret = adef_stats_snapshot(&stats);
+	if (ret < 0)
+		return ret;
+
+	for (unsigned int i = 0; i < ADEF_STAT_MAX; i++) {
+		json_object_object_add(
+			jobj,
+			stat_keys[i],
+			json_object_new_int64((int64_t)stats.counters[i]));
+	}
+
 	return 0;
 }
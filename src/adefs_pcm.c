@@ -0,0 +1,521 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Read a raw container of 'bytes' bytes with the given endianness */
+static inline uint32_t read_raw(const uint8_t *p, unsigned int bytes, bool le)
+{
+	switch (bytes) {
+	case 1:
+		return p[0];
+	case 2:
+		return le ? (uint32_t)p[0] | ((uint32_t)p[1] << 8)
+			  : (uint32_t)p[1] | ((uint32_t)p[0] << 8);
+	case 3:
+		return le ? (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+				    ((uint32_t)p[2] << 16)
+			  : (uint32_t)p[2] | ((uint32_t)p[1] << 8) |
+				    ((uint32_t)p[0] << 16);
+	default:
+		return le ? (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+				    ((uint32_t)p[2] << 16) |
+				    ((uint32_t)p[3] << 24)
+			  : (uint32_t)p[3] | ((uint32_t)p[2] << 8) |
+				    ((uint32_t)p[1] << 16) |
+				    ((uint32_t)p[0] << 24);
+	}
+}
+
+
+/* Write a raw container of 'bytes' bytes with the given endianness */
+static inline void
+write_raw(uint8_t *p, uint32_t v, unsigned int bytes, bool le)
+{
+	for (unsigned int i = 0; i < bytes; i++) {
+		unsigned int shift = le ? 8 * i : 8 * (bytes - 1 - i);
+		p[i] = (uint8_t)(v >> shift);
+	}
+}
+
+
+/* Convert a raw container holding 'bits' valid bits to a left-justified
+ * signed 32-bit value */
+static inline int32_t
+raw_to_s32(uint32_t raw, unsigned int bits, bool signed_val)
+{
+	uint32_t v = raw << (32 - bits);
+	if (!signed_val)
+		v ^= 0x80000000u;
+	return (int32_t)v;
+}
+
+
+/* Convert a left-justified signed 32-bit value to a raw container holding
+ * 'bits' valid bits (sign-extended for signed values) */
+static inline uint32_t
+s32_to_raw(int32_t s, unsigned int bits, bool signed_val)
+{
+	if (!signed_val)
+		return ((uint32_t)s ^ 0x80000000u) >> (32 - bits);
+	return (uint32_t)(s >> (32 - bits));
+}
+
+
+/* Convert a float sample to a signed value of 'bits' bits, with rounding
+ * and saturation */
+static inline int32_t f32_to_int(float f, unsigned int bits)
+{
+	/* 2^(bits-1), and the largest float strictly below it which fits
+	 * in an int32_t (2^31 - 128 for 32 bits) */
+	const float scale = (float)(1u << (bits - 1));
+	const float hi = bits < 25 ? scale - 1.f : 2147483520.f;
+	float v = f * scale;
+	v = v < -scale ? -scale : v;
+	v = v > hi ? hi : v;
+	return (int32_t)(v + (v >= 0.f ? 0.5f : -0.5f));
+}
+
+
+/* The codec functions are instantiated for every container size, valid
+ * bit count, signedness and endianness; the per-sample helpers are inlined
+ * with constant arguments so that each instance is a straight loop. The
+ * contiguous (stride == sample size) case is split out so that the compiler
+ * can vectorize it. */
+#define ADEF_PCM_CODEC(_name, _bytes, _bits, _signed, _le)                     \
+	static void load_s32_##_name(const uint8_t *src,                       \
+				     size_t stride,                            \
+				     int32_t *dst,                             \
+				     size_t count)                             \
+	{                                                                      \
+		if (stride == _bytes) {                                        \
+			for (size_t i = 0; i < count; i++)                     \
+				dst[i] = raw_to_s32(                           \
+					read_raw(src + i * _bytes,             \
+						 _bytes,                       \
+						 _le),                         \
+					_bits,                                 \
+					_signed);                              \
+			return;                                                \
+		}                                                              \
+		for (size_t i = 0; i < count; i++, src += stride)              \
+			dst[i] = raw_to_s32(                                   \
+				read_raw(src, _bytes, _le), _bits, _signed);   \
+	}                                                                      \
+	static void store_s32_##_name(const int32_t *src,                      \
+				      uint8_t *dst,                            \
+				      size_t stride,                           \
+				      size_t count)                            \
+	{                                                                      \
+		for (size_t i = 0; i < count; i++, dst += stride)              \
+			write_raw(dst,                                         \
+				  s32_to_raw(src[i], _bits, _signed),          \
+				  _bytes,                                      \
+				  _le);                                        \
+	}                                                                      \
+	static void load_f32_##_name(                                          \
+		const uint8_t *src, size_t stride, float *dst, size_t count)   \
+	{                                                                      \
+		const float k = 1.f / 2147483648.f;                            \
+		if (stride == _bytes) {                                        \
+			for (size_t i = 0; i < count; i++) {                   \
+				const uint8_t *p = src + i * _bytes;           \
+				uint32_t raw = read_raw(p, _bytes, _le);       \
+				dst[i] = k * (float)raw_to_s32(                \
+						     raw, _bits, _signed);     \
+			}                                                      \
+			return;                                                \
+		}                                                              \
+		for (size_t i = 0; i < count; i++, src += stride)              \
+			dst[i] = k * (float)raw_to_s32(                        \
+					     read_raw(src, _bytes, _le),       \
+					     _bits,                            \
+					     _signed);                         \
+	}                                                                      \
+	static void store_f32_##_name(                                         \
+		const float *src, uint8_t *dst, size_t stride, size_t count)   \
+	{                                                                      \
+		for (size_t i = 0; i < count; i++, dst += stride) {            \
+			uint32_t v = (uint32_t)f32_to_int(src[i], _bits);      \
+			if (!_signed)                                          \
+				v = (v ^ (1u << (_bits - 1))) &                \
+				    (0xffffffffu >> (32 - _bits));             \
+			write_raw(dst, v, _bytes, _le);                        \
+		}                                                              \
+	}
+
+
+ADEF_PCM_CODEC(u8, 1, 8, false, true)
+ADEF_PCM_CODEC(s8, 1, 8, true, true)
+ADEF_PCM_CODEC(u16le, 2, 16, false, true)
+ADEF_PCM_CODEC(u16be, 2, 16, false, false)
+ADEF_PCM_CODEC(s16le, 2, 16, true, true)
+ADEF_PCM_CODEC(s16be, 2, 16, true, false)
+ADEF_PCM_CODEC(u24le, 3, 24, false, true)
+ADEF_PCM_CODEC(u24be, 3, 24, false, false)
+ADEF_PCM_CODEC(s24le, 3, 24, true, true)
+ADEF_PCM_CODEC(s24be, 3, 24, true, false)
+ADEF_PCM_CODEC(u24le4, 4, 24, false, true)
+ADEF_PCM_CODEC(u24be4, 4, 24, false, false)
+ADEF_PCM_CODEC(s24le4, 4, 24, true, true)
+ADEF_PCM_CODEC(s24be4, 4, 24, true, false)
+ADEF_PCM_CODEC(u32le, 4, 32, false, true)
+ADEF_PCM_CODEC(u32be, 4, 32, false, false)
+ADEF_PCM_CODEC(s32le, 4, 32, true, true)
+ADEF_PCM_CODEC(s32be, 4, 32, true, false)
+
+
+/* Read a floating-point sample with the given endianness */
+static inline float read_f32(const uint8_t *p, bool le)
+{
+	uint32_t raw = read_raw(p, 4, le);
+	float f;
+	memcpy(&f, &raw, sizeof(f));
+	return f;
+}
+
+
+/* Write a floating-point sample with the given endianness */
+static inline void write_f32(uint8_t *p, float f, bool le)
+{
+	uint32_t raw;
+	memcpy(&raw, &f, sizeof(raw));
+	write_raw(p, raw, 4, le);
+}
+
+
+/* Floating-point codec functions: no saturation of floating-point output
+ * (the headroom is kept), NaN values are converted to 0 for integer
+ * output */
+#define ADEF_PCM_CODEC_F32(_name, _le)                                         \
+	static void load_s32_##_name(const uint8_t *src,                       \
+				     size_t stride,                            \
+				     int32_t *dst,                             \
+				     size_t count)                             \
+	{                                                                      \
+		for (size_t i = 0; i < count; i++, src += stride) {            \
+			float f = read_f32(src, _le);                          \
+			dst[i] = f32_to_int(f == f ? f : 0.f, 32);             \
+		}                                                              \
+	}                                                                      \
+	static void store_s32_##_name(const int32_t *src,                      \
+				      uint8_t *dst,                            \
+				      size_t stride,                           \
+				      size_t count)                            \
+	{                                                                      \
+		const float k = 1.f / 2147483648.f;                            \
+		for (size_t i = 0; i < count; i++, dst += stride)              \
+			write_f32(dst, k * (float)src[i], _le);                \
+	}                                                                      \
+	static void load_f32_##_name(                                          \
+		const uint8_t *src, size_t stride, float *dst, size_t count)   \
+	{                                                                      \
+		if (stride == 4 && _le == ADEF_HOST_LITTLE_ENDIAN) {           \
+			memcpy(dst, src, count * 4);                           \
+			return;                                                \
+		}                                                              \
+		for (size_t i = 0; i < count; i++, src += stride)              \
+			dst[i] = read_f32(src, _le);                           \
+	}                                                                      \
+	static void store_f32_##_name(                                         \
+		const float *src, uint8_t *dst, size_t stride, size_t count)   \
+	{                                                                      \
+		if (stride == 4 && _le == ADEF_HOST_LITTLE_ENDIAN) {           \
+			memcpy(dst, src, count * 4);                           \
+			return;                                                \
+		}                                                              \
+		for (size_t i = 0; i < count; i++, dst += stride)              \
+			write_f32(dst, src[i], _le);                           \
+	}
+
+
+ADEF_PCM_CODEC_F32(f32le, true)
+ADEF_PCM_CODEC_F32(f32be, false)
+
+
+#define ADEF_PCM_CODEC_ENTRY(_name, _bytes, _bits)                             \
+	{                                                                      \
+		.sample_size = _bytes,                                         \
+		.bits = _bits,                                                 \
+		.load_s32 = load_s32_##_name,                                  \
+		.store_s32 = store_s32_##_name,                                \
+		.load_f32 = load_f32_##_name,                                  \
+		.store_f32 = store_f32_##_name,                                \
+	}
+
+
+/* Packed containers, indexed by [bytes - 1][signed][little_endian] */
+static const struct adef_pcm_codec codec_map[4][2][2] = {
+	{
+		{ADEF_PCM_CODEC_ENTRY(u8, 1, 8),
+		 ADEF_PCM_CODEC_ENTRY(u8, 1, 8)},
+		{ADEF_PCM_CODEC_ENTRY(s8, 1, 8),
+		 ADEF_PCM_CODEC_ENTRY(s8, 1, 8)},
+	},
+	{
+		{ADEF_PCM_CODEC_ENTRY(u16be, 2, 16),
+		 ADEF_PCM_CODEC_ENTRY(u16le, 2, 16)},
+		{ADEF_PCM_CODEC_ENTRY(s16be, 2, 16),
+		 ADEF_PCM_CODEC_ENTRY(s16le, 2, 16)},
+	},
+	{
+		{ADEF_PCM_CODEC_ENTRY(u24be, 3, 24),
+		 ADEF_PCM_CODEC_ENTRY(u24le, 3, 24)},
+		{ADEF_PCM_CODEC_ENTRY(s24be, 3, 24),
+		 ADEF_PCM_CODEC_ENTRY(s24le, 3, 24)},
+	},
+	{
+		{ADEF_PCM_CODEC_ENTRY(u32be, 4, 32),
+		 ADEF_PCM_CODEC_ENTRY(u32le, 4, 32)},
+		{ADEF_PCM_CODEC_ENTRY(s32be, 4, 32),
+		 ADEF_PCM_CODEC_ENTRY(s32le, 4, 32)},
+	},
+};
+
+
+/* Floating-point samples, indexed by [little_endian] */
+static const struct adef_pcm_codec codec_map_f32[2] = {
+	ADEF_PCM_CODEC_ENTRY(f32be, 4, 32),
+	ADEF_PCM_CODEC_ENTRY(f32le, 4, 32),
+};
+
+
+/* 24-bit samples in 4-byte containers, indexed by [signed][little_endian] */
+static const struct adef_pcm_codec codec_map_24in32[2][2] = {
+	{ADEF_PCM_CODEC_ENTRY(u24be4, 4, 24),
+	 ADEF_PCM_CODEC_ENTRY(u24le4, 4, 24)},
+	{ADEF_PCM_CODEC_ENTRY(s24be4, 4, 24),
+	 ADEF_PCM_CODEC_ENTRY(s24le4, 4, 24)},
+};
+
+
+int adef_pcm_codec_get(const struct adef_format *format,
+		       struct adef_pcm_codec *codec)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(format == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(codec == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(format->encoding != ADEF_ENCODING_PCM,
+				 EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!adef_is_format_valid(format), EINVAL);
+
+	if (format->channel_count > ADEF_PCM_MAX_CHANNELS) {
+		ULOGE("%s: unsupported channel count %u",
+		      __func__,
+		      format->channel_count);
+		return -ENOTSUP;
+	}
+
+	switch (format->bit_depth) {
+	case 8:
+	case 16:
+	case 24:
+	case 32:
+		break;
+	default:
+		ULOGE("%s: unsupported bit depth %u",
+		      __func__,
+		      format->bit_depth);
+		return -ENOTSUP;
+	}
+
+	if (format->pcm.float_val) {
+		/* Validity implies 32-bit samples */
+		*codec = codec_map_f32[format->pcm.little_endian];
+	} else if (format->pcm.container_width == 0 ||
+		   format->pcm.container_width == format->bit_depth) {
+		*codec = codec_map[format->bit_depth / 8 - 1]
+				  [format->pcm.signed_val]
+				  [format->pcm.little_endian];
+	} else if (format->bit_depth == 24 &&
+		   format->pcm.container_width == 32) {
+		*codec = codec_map_24in32[format->pcm.signed_val]
+					 [format->pcm.little_endian];
+	} else {
+		ULOGE("%s: unsupported container width %u for bit depth %u",
+		      __func__,
+		      format->pcm.container_width,
+		      format->bit_depth);
+		return -ENOTSUP;
+	}
+	return 0;
+}
+
+
+/* Channel count of the group of lanes starting at a channel */
+static unsigned int lanes_used(const struct adef_format *format,
+			       unsigned int first)
+{
+	unsigned int used = format->channel_count - first;
+	return used > ADEF_VEC_LEN ? ADEF_VEC_LEN : used;
+}
+
+
+void adef_pcm_lanes_load(const struct adef_pcm_codec *codec,
+			 const struct adef_format *format,
+			 const struct adef_pcm_buffer *buf,
+			 unsigned int first,
+			 size_t offset,
+			 size_t frames,
+			 float *tmp,
+			 float *lanes)
+{
+	unsigned int used = lanes_used(format, first);
+
+	for (unsigned int l = 0; l < used; l++) {
+		size_t stride;
+		const uint8_t *src = adef_pcm_buffer_channel(
+			buf, format, codec->sample_size, first + l, &stride);
+		codec->load_f32(src + offset * stride, stride, tmp, frames);
+		for (size_t i = 0; i < frames; i++)
+			lanes[i * ADEF_VEC_LEN + l] = tmp[i];
+	}
+
+	/* Unused lanes (last group) hold zeros */
+	for (size_t i = 0; used < ADEF_VEC_LEN && i < frames; i++) {
+		for (unsigned int l = used; l < ADEF_VEC_LEN; l++)
+			lanes[i * ADEF_VEC_LEN + l] = 0.f;
+	}
+}
+
+
+void adef_pcm_lanes_store(const struct adef_pcm_codec *codec,
+			  const struct adef_format *format,
+			  const struct adef_pcm_buffer *buf,
+			  unsigned int first,
+			  size_t offset,
+			  size_t frames,
+			  float *tmp,
+			  const float *lanes)
+{
+	unsigned int used = lanes_used(format, first);
+
+	for (unsigned int l = 0; l < used; l++) {
+		size_t stride;
+		uint8_t *dst = adef_pcm_buffer_channel(
+			buf, format, codec->sample_size, first + l, &stride);
+		for (size_t i = 0; i < frames; i++)
+			tmp[i] = lanes[i * ADEF_VEC_LEN + l];
+		codec->store_f32(tmp, dst + offset * stride, stride, frames);
+	}
+}
+
+
+int adef_pcm_unpack_24le(const void *src,
+			 void *dst,
+			 size_t count,
+			 bool signed_val)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(src == NULL && count != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(dst == NULL && count != 0, EINVAL);
+
+	adef_pcm_kernels_get()->unpack_24le(src, dst, count, signed_val);
+
+	return 0;
+}
+
+
+int adef_pcm_pack_24le(const void *src, void *dst, size_t count)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(src == NULL && count != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(dst == NULL && count != 0, EINVAL);
+
+	adef_pcm_kernels_get()->pack_24le(src, dst, count);
+
+	return 0;
+}
+
+
+size_t adef_pcm_get_sample_size(const struct adef_format *format)
+{
+	struct adef_pcm_codec codec;
+
+	if (adef_pcm_codec_get(format, &codec) < 0)
+		return 0;
+	return codec.sample_size;
+}
+
+
+int adef_pcm_buffer_to_array(const struct adef_format *format,
+			     const struct adef_pcm_buffer *buf,
+			     struct adef_pcm_array *array)
+{
+	int ret;
+	struct adef_pcm_codec codec;
+	size_t plane_stride;
+
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf->data == NULL && buf->frames != 0,
+				 EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(array == NULL, EINVAL);
+
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+	if (codec.sample_size == 3) {
+		ULOGE("%s: no array type for packed 24-bit samples", __func__);
+		return -ENOTSUP;
+	}
+
+	if (codec.sample_size == 1)
+		array->typestr[0] = '|';
+	else
+		array->typestr[0] = format->pcm.little_endian ? '<' : '>';
+	if (format->pcm.float_val)
+		array->typestr[1] = 'f';
+	else
+		array->typestr[1] = format->pcm.signed_val ? 'i' : 'u';
+	array->typestr[2] = '0' + codec.sample_size;
+	array->typestr[3] = '\0';
+
+	array->data = buf->data;
+	array->shape[0] = buf->frames;
+	array->shape[1] = format->channel_count;
+	if (format->pcm.interleaved) {
+		array->strides[0] = codec.sample_size * format->channel_count;
+		array->strides[1] = codec.sample_size;
+		array->size = buf->frames * array->strides[0];
+	} else {
+		plane_stride = buf->plane_stride ? buf->plane_stride
+						 : buf->frames *
+							   codec.sample_size;
+		array->strides[0] = codec.sample_size;
+		array->strides[1] = plane_stride;
+		array->size = buf->frames == 0
+				      ? 0
+				      : (format->channel_count - 1) *
+						plane_stride +
+					buf->frames * codec.sample_size;
+	}
+
+	return 0;
+}
@@ -0,0 +1,281 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Allocated blocks start with a header in the cache line preceding the
+ * first plane, so that the buffers can be resized and freed with only the
+ * struct adef_pcm_buffer */
+#define HEADER_MAGIC 0x61646566 /* "adef" */
+
+/* Huge page size (the default size on x86_64 and arm64) */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+
+struct layout {
+	/* Plane count, frame size in bytes in a plane, and offset between
+	 * planes */
+	unsigned int planes;
+	size_t frame_size;
+	size_t plane_stride;
+};
+
+
+struct block_header {
+	uint32_t magic;
+
+	/* True if the block is mapped with mmap(), false if allocated with
+	 * posix_memalign() */
+	bool mapped;
+
+	/* Allocation flags */
+	unsigned int flags;
+
+	/* Block size in bytes */
+	size_t size;
+
+	/* Buffer layout (see get_layout()) */
+	size_t frames;
+	struct layout layout;
+};
+
+_Static_assert(sizeof(struct block_header) <= ADEF_PCM_BUFFER_ALIGN,
+	       "block header larger than the plane alignment");
+
+
+static int get_layout(const struct adef_format *format,
+		      size_t frames,
+		      struct layout *layout)
+{
+	int ret;
+	struct adef_pcm_codec codec;
+
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+
+	layout->frame_size = codec.sample_size;
+	layout->planes = format->channel_count;
+	if (format->pcm.interleaved) {
+		layout->frame_size *= format->channel_count;
+		layout->planes = 1;
+	}
+	if (frames > (SIZE_MAX / 2 - ADEF_PCM_BUFFER_PADDING) /
+			     layout->frame_size / layout->planes)
+		return -ENOMEM;
+
+	layout->plane_stride =
+		(layout->frame_size * frames + ADEF_PCM_BUFFER_PADDING +
+		 ADEF_PCM_BUFFER_ALIGN - 1) &
+		~(size_t)(ADEF_PCM_BUFFER_ALIGN - 1);
+	return 0;
+}
+
+
+static struct block_header *alloc_block(size_t size, unsigned int flags)
+{
+	struct block_header *header = NULL;
+	void *ptr = MAP_FAILED;
+
+	if ((flags & ADEF_PCM_ALLOC_HUGE_PAGES) && size >= HUGE_PAGE_SIZE) {
+		size = (size + HUGE_PAGE_SIZE - 1) &
+		       ~(size_t)(HUGE_PAGE_SIZE - 1);
+#ifdef MAP_HUGETLB
+		/* Explicit huge pages (reserved by the system
+		 * administrator) */
+		ptr = mmap(NULL,
+			   size,
+			   PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+			   -1,
+			   0);
+#endif
+		if (ptr == MAP_FAILED) {
+			ptr = mmap(NULL,
+				   size,
+				   PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS,
+				   -1,
+				   0);
+			if (ptr == MAP_FAILED) {
+				ULOG_ERRNO("mmap", errno);
+				return NULL;
+			}
+#ifdef MADV_HUGEPAGE
+			/* Transparent huge pages (best effort) */
+			(void)madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+		}
+		/* Anonymous mappings are zero-filled */
+		header = ptr;
+		header->mapped = true;
+	} else {
+		if (posix_memalign(&ptr, ADEF_PCM_BUFFER_ALIGN, size) != 0)
+			return NULL;
+		memset(ptr, 0, size);
+		header = ptr;
+		header->mapped = false;
+	}
+
+	header->magic = HEADER_MAGIC;
+	header->flags = flags;
+	header->size = size;
+	return header;
+}
+
+
+static void free_block(struct block_header *header)
+{
+	header->magic = 0;
+	if (header->mapped) {
+		if (munmap(header, header->size) < 0)
+			ULOG_ERRNO("munmap", errno);
+	} else {
+		free(header);
+	}
+}
+
+
+static struct block_header *get_header(const struct adef_pcm_buffer *buf)
+{
+	struct block_header *header;
+
+	if (buf->data == NULL ||
+	    ((uintptr_t)buf->data & (ADEF_PCM_BUFFER_ALIGN - 1)) != 0)
+		return NULL;
+	header = (struct block_header *)((uint8_t *)buf->data -
+					 ADEF_PCM_BUFFER_ALIGN);
+	return (header->magic == HEADER_MAGIC) ? header : NULL;
+}
+
+
+int adef_pcm_buffer_alloc(const struct adef_format *format,
+			  size_t frames,
+			  unsigned int flags,
+			  struct adef_pcm_buffer *buf)
+{
+	int ret;
+	struct block_header *header;
+	struct layout layout;
+
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+
+	ret = get_layout(format, frames, &layout);
+	if (ret < 0)
+		return ret;
+
+	header = alloc_block(ADEF_PCM_BUFFER_ALIGN +
+				     layout.plane_stride * layout.planes,
+			     flags);
+	if (header == NULL)
+		return -ENOMEM;
+	header->frames = frames;
+	header->layout = layout;
+
+	buf->data = (uint8_t *)header + ADEF_PCM_BUFFER_ALIGN;
+	buf->frames = frames;
+	buf->plane_stride = format->pcm.interleaved ? 0 : layout.plane_stride;
+
+	return 0;
+}
+
+
+int adef_pcm_buffer_resize(const struct adef_format *format,
+			   size_t frames,
+			   struct adef_pcm_buffer *buf)
+{
+	int ret;
+	struct block_header *header, *old;
+	struct layout layout;
+	size_t size;
+	const uint8_t *src;
+	uint8_t *dst;
+
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+	old = get_header(buf);
+	ULOG_ERRNO_RETURN_ERR_IF(old == NULL, EINVAL);
+
+	ret = get_layout(format, frames, &layout);
+	if (ret < 0)
+		return ret;
+	ULOG_ERRNO_RETURN_ERR_IF(layout.planes != old->layout.planes ||
+					 layout.frame_size !=
+						 old->layout.frame_size,
+				 EINVAL);
+
+	header = alloc_block(ADEF_PCM_BUFFER_ALIGN +
+				     layout.plane_stride * layout.planes,
+			     old->flags);
+	if (header == NULL)
+		return -ENOMEM;
+	header->frames = frames;
+	header->layout = layout;
+
+	/* Copy the kept samples of each plane */
+	size = layout.frame_size * ((frames < old->frames) ? frames
+							    : old->frames);
+	for (unsigned int p = 0; p < layout.planes; p++) {
+		src = (const uint8_t *)old + ADEF_PCM_BUFFER_ALIGN +
+		      p * old->layout.plane_stride;
+		dst = (uint8_t *)header + ADEF_PCM_BUFFER_ALIGN +
+		      p * layout.plane_stride;
+		memcpy(dst, src, size);
+	}
+	free_block(old);
+
+	buf->data = (uint8_t *)header + ADEF_PCM_BUFFER_ALIGN;
+	buf->frames = frames;
+	buf->plane_stride = format->pcm.interleaved ? 0 : layout.plane_stride;
+
+	return 0;
+}
+
+
+int adef_pcm_buffer_free(struct adef_pcm_buffer *buf)
+{
+	struct block_header *header;
+
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+
+	if (buf->data == NULL)
+		return 0;
+	header = get_header(buf);
+	ULOG_ERRNO_RETURN_ERR_IF(header == NULL, EINVAL);
+
+	free_block(header);
+	memset(buf, 0, sizeof(*buf));
+
+	return 0;
+}
@@ -0,0 +1,317 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* The channels are processed in groups of ADEF_VEC_LEN, one channel per
+ * vector lane: the samples of a block of frames are decoded to floats and
+ * interleaved in the lanes, filtered by the kernel, then de-interleaved
+ * and encoded back; unused lanes of the last group are zero */
+
+
+/* State values below this threshold are flushed to 0 after each block:
+ * the state of a filter fed with silence decays towards denormal values,
+ * which are very slow to compute on some CPUs */
+#define STATE_FLUSH_THRESHOLD 1e-30f
+
+
+struct adef_pcm_biquad {
+	struct adef_format format;
+	struct adef_pcm_codec codec;
+
+	struct adef_pcm_biquad_coefs coefs[ADEF_PCM_BIQUAD_MAX_STAGES];
+	unsigned int stage_count;
+
+	/* State of each channel group */
+	unsigned int group_count;
+	float (*state)[ADEF_PCM_BIQUAD_MAX_STAGES][2][ADEF_VEC_LEN];
+
+	/* Samples of a block of frames of a group, interleaved in the vector
+	 * lanes, and samples of a channel */
+	float lanes[ADEF_PCM_BLOCK_FRAMES * ADEF_VEC_LEN];
+	float tmp[ADEF_PCM_BLOCK_FRAMES];
+};
+
+
+int adef_pcm_biquad_design(enum adef_pcm_biquad_type type,
+			   unsigned int sample_rate,
+			   float frequency,
+			   float q,
+			   float gain_db,
+			   struct adef_pcm_biquad_coefs *coefs)
+{
+	double w, cw, alpha, a, sa, r;
+	double b0, b1, b2, a0, a1, a2;
+
+	ULOG_ERRNO_RETURN_ERR_IF(sample_rate == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!(frequency > 0.f), EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!(frequency < sample_rate / 2.f), EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(
+		!(q > 0.f) && type != ADEF_PCM_BIQUAD_DC_BLOCKER, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!isfinite(gain_db), EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(coefs == NULL, EINVAL);
+
+	w = 2. * M_PI * frequency / sample_rate;
+	cw = cos(w);
+	alpha = sin(w) / (2. * q);
+	/* Square root of the linear gain */
+	a = pow(10., gain_db / 40.);
+	sa = 2. * sqrt(a) * alpha;
+
+	switch (type) {
+	case ADEF_PCM_BIQUAD_DC_BLOCKER:
+		/* H(z) = g (1 - z^-1) / (1 - r z^-1), with a unity gain at
+		 * half the sample rate */
+		r = exp(-w);
+		*coefs = (struct adef_pcm_biquad_coefs){
+			.b0 = (float)((1. + r) / 2.),
+			.b1 = (float)(-(1. + r) / 2.),
+			.a1 = (float)-r,
+		};
+		return 0;
+	case ADEF_PCM_BIQUAD_LOW_PASS:
+		b0 = (1. - cw) / 2.;
+		b1 = 1. - cw;
+		b2 = b0;
+		a0 = 1. + alpha;
+		a1 = -2. * cw;
+		a2 = 1. - alpha;
+		break;
+	case ADEF_PCM_BIQUAD_HIGH_PASS:
+		b0 = (1. + cw) / 2.;
+		b1 = -(1. + cw);
+		b2 = b0;
+		a0 = 1. + alpha;
+		a1 = -2. * cw;
+		a2 = 1. - alpha;
+		break;
+	case ADEF_PCM_BIQUAD_PEAKING:
+		b0 = 1. + alpha * a;
+		b1 = -2. * cw;
+		b2 = 1. - alpha * a;
+		a0 = 1. + alpha / a;
+		a1 = -2. * cw;
+		a2 = 1. - alpha / a;
+		break;
+	case ADEF_PCM_BIQUAD_LOW_SHELF:
+		b0 = a * ((a + 1.) - (a - 1.) * cw + sa);
+		b1 = 2. * a * ((a - 1.) - (a + 1.) * cw);
+		b2 = a * ((a + 1.) - (a - 1.) * cw - sa);
+		a0 = (a + 1.) + (a - 1.) * cw + sa;
+		a1 = -2. * ((a - 1.) + (a + 1.) * cw);
+		a2 = (a + 1.) + (a - 1.) * cw - sa;
+		break;
+	case ADEF_PCM_BIQUAD_HIGH_SHELF:
+		b0 = a * ((a + 1.) + (a - 1.) * cw + sa);
+		b1 = -2. * a * ((a - 1.) + (a + 1.) * cw);
+		b2 = a * ((a + 1.) + (a - 1.) * cw - sa);
+		a0 = (a + 1.) - (a - 1.) * cw + sa;
+		a1 = 2. * ((a - 1.) - (a + 1.) * cw);
+		a2 = (a + 1.) - (a - 1.) * cw - sa;
+		break;
+	default:
+		ULOGE("%s: unsupported filter type %d", __func__, type);
+		return -EINVAL;
+	}
+
+	coefs->b0 = (float)(b0 / a0);
+	coefs->b1 = (float)(b1 / a0);
+	coefs->b2 = (float)(b2 / a0);
+	coefs->a1 = (float)(a1 / a0);
+	coefs->a2 = (float)(a2 / a0);
+	return 0;
+}
+
+
+int adef_pcm_biquad_new(const struct adef_format *format,
+			const struct adef_pcm_biquad_coefs *coefs,
+			unsigned int count,
+			struct adef_pcm_biquad **ret_obj)
+{
+	int ret;
+	struct adef_pcm_biquad *biquad;
+
+	ULOG_ERRNO_RETURN_ERR_IF(format == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	biquad = calloc(1, sizeof(*biquad));
+	if (biquad == NULL)
+		return -ENOMEM;
+	biquad->format = *format;
+
+	ret = adef_pcm_codec_get(format, &biquad->codec);
+	if (ret < 0)
+		goto error;
+	ret = adef_pcm_biquad_set_coefs(biquad, coefs, count);
+	if (ret < 0)
+		goto error;
+
+	biquad->group_count =
+		(format->channel_count + ADEF_VEC_LEN - 1) / ADEF_VEC_LEN;
+	biquad->state = calloc(biquad->group_count, sizeof(*biquad->state));
+	if (biquad->state == NULL) {
+		ret = -ENOMEM;
+		goto error;
+	}
+
+	*ret_obj = biquad;
+	return 0;
+
+error:
+	adef_pcm_biquad_destroy(biquad);
+	return ret;
+}
+
+
+int adef_pcm_biquad_destroy(struct adef_pcm_biquad *biquad)
+{
+	if (biquad == NULL)
+		return 0;
+
+	free(biquad->state);
+	free(biquad);
+	return 0;
+}
+
+
+int adef_pcm_biquad_set_coefs(struct adef_pcm_biquad *biquad,
+			      const struct adef_pcm_biquad_coefs *coefs,
+			      unsigned int count)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(biquad == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(coefs == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count > ADEF_PCM_BIQUAD_MAX_STAGES, E2BIG);
+
+	for (unsigned int s = 0; s < count; s++) {
+		const struct adef_pcm_biquad_coefs *c = &coefs[s];
+		ULOG_ERRNO_RETURN_ERR_IF(!isfinite(c->b0) || !isfinite(c->b1) ||
+						 !isfinite(c->b2) ||
+						 !isfinite(c->a1) ||
+						 !isfinite(c->a2),
+					 EINVAL);
+	}
+
+	/* Stages beyond the previous count start from a zero state */
+	for (unsigned int g = 0; g < biquad->group_count; g++) {
+		for (unsigned int s = biquad->stage_count; s < count; s++) {
+			memset(biquad->state[g][s],
+			       0,
+			       sizeof(biquad->state[g][s]));
+		}
+	}
+	memcpy(biquad->coefs, coefs, count * sizeof(*coefs));
+	biquad->stage_count = count;
+	return 0;
+}
+
+
+int adef_pcm_biquad_reset(struct adef_pcm_biquad *biquad)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(biquad == NULL, EINVAL);
+
+	memset(biquad->state, 0, biquad->group_count * sizeof(*biquad->state));
+	return 0;
+}
+
+
+/* Flush the denormal state values of a group to 0 */
+static void flush_state(struct adef_pcm_biquad *biquad, unsigned int group)
+{
+	for (unsigned int s = 0; s < biquad->stage_count; s++) {
+		float *z = &biquad->state[group][s][0][0];
+		for (unsigned int i = 0; i < 2 * ADEF_VEC_LEN; i++) {
+			if (fabsf(z[i]) < STATE_FLUSH_THRESHOLD)
+				z[i] = 0.f;
+		}
+	}
+}
+
+
+int adef_pcm_biquad_process(struct adef_pcm_biquad *biquad,
+			    const struct adef_pcm_buffer *in,
+			    const struct adef_pcm_buffer *out)
+{
+	const struct adef_pcm_kernels *kernels = adef_pcm_kernels_get();
+	const struct adef_format *format;
+	const struct adef_pcm_codec *codec;
+	float *lanes;
+
+	ULOG_ERRNO_RETURN_ERR_IF(biquad == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(in == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(in->data == NULL && in->frames != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out->data == NULL && in->frames != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out->frames < in->frames, ENOBUFS);
+
+	format = &biquad->format;
+	codec = &biquad->codec;
+	lanes = biquad->lanes;
+
+	for (unsigned int g = 0; g < biquad->group_count; g++) {
+		unsigned int first = g * ADEF_VEC_LEN;
+		for (size_t f = 0; f < in->frames; f += ADEF_PCM_BLOCK_FRAMES) {
+			size_t n = in->frames - f;
+			if (n > ADEF_PCM_BLOCK_FRAMES)
+				n = ADEF_PCM_BLOCK_FRAMES;
+
+			adef_pcm_lanes_load(codec,
+					    format,
+					    in,
+					    first,
+					    f,
+					    n,
+					    biquad->tmp,
+					    lanes);
+			kernels->biquad(lanes,
+					n,
+					biquad->coefs,
+					biquad->stage_count,
+					biquad->state[g]);
+			flush_state(biquad, g);
+			adef_pcm_lanes_store(codec,
+					     format,
+					     out,
+					     first,
+					     f,
+					     n,
+					     biquad->tmp,
+					     lanes);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,645 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Fixed point (32.32) position unit of the resampler */
+#define POS_ONE (1ll << 32)
+
+/* 1/sqrt(2): gain of a position folded into two others */
+#define FOLD_GAIN 0.70710678f
+
+
+struct adef_pcm_convert {
+	struct adef_format src;
+	struct adef_format dst;
+	struct adef_pcm_codec src_codec;
+	struct adef_pcm_codec dst_codec;
+
+	/* Planned stages */
+	enum adef_pcm_stage stages[ADEF_PCM_STAGE_MAX];
+	unsigned int stage_count;
+
+	/* Channel remixing: matrix[out][in] */
+	bool remix;
+	bool remix_first;
+	float matrix[ADEF_PCM_MAX_CHANNELS][ADEF_PCM_MAX_CHANNELS];
+
+	/* Sample rate conversion: input frames per output frame and position
+	 * of the next output frame relative to the current input block, in
+	 * 32.32 fixed point; history is the last input frame of the previous
+	 * block (position -1) */
+	bool resample;
+	unsigned int resample_channels;
+	uint64_t step;
+	int64_t pos;
+	float *history;
+
+	/* Intermediate planar float buffers */
+	float *scratch[2];
+	size_t scratch_frames;
+
+	/* Block of samples of the REPACK stage: floats if repack_f32 is true
+	 * (when either side is floating-point: the values above full scale
+	 * are kept and the rounding is that of the DECODE and ENCODE stages),
+	 * otherwise left-justified 32-bit integers */
+	void *repack;
+	bool repack_f32;
+};
+
+
+static const char *const stage_str[] = {
+	[ADEF_PCM_STAGE_COPY] = "COPY",
+	[ADEF_PCM_STAGE_REPACK] = "REPACK",
+	[ADEF_PCM_STAGE_DECODE] = "DECODE",
+	[ADEF_PCM_STAGE_REMIX] = "REMIX",
+	[ADEF_PCM_STAGE_RESAMPLE] = "RESAMPLE",
+	[ADEF_PCM_STAGE_ENCODE] = "ENCODE",
+};
+
+
+const char *adef_pcm_stage_to_str(enum adef_pcm_stage stage)
+{
+	if (stage >= ADEF_PCM_STAGE_MAX)
+		return "UNKNOWN";
+	return stage_str[stage];
+}
+
+
+/* Index of a channel position in a layout, or -1 if absent */
+static int layout_index(uint32_t layout, uint32_t position)
+{
+	if (!(layout & position))
+		return -1;
+	return __builtin_popcount(layout & (position - 1));
+}
+
+
+/* Fold a source position missing from the destination layout into the
+ * closest destination positions */
+static void fold_position(float (*m)[ADEF_PCM_MAX_CHANNELS],
+			  uint32_t dst_layout,
+			  uint32_t position,
+			  unsigned int in)
+{
+	int fl = layout_index(dst_layout, ADEF_CHANNEL_FRONT_LEFT);
+	int fr = layout_index(dst_layout, ADEF_CHANNEL_FRONT_RIGHT);
+	int fc = layout_index(dst_layout, ADEF_CHANNEL_FRONT_CENTER);
+	int left = fl, right = fr;
+
+	switch (position) {
+	case ADEF_CHANNEL_LOW_FREQUENCY:
+		/* Dropped */
+		return;
+	case ADEF_CHANNEL_FRONT_LEFT:
+	case ADEF_CHANNEL_FRONT_LEFT_OF_CENTER:
+	case ADEF_CHANNEL_BACK_LEFT:
+	case ADEF_CHANNEL_SIDE_LEFT:
+		right = -1;
+		break;
+	case ADEF_CHANNEL_FRONT_RIGHT:
+	case ADEF_CHANNEL_FRONT_RIGHT_OF_CENTER:
+	case ADEF_CHANNEL_BACK_RIGHT:
+	case ADEF_CHANNEL_SIDE_RIGHT:
+		left = -1;
+		break;
+	default:
+		break;
+	}
+
+	if (left >= 0 || right >= 0) {
+		if (left >= 0)
+			m[left][in] += FOLD_GAIN;
+		if (right >= 0)
+			m[right][in] += FOLD_GAIN;
+	} else if (fc >= 0) {
+		m[fc][in] += FOLD_GAIN;
+	}
+}
+
+
+/* Build the remixing matrix; returns false if it is the identity */
+static bool build_matrix(const struct adef_format *src,
+			 const struct adef_format *dst,
+			 float (*m)[ADEF_PCM_MAX_CHANNELS])
+{
+	unsigned int in_count = src->channel_count;
+	unsigned int out_count = dst->channel_count;
+	bool identity = in_count == out_count;
+
+	memset(m, 0, sizeof(float) * ADEF_PCM_MAX_CHANNELS * out_count);
+
+	if (src->channel_layout != ADEF_CHANNEL_LAYOUT_UNSPECIFIED &&
+	    dst->channel_layout != ADEF_CHANNEL_LAYOUT_UNSPECIFIED) {
+		uint32_t layout = src->channel_layout;
+		for (unsigned int in = 0; layout != 0; in++) {
+			uint32_t position = layout & -layout;
+			int out = layout_index(dst->channel_layout, position);
+			if (out >= 0)
+				m[out][in] = 1.f;
+			else
+				fold_position(
+					m, dst->channel_layout, position, in);
+			layout &= ~position;
+		}
+	} else if (in_count == 1) {
+		/* Duplicate mono */
+		for (unsigned int out = 0; out < out_count; out++)
+			m[out][0] = 1.f;
+	} else if (out_count == 1) {
+		/* Average to mono */
+		for (unsigned int in = 0; in < in_count; in++)
+			m[0][in] = 1.f / in_count;
+	} else {
+		/* Keep the first channels */
+		for (unsigned int c = 0; c < in_count && c < out_count; c++)
+			m[c][c] = 1.f;
+	}
+
+	/* Normalize the rows to avoid saturation */
+	for (unsigned int out = 0; out < out_count; out++) {
+		float sum = 0.f;
+		for (unsigned int in = 0; in < in_count; in++)
+			sum += m[out][in];
+		if (sum > 1.f) {
+			for (unsigned int in = 0; in < in_count; in++)
+				m[out][in] /= sum;
+		}
+		for (unsigned int in = 0; in < in_count; in++) {
+			if (m[out][in] != (out == in ? 1.f : 0.f))
+				identity = false;
+		}
+	}
+
+	return !identity;
+}
+
+
+static void add_stage(struct adef_pcm_convert *conv, enum adef_pcm_stage stage)
+{
+	conv->stages[conv->stage_count++] = stage;
+}
+
+
+int adef_pcm_convert_new(const struct adef_format *src,
+			 const struct adef_format *dst,
+			 struct adef_pcm_convert **ret_obj)
+{
+	int ret;
+	struct adef_pcm_convert *conv;
+	unsigned int channels;
+
+	ULOG_ERRNO_RETURN_ERR_IF(src == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(dst == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	conv = calloc(1, sizeof(*conv));
+	if (conv == NULL)
+		return -ENOMEM;
+	conv->src = *src;
+	conv->dst = *dst;
+
+	ret = adef_pcm_codec_get(src, &conv->src_codec);
+	if (ret < 0)
+		goto error;
+	ret = adef_pcm_codec_get(dst, &conv->dst_codec);
+	if (ret < 0)
+		goto error;
+
+	/* Plan */
+	if (adef_format_cmp(src, dst)) {
+		add_stage(conv, ADEF_PCM_STAGE_COPY);
+		goto out;
+	}
+	conv->remix = build_matrix(src, dst, conv->matrix);
+	conv->resample = src->sample_rate != dst->sample_rate;
+	if (!conv->remix && !conv->resample) {
+		add_stage(conv, ADEF_PCM_STAGE_REPACK);
+		goto out;
+	}
+
+	/* Work on as few channels as possible: downmix before and upmix
+	 * after the sample rate conversion */
+	conv->remix_first = dst->channel_count <= src->channel_count;
+	add_stage(conv, ADEF_PCM_STAGE_DECODE);
+	if (conv->remix && (conv->remix_first || !conv->resample))
+		add_stage(conv, ADEF_PCM_STAGE_REMIX);
+	if (conv->resample)
+		add_stage(conv, ADEF_PCM_STAGE_RESAMPLE);
+	if (conv->remix && !conv->remix_first && conv->resample)
+		add_stage(conv, ADEF_PCM_STAGE_REMIX);
+	add_stage(conv, ADEF_PCM_STAGE_ENCODE);
+
+	/* Allocate all buffers once */
+	channels = src->channel_count > dst->channel_count
+			   ? src->channel_count
+			   : dst->channel_count;
+	conv->scratch_frames = ADEF_PCM_BLOCK_FRAMES;
+	if (conv->resample) {
+		size_t max = adef_pcm_convert_get_max_output(
+			conv, ADEF_PCM_BLOCK_FRAMES);
+		if (max > conv->scratch_frames)
+			conv->scratch_frames = max;
+		conv->step = ((uint64_t)src->sample_rate << 32) /
+			     dst->sample_rate;
+		conv->resample_channels = conv->remix_first
+						  ? dst->channel_count
+						  : src->channel_count;
+		conv->history =
+			calloc(conv->resample_channels, sizeof(*conv->history));
+		if (conv->history == NULL) {
+			ret = -ENOMEM;
+			goto error;
+		}
+	}
+	for (unsigned int i = 0; i < 2; i++) {
+		conv->scratch[i] = malloc(channels * conv->scratch_frames *
+					  sizeof(*conv->scratch[i]));
+		if (conv->scratch[i] == NULL) {
+			ret = -ENOMEM;
+			goto error;
+		}
+	}
+
+out:
+	if (conv->stages[0] == ADEF_PCM_STAGE_REPACK) {
+		conv->repack_f32 = src->pcm.float_val || dst->pcm.float_val;
+		conv->repack = malloc(ADEF_PCM_BLOCK_FRAMES * sizeof(int32_t));
+		if (conv->repack == NULL) {
+			ret = -ENOMEM;
+			goto error;
+		}
+	}
+	*ret_obj = conv;
+	return 0;
+
+error:
+	adef_pcm_convert_destroy(conv);
+	return ret;
+}
+
+
+int adef_pcm_convert_destroy(struct adef_pcm_convert *conv)
+{
+	if (conv == NULL)
+		return 0;
+
+	free(conv->history);
+	free(conv->scratch[0]);
+	free(conv->scratch[1]);
+	free(conv->repack);
+	free(conv);
+
+	return 0;
+}
+
+
+int adef_pcm_convert_reset(struct adef_pcm_convert *conv)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(conv == NULL, EINVAL);
+
+	conv->pos = 0;
+	if (conv->history != NULL) {
+		memset(conv->history,
+		       0,
+		       conv->resample_channels * sizeof(*conv->history));
+	}
+
+	return 0;
+}
+
+
+size_t adef_pcm_convert_get_max_output(struct adef_pcm_convert *conv,
+				       size_t in_frames)
+{
+	ULOG_ERRNO_RETURN_VAL_IF(conv == NULL, EINVAL, 0);
+
+	if (conv->src.sample_rate == conv->dst.sample_rate)
+		return in_frames;
+
+	/* The resampler may hold back one input frame, or release one held
+	 * back previously */
+	return (in_frames + 1) * conv->dst.sample_rate /
+		       conv->src.sample_rate +
+	       1;
+}
+
+
+int adef_pcm_convert_buffer(const struct adef_format *src,
+			    const struct adef_format *dst,
+			    const struct adef_pcm_buffer *in,
+			    const struct adef_pcm_buffer *out,
+			    size_t *out_frames)
+{
+	int ret, err;
+	struct adef_pcm_convert *conv;
+
+	ret = adef_pcm_convert_new(src, dst, &conv);
+	if (ret < 0)
+		return ret;
+	ret = adef_pcm_convert_process(conv, in, out, out_frames);
+	err = adef_pcm_convert_destroy(conv);
+	return ret < 0 ? ret : err;
+}
+
+
+int adef_pcm_convert_get_stages(struct adef_pcm_convert *conv,
+				enum adef_pcm_stage *stages,
+				unsigned int *count)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(conv == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(stages == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count == NULL, EINVAL);
+
+	if (*count < conv->stage_count) {
+		*count = conv->stage_count;
+		return -ENOBUFS;
+	}
+	memcpy(stages, conv->stages, conv->stage_count * sizeof(*stages));
+	*count = conv->stage_count;
+
+	return 0;
+}
+
+
+static void copy(struct adef_pcm_convert *conv,
+		 const struct adef_pcm_buffer *in,
+		 const struct adef_pcm_buffer *out)
+{
+	size_t size = conv->src_codec.sample_size;
+	size_t in_stride, out_stride;
+
+	if (conv->src.pcm.interleaved) {
+		memcpy(out->data,
+		       in->data,
+		       in->frames * size * conv->src.channel_count);
+		return;
+	}
+	for (unsigned int c = 0; c < conv->src.channel_count; c++) {
+		memcpy(adef_pcm_buffer_channel(
+			       out, &conv->dst, size, c, &out_stride),
+		       adef_pcm_buffer_channel(
+			       in, &conv->src, size, c, &in_stride),
+		       in->frames * size);
+	}
+}
+
+
+/* Repack between packed and 4-byte containers of 24-bit little-endian
+ * samples with the dedicated kernels; returns false if not applicable */
+static bool repack_24le(struct adef_pcm_convert *conv,
+			const struct adef_pcm_buffer *in,
+			const struct adef_pcm_buffer *out)
+{
+	const struct adef_format *src = &conv->src;
+	const struct adef_format *dst = &conv->dst;
+	size_t src_size = conv->src_codec.sample_size;
+	size_t dst_size = conv->dst_codec.sample_size;
+	unsigned int runs = src->pcm.interleaved ? 1 : src->channel_count;
+	size_t count = src->pcm.interleaved ? in->frames * src->channel_count
+					    : in->frames;
+
+	if (src->bit_depth != 24 || dst->bit_depth != 24 ||
+	    !src->pcm.little_endian || !dst->pcm.little_endian ||
+	    src->pcm.signed_val != dst->pcm.signed_val ||
+	    src->pcm.interleaved != dst->pcm.interleaved ||
+	    src_size == dst_size)
+		return false;
+
+	for (unsigned int r = 0; r < runs; r++) {
+		size_t is, os;
+		const uint8_t *s =
+			adef_pcm_buffer_channel(in, src, src_size, r, &is);
+		uint8_t *d =
+			adef_pcm_buffer_channel(out, dst, dst_size, r, &os);
+		if (src_size == 3)
+			adef_pcm_unpack_24le(s, d, count, src->pcm.signed_val);
+		else
+			adef_pcm_pack_24le(s, d, count);
+	}
+	return true;
+}
+
+
+static void repack(struct adef_pcm_convert *conv,
+		   const struct adef_pcm_buffer *in,
+		   const struct adef_pcm_buffer *out)
+{
+	const struct adef_pcm_codec *src_codec = &conv->src_codec;
+	const struct adef_pcm_codec *dst_codec = &conv->dst_codec;
+	size_t src_size = src_codec->sample_size;
+	size_t dst_size = dst_codec->sample_size;
+
+	if (repack_24le(conv, in, out))
+		return;
+
+	/* Single pass over blocks: all the channels of a block are
+	 * processed together, so that interleaved buffers are only read once
+	 * from memory */
+	for (size_t f = 0; f < in->frames; f += ADEF_PCM_BLOCK_FRAMES) {
+		size_t n = in->frames - f;
+		if (n > ADEF_PCM_BLOCK_FRAMES)
+			n = ADEF_PCM_BLOCK_FRAMES;
+		for (unsigned int c = 0; c < conv->src.channel_count; c++) {
+			size_t is, os;
+			const uint8_t *src = adef_pcm_buffer_channel(
+				in, &conv->src, src_size, c, &is);
+			uint8_t *dst = adef_pcm_buffer_channel(
+				out, &conv->dst, dst_size, c, &os);
+			src += f * is;
+			dst += f * os;
+			if (conv->repack_f32) {
+				src_codec->load_f32(src, is, conv->repack, n);
+				dst_codec->store_f32(conv->repack, dst, os, n);
+			} else {
+				src_codec->load_s32(src, is, conv->repack, n);
+				dst_codec->store_s32(conv->repack, dst, os, n);
+			}
+		}
+	}
+}
+
+
+static void remix(struct adef_pcm_convert *conv,
+		  const float *in,
+		  float *out,
+		  size_t frames)
+{
+	const struct adef_pcm_kernels *kernels = adef_pcm_kernels_get();
+	size_t stride = conv->scratch_frames;
+
+	for (unsigned int o = 0; o < conv->dst.channel_count; o++) {
+		float *dst = out + o * stride;
+		memset(dst, 0, frames * sizeof(*dst));
+		for (unsigned int i = 0; i < conv->src.channel_count; i++) {
+			float k = conv->matrix[o][i];
+			if (k == 0.f)
+				continue;
+			kernels->mix_f32(in + i * stride, dst, frames, k);
+		}
+	}
+}
+
+
+static size_t resample(struct adef_pcm_convert *conv,
+		       const float *in,
+		       float *out,
+		       size_t frames)
+{
+	size_t stride = conv->scratch_frames;
+	int64_t end = (int64_t)(frames - 1) * POS_ONE;
+	size_t count = 0;
+
+	for (unsigned int c = 0; c < conv->resample_channels; c++) {
+		const float *src = in + c * stride;
+		float *dst = out + c * stride;
+		int64_t pos = conv->pos;
+		count = 0;
+		/* Frame at position -1 is the previous block last frame */
+		for (; pos < end; pos += conv->step) {
+			int64_t idx = pos >> 32;
+			float frac = (float)(pos & (POS_ONE - 1)) *
+				     (1.f / (float)POS_ONE);
+			float a = idx < 0 ? conv->history[c] : src[idx];
+			float b = src[idx + 1];
+			dst[count++] = a + frac * (b - a);
+		}
+		conv->history[c] = src[frames - 1];
+		if (c == conv->resample_channels - 1)
+			conv->pos = pos - (int64_t)frames * POS_ONE;
+	}
+
+	return count;
+}
+
+
+int adef_pcm_convert_process(struct adef_pcm_convert *conv,
+			     const struct adef_pcm_buffer *in,
+			     const struct adef_pcm_buffer *out,
+			     size_t *out_frames)
+{
+	size_t written = 0;
+
+	ULOG_ERRNO_RETURN_ERR_IF(conv == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(in == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(in->data == NULL && in->frames != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out->data == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out_frames == NULL, EINVAL);
+
+	if (out->frames < adef_pcm_convert_get_max_output(conv, in->frames))
+		return -ENOBUFS;
+
+	switch (conv->stages[0]) {
+	case ADEF_PCM_STAGE_COPY:
+		copy(conv, in, out);
+		*out_frames = in->frames;
+		return 0;
+	case ADEF_PCM_STAGE_REPACK:
+		repack(conv, in, out);
+		*out_frames = in->frames;
+		return 0;
+	default:
+		break;
+	}
+
+	for (size_t f = 0; f < in->frames; f += ADEF_PCM_BLOCK_FRAMES) {
+		size_t n = in->frames - f;
+		float *cur = conv->scratch[0];
+		float *next = conv->scratch[1];
+		float *tmp;
+
+		if (n > ADEF_PCM_BLOCK_FRAMES)
+			n = ADEF_PCM_BLOCK_FRAMES;
+
+		/* Decode */
+		for (unsigned int c = 0; c < conv->src.channel_count; c++) {
+			size_t stride;
+			const uint8_t *src = adef_pcm_buffer_channel(
+				in,
+				&conv->src,
+				conv->src_codec.sample_size,
+				c,
+				&stride);
+			conv->src_codec.load_f32(src + f * stride,
+						 stride,
+						 cur + c * conv->scratch_frames,
+						 n);
+		}
+
+		/* Remix (downmix) */
+		if (conv->remix && (conv->remix_first || !conv->resample)) {
+			remix(conv, cur, next, n);
+			tmp = cur;
+			cur = next;
+			next = tmp;
+		}
+
+		/* Resample */
+		if (conv->resample) {
+			n = resample(conv, cur, next, n);
+			tmp = cur;
+			cur = next;
+			next = tmp;
+		}
+
+		/* Remix (upmix) */
+		if (conv->remix && !conv->remix_first && conv->resample) {
+			remix(conv, cur, next, n);
+			tmp = cur;
+			cur = next;
+			next = tmp;
+		}
+
+		/* Encode */
+		for (unsigned int c = 0; c < conv->dst.channel_count; c++) {
+			size_t stride;
+			uint8_t *dst = adef_pcm_buffer_channel(
+				out,
+				&conv->dst,
+				conv->dst_codec.sample_size,
+				c,
+				&stride);
+			conv->dst_codec.store_f32(
+				cur + c * conv->scratch_frames,
+				dst + written * stride,
+				stride,
+				n);
+		}
+		written += n;
+	}
+
+	*out_frames = written;
+	return 0;
+}
@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Samples are processed in units of destination LSB: an input sample x
+ * (left-justified) becomes v = x / 2^(32 - bits), the output is
+ * y = round(v + dither), saturated, and the requantization error y - v
+ * is fed back (negated) to the next sample when noise shaping is on */
+
+
+/* Sequential requantization with first order error feedback */
+static void requantize_block_shaped(struct adef_pcm_requantize *rq,
+				    const int32_t *in,
+				    int32_t *out,
+				    size_t count,
+				    unsigned int bits,
+				    float *error)
+{
+	const float k = 1.f / (float)(1u << (32 - bits));
+	const int32_t lo = -(int32_t)(1u << (bits - 1));
+	const int32_t hi = (int32_t)(1u << (bits - 1)) - 1;
+	const unsigned int shift = 32 - bits;
+	const bool dither = rq->dither == ADEF_PCM_DITHER_TPDF;
+	uint32_t rng = rq->rng[0];
+	float e = *error;
+
+	for (size_t i = 0; i < count; i++) {
+		float v = (float)in[i] * k - e;
+		float w = v + 0.5f;
+		int32_t y;
+		if (dither) {
+			rng = adef_xorshift32(rng);
+			w += adef_tpdf(rng);
+		}
+		y = (int32_t)w;
+		y -= (float)y > w;
+		y = y < lo ? lo : (y > hi ? hi : y);
+		/* Bound the feedback when saturating */
+		e = (float)y - v;
+		e = e < -1.f ? -1.f : (e > 1.f ? 1.f : e);
+		out[i] = (int32_t)((uint32_t)y << shift);
+	}
+
+	rq->rng[0] = rng;
+	*error = e;
+}
+
+
+int adef_pcm_requantize_init(struct adef_pcm_requantize *rq,
+			     const struct adef_format *src,
+			     const struct adef_format *dst,
+			     enum adef_pcm_dither dither,
+			     bool noise_shaping,
+			     uint64_t seed)
+{
+	int ret;
+	struct adef_pcm_codec codec;
+
+	ULOG_ERRNO_RETURN_ERR_IF(rq == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(dither >= ADEF_PCM_DITHER_MAX, EINVAL);
+
+	ret = adef_pcm_codec_get(src, &codec);
+	if (ret < 0)
+		return ret;
+	ret = adef_pcm_codec_get(dst, &codec);
+	if (ret < 0)
+		return ret;
+	if (src->channel_count != dst->channel_count ||
+	    src->sample_rate != dst->sample_rate) {
+		ULOGE("%s: channel count and sample rate must match", __func__);
+		return -EINVAL;
+	}
+
+	memset(rq, 0, sizeof(*rq));
+	rq->src = *src;
+	rq->dst = *dst;
+	rq->dither = dither;
+	rq->noise_shaping = noise_shaping;
+
+	/* Seed the generators with splitmix64; xorshift32 must not be
+	 * seeded with 0 */
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(rq->rng); i++) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		z ^= z >> 31;
+		rq->rng[i] = (uint32_t)z ? (uint32_t)z : 0x9e3779b9u;
+	}
+
+	return 0;
+}
+
+
+int adef_pcm_requantize_process(struct adef_pcm_requantize *rq,
+				const struct adef_pcm_buffer *in,
+				const struct adef_pcm_buffer *out)
+{
+	struct adef_pcm_codec src_codec, dst_codec;
+	const struct adef_pcm_kernels *kernels = adef_pcm_kernels_get();
+	int32_t samples[ADEF_PCM_BLOCK_FRAMES];
+	unsigned int bits;
+	bool dither;
+
+	ULOG_ERRNO_RETURN_ERR_IF(rq == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(in == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(in->data == NULL && in->frames != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out->data == NULL && in->frames != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out->frames < in->frames, ENOBUFS);
+
+	if (adef_pcm_codec_get(&rq->src, &src_codec) < 0 ||
+	    adef_pcm_codec_get(&rq->dst, &dst_codec) < 0)
+		return -EINVAL;
+	bits = dst_codec.bits;
+	dither = rq->dither == ADEF_PCM_DITHER_TPDF;
+
+	for (size_t f = 0; f < in->frames; f += ADEF_PCM_BLOCK_FRAMES) {
+		size_t n = in->frames - f;
+		if (n > ADEF_PCM_BLOCK_FRAMES)
+			n = ADEF_PCM_BLOCK_FRAMES;
+		for (unsigned int c = 0; c < rq->src.channel_count; c++) {
+			size_t is, os;
+			const uint8_t *src = adef_pcm_buffer_channel(
+				in, &rq->src, src_codec.sample_size, c, &is);
+			uint8_t *dst = adef_pcm_buffer_channel(
+				out, &rq->dst, dst_codec.sample_size, c, &os);
+			src_codec.load_s32(src + f * is, is, samples, n);
+			if (bits >= src_codec.bits) {
+				/* Nothing to requantize */
+			} else if (rq->noise_shaping) {
+				requantize_block_shaped(rq,
+							samples,
+							samples,
+							n,
+							bits,
+							&rq->error[c]);
+			} else {
+				kernels->requantize(samples,
+						    samples,
+						    n,
+						    bits,
+						    rq->rng,
+						    dither);
+			}
+			dst_codec.store_s32(samples, dst + f * os, os, n);
+		}
+	}
+
+	return 0;
+}
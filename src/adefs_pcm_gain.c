@@ -0,0 +1,318 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Gain floor of exponential ramps (-80 dB) */
+#define EXP_FLOOR 1e-4f
+
+
+/* The per-frame gains are computed once per block of frames and shared by
+ * all channels; the buffers are then processed as runs of contiguous
+ * samples (the whole block for interleaved formats, with the gains
+ * expanded to each sample, each plane for planar formats) */
+
+
+enum kernel {
+	KERNEL_S16 = 0,
+	KERNEL_S32,
+	KERNEL_F32,
+	KERNEL_GENERIC,
+};
+
+
+struct block {
+	float gains[ADEF_PCM_BLOCK_FRAMES];
+	float expanded[ADEF_PCM_BLOCK_FRAMES];
+	union {
+		float f[ADEF_PCM_BLOCK_FRAMES];
+		double d[ADEF_PCM_BLOCK_FRAMES];
+	} tmp;
+};
+
+
+/* Gain of the ramp at a position */
+static float gain_at(const struct adef_pcm_gain *gain, uint64_t pos)
+{
+	float t, from, to;
+
+	if (pos < gain->start)
+		return gain->from;
+	if (pos >= gain->end)
+		return gain->to;
+
+	t = (float)(pos - gain->start) / (float)(gain->end - gain->start);
+	if (gain->shape == ADEF_PCM_RAMP_LINEAR)
+		return gain->from + (gain->to - gain->from) * t;
+
+	from = gain->from > EXP_FLOOR ? gain->from : EXP_FLOOR;
+	to = gain->to > EXP_FLOOR ? gain->to : EXP_FLOOR;
+	return from * powf(to / from, t);
+}
+
+
+/* Compute the gains of 'count' frames from a position: the ramp section
+ * is computed incrementally from an exact value at the block start */
+static void compute_gains(const struct adef_pcm_gain *gain,
+			  uint64_t pos,
+			  float *gains,
+			  size_t count)
+{
+	size_t i = 0;
+	float g, step;
+
+	for (; i < count && pos + i < gain->start; i++)
+		gains[i] = gain->from;
+	if (i < count && pos + i < gain->end) {
+		float dur = (float)(gain->end - gain->start);
+		g = gain_at(gain, pos + i);
+		if (gain->shape == ADEF_PCM_RAMP_LINEAR) {
+			step = (gain->to - gain->from) / dur;
+			for (; i < count && pos + i < gain->end; i++) {
+				gains[i] = g;
+				g += step;
+			}
+		} else {
+			float from = gain->from > EXP_FLOOR ? gain->from
+							    : EXP_FLOOR;
+			float to = gain->to > EXP_FLOOR ? gain->to : EXP_FLOOR;
+			step = powf(to / from, 1.f / dur);
+			for (; i < count && pos + i < gain->end; i++) {
+				gains[i] = g;
+				g *= step;
+			}
+		}
+	}
+	for (; i < count; i++)
+		gains[i] = gain->to;
+}
+
+
+/* Apply per-sample gains to a run of contiguous samples */
+static void apply_gains(enum kernel kernel,
+			const struct adef_pcm_kernels *kernels,
+			const struct adef_pcm_codec *codec,
+			uint8_t *data,
+			const float *gains,
+			struct block *block,
+			size_t count)
+{
+	switch (kernel) {
+	case KERNEL_S16:
+		kernels->gain_s16(
+			(const int16_t *)data, gains, block->tmp.f, count);
+		kernels->store_s16_sat(block->tmp.f, (int16_t *)data, count);
+		break;
+	case KERNEL_F32:
+		kernels->gain_f32((float *)data, gains, count);
+		break;
+	case KERNEL_S32:
+		kernels->gain_s32(
+			(const int32_t *)data, gains, block->tmp.d, count);
+		kernels->store_s32_sat(block->tmp.d, (int32_t *)data, count);
+		break;
+	default:
+		codec->load_f32(data, codec->sample_size, block->tmp.f, count);
+		kernels->gain_f32(block->tmp.f, gains, count);
+		codec->store_f32(block->tmp.f, data, codec->sample_size, count);
+		break;
+	}
+}
+
+
+int adef_pcm_gain_init(struct adef_pcm_gain *gain,
+		       const struct adef_format *format,
+		       float value)
+{
+	int ret;
+	struct adef_pcm_codec codec;
+
+	ULOG_ERRNO_RETURN_ERR_IF(gain == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!isfinite(value), EINVAL);
+
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+
+	memset(gain, 0, sizeof(*gain));
+	gain->format = *format;
+	gain->shape = ADEF_PCM_RAMP_LINEAR;
+	gain->from = value;
+	gain->to = value;
+
+	return 0;
+}
+
+
+int adef_pcm_gain_set_ramp(struct adef_pcm_gain *gain,
+			   float target,
+			   enum adef_pcm_ramp shape,
+			   const struct adef_frame_info *start,
+			   uint32_t duration)
+{
+	uint64_t pos;
+
+	ULOG_ERRNO_RETURN_ERR_IF(gain == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!isfinite(target), EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(shape >= ADEF_PCM_RAMP_MAX, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(start != NULL && start->timescale == 0,
+				 EINVAL);
+
+	if (start != NULL)
+		pos = adef_frame_info_to_samples(start,
+						 gain->format.sample_rate);
+	else
+		pos = gain->position;
+
+	if (shape == ADEF_PCM_RAMP_EXPONENTIAL) {
+		ULOG_ERRNO_RETURN_ERR_IF(target < 0.f, EINVAL);
+		ULOG_ERRNO_RETURN_ERR_IF(gain_at(gain, pos) < 0.f, EINVAL);
+	}
+
+	gain->from = gain_at(gain, pos);
+	gain->to = target;
+	gain->shape = shape;
+	gain->start = pos;
+	gain->end = pos + duration;
+	gain->start_pending = (start == NULL);
+
+	return 0;
+}
+
+
+int adef_pcm_gain_process(struct adef_pcm_gain *gain,
+			  const struct adef_pcm_buffer *buf,
+			  const struct adef_frame_info *info)
+{
+	int ret;
+	const struct adef_format *format;
+	struct adef_pcm_codec codec;
+	const struct adef_pcm_kernels *kernels = adef_pcm_kernels_get();
+	enum kernel kernel = KERNEL_GENERIC;
+	unsigned int channels;
+	struct block block;
+
+	ULOG_ERRNO_RETURN_ERR_IF(gain == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf->data == NULL && buf->frames != 0, EINVAL);
+
+	format = &gain->format;
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+	if (format->pcm.float_val &&
+	    format->pcm.little_endian == ADEF_HOST_LITTLE_ENDIAN) {
+		kernel = KERNEL_F32;
+	} else if (format->pcm.signed_val &&
+		   format->pcm.little_endian == ADEF_HOST_LITTLE_ENDIAN) {
+		if (codec.bits == 16)
+			kernel = KERNEL_S16;
+		else if (codec.bits == 32)
+			kernel = KERNEL_S32;
+	}
+	channels = format->channel_count;
+
+	if (info != NULL && info->timescale != 0) {
+		uint64_t pos =
+			adef_frame_info_to_samples(info, format->sample_rate);
+		if (gain->start_pending) {
+			/* Move the ramp to this buffer */
+			gain->end = pos + (gain->end - gain->start);
+			gain->start = pos;
+		}
+		gain->position = pos;
+	}
+	gain->start_pending = false;
+
+	/* Nothing to do in a unity gain section */
+	if ((gain->position + buf->frames <= gain->start &&
+	     gain->from == 1.f) ||
+	    (gain->position >= gain->end && gain->to == 1.f))
+		goto out;
+
+	for (size_t f = 0; f < buf->frames; f += ADEF_PCM_BLOCK_FRAMES) {
+		size_t n = buf->frames - f;
+		if (n > ADEF_PCM_BLOCK_FRAMES)
+			n = ADEF_PCM_BLOCK_FRAMES;
+		compute_gains(gain, gain->position + f, block.gains, n);
+
+		if (!format->pcm.interleaved) {
+			for (unsigned int c = 0; c < channels; c++) {
+				size_t stride;
+				uint8_t *data = adef_pcm_buffer_channel(
+					buf, format, codec.sample_size, c,
+					&stride);
+				apply_gains(kernel,
+					    kernels,
+					    &codec,
+					    data + f * codec.sample_size,
+					    block.gains,
+					    &block,
+					    n);
+			}
+			continue;
+		}
+
+		/* Interleaved: expand the gains to the samples, one chunk at
+		 * a time */
+		uint8_t *data = (uint8_t *)buf->data +
+				f * channels * codec.sample_size;
+		size_t total = n * channels;
+		size_t frame = 0;
+		unsigned int channel = 0;
+		for (size_t s = 0; s < total; s += ADEF_PCM_BLOCK_FRAMES) {
+			size_t m = total - s;
+			if (m > ADEF_PCM_BLOCK_FRAMES)
+				m = ADEF_PCM_BLOCK_FRAMES;
+			for (size_t i = 0; i < m; i++) {
+				block.expanded[i] = block.gains[frame];
+				if (++channel == channels) {
+					channel = 0;
+					frame++;
+				}
+			}
+			apply_gains(kernel,
+				    kernels,
+				    &codec,
+				    data + s * codec.sample_size,
+				    block.expanded,
+				    &block,
+				    m);
+		}
+	}
+
+out:
+	gain->position += buf->frames;
+	return 0;
+}
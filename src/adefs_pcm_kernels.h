@@ -0,0 +1,726 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* PCM processing kernels, included once by each adefs_pcm_kernels_*.c
+ * file (no include guard), which defines ADEF_PCM_KERNELS to the name of
+ * the kernel table to build and ADEF_PCM_KERNELS_VECTOR to use the vector
+ * kernels, compiled for the instruction set of the file. The scalar
+ * kernels are the reference implementations, and process the remaining
+ * samples after the last full vector of the vector kernels (each vector
+ * lane computing exactly what the scalar code computes) */
+
+#ifndef ADEF_PCM_KERNELS
+#	error "ADEF_PCM_KERNELS must be defined"
+#endif
+
+
+static void scalar_store_s16_sat(const float *src, int16_t *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		float a = src[i];
+		a = a < -32768.f ? -32768.f : (a > 32767.f ? 32767.f : a);
+		dst[i] = (int16_t)(a + (a < 0.f ? -0.5f : 0.5f));
+	}
+}
+
+
+static void
+scalar_store_s32_sat(const double *src, int32_t *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		double a = src[i];
+		a = a < -2147483648. ? -2147483648.
+				     : (a > 2147483647. ? 2147483647. : a);
+		dst[i] = (int32_t)(a + (a < 0. ? -0.5 : 0.5));
+	}
+}
+
+
+static void scalar_unpack_24le(const uint8_t *src,
+			       uint32_t *dst,
+			       size_t count,
+			       bool signed_val)
+{
+	for (size_t i = 0; i < count; i++, src += 3) {
+		uint32_t v = ((uint32_t)src[0] << 8) |
+			     ((uint32_t)src[1] << 16) |
+			     ((uint32_t)src[2] << 24);
+		v = signed_val ? (uint32_t)((int32_t)v >> 8) : v >> 8;
+		dst[i] = htole32(v);
+	}
+}
+
+
+static void scalar_pack_24le(const uint32_t *src, uint8_t *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++, dst += 3) {
+		uint32_t v = le32toh(src[i]);
+		dst[0] = (uint8_t)v;
+		dst[1] = (uint8_t)(v >> 8);
+		dst[2] = (uint8_t)(v >> 16);
+	}
+}
+
+
+static void scalar_level(const int32_t *samples,
+			 size_t count,
+			 int32_t clip_hi,
+			 uint32_t *peak,
+			 double *sum_sq,
+			 uint64_t *clip_count)
+{
+	const float k = 1.f / 2147483648.f;
+	uint32_t p = *peak;
+	float sum = 0.f;
+	uint64_t clip = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		int32_t s = samples[i];
+		/* One's complement absolute value, INT32_MIN gives
+		 * INT32_MAX instead of overflowing */
+		uint32_t a = (uint32_t)(s ^ (s >> 31));
+		float f = (float)s * k;
+		p = a > p ? a : p;
+		sum += f * f;
+		clip += s >= clip_hi || s == INT32_MIN;
+	}
+
+	*peak = p;
+	*sum_sq += sum;
+	*clip_count += clip;
+}
+
+
+static void
+scalar_mix_s16(const int16_t *src, float *acc, size_t count, float gain)
+{
+	for (size_t i = 0; i < count; i++)
+		acc[i] += (float)src[i] * gain;
+}
+
+
+static void
+scalar_mix_s32(const int32_t *src, double *acc, size_t count, double gain)
+{
+	for (size_t i = 0; i < count; i++)
+		acc[i] += (double)src[i] * gain;
+}
+
+
+static void
+scalar_mix_f32(const float *src, float *acc, size_t count, float gain)
+{
+	for (size_t i = 0; i < count; i++)
+		acc[i] += src[i] * gain;
+}
+
+
+static void scalar_gain_s16(const int16_t *src,
+			    const float *gains,
+			    float *dst,
+			    size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] = (float)src[i] * gains[i];
+}
+
+
+static void scalar_gain_s32(const int32_t *src,
+			    const float *gains,
+			    double *dst,
+			    size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] = (double)src[i] * gains[i];
+}
+
+
+static void scalar_gain_f32(float *samples, const float *gains, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		samples[i] *= gains[i];
+}
+
+
+/* Requantize a sample, with TPDF dither if rng is not NULL: the input
+ * sample x (left-justified) becomes v = x / 2^(32 - bits) in units of
+ * destination LSB, the output is floor(v + 0.5 + dither), saturated. It is
+ * computed in fixed point, exactly for all bit depths: the fractional part
+ * of v is taken in units of 2^-16 LSB (the resolution of the dither),
+ * truncating it does not change the floor */
+static inline int32_t requantize_sample(int32_t x,
+					unsigned int bits,
+					uint32_t *rng)
+{
+	const unsigned int shift = 32 - bits;
+	const int32_t lo = -(int32_t)(1u << (bits - 1));
+	const int32_t hi = (int32_t)(1u << (bits - 1)) - 1;
+	int32_t frac = (int32_t)((uint32_t)x & ((1u << shift) - 1));
+	int32_t y;
+
+	frac = shift >= 16 ? frac >> (shift - 16) : frac << (16 - shift);
+	frac += 0x8000;
+	if (rng != NULL) {
+		*rng = adef_xorshift32(*rng);
+		frac += (int32_t)(*rng & 0xffff) + (int32_t)(*rng >> 16) -
+			65535;
+	}
+	y = (x >> shift) + (frac >> 16);
+	y = y < lo ? lo : (y > hi ? hi : y);
+	return (int32_t)((uint32_t)y << shift);
+}
+
+
+static void scalar_requantize(const int32_t *in,
+			      int32_t *out,
+			      size_t count,
+			      unsigned int bits,
+			      uint32_t rng[ADEF_VEC_LEN],
+			      bool dither)
+{
+	size_t i = 0;
+
+	/* Full vectors: one generator per lane */
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		for (unsigned int j = 0; j < ADEF_VEC_LEN; j++) {
+			out[i + j] = requantize_sample(
+				in[i + j], bits, dither ? &rng[j] : NULL);
+		}
+	}
+	for (; i < count; i++)
+		out[i] = requantize_sample(in[i], bits, dither ? rng : NULL);
+}
+
+
+static size_t scalar_sanitize(float *samples, size_t count, float limit)
+{
+	size_t modified = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		float v = samples[i];
+		float s = v;
+		if (isnan(s) || fabsf(s) < FLT_MIN)
+			s = 0.f;
+		s = s < -limit ? -limit : (s > limit ? limit : s);
+		if (memcmp(&s, &v, sizeof(s)) != 0) {
+			samples[i] = s;
+			modified++;
+		}
+	}
+
+	return modified;
+}
+
+
+/* The vector biquad kernel has no remaining samples to process (one frame
+ * per vector) */
+#ifndef ADEF_PCM_KERNELS_VECTOR
+static void scalar_biquad(float *samples,
+			  size_t frames,
+			  const struct adef_pcm_biquad_coefs *coefs,
+			  unsigned int stages,
+			  float state[][2][ADEF_VEC_LEN])
+{
+	for (unsigned int s = 0; s < stages; s++) {
+		const struct adef_pcm_biquad_coefs *c = &coefs[s];
+		for (unsigned int j = 0; j < ADEF_VEC_LEN; j++) {
+			float z1 = state[s][0][j];
+			float z2 = state[s][1][j];
+			for (size_t f = 0; f < frames; f++) {
+				float x = samples[f * ADEF_VEC_LEN + j];
+				float y = c->b0 * x + z1;
+				z1 = c->b1 * x - c->a1 * y + z2;
+				z2 = c->b2 * x - c->a2 * y;
+				samples[f * ADEF_VEC_LEN + j] = y;
+			}
+			state[s][0][j] = z1;
+			state[s][1][j] = z2;
+		}
+	}
+}
+
+
+static void scalar_sum_sq(const float *samples,
+			  size_t frames,
+			  double sum_sq[ADEF_VEC_LEN])
+{
+	for (unsigned int j = 0; j < ADEF_VEC_LEN; j++) {
+		float acc = 0.f;
+		for (size_t f = 0; f < frames; f++) {
+			float x = samples[f * ADEF_VEC_LEN + j];
+			acc += x * x;
+		}
+		sum_sq[j] += acc;
+	}
+}
+
+
+static void scalar_peak_fir(const float *samples,
+			    size_t frames,
+			    const float *coefs,
+			    unsigned int phases,
+			    unsigned int taps,
+			    float peak[ADEF_VEC_LEN])
+{
+	for (unsigned int j = 0; j < ADEF_VEC_LEN; j++) {
+		float pk = peak[j];
+		for (size_t f = 0; f < frames; f++) {
+			for (unsigned int p = 0; p < phases; p++) {
+				const float *c = coefs + p * taps;
+				float acc = 0.f;
+				for (unsigned int t = 0; t < taps; t++) {
+					size_t i = (f + taps - 1 - t) *
+							   ADEF_VEC_LEN +
+						   j;
+					acc += c[t] * samples[i];
+				}
+				acc = acc < 0.f ? -acc : acc;
+				pk = acc > pk ? acc : pk;
+			}
+		}
+		peak[j] = pk;
+	}
+}
+#endif /* !ADEF_PCM_KERNELS_VECTOR */
+
+
+#ifdef ADEF_PCM_KERNELS_VECTOR
+
+
+static void vec_store_s16_sat(const float *src, int16_t *dst, size_t count)
+{
+	const adef_v8sf lo = (adef_v8sf){0} - 32768.f;
+	const adef_v8sf hi = (adef_v8sf){0} + 32767.f;
+	const adef_v8sf half = (adef_v8sf){0} + 0.5f;
+	size_t i = 0;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8sf a;
+		adef_v8si v;
+		memcpy(&a, src + i, sizeof(a));
+		/* Saturate, then round half away from zero */
+		a = ADEF_V8SF_SELECT(a < lo, lo, a);
+		a = ADEF_V8SF_SELECT(a > hi, hi, a);
+		a += ADEF_V8SF_SELECT(a < 0.f, -half, half);
+		v = __builtin_convertvector(a, adef_v8si);
+		for (unsigned int j = 0; j < ADEF_VEC_LEN; j++)
+			dst[i + j] = (int16_t)v[j];
+	}
+	scalar_store_s16_sat(src + i, dst + i, count - i);
+}
+
+
+static void vec_store_s32_sat(const double *src, int32_t *dst, size_t count)
+{
+	const adef_v8df lo = (adef_v8df){0} - 2147483648.;
+	const adef_v8df hi = (adef_v8df){0} + 2147483647.;
+	const adef_v8df half = (adef_v8df){0} + 0.5;
+	size_t i = 0;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8df a;
+		adef_v8si v;
+		memcpy(&a, src + i, sizeof(a));
+		a = ADEF_V8DF_SELECT(a < lo, lo, a);
+		a = ADEF_V8DF_SELECT(a > hi, hi, a);
+		a += ADEF_V8DF_SELECT(a < 0., -half, half);
+		v = __builtin_convertvector(a, adef_v8si);
+		memcpy(dst + i, &v, sizeof(v));
+	}
+	scalar_store_s32_sat(src + i, dst + i, count - i);
+}
+
+
+/* The 24-bit pack and unpack kernels move 4 samples (3 words of packed
+ * samples) per step with 32-bit word loads and shifts, which is much
+ * faster than byte accesses */
+
+
+static void vec_unpack_24le(const uint8_t *src,
+			    uint32_t *dst,
+			    size_t count,
+			    bool signed_val)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4, src += 12) {
+		uint32_t w[3], v[4];
+		memcpy(w, src, sizeof(w));
+		w[0] = le32toh(w[0]);
+		w[1] = le32toh(w[1]);
+		w[2] = le32toh(w[2]);
+		v[0] = w[0] << 8;
+		v[1] = (w[0] >> 16 | w[1] << 16) & 0xffffff00u;
+		v[2] = (w[1] >> 8 | w[2] << 24) & 0xffffff00u;
+		v[3] = w[2] & 0xffffff00u;
+		for (unsigned int j = 0; j < 4; j++) {
+			v[j] = signed_val ? (uint32_t)((int32_t)v[j] >> 8)
+					  : v[j] >> 8;
+			dst[i + j] = htole32(v[j]);
+		}
+	}
+	scalar_unpack_24le(src, dst + i, count - i, signed_val);
+}
+
+
+static void vec_pack_24le(const uint32_t *src, uint8_t *dst, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4, dst += 12) {
+		uint32_t v[4], w[3];
+		memcpy(v, src + i, sizeof(v));
+		for (unsigned int j = 0; j < 4; j++)
+			v[j] = le32toh(v[j]) & 0xffffffu;
+		w[0] = htole32(v[0] | v[1] << 24);
+		w[1] = htole32(v[1] >> 8 | v[2] << 16);
+		w[2] = htole32(v[2] >> 16 | v[3] << 8);
+		memcpy(dst, w, sizeof(w));
+	}
+	scalar_pack_24le(src + i, dst, count - i);
+}
+
+
+static void vec_level(const int32_t *samples,
+		      size_t count,
+		      int32_t clip_hi,
+		      uint32_t *peak,
+		      double *sum_sq,
+		      uint64_t *clip_count)
+{
+	const float k = 1.f / 2147483648.f;
+	adef_v8su vpeak = {0};
+	adef_v8sf vsum = {0};
+	adef_v8si vclip = {0};
+	uint32_t p;
+	float sum = 0.f;
+	int32_t clip = 0;
+	size_t i = 0;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8si s;
+		adef_v8su a, m;
+		adef_v8sf f;
+		memcpy(&s, samples + i, sizeof(s));
+		a = (adef_v8su)(s ^ (s >> 31));
+		m = (adef_v8su)(vpeak > a);
+		vpeak = ADEF_VEC_SELECT(m, vpeak, a);
+		f = __builtin_convertvector(s, adef_v8sf) * k;
+		vsum += f * f;
+		/* Comparisons give -1 for true */
+		vclip -= (s >= clip_hi) | (s == INT32_MIN);
+	}
+
+	p = *peak;
+	for (unsigned int j = 0; j < ADEF_VEC_LEN; j++) {
+		p = vpeak[j] > p ? vpeak[j] : p;
+		sum += vsum[j];
+		clip += vclip[j];
+	}
+	*peak = p;
+	*sum_sq += sum;
+	*clip_count += (uint64_t)clip;
+
+	scalar_level(samples + i, count - i, clip_hi, peak, sum_sq, clip_count);
+}
+
+
+static void
+vec_mix_s16(const int16_t *src, float *acc, size_t count, float gain)
+{
+	size_t i = 0;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8hi s;
+		adef_v8sf a;
+		memcpy(&s, src + i, sizeof(s));
+		memcpy(&a, acc + i, sizeof(a));
+		a += __builtin_convertvector(s, adef_v8sf) * gain;
+		memcpy(acc + i, &a, sizeof(a));
+	}
+	scalar_mix_s16(src + i, acc + i, count - i, gain);
+}
+
+
+static void
+vec_mix_s32(const int32_t *src, double *acc, size_t count, double gain)
+{
+	size_t i = 0;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8si s;
+		adef_v8df a;
+		memcpy(&s, src + i, sizeof(s));
+		memcpy(&a, acc + i, sizeof(a));
+		a += __builtin_convertvector(s, adef_v8df) * gain;
+		memcpy(acc + i, &a, sizeof(a));
+	}
+	scalar_mix_s32(src + i, acc + i, count - i, gain);
+}
+
+
+static void
+vec_mix_f32(const float *src, float *acc, size_t count, float gain)
+{
+	size_t i = 0;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8sf s, a;
+		memcpy(&s, src + i, sizeof(s));
+		memcpy(&a, acc + i, sizeof(a));
+		a += s * gain;
+		memcpy(acc + i, &a, sizeof(a));
+	}
+	scalar_mix_f32(src + i, acc + i, count - i, gain);
+}
+
+
+static void vec_gain_s16(const int16_t *src,
+			 const float *gains,
+			 float *dst,
+			 size_t count)
+{
+	size_t i = 0;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8hi v;
+		adef_v8sf g, a;
+		memcpy(&v, src + i, sizeof(v));
+		memcpy(&g, gains + i, sizeof(g));
+		a = __builtin_convertvector(v, adef_v8sf) * g;
+		memcpy(dst + i, &a, sizeof(a));
+	}
+	scalar_gain_s16(src + i, gains + i, dst + i, count - i);
+}
+
+
+static void vec_gain_s32(const int32_t *src,
+			 const float *gains,
+			 double *dst,
+			 size_t count)
+{
+	size_t i = 0;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8si v;
+		adef_v8sf g;
+		adef_v8df a;
+		memcpy(&v, src + i, sizeof(v));
+		memcpy(&g, gains + i, sizeof(g));
+		a = __builtin_convertvector(v, adef_v8df) *
+		    __builtin_convertvector(g, adef_v8df);
+		memcpy(dst + i, &a, sizeof(a));
+	}
+	scalar_gain_s32(src + i, gains + i, dst + i, count - i);
+}
+
+
+static void vec_gain_f32(float *samples, const float *gains, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8sf v, g;
+		memcpy(&v, samples + i, sizeof(v));
+		memcpy(&g, gains + i, sizeof(g));
+		v *= g;
+		memcpy(samples + i, &v, sizeof(v));
+	}
+	scalar_gain_f32(samples + i, gains + i, count - i);
+}
+
+
+static void vec_requantize(const int32_t *in,
+			   int32_t *out,
+			   size_t count,
+			   unsigned int bits,
+			   uint32_t rng[ADEF_VEC_LEN],
+			   bool dither)
+{
+	const int32_t lo = -(int32_t)(1u << (bits - 1));
+	const int32_t hi = (int32_t)(1u << (bits - 1)) - 1;
+	const unsigned int shift = 32 - bits;
+	const int32_t mask = (int32_t)((1u << shift) - 1);
+	adef_v8su vrng;
+	size_t i = 0;
+
+	memcpy(&vrng, rng, sizeof(vrng));
+
+	/* Same fixed-point computation as requantize_sample() */
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8si x, y, frac;
+		memcpy(&x, in + i, sizeof(x));
+		frac = x & mask;
+		if (shift >= 16)
+			frac >>= shift - 16;
+		else
+			frac <<= 16 - shift;
+		frac += 0x8000;
+		if (dither) {
+			vrng ^= vrng << 13;
+			vrng ^= vrng >> 17;
+			vrng ^= vrng << 5;
+			frac += (adef_v8si)(vrng & 0xffff) +
+				(adef_v8si)(vrng >> 16) - 65535;
+		}
+		y = (x >> shift) + (frac >> 16);
+		ADEF_V8SI_CLAMP(y, lo, hi);
+		y = (adef_v8si)((adef_v8su)y << shift);
+		memcpy(out + i, &y, sizeof(y));
+	}
+
+	memcpy(rng, &vrng, sizeof(vrng));
+
+	scalar_requantize(in + i, out + i, count - i, bits, rng, dither);
+}
+
+
+static size_t vec_sanitize(float *samples, size_t count, float limit)
+{
+	size_t i = 0, modified = 0;
+	adef_v8si changed = {0};
+	const adef_v8sf hi = (adef_v8sf){0} + limit;
+	const adef_v8sf lo = -hi;
+
+	for (; i + ADEF_VEC_LEN <= count; i += ADEF_VEC_LEN) {
+		adef_v8sf v, s;
+		adef_v8si bits, abs_bits;
+		memcpy(&v, samples + i, sizeof(v));
+		bits = (adef_v8si)v;
+		abs_bits = bits & 0x7fffffff;
+		/* NaN (above the infinity bit pattern) and denormals (below
+		 * the smallest normal) are flushed to 0 */
+		s = (adef_v8sf)(bits & ~((abs_bits > 0x7f800000) |
+					 (abs_bits < 0x00800000)));
+		s = ADEF_V8SF_SELECT(s < lo, lo, s);
+		s = ADEF_V8SF_SELECT(s > hi, hi, s);
+		/* Count the lanes whose bit pattern changed (-1 each) */
+		changed += (adef_v8si)s != bits;
+		memcpy(samples + i, &s, sizeof(s));
+	}
+
+	for (unsigned int j = 0; j < ADEF_VEC_LEN; j++)
+		modified -= changed[j];
+
+	return modified + scalar_sanitize(samples + i, count - i, limit);
+}
+
+
+static void vec_biquad(float *samples,
+		       size_t frames,
+		       const struct adef_pcm_biquad_coefs *coefs,
+		       unsigned int stages,
+		       float state[][2][ADEF_VEC_LEN])
+{
+	/* One stage at a time over the whole block, so that the state stays
+	 * in registers */
+	for (unsigned int s = 0; s < stages; s++) {
+		const struct adef_pcm_biquad_coefs *c = &coefs[s];
+		adef_v8sf z1, z2;
+		memcpy(&z1, state[s][0], sizeof(z1));
+		memcpy(&z2, state[s][1], sizeof(z2));
+		for (size_t f = 0; f < frames; f++) {
+			adef_v8sf x, y;
+			memcpy(&x, samples + f * ADEF_VEC_LEN, sizeof(x));
+			y = c->b0 * x + z1;
+			z1 = c->b1 * x - c->a1 * y + z2;
+			z2 = c->b2 * x - c->a2 * y;
+			memcpy(samples + f * ADEF_VEC_LEN, &y, sizeof(y));
+		}
+		memcpy(state[s][0], &z1, sizeof(z1));
+		memcpy(state[s][1], &z2, sizeof(z2));
+	}
+}
+
+
+static void
+vec_sum_sq(const float *samples, size_t frames, double sum_sq[ADEF_VEC_LEN])
+{
+	adef_v8sf acc = {0};
+	for (size_t f = 0; f < frames; f++) {
+		adef_v8sf x;
+		memcpy(&x, samples + f * ADEF_VEC_LEN, sizeof(x));
+		acc += x * x;
+	}
+	for (unsigned int j = 0; j < ADEF_VEC_LEN; j++)
+		sum_sq[j] += acc[j];
+}
+
+
+static void vec_peak_fir(const float *samples,
+			 size_t frames,
+			 const float *coefs,
+			 unsigned int phases,
+			 unsigned int taps,
+			 float peak[ADEF_VEC_LEN])
+{
+	adef_v8sf pk;
+	memcpy(&pk, peak, sizeof(pk));
+	for (size_t f = 0; f < frames; f++) {
+		for (unsigned int p = 0; p < phases; p++) {
+			const float *c = coefs + p * taps;
+			adef_v8sf acc = {0};
+			for (unsigned int t = 0; t < taps; t++) {
+				size_t i = (f + taps - 1 - t) * ADEF_VEC_LEN;
+				adef_v8sf v;
+				memcpy(&v, samples + i, sizeof(v));
+				acc += c[t] * v;
+			}
+			acc = ADEF_V8SF_SELECT(acc < 0.f, -acc, acc);
+			pk = ADEF_V8SF_SELECT(acc > pk, acc, pk);
+		}
+	}
+	memcpy(peak, &pk, sizeof(pk));
+}
+
+
+#	define ADEF_PCM_KERNEL(_name) vec_##_name
+
+#else /* !ADEF_PCM_KERNELS_VECTOR */
+
+#	define ADEF_PCM_KERNEL(_name) scalar_##_name
+
+#endif /* !ADEF_PCM_KERNELS_VECTOR */
+
+
+const struct adef_pcm_kernels ADEF_PCM_KERNELS = {
+	.store_s16_sat = ADEF_PCM_KERNEL(store_s16_sat),
+	.store_s32_sat = ADEF_PCM_KERNEL(store_s32_sat),
+	.unpack_24le = ADEF_PCM_KERNEL(unpack_24le),
+	.pack_24le = ADEF_PCM_KERNEL(pack_24le),
+	.level = ADEF_PCM_KERNEL(level),
+	.mix_s16 = ADEF_PCM_KERNEL(mix_s16),
+	.mix_s32 = ADEF_PCM_KERNEL(mix_s32),
+	.mix_f32 = ADEF_PCM_KERNEL(mix_f32),
+	.gain_s16 = ADEF_PCM_KERNEL(gain_s16),
+	.gain_s32 = ADEF_PCM_KERNEL(gain_s32),
+	.gain_f32 = ADEF_PCM_KERNEL(gain_f32),
+	.requantize = ADEF_PCM_KERNEL(requantize),
+	.sanitize = ADEF_PCM_KERNEL(sanitize),
+	.biquad = ADEF_PCM_KERNEL(biquad),
+	.sum_sq = ADEF_PCM_KERNEL(sum_sq),
+	.peak_fir = ADEF_PCM_KERNEL(peak_fir),
+};
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <endian.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+
+/* Vector kernels compiled for AVX2, whatever the instruction set of the
+ * build; they are only called when the CPU supports it (see
+ * adefs_pcm_simd.c). Fused multiply-add is not enabled, so that the
+ * results are the same as with the other levels. */
+#if ADEF_PCM_HAVE_AVX2
+
+#	ifdef __clang__
+#		pragma clang attribute push(__attribute__((target("avx2"))), \
+					    apply_to = function)
+#	else
+#		pragma GCC push_options
+#		pragma GCC target("avx2")
+#	endif
+
+#	define ADEF_PCM_KERNELS adef_pcm_kernels_avx2
+#	define ADEF_PCM_KERNELS_VECTOR
+#	include "adefs_pcm_kernels.h"
+
+#	ifdef __clang__
+#		pragma clang attribute pop
+#	else
+#		pragma GCC pop_options
+#	endif
+
+#endif /* ADEF_PCM_HAVE_AVX2 */
@@ -0,0 +1,610 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* The channels are processed in groups of ADEF_VEC_LEN, one channel per
+ * vector lane (see adefs_pcm_biquad.c): each block of frames is decoded
+ * once, interpolated for the true peak, K-weighted in place and its
+ * energy accumulated; the energies are summed over 100 ms sub-blocks, the
+ * 400 ms and 3 s windows sliding by one sub-block (75% overlap for the
+ * gating blocks). The gated loudness values are computed from histograms
+ * of the window loudness, so that the memory use does not depend on the
+ * measured duration */
+
+
+/* Minimum sample rate (the K-weighting shelf is at 1.7 kHz) */
+#define MIN_SAMPLE_RATE 8000
+
+/* Sub-blocks per second, and sub-block count of the momentary and
+ * short-term windows */
+#define SUBBLOCKS_PER_SECOND 10
+#define MOMENTARY_SUBBLOCKS 4
+#define SHORT_TERM_SUBBLOCKS 30
+
+/* Absolute gate in LUFS, and relative gates in LU of the integrated
+ * loudness (BS.1770) and the loudness range (EBU Tech 3342) */
+#define ABSOLUTE_GATE -70.
+#define INTEGRATED_RELATIVE_GATE -10.
+#define RANGE_RELATIVE_GATE -20.
+
+/* Percentiles of the short-term loudness distribution bounding the
+ * loudness range */
+#define RANGE_LOW_PERCENTILE 0.10
+#define RANGE_HIGH_PERCENTILE 0.95
+
+/* Histogram bins of 0.1 LU from the absolute gate to +10 LUFS (louder
+ * windows are counted in the last bin, their energy is kept exact) */
+#define HISTOGRAM_STEP 0.1
+#define HISTOGRAM_BINS 800
+
+/* True peak interpolation filter: oversampling to at least 192 kHz (4x
+ * at most), with 12 taps per phase */
+#define TRUE_PEAK_RATE 192000
+#define TRUE_PEAK_MAX_PHASES 4
+#define TRUE_PEAK_TAPS 12
+
+/* K-weighting state values below this threshold are flushed to 0 (see
+ * adefs_pcm_biquad.c) */
+#define STATE_FLUSH_THRESHOLD 1e-30f
+
+
+/* Per channel group state */
+struct loudness_group {
+	/* K-weighting filter state */
+	float state[2][2][ADEF_VEC_LEN];
+
+	/* Last frames of the previous block, for the interpolation */
+	float history[TRUE_PEAK_TAPS - 1][ADEF_VEC_LEN];
+
+	/* Peak interpolated absolute value */
+	float peak[ADEF_VEC_LEN];
+
+	/* Sum of squares of the K-weighted samples of the current
+	 * sub-block */
+	double sum_sq[ADEF_VEC_LEN];
+};
+
+
+/* Histogram of the loudness of the windows above the absolute gate */
+struct loudness_histogram {
+	uint64_t count[HISTOGRAM_BINS];
+	double energy[HISTOGRAM_BINS];
+	uint64_t total_count;
+	double total_energy;
+};
+
+
+struct adef_pcm_loudness {
+	struct adef_format format;
+	struct adef_pcm_codec codec;
+
+	/* K-weighting filter: pre-filter (high shelf) and RLB high-pass */
+	struct adef_pcm_biquad_coefs k_weighting[2];
+
+	/* Channel weights */
+	float weights[ADEF_PCM_MAX_CHANNELS];
+
+	/* True peak interpolation filter */
+	unsigned int phases;
+	float fir[TRUE_PEAK_MAX_PHASES * TRUE_PEAK_TAPS];
+
+	unsigned int group_count;
+	struct loudness_group *groups;
+
+	/* Sub-block length and position in the current sub-block */
+	size_t subblock_frames;
+	size_t subblock_pos;
+
+	/* Weighted mean square of the last sub-blocks (ring buffer, next
+	 * sub-block index) and completed sub-block count */
+	double subblocks[SHORT_TERM_SUBBLOCKS];
+	unsigned int subblock_index;
+	uint64_t subblock_count;
+
+	/* Maximum momentary and short-term energies */
+	double momentary_max;
+	double short_term_max;
+
+	/* Momentary (gating blocks) and short-term loudness histograms */
+	struct loudness_histogram momentary;
+	struct loudness_histogram short_term;
+
+	uint64_t frames;
+
+	/* Samples of a block of frames of a group, interleaved in the vector
+	 * lanes and preceded by the interpolation history, and samples of a
+	 * channel */
+	float lanes[(TRUE_PEAK_TAPS - 1 + ADEF_PCM_BLOCK_FRAMES) *
+		    ADEF_VEC_LEN];
+	float tmp[ADEF_PCM_BLOCK_FRAMES];
+};
+
+
+/* Design the K-weighting filter for a sample rate; the analog prototypes
+ * match the BS.1770 coefficients given for 48 kHz */
+static void k_weighting_design(unsigned int sample_rate,
+			       struct adef_pcm_biquad_coefs coefs[2])
+{
+	double k, vh, vb, a0, q;
+
+	/* Pre-filter: high shelf of +4 dB at 1.68 kHz (head effects) */
+	k = tan(M_PI * 1681.974450955533 / sample_rate);
+	q = 0.7071752369554196;
+	vh = pow(10., 3.999843853973347 / 20.);
+	vb = pow(vh, 0.4996667741545416);
+	a0 = 1. + k / q + k * k;
+	coefs[0] = (struct adef_pcm_biquad_coefs){
+		.b0 = (float)((vh + vb * k / q + k * k) / a0),
+		.b1 = (float)(2. * (k * k - vh) / a0),
+		.b2 = (float)((vh - vb * k / q + k * k) / a0),
+		.a1 = (float)(2. * (k * k - 1.) / a0),
+		.a2 = (float)((1. - k / q + k * k) / a0),
+	};
+
+	/* RLB weighting: high-pass at 38 Hz */
+	k = tan(M_PI * 38.13547087602444 / sample_rate);
+	q = 0.5003270373238773;
+	a0 = 1. + k / q + k * k;
+	coefs[1] = (struct adef_pcm_biquad_coefs){
+		.b0 = 1.f,
+		.b1 = -2.f,
+		.b2 = 1.f,
+		.a1 = (float)(2. * (k * k - 1.) / a0),
+		.a2 = (float)((1. - k / q + k * k) / a0),
+	};
+}
+
+
+/* Design the true peak interpolation filter: Hann-windowed sinc low-pass
+ * at the original Nyquist frequency, split in phases normalized to a unit
+ * gain at DC */
+static void true_peak_design(struct adef_pcm_loudness *loudness)
+{
+	unsigned int rate = loudness->format.sample_rate;
+	unsigned int phases = (TRUE_PEAK_RATE + rate - 1) / rate;
+	unsigned int len;
+
+	if (phases > TRUE_PEAK_MAX_PHASES)
+		phases = TRUE_PEAK_MAX_PHASES;
+	loudness->phases = phases;
+	memset(loudness->fir, 0, sizeof(loudness->fir));
+
+	if (phases == 1) {
+		/* No oversampling: sample peak */
+		loudness->fir[0] = 1.f;
+		return;
+	}
+
+	len = phases * TRUE_PEAK_TAPS;
+	for (unsigned int p = 0; p < phases; p++) {
+		float *c = &loudness->fir[p * TRUE_PEAK_TAPS];
+		double h[TRUE_PEAK_TAPS], sum = 0.;
+		for (unsigned int t = 0; t < TRUE_PEAK_TAPS; t++) {
+			unsigned int n = t * phases + p;
+			double x = (n - (len - 1) / 2.) / phases;
+			double w = 0.5 - 0.5 * cos(2. * M_PI * (n + 1) /
+						   (len + 1));
+			h[t] = w * sin(M_PI * x) / (M_PI * x);
+			sum += h[t];
+		}
+		for (unsigned int t = 0; t < TRUE_PEAK_TAPS; t++)
+			c[t] = (float)(h[t] / sum);
+	}
+}
+
+
+/* Weight of a channel (BS.1770-4 position weights); an unspecified
+ * layout is the default layout of the channel count */
+static float channel_weight(const struct adef_format *format,
+			    unsigned int channel)
+{
+	uint32_t layout = format->channel_layout;
+
+	if (layout == ADEF_CHANNEL_LAYOUT_UNSPECIFIED)
+		layout = adef_channel_layout_default(format->channel_count);
+	if (layout == ADEF_CHANNEL_LAYOUT_UNSPECIFIED)
+		return 1.f;
+
+	/* Position of the channel: the channel-th bit set in the layout */
+	for (unsigned int i = 0; i < channel; i++)
+		layout &= layout - 1;
+
+	switch (layout & -layout) {
+	case ADEF_CHANNEL_LOW_FREQUENCY:
+		return 0.f;
+	case ADEF_CHANNEL_BACK_LEFT:
+	case ADEF_CHANNEL_BACK_RIGHT:
+	case ADEF_CHANNEL_BACK_CENTER:
+	case ADEF_CHANNEL_SIDE_LEFT:
+	case ADEF_CHANNEL_SIDE_RIGHT:
+		return 1.41f;
+	default:
+		return 1.f;
+	}
+}
+
+
+static double energy_to_lufs(double energy)
+{
+	return energy > 0. ? -0.691 + 10. * log10(energy) : -INFINITY;
+}
+
+
+static void histogram_add(struct loudness_histogram *hist, double energy)
+{
+	double lufs = energy_to_lufs(energy);
+	unsigned int bin;
+
+	if (!(lufs > ABSOLUTE_GATE))
+		return;
+
+	bin = (unsigned int)((lufs - ABSOLUTE_GATE) / HISTOGRAM_STEP);
+	if (bin >= HISTOGRAM_BINS)
+		bin = HISTOGRAM_BINS - 1;
+	hist->count[bin]++;
+	hist->energy[bin] += energy;
+	hist->total_count++;
+	hist->total_energy += energy;
+}
+
+
+/* Index of the first histogram bin above the relative gate (a bin is
+ * above the gate when its center is); the histogram must not be empty */
+static unsigned int histogram_gate(const struct loudness_histogram *hist,
+				   double relative_gate)
+{
+	double gate =
+		energy_to_lufs(hist->total_energy / hist->total_count) +
+		relative_gate;
+	double bin = floor((gate - ABSOLUTE_GATE) / HISTOGRAM_STEP - 0.5) + 1.;
+
+	if (bin < 0.)
+		return 0;
+	if (bin > HISTOGRAM_BINS)
+		return HISTOGRAM_BINS;
+	return (unsigned int)bin;
+}
+
+
+/* Loudness of a bin center */
+static double histogram_bin_lufs(unsigned int bin)
+{
+	return ABSOLUTE_GATE + (bin + 0.5) * HISTOGRAM_STEP;
+}
+
+
+static double integrated_lufs(const struct loudness_histogram *hist)
+{
+	uint64_t count = 0;
+	double energy = 0.;
+
+	if (hist->total_count == 0)
+		return -INFINITY;
+
+	for (unsigned int i = histogram_gate(hist, INTEGRATED_RELATIVE_GATE);
+	     i < HISTOGRAM_BINS;
+	     i++) {
+		count += hist->count[i];
+		energy += hist->energy[i];
+	}
+	return count > 0 ? energy_to_lufs(energy / count) : -INFINITY;
+}
+
+
+/* Loudness of the bin holding a percentile of the gated values */
+static double percentile_lufs(const struct loudness_histogram *hist,
+			      unsigned int first,
+			      uint64_t count,
+			      double percentile)
+{
+	uint64_t rank = (uint64_t)((count - 1) * percentile + 0.5);
+	uint64_t cumulated = 0;
+	unsigned int i;
+
+	for (i = first; i < HISTOGRAM_BINS - 1; i++) {
+		cumulated += hist->count[i];
+		if (cumulated > rank)
+			break;
+	}
+	return histogram_bin_lufs(i);
+}
+
+
+static double range_lu(const struct loudness_histogram *hist)
+{
+	unsigned int first;
+	uint64_t count = 0;
+
+	if (hist->total_count == 0)
+		return 0.;
+
+	first = histogram_gate(hist, RANGE_RELATIVE_GATE);
+	for (unsigned int i = first; i < HISTOGRAM_BINS; i++)
+		count += hist->count[i];
+	if (count == 0)
+		return 0.;
+
+	return percentile_lufs(hist, first, count, RANGE_HIGH_PERCENTILE) -
+	       percentile_lufs(hist, first, count, RANGE_LOW_PERCENTILE);
+}
+
+
+/* Mean energy of the last sub-blocks (missing sub-blocks at the start
+ * count as silence) */
+static double window_energy(const struct adef_pcm_loudness *loudness,
+			    unsigned int count)
+{
+	double sum = 0.;
+	unsigned int index = loudness->subblock_index;
+
+	for (unsigned int i = 0; i < count; i++) {
+		index = (index + SHORT_TERM_SUBBLOCKS - 1) %
+			SHORT_TERM_SUBBLOCKS;
+		sum += loudness->subblocks[index];
+	}
+	return sum / count;
+}
+
+
+/* Complete the current sub-block and update the windows */
+static void end_subblock(struct adef_pcm_loudness *loudness)
+{
+	double energy = 0.;
+
+	for (unsigned int c = 0; c < loudness->format.channel_count; c++) {
+		struct loudness_group *group =
+			&loudness->groups[c / ADEF_VEC_LEN];
+		energy += loudness->weights[c] *
+			  group->sum_sq[c % ADEF_VEC_LEN];
+	}
+	for (unsigned int g = 0; g < loudness->group_count; g++) {
+		memset(loudness->groups[g].sum_sq,
+		       0,
+		       sizeof(loudness->groups[g].sum_sq));
+	}
+
+	loudness->subblocks[loudness->subblock_index] =
+		energy / loudness->subblock_frames;
+	loudness->subblock_index =
+		(loudness->subblock_index + 1) % SHORT_TERM_SUBBLOCKS;
+	loudness->subblock_count++;
+	loudness->subblock_pos = 0;
+
+	if (loudness->subblock_count >= MOMENTARY_SUBBLOCKS) {
+		energy = window_energy(loudness, MOMENTARY_SUBBLOCKS);
+		if (energy > loudness->momentary_max)
+			loudness->momentary_max = energy;
+		histogram_add(&loudness->momentary, energy);
+	}
+	if (loudness->subblock_count >= SHORT_TERM_SUBBLOCKS) {
+		energy = window_energy(loudness, SHORT_TERM_SUBBLOCKS);
+		if (energy > loudness->short_term_max)
+			loudness->short_term_max = energy;
+		histogram_add(&loudness->short_term, energy);
+	}
+}
+
+
+/* Measure a block of frames of a channel group */
+static void process_block(struct adef_pcm_loudness *loudness,
+			  const struct adef_pcm_kernels *kernels,
+			  unsigned int g,
+			  const struct adef_pcm_buffer *buf,
+			  size_t offset,
+			  size_t frames)
+{
+	struct loudness_group *group = &loudness->groups[g];
+	float *lanes = loudness->lanes;
+	float *block = lanes + (TRUE_PEAK_TAPS - 1) * ADEF_VEC_LEN;
+	float *z = &group->state[0][0][0];
+
+	memcpy(lanes, group->history, sizeof(group->history));
+	adef_pcm_lanes_load(&loudness->codec,
+			    &loudness->format,
+			    buf,
+			    g * ADEF_VEC_LEN,
+			    offset,
+			    frames,
+			    loudness->tmp,
+			    block);
+
+	kernels->peak_fir(lanes,
+			  frames,
+			  loudness->fir,
+			  loudness->phases,
+			  TRUE_PEAK_TAPS,
+			  group->peak);
+	memcpy(group->history,
+	       lanes + frames * ADEF_VEC_LEN,
+	       sizeof(group->history));
+
+	kernels->biquad(block,
+			frames,
+			loudness->k_weighting,
+			ADEF_ARRAY_SIZE(loudness->k_weighting),
+			group->state);
+	for (unsigned int i = 0; i < sizeof(group->state) / sizeof(*z); i++) {
+		if (fabsf(z[i]) < STATE_FLUSH_THRESHOLD)
+			z[i] = 0.f;
+	}
+
+	kernels->sum_sq(block, frames, group->sum_sq);
+}
+
+
+int adef_pcm_loudness_new(const struct adef_format *format,
+			  struct adef_pcm_loudness **ret_obj)
+{
+	int ret;
+	struct adef_pcm_loudness *loudness;
+
+	ULOG_ERRNO_RETURN_ERR_IF(format == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	loudness = calloc(1, sizeof(*loudness));
+	if (loudness == NULL)
+		return -ENOMEM;
+	loudness->format = *format;
+
+	ret = adef_pcm_codec_get(format, &loudness->codec);
+	if (ret < 0)
+		goto error;
+	if (format->sample_rate < MIN_SAMPLE_RATE) {
+		ULOGE("%s: unsupported sample rate %u",
+		      __func__,
+		      format->sample_rate);
+		ret = -ENOTSUP;
+		goto error;
+	}
+
+	k_weighting_design(format->sample_rate, loudness->k_weighting);
+	true_peak_design(loudness);
+	for (unsigned int c = 0; c < format->channel_count; c++)
+		loudness->weights[c] = channel_weight(format, c);
+	loudness->subblock_frames =
+		(format->sample_rate + SUBBLOCKS_PER_SECOND / 2) /
+		SUBBLOCKS_PER_SECOND;
+
+	loudness->group_count =
+		(format->channel_count + ADEF_VEC_LEN - 1) / ADEF_VEC_LEN;
+	loudness->groups =
+		calloc(loudness->group_count, sizeof(*loudness->groups));
+	if (loudness->groups == NULL) {
+		ret = -ENOMEM;
+		goto error;
+	}
+
+	*ret_obj = loudness;
+	return 0;
+
+error:
+	adef_pcm_loudness_destroy(loudness);
+	return ret;
+}
+
+
+int adef_pcm_loudness_destroy(struct adef_pcm_loudness *loudness)
+{
+	if (loudness == NULL)
+		return 0;
+
+	free(loudness->groups);
+	free(loudness);
+	return 0;
+}
+
+
+int adef_pcm_loudness_reset(struct adef_pcm_loudness *loudness)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(loudness == NULL, EINVAL);
+
+	memset(loudness->groups,
+	       0,
+	       loudness->group_count * sizeof(*loudness->groups));
+	loudness->subblock_pos = 0;
+	memset(loudness->subblocks, 0, sizeof(loudness->subblocks));
+	loudness->subblock_index = 0;
+	loudness->subblock_count = 0;
+	loudness->momentary_max = 0.;
+	loudness->short_term_max = 0.;
+	memset(&loudness->momentary, 0, sizeof(loudness->momentary));
+	memset(&loudness->short_term, 0, sizeof(loudness->short_term));
+	loudness->frames = 0;
+	return 0;
+}
+
+
+int adef_pcm_loudness_update(struct adef_pcm_loudness *loudness,
+			     const struct adef_pcm_buffer *buf)
+{
+	const struct adef_pcm_kernels *kernels = adef_pcm_kernels_get();
+
+	ULOG_ERRNO_RETURN_ERR_IF(loudness == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf->data == NULL && buf->frames != 0,
+				 EINVAL);
+
+	for (size_t f = 0; f < buf->frames;) {
+		size_t n = buf->frames - f;
+		if (n > ADEF_PCM_BLOCK_FRAMES)
+			n = ADEF_PCM_BLOCK_FRAMES;
+		if (n > loudness->subblock_frames - loudness->subblock_pos)
+			n = loudness->subblock_frames - loudness->subblock_pos;
+
+		for (unsigned int g = 0; g < loudness->group_count; g++)
+			process_block(loudness, kernels, g, buf, f, n);
+
+		f += n;
+		loudness->subblock_pos += n;
+		if (loudness->subblock_pos == loudness->subblock_frames)
+			end_subblock(loudness);
+	}
+
+	loudness->frames += buf->frames;
+	return 0;
+}
+
+
+int adef_pcm_loudness_get_values(const struct adef_pcm_loudness *loudness,
+				 struct adef_pcm_loudness_values *values)
+{
+	float peak = 0.f;
+
+	ULOG_ERRNO_RETURN_ERR_IF(loudness == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(values == NULL, EINVAL);
+
+	/* Unused lanes of the last group hold zeros */
+	for (unsigned int g = 0; g < loudness->group_count; g++) {
+		for (unsigned int j = 0; j < ADEF_VEC_LEN; j++) {
+			if (loudness->groups[g].peak[j] > peak)
+				peak = loudness->groups[g].peak[j];
+		}
+	}
+
+	*values = (struct adef_pcm_loudness_values){
+		.momentary = energy_to_lufs(
+			window_energy(loudness, MOMENTARY_SUBBLOCKS)),
+		.momentary_max = energy_to_lufs(loudness->momentary_max),
+		.short_term = energy_to_lufs(
+			window_energy(loudness, SHORT_TERM_SUBBLOCKS)),
+		.short_term_max = energy_to_lufs(loudness->short_term_max),
+		.integrated = integrated_lufs(&loudness->momentary),
+		.range = range_lu(&loudness->short_term),
+		.true_peak = peak > 0.f ? 20.f * log10f(peak) : -INFINITY,
+		.frames = loudness->frames,
+	};
+	return 0;
+}
@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+int adef_pcm_meter_reset(struct adef_pcm_meter *meter,
+			 const struct adef_format *format)
+{
+	int ret;
+	struct adef_pcm_codec codec;
+
+	ULOG_ERRNO_RETURN_ERR_IF(meter == NULL, EINVAL);
+
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+
+	memset(meter, 0, sizeof(*meter));
+	meter->format = *format;
+
+	return 0;
+}
+
+
+/* Level of floating-point samples, on the float values so that the
+ * samples over full scale are neither clamped nor missed as clips; NaN
+ * values count as 0 */
+static void level_f32(const float *samples,
+		      size_t count,
+		      float *peak,
+		      double *sum_sq,
+		      uint64_t *clip_count)
+{
+	float p = *peak;
+	float sum = 0.f;
+	uint64_t clip = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		float f = samples[i] == samples[i] ? samples[i] : 0.f;
+		float a = fabsf(f);
+		p = a > p ? a : p;
+		sum += f * f;
+		clip += a >= 1.f;
+	}
+
+	*peak = p;
+	*sum_sq += sum;
+	*clip_count += clip;
+}
+
+
+int adef_pcm_meter_update(struct adef_pcm_meter *meter,
+			  const struct adef_pcm_buffer *buf)
+{
+	int ret;
+	struct adef_pcm_codec codec;
+	const struct adef_format *format;
+	const struct adef_pcm_kernels *kernels = adef_pcm_kernels_get();
+	int32_t samples[ADEF_PCM_BLOCK_FRAMES];
+	float fsamples[ADEF_PCM_BLOCK_FRAMES];
+	int32_t clip_hi;
+
+	ULOG_ERRNO_RETURN_ERR_IF(meter == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf->data == NULL && buf->frames != 0,
+				 EINVAL);
+
+	format = &meter->format;
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+	clip_hi = (int32_t)(0x7fffffffu &
+			    ~((1u << (32 - codec.bits)) - 1));
+
+	/* Process the buffer block by block, all channels of a block
+	 * together, so that the buffer is only read once from memory */
+	for (size_t f = 0; f < buf->frames; f += ADEF_PCM_BLOCK_FRAMES) {
+		size_t n = buf->frames - f;
+		if (n > ADEF_PCM_BLOCK_FRAMES)
+			n = ADEF_PCM_BLOCK_FRAMES;
+		for (unsigned int c = 0; c < format->channel_count; c++) {
+			size_t stride;
+			const uint8_t *src = adef_pcm_buffer_channel(
+				buf, format, codec.sample_size, c, &stride);
+			if (format->pcm.float_val) {
+				codec.load_f32(
+					src + f * stride, stride, fsamples, n);
+				level_f32(fsamples,
+					  n,
+					  &meter->channels[c].float_peak,
+					  &meter->channels[c].sum_sq,
+					  &meter->channels[c].clip_count);
+				continue;
+			}
+			codec.load_s32(src + f * stride, stride, samples, n);
+			kernels->level(samples,
+				       n,
+				       clip_hi,
+				       &meter->channels[c].peak,
+				       &meter->channels[c].sum_sq,
+				       &meter->channels[c].clip_count);
+		}
+	}
+	meter->frames += buf->frames;
+
+	return 0;
+}
+
+
+int adef_pcm_meter_get_levels(const struct adef_pcm_meter *meter,
+			      struct adef_pcm_level *levels,
+			      unsigned int count)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(meter == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(levels == NULL && count != 0, EINVAL);
+
+	if (count > meter->format.channel_count)
+		count = meter->format.channel_count;
+
+	for (unsigned int c = 0; c < count; c++) {
+		levels[c].peak =
+			meter->format.pcm.float_val
+				? meter->channels[c].float_peak
+				: (float)meter->channels[c].peak / 2147483648.f;
+		double sum_sq = meter->channels[c].sum_sq;
+		levels[c].rms = meter->frames == 0
+					? 0.f
+					: (float)sqrt(sum_sq / meter->frames);
+		levels[c].clip_count = meter->channels[c].clip_count;
+	}
+
+	return 0;
+}
+
+
+int adef_pcm_get_levels(const struct adef_format *format,
+			const struct adef_pcm_buffer *buf,
+			struct adef_pcm_level *levels,
+			unsigned int count)
+{
+	int ret;
+	struct adef_pcm_meter meter;
+
+	ret = adef_pcm_meter_reset(&meter, format);
+	if (ret < 0)
+		return ret;
+	ret = adef_pcm_meter_update(&meter, buf);
+	if (ret < 0)
+		return ret;
+	return adef_pcm_meter_get_levels(&meter, levels, count);
+}
+
+
+int adef_pcm_get_window_levels(const struct adef_format *format,
+			       const struct adef_pcm_buffer *buf,
+			       size_t window,
+			       struct adef_pcm_level *levels,
+			       size_t count,
+			       size_t *window_count)
+{
+	int ret;
+	struct adef_pcm_meter meter;
+	struct adef_pcm_buffer win;
+	size_t sample_size, windows;
+
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf->data == NULL && buf->frames != 0,
+				 EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(window == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(levels == NULL && count != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(window_count == NULL, EINVAL);
+
+	ret = adef_pcm_meter_reset(&meter, format);
+	if (ret < 0)
+		return ret;
+	windows = buf->frames / window + (buf->frames % window != 0);
+	*window_count = windows;
+	if (count / format->channel_count < windows)
+		return -ENOBUFS;
+
+	/* Each window is a sub-buffer sharing the plane stride of the
+	 * whole buffer */
+	sample_size = adef_pcm_get_sample_size(format);
+	win.plane_stride = buf->plane_stride ? buf->plane_stride
+					     : buf->frames * sample_size;
+	for (size_t w = 0; w < windows; w++) {
+		size_t offset = w * window;
+		win.frames = buf->frames - offset;
+		if (win.frames > window)
+			win.frames = window;
+		win.data = (uint8_t *)buf->data +
+			   offset * sample_size *
+				   (format->pcm.interleaved
+					    ? format->channel_count
+					    : 1);
+		ret = adef_pcm_meter_reset(&meter, format);
+		if (ret < 0)
+			return ret;
+		ret = adef_pcm_meter_update(&meter, &win);
+		if (ret < 0)
+			return ret;
+		ret = adef_pcm_meter_get_levels(
+			&meter,
+			levels + w * format->channel_count,
+			format->channel_count);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
@@ -0,0 +1,285 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* The buffers are mixed as runs of contiguous samples: the whole buffer
+ * for interleaved formats (positions are then scaled by the channel
+ * count), each plane for planar formats. Runs are processed in blocks
+ * accumulated in float (double for 32-bit samples, to stay exact) */
+
+
+enum kernel {
+	KERNEL_S16 = 0,
+	KERNEL_S32,
+	KERNEL_F32,
+	KERNEL_GENERIC,
+};
+
+
+struct block {
+	size_t count;
+	union {
+		float f[ADEF_PCM_BLOCK_FRAMES];
+		double d[ADEF_PCM_BLOCK_FRAMES];
+	} acc;
+	float tmp[ADEF_PCM_BLOCK_FRAMES];
+};
+
+
+static void mix_generic(const struct adef_pcm_kernels *kernels,
+			const struct adef_pcm_codec *codec,
+			const uint8_t *src,
+			struct block *block,
+			size_t offset,
+			size_t count,
+			float gain)
+{
+	float *acc = block->acc.f + offset;
+
+	codec->load_f32(src, codec->sample_size, block->tmp, count);
+	kernels->mix_f32(block->tmp, acc, count, gain);
+}
+
+
+int adef_pcm_mixer_init(struct adef_pcm_mixer *mixer,
+			const struct adef_format *format)
+{
+	int ret;
+	struct adef_pcm_codec codec;
+
+	ULOG_ERRNO_RETURN_ERR_IF(mixer == NULL, EINVAL);
+
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+
+	memset(mixer, 0, sizeof(*mixer));
+	mixer->format = *format;
+
+	return 0;
+}
+
+
+int adef_pcm_mixer_process(struct adef_pcm_mixer *mixer,
+			   const struct adef_pcm_mixer_input *inputs,
+			   unsigned int count,
+			   const struct adef_pcm_buffer *out,
+			   struct adef_frame_info *out_info)
+{
+	int ret;
+	const struct adef_format *format;
+	struct adef_pcm_codec codec;
+	const struct adef_pcm_kernels *kernels = adef_pcm_kernels_get();
+	enum kernel kernel = KERNEL_GENERIC;
+	int64_t offsets[ADEF_PCM_MIXER_MAX_INPUTS];
+	uint64_t pos, first = UINT64_MAX;
+	unsigned int runs, scale;
+	size_t run_len;
+	struct block block;
+
+	ULOG_ERRNO_RETURN_ERR_IF(mixer == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(inputs == NULL && count != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count > ADEF_PCM_MIXER_MAX_INPUTS, E2BIG);
+	ULOG_ERRNO_RETURN_ERR_IF(out == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out->data == NULL && out->frames != 0, EINVAL);
+
+	format = &mixer->format;
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+	if (format->pcm.float_val &&
+	    format->pcm.little_endian == ADEF_HOST_LITTLE_ENDIAN) {
+		kernel = KERNEL_F32;
+	} else if (format->pcm.signed_val &&
+		   format->pcm.little_endian == ADEF_HOST_LITTLE_ENDIAN) {
+		if (codec.bits == 16)
+			kernel = KERNEL_S16;
+		else if (codec.bits == 32)
+			kernel = KERNEL_S32;
+	}
+
+	/* Place the inputs on the output timeline, which starts at the
+	 * earliest input on the first call */
+	for (unsigned int i = 0; i < count; i++) {
+		ULOG_ERRNO_RETURN_ERR_IF(inputs[i].buf.data == NULL &&
+						 inputs[i].buf.frames != 0,
+					 EINVAL);
+		if (inputs[i].info.timescale == 0)
+			continue;
+		pos = adef_frame_info_to_samples(&inputs[i].info,
+						 format->sample_rate);
+		if (pos < first)
+			first = pos;
+		offsets[i] = (int64_t)pos;
+	}
+	if (!mixer->started) {
+		if (first != UINT64_MAX)
+			mixer->position = first;
+		mixer->started = true;
+	}
+	for (unsigned int i = 0; i < count; i++) {
+		offsets[i] = inputs[i].info.timescale == 0
+				     ? 0
+				     : offsets[i] - (int64_t)mixer->position;
+	}
+
+	if (out_info != NULL) {
+		memset(out_info, 0, sizeof(*out_info));
+		out_info->timestamp = mixer->position;
+		out_info->timescale = format->sample_rate;
+		out_info->index = mixer->index;
+		for (unsigned int i = 0; i < count; i++) {
+			if (inputs[i].info.capture_timestamp == 0 ||
+			    inputs[i].info.timescale == 0)
+				continue;
+			out_info->capture_timestamp =
+				inputs[i].info.capture_timestamp -
+				offsets[i] * 1000000 /
+					(int64_t)format->sample_rate;
+			break;
+		}
+	}
+
+	/* Runs of contiguous samples */
+	if (format->pcm.interleaved) {
+		runs = 1;
+		scale = format->channel_count;
+	} else {
+		runs = format->channel_count;
+		scale = 1;
+	}
+	run_len = out->frames * scale;
+
+	for (unsigned int r = 0; r < runs; r++) {
+		size_t stride;
+		uint8_t *dst = adef_pcm_buffer_channel(
+			out, format, codec.sample_size, r, &stride);
+
+		for (size_t s = 0; s < run_len; s += ADEF_PCM_BLOCK_FRAMES) {
+			size_t n = run_len - s;
+			if (n > ADEF_PCM_BLOCK_FRAMES)
+				n = ADEF_PCM_BLOCK_FRAMES;
+			if (kernel == KERNEL_S32)
+				memset(block.acc.d, 0, n * sizeof(double));
+			else
+				memset(block.acc.f, 0, n * sizeof(float));
+
+			for (unsigned int i = 0; i < count; i++) {
+				const struct adef_pcm_mixer_input *in =
+					&inputs[i];
+				/* Overlap of the block with the input, in
+				 * samples relative to the block start */
+				int64_t start = offsets[i] * (int64_t)scale -
+						(int64_t)s;
+				int64_t end = start + (int64_t)(in->buf.frames *
+								scale);
+				size_t in_stride;
+				const uint8_t *src;
+				if (start < 0)
+					start = 0;
+				if (end > (int64_t)n)
+					end = (int64_t)n;
+				if (start >= end)
+					continue;
+				src = adef_pcm_buffer_channel(&in->buf,
+							      format,
+							      codec.sample_size,
+							      r,
+							      &in_stride);
+				src += ((int64_t)s + start -
+					offsets[i] * (int64_t)scale) *
+				       codec.sample_size;
+				switch (kernel) {
+				case KERNEL_S16:
+					kernels->mix_s16(
+						(const int16_t *)src,
+						block.acc.f + start,
+						end - start,
+						in->gain);
+					break;
+				case KERNEL_F32:
+					kernels->mix_f32(
+						(const float *)src,
+						block.acc.f + start,
+						end - start,
+						in->gain);
+					break;
+				case KERNEL_S32:
+					kernels->mix_s32(
+						(const int32_t *)src,
+						block.acc.d + start,
+						end - start,
+						in->gain);
+					break;
+				default:
+					mix_generic(kernels,
+						    &codec,
+						    src,
+						    &block,
+						    start,
+						    end - start,
+						    in->gain);
+					break;
+				}
+			}
+
+			switch (kernel) {
+			case KERNEL_S16:
+				kernels->store_s16_sat(
+					block.acc.f, (int16_t *)dst + s, n);
+				break;
+			case KERNEL_F32:
+				memcpy((float *)dst + s,
+				       block.acc.f,
+				       n * sizeof(float));
+				break;
+			case KERNEL_S32:
+				kernels->store_s32_sat(
+					block.acc.d, (int32_t *)dst + s, n);
+				break;
+			default:
+				codec.store_f32(block.acc.f,
+						dst + s * codec.sample_size,
+						codec.sample_size,
+						n);
+				break;
+			}
+		}
+	}
+
+	mixer->position += out->frames;
+	mixer->index++;
+
+	return 0;
+}
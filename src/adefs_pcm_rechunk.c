@@ -0,0 +1,326 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+struct adef_pcm_rechunk {
+	struct adef_format format;
+	struct adef_pcm_codec codec;
+	size_t frame_size;
+
+	/* Current input buffer and number of frames already consumed */
+	struct adef_pcm_buffer in;
+	size_t in_offset;
+
+	/* Timeline: position in samples of the first frame of the current
+	 * input and of the next input, and capture timestamp of a reference
+	 * position (0 if unknown) */
+	uint64_t in_position;
+	uint64_t next_position;
+	uint64_t capture_timestamp;
+	uint64_t capture_position;
+
+	/* Pending samples (planar formats: contiguous planes) and
+	 * information of the first pending frame */
+	uint8_t *buf;
+	size_t pending;
+	struct adef_frame_info pending_info;
+
+	/* Index of the next output frame */
+	uint32_t index;
+};
+
+
+/* Information of the frame at an offset in the current input */
+static void get_info(const struct adef_pcm_rechunk *rechunk,
+		     size_t offset,
+		     struct adef_frame_info *info)
+{
+	unsigned int sample_rate = rechunk->format.sample_rate;
+	uint64_t position = rechunk->in_position + offset;
+
+	info->timestamp = position;
+	info->timescale = sample_rate;
+	info->capture_timestamp = 0;
+	if (rechunk->capture_timestamp != 0) {
+		info->capture_timestamp =
+			rechunk->capture_timestamp +
+			adef_rescale(position - rechunk->capture_position,
+				     1000000,
+				     sample_rate);
+	}
+	info->index = 0;
+}
+
+
+/* Copy frames of the current input to the pending samples */
+static void copy_pending(struct adef_pcm_rechunk *rechunk, size_t count)
+{
+	const struct adef_format *format = &rechunk->format;
+	size_t sample_size = rechunk->codec.sample_size;
+	struct adef_pcm_buffer pending = {
+		.data = rechunk->buf,
+		.frames = rechunk->frame_size,
+	};
+	size_t in_stride, stride;
+	const uint8_t *src;
+	uint8_t *dst;
+
+	if (format->pcm.interleaved) {
+		stride = sample_size * format->channel_count;
+		memcpy(rechunk->buf + rechunk->pending * stride,
+		       (const uint8_t *)rechunk->in.data +
+			       rechunk->in_offset * stride,
+		       count * stride);
+		return;
+	}
+
+	for (unsigned int c = 0; c < format->channel_count; c++) {
+		src = adef_pcm_buffer_channel(
+			&rechunk->in, format, sample_size, c, &in_stride);
+		dst = adef_pcm_buffer_channel(
+			&pending, format, sample_size, c, &stride);
+		memcpy(dst + rechunk->pending * stride,
+		       src + rechunk->in_offset * in_stride,
+		       count * sample_size);
+	}
+}
+
+
+/* Fill the end of the pending samples with silence */
+static void pad_pending(struct adef_pcm_rechunk *rechunk)
+{
+	static const int32_t zeros[ADEF_PCM_BLOCK_FRAMES];
+	const struct adef_format *format = &rechunk->format;
+	struct adef_pcm_buffer pending = {
+		.data = rechunk->buf,
+		.frames = rechunk->frame_size,
+	};
+	size_t stride, n;
+	uint8_t *dst;
+
+	for (unsigned int c = 0; c < format->channel_count; c++) {
+		dst = adef_pcm_buffer_channel(&pending,
+					      format,
+					      rechunk->codec.sample_size,
+					      c,
+					      &stride);
+		for (size_t i = rechunk->pending; i < rechunk->frame_size;
+		     i += n) {
+			n = rechunk->frame_size - i;
+			if (n > ADEF_PCM_BLOCK_FRAMES)
+				n = ADEF_PCM_BLOCK_FRAMES;
+			rechunk->codec.store_s32(
+				zeros, dst + i * stride, stride, n);
+		}
+	}
+}
+
+
+/* Output the pending samples */
+static void output_pending(struct adef_pcm_rechunk *rechunk,
+			   struct adef_pcm_buffer *out,
+			   struct adef_frame_info *out_info)
+{
+	out->data = rechunk->buf;
+	out->frames = rechunk->frame_size;
+	out->plane_stride = 0;
+	if (out_info != NULL) {
+		*out_info = rechunk->pending_info;
+		out_info->index = rechunk->index;
+	}
+	rechunk->index++;
+	rechunk->pending = 0;
+}
+
+
+int adef_pcm_rechunk_new(const struct adef_format *format,
+			 size_t frame_size,
+			 struct adef_pcm_rechunk **ret_obj)
+{
+	int ret;
+	struct adef_pcm_rechunk *rechunk;
+	struct adef_pcm_codec codec;
+
+	ULOG_ERRNO_RETURN_ERR_IF(format == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(frame_size == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+	ULOG_ERRNO_RETURN_ERR_IF(format->sample_rate == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(frame_size > SIZE_MAX / codec.sample_size /
+						      format->channel_count,
+				 EINVAL);
+
+	rechunk = calloc(1, sizeof(*rechunk));
+	if (rechunk == NULL)
+		return -ENOMEM;
+	rechunk->format = *format;
+	rechunk->codec = codec;
+	rechunk->frame_size = frame_size;
+	rechunk->buf =
+		malloc(frame_size * codec.sample_size * format->channel_count);
+	if (rechunk->buf == NULL) {
+		free(rechunk);
+		return -ENOMEM;
+	}
+
+	*ret_obj = rechunk;
+	return 0;
+}
+
+
+int adef_pcm_rechunk_destroy(struct adef_pcm_rechunk *rechunk)
+{
+	if (rechunk == NULL)
+		return 0;
+
+	free(rechunk->buf);
+	free(rechunk);
+
+	return 0;
+}
+
+
+int adef_pcm_rechunk_push(struct adef_pcm_rechunk *rechunk,
+			  const struct adef_pcm_buffer *in,
+			  const struct adef_frame_info *info)
+{
+	uint64_t position;
+
+	ULOG_ERRNO_RETURN_ERR_IF(rechunk == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(in == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(in->data == NULL && in->frames != 0, EINVAL);
+
+	if (rechunk->in_offset < rechunk->in.frames)
+		return -EBUSY;
+
+	position = rechunk->next_position;
+	if (info != NULL && info->timescale != 0)
+		position = adef_frame_info_to_samples(
+			info, rechunk->format.sample_rate);
+	if (info != NULL) {
+		rechunk->capture_timestamp = info->capture_timestamp;
+		rechunk->capture_position = position;
+	}
+	rechunk->in = *in;
+	rechunk->in_offset = 0;
+	rechunk->in_position = position;
+	rechunk->next_position = position + in->frames;
+
+	return 0;
+}
+
+
+int adef_pcm_rechunk_pull(struct adef_pcm_rechunk *rechunk,
+			  struct adef_pcm_buffer *out,
+			  struct adef_frame_info *out_info)
+{
+	const struct adef_format *format;
+	size_t sample_size, remaining, n;
+
+	ULOG_ERRNO_RETURN_ERR_IF(rechunk == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out == NULL, EINVAL);
+
+	format = &rechunk->format;
+	sample_size = rechunk->codec.sample_size;
+	remaining = rechunk->in.frames - rechunk->in_offset;
+
+	/* Aligned input: output the input samples without copy */
+	if (rechunk->pending == 0 && remaining >= rechunk->frame_size) {
+		if (format->pcm.interleaved) {
+			out->data = (uint8_t *)rechunk->in.data +
+				    rechunk->in_offset * sample_size *
+					    format->channel_count;
+			out->plane_stride = 0;
+		} else {
+			out->data = (uint8_t *)rechunk->in.data +
+				    rechunk->in_offset * sample_size;
+			out->plane_stride =
+				rechunk->in.plane_stride
+					? rechunk->in.plane_stride
+					: rechunk->in.frames * sample_size;
+		}
+		out->frames = rechunk->frame_size;
+		if (out_info != NULL) {
+			get_info(rechunk, rechunk->in_offset, out_info);
+			out_info->index = rechunk->index;
+		}
+		rechunk->index++;
+		rechunk->in_offset += rechunk->frame_size;
+		return 0;
+	}
+
+	if (remaining == 0)
+		return -EAGAIN;
+
+	/* Gather the samples in the internal buffer */
+	if (rechunk->pending == 0)
+		get_info(rechunk, rechunk->in_offset, &rechunk->pending_info);
+	n = rechunk->frame_size - rechunk->pending;
+	if (n > remaining)
+		n = remaining;
+	copy_pending(rechunk, n);
+	rechunk->pending += n;
+	rechunk->in_offset += n;
+	if (rechunk->pending < rechunk->frame_size)
+		return -EAGAIN;
+
+	output_pending(rechunk, out, out_info);
+	return 0;
+}
+
+
+int adef_pcm_rechunk_flush(struct adef_pcm_rechunk *rechunk,
+			   struct adef_pcm_buffer *out,
+			   struct adef_frame_info *out_info,
+			   size_t *valid_frames)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(rechunk == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out == NULL, EINVAL);
+
+	if (rechunk->in_offset < rechunk->in.frames)
+		return -EBUSY;
+	if (rechunk->pending == 0)
+		return -EAGAIN;
+
+	if (valid_frames != NULL)
+		*valid_frames = rechunk->pending;
+	pad_pending(rechunk);
+	output_pending(rechunk, out, out_info);
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+int adef_pcm_sanitize(const struct adef_format *format,
+		      const struct adef_pcm_buffer *buf,
+		      float limit)
+{
+	int ret;
+	struct adef_pcm_codec codec;
+	const struct adef_pcm_kernels *kernels = adef_pcm_kernels_get();
+	unsigned int runs;
+	size_t count, modified = 0;
+
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf->data == NULL && buf->frames != 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!(limit > 0.f), EINVAL);
+
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+	ULOG_ERRNO_RETURN_ERR_IF(!format->pcm.float_val, EINVAL);
+	if (format->pcm.little_endian != ADEF_HOST_LITTLE_ENDIAN) {
+		ULOGE("%s: only native endianness is supported", __func__);
+		return -ENOTSUP;
+	}
+
+	if (format->pcm.interleaved) {
+		runs = 1;
+		count = buf->frames * format->channel_count;
+	} else {
+		runs = format->channel_count;
+		count = buf->frames;
+	}
+	for (unsigned int r = 0; r < runs; r++) {
+		size_t stride;
+		float *samples = (float *)adef_pcm_buffer_channel(
+			buf, format, codec.sample_size, r, &stride);
+		modified += kernels->sanitize(samples, count, limit);
+	}
+
+	return modified > INT32_MAX ? INT32_MAX : (int)modified;
+}
@@ -0,0 +1,520 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* The CPU features are probed once at load time, and the table of the
+ * best supported level (or of the level forced by the environment) is
+ * published in adef_pcm_kernels_current; until then, the baseline table
+ * is used (always supported) */
+
+
+static const struct {
+	enum adef_pcm_simd simd;
+	const char *str;
+} simd_map[] = {
+	{ADEF_PCM_SIMD_SCALAR, "SCALAR"},
+	{ADEF_PCM_SIMD_BASELINE, "BASELINE"},
+	{ADEF_PCM_SIMD_AVX2, "AVX2"},
+};
+
+
+static const struct adef_pcm_kernels *const kernels_map[ADEF_PCM_SIMD_MAX] = {
+	[ADEF_PCM_SIMD_SCALAR] = &adef_pcm_kernels_scalar,
+	[ADEF_PCM_SIMD_BASELINE] = &adef_pcm_kernels_baseline,
+#if ADEF_PCM_HAVE_AVX2
+	[ADEF_PCM_SIMD_AVX2] = &adef_pcm_kernels_avx2,
+#endif
+};
+
+
+/* Supported levels, set at load time */
+static bool s_supported[ADEF_PCM_SIMD_MAX] = {
+	[ADEF_PCM_SIMD_SCALAR] = true,
+	[ADEF_PCM_SIMD_BASELINE] = true,
+};
+
+
+const struct adef_pcm_kernels *adef_pcm_kernels_current =
+	&adef_pcm_kernels_baseline;
+
+
+/* Sample count of the self-test, with remaining samples after the last
+ * full vector */
+#define SELF_TEST_COUNT (ADEF_PCM_BLOCK_FRAMES + ADEF_VEC_LEN / 2 + 1)
+
+
+/* Biquad cascade of the self-test: 100 Hz high-pass and +6 dB peaking
+ * equalizer at 1 kHz (48 kHz sample rate) */
+static const struct adef_pcm_biquad_coefs biquad_coefs[] = {
+	{0.990787f, -1.981573f, 0.990787f, -1.981488f, 0.981658f},
+	{1.043953f, -1.895321f, 0.867722f, -1.895321f, 0.911675f},
+};
+
+
+/* Polyphase FIR filter of the self-test (the coefficients are taken from
+ * the random gains) */
+#define SELF_TEST_FIR_PHASES 4
+#define SELF_TEST_FIR_TAPS 12
+
+
+/* Self-test output of a kernel table */
+struct self_test_output {
+	union {
+		int16_t s16[SELF_TEST_COUNT];
+		int32_t s32[SELF_TEST_COUNT];
+		uint32_t u32[SELF_TEST_COUNT];
+		float f32[SELF_TEST_COUNT];
+		double f64[SELF_TEST_COUNT];
+		uint8_t u24[SELF_TEST_COUNT * 3];
+	};
+	uint32_t rng[ADEF_VEC_LEN];
+	float state[2][2][ADEF_VEC_LEN];
+	float lane_peak[ADEF_VEC_LEN];
+	double lane_sum_sq[ADEF_VEC_LEN];
+	uint32_t peak;
+	double sum_sq;
+	uint64_t clip_count;
+	size_t modified;
+};
+
+
+/* Self-test buffers: inputs, and outputs of the reference ([0]) and
+ * tested ([1]) kernels */
+struct self_test {
+	uint32_t rng;
+	float gains[SELF_TEST_COUNT];
+	int16_t s16[SELF_TEST_COUNT];
+	int32_t s32[SELF_TEST_COUNT];
+	float f32[SELF_TEST_COUNT];
+	/* Unnormalized samples to saturate */
+	float f32_sat[SELF_TEST_COUNT];
+	double f64_sat[SELF_TEST_COUNT];
+	/* Samples with NaN, infinite and denormal values */
+	float f32_special[SELF_TEST_COUNT];
+	uint8_t u24[SELF_TEST_COUNT * 3];
+	struct self_test_output out[2];
+};
+
+
+static bool cpu_supports(enum adef_pcm_simd simd)
+{
+	switch (simd) {
+	case ADEF_PCM_SIMD_SCALAR:
+	case ADEF_PCM_SIMD_BASELINE:
+		return true;
+#if ADEF_PCM_HAVE_AVX2
+	case ADEF_PCM_SIMD_AVX2:
+		/* Also checks that the OS saves the AVX registers */
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+
+static __attribute__((constructor)) void simd_init(void)
+{
+	enum adef_pcm_simd simd = ADEF_PCM_SIMD_SCALAR;
+	const char *env;
+
+	for (unsigned int i = 0; i < ADEF_PCM_SIMD_MAX; i++) {
+		s_supported[i] = kernels_map[i] != NULL && cpu_supports(i);
+		if (s_supported[i])
+			simd = i;
+	}
+
+	env = getenv(ADEF_PCM_SIMD_ENV);
+	if (env != NULL && *env != '\0') {
+		enum adef_pcm_simd forced = adef_pcm_simd_from_str(env);
+		if (forced == ADEF_PCM_SIMD_MAX)
+			ULOGW("%s: ignoring %s='%s'",
+			      __func__,
+			      ADEF_PCM_SIMD_ENV,
+			      env);
+		else if (!s_supported[forced])
+			ULOGW("%s: %s level not supported, ignoring %s",
+			      __func__,
+			      env,
+			      ADEF_PCM_SIMD_ENV);
+		else
+			simd = forced;
+	}
+
+	ULOGD("PCM kernels level: %s", adef_pcm_simd_to_str(simd));
+	__atomic_store_n(
+		&adef_pcm_kernels_current, kernels_map[simd], __ATOMIC_RELAXED);
+}
+
+
+enum adef_pcm_simd adef_pcm_simd_from_str(const char *str)
+{
+	enum adef_pcm_simd ret = ADEF_PCM_SIMD_MAX;
+
+	ULOG_ERRNO_RETURN_VAL_IF(str == NULL, EINVAL, ret);
+
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(simd_map); i++) {
+		if (strcasecmp(str, simd_map[i].str) == 0)
+			return simd_map[i].simd;
+	}
+	ULOGW("%s: unknown level '%s'", __func__, str);
+	return ret;
+}
+
+
+const char *adef_pcm_simd_to_str(enum adef_pcm_simd simd)
+{
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(simd_map); i++) {
+		if (simd == simd_map[i].simd)
+			return simd_map[i].str;
+	}
+	return "UNKNOWN";
+}
+
+
+bool adef_pcm_simd_is_supported(enum adef_pcm_simd simd)
+{
+	return (unsigned int)simd < ADEF_PCM_SIMD_MAX && s_supported[simd];
+}
+
+
+enum adef_pcm_simd adef_pcm_simd_get(void)
+{
+	const struct adef_pcm_kernels *kernels = adef_pcm_kernels_get();
+
+	for (unsigned int i = 0; i < ADEF_PCM_SIMD_MAX; i++) {
+		if (kernels == kernels_map[i])
+			return i;
+	}
+	return ADEF_PCM_SIMD_BASELINE;
+}
+
+
+int adef_pcm_simd_set(enum adef_pcm_simd simd)
+{
+	ULOG_ERRNO_RETURN_ERR_IF((unsigned int)simd >= ADEF_PCM_SIMD_MAX,
+				 EINVAL);
+
+	if (!s_supported[simd]) {
+		ULOGE("%s: %s level not supported",
+		      __func__,
+		      adef_pcm_simd_to_str(simd));
+		return -ENOTSUP;
+	}
+
+	__atomic_store_n(
+		&adef_pcm_kernels_current, kernels_map[simd], __ATOMIC_RELAXED);
+	return 0;
+}
+
+
+static float random_float(struct self_test *test, float range)
+{
+	test->rng = adef_xorshift32(test->rng);
+	return (float)(int32_t)test->rng * (range / 2147483648.f);
+}
+
+
+/* Fill the inputs with random values, the first ones being edge values */
+static void self_test_fill(struct self_test *test)
+{
+	static const int32_t s32_edges[] = {
+		INT32_MIN, INT32_MIN + 1, INT32_MAX, INT32_MAX - 65535, -1, 0,
+	};
+	static const float sat_edges[] = {
+		INFINITY, -INFINITY, 32767.5f, -32768.5f, 0.5f, -0.5f, -2.5f,
+	};
+	static const double f64_edges[] = {
+		INFINITY, -INFINITY, 2147483647.5, -2147483648.5, 0.5, -2.5,
+	};
+	static const float special_edges[] = {
+		NAN, INFINITY, -INFINITY, -0.f, 1e-40f, -1e-40f, FLT_MIN,
+	};
+
+	for (size_t i = 0; i < SELF_TEST_COUNT; i++) {
+		test->rng = adef_xorshift32(test->rng);
+		test->s32[i] = (int32_t)test->rng;
+		test->s16[i] = (int16_t)(test->rng >> 16);
+		test->u24[3 * i] = (uint8_t)test->rng;
+		test->u24[3 * i + 1] = (uint8_t)(test->rng >> 8);
+		test->u24[3 * i + 2] = (uint8_t)(test->rng >> 24);
+		test->gains[i] = random_float(test, 4.f);
+		test->f32[i] = random_float(test, 2.f);
+		test->f32_sat[i] = random_float(test, 40000.f);
+		test->f64_sat[i] = random_float(test, 3e9f);
+		test->f32_special[i] = random_float(test, 2.f);
+	}
+	memcpy(test->s32, s32_edges, sizeof(s32_edges));
+	memcpy(test->f32_sat, sat_edges, sizeof(sat_edges));
+	memcpy(test->f64_sat, f64_edges, sizeof(f64_edges));
+	memcpy(test->f32_special, special_edges, sizeof(special_edges));
+	test->s16[0] = INT16_MIN;
+	test->s16[1] = INT16_MAX;
+}
+
+
+/* Compare floating-point values; fused multiply-add contraction by the
+ * compiler can change the last bits */
+static bool close_values(double a, double b, double epsilon)
+{
+	return a == b || fabs(a - b) <= epsilon * fabs(b);
+}
+
+
+static bool close_f32(const float *a, const float *b, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (!close_values(a[i], b[i], 1e-6))
+			return false;
+	}
+	return true;
+}
+
+
+static bool close_f64(const double *a, const double *b, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (!close_values(a[i], b[i], 1e-12))
+			return false;
+	}
+	return true;
+}
+
+
+/* Compare filtered samples; the rounding differences of contractions
+ * are accumulated by the filters (absolute tolerance) */
+static bool close_biquad(const float *a, const float *b, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (!(fabsf(a[i] - b[i]) <= 1e-4f))
+			return false;
+	}
+	return true;
+}
+
+
+/* Check the kernels of a table against the reference kernels, return the
+ * name of the first kernel giving a different result, or NULL; each
+ * kernel is run with both tables, the outputs are then compared */
+static const char *self_test_check(struct self_test *test,
+				   const struct adef_pcm_kernels *ref,
+				   const struct adef_pcm_kernels *kernels)
+{
+	const size_t n = SELF_TEST_COUNT;
+	const struct adef_pcm_kernels *k[2] = {ref, kernels};
+	struct self_test_output *o0 = &test->out[0], *o1 = &test->out[1];
+	struct self_test_output *o;
+
+	for (unsigned int r = 0; r < 2; r++)
+		k[r]->store_s16_sat(test->f32_sat, test->out[r].s16, n);
+	if (memcmp(o0->s16, o1->s16, n * sizeof(int16_t)) != 0)
+		return "store_s16_sat";
+
+	for (unsigned int r = 0; r < 2; r++)
+		k[r]->store_s32_sat(test->f64_sat, test->out[r].s32, n);
+	if (memcmp(o0->s32, o1->s32, n * sizeof(int32_t)) != 0)
+		return "store_s32_sat";
+
+	for (unsigned int s = 0; s < 2; s++) {
+		for (unsigned int r = 0; r < 2; r++)
+			k[r]->unpack_24le(test->u24, test->out[r].u32, n, s);
+		if (memcmp(o0->u32, o1->u32, n * sizeof(uint32_t)) != 0)
+			return "unpack_24le";
+	}
+
+	for (unsigned int r = 0; r < 2; r++) {
+		k[r]->pack_24le(
+			(const uint32_t *)test->s32, test->out[r].u24, n);
+	}
+	if (memcmp(o0->u24, o1->u24, n * 3) != 0)
+		return "pack_24le";
+
+	for (unsigned int r = 0; r < 2; r++) {
+		o = &test->out[r];
+		o->peak = 0;
+		o->sum_sq = 0.;
+		o->clip_count = 0;
+		k[r]->level(test->s32,
+			    n,
+			    INT32_MAX - 65535,
+			    &o->peak,
+			    &o->sum_sq,
+			    &o->clip_count);
+	}
+	if (o0->peak != o1->peak || o0->clip_count != o1->clip_count ||
+	    !close_values(o0->sum_sq, o1->sum_sq, 1e-5))
+		return "level";
+
+	for (unsigned int r = 0; r < 2; r++) {
+		memcpy(test->out[r].f32, test->gains, n * sizeof(float));
+		k[r]->mix_s16(test->s16, test->out[r].f32, n, 0.7f);
+	}
+	if (!close_f32(o0->f32, o1->f32, n))
+		return "mix_s16";
+
+	for (unsigned int r = 0; r < 2; r++) {
+		memcpy(test->out[r].f64, test->f64_sat, n * sizeof(double));
+		k[r]->mix_s32(test->s32, test->out[r].f64, n, 0.7);
+	}
+	if (!close_f64(o0->f64, o1->f64, n))
+		return "mix_s32";
+
+	for (unsigned int r = 0; r < 2; r++) {
+		memcpy(test->out[r].f32, test->gains, n * sizeof(float));
+		k[r]->mix_f32(test->f32, test->out[r].f32, n, 0.7f);
+	}
+	if (!close_f32(o0->f32, o1->f32, n))
+		return "mix_f32";
+
+	for (unsigned int r = 0; r < 2; r++)
+		k[r]->gain_s16(test->s16, test->gains, test->out[r].f32, n);
+	if (!close_f32(o0->f32, o1->f32, n))
+		return "gain_s16";
+
+	for (unsigned int r = 0; r < 2; r++)
+		k[r]->gain_s32(test->s32, test->gains, test->out[r].f64, n);
+	if (!close_f64(o0->f64, o1->f64, n))
+		return "gain_s32";
+
+	for (unsigned int r = 0; r < 2; r++) {
+		memcpy(test->out[r].f32, test->f32, n * sizeof(float));
+		k[r]->gain_f32(test->out[r].f32, test->gains, n);
+	}
+	if (!close_f32(o0->f32, o1->f32, n))
+		return "gain_f32";
+
+	for (unsigned int bits = 8; bits <= 24; bits += 8) {
+		for (unsigned int d = 0; d < 2; d++) {
+			for (unsigned int r = 0; r < 2; r++) {
+				o = &test->out[r];
+				for (unsigned int j = 0; j < ADEF_VEC_LEN; j++)
+					o->rng[j] = 0x9e3779b9u * (j + 1);
+				k[r]->requantize(
+					test->s32, o->s32, n, bits, o->rng, d);
+			}
+			if (memcmp(o0->s32, o1->s32, n * sizeof(int32_t)) != 0)
+				return "requantize";
+			if (memcmp(o0->rng, o1->rng, sizeof(o0->rng)) != 0)
+				return "requantize";
+		}
+	}
+
+	for (unsigned int r = 0; r < 2; r++) {
+		o = &test->out[r];
+		memcpy(o->f32, test->f32_special, n * sizeof(float));
+		o->modified = k[r]->sanitize(o->f32, n, 1.5f);
+	}
+	if (o0->modified != o1->modified ||
+	    memcmp(o0->f32, o1->f32, n * sizeof(float)) != 0)
+		return "sanitize";
+
+	for (unsigned int r = 0; r < 2; r++) {
+		o = &test->out[r];
+		memcpy(o->f32, test->f32, n * sizeof(float));
+		memset(o->state, 0, sizeof(o->state));
+		k[r]->biquad(o->f32,
+			     n / ADEF_VEC_LEN,
+			     biquad_coefs,
+			     ADEF_ARRAY_SIZE(biquad_coefs),
+			     o->state);
+	}
+	if (!close_biquad(o0->f32, o1->f32, n) ||
+	    !close_biquad(&o0->state[0][0][0],
+			  &o1->state[0][0][0],
+			  sizeof(o0->state) / sizeof(float)))
+		return "biquad";
+
+	for (unsigned int r = 0; r < 2; r++) {
+		o = &test->out[r];
+		memset(o->lane_sum_sq, 0, sizeof(o->lane_sum_sq));
+		k[r]->sum_sq(test->f32, n / ADEF_VEC_LEN, o->lane_sum_sq);
+	}
+	for (unsigned int j = 0; j < ADEF_VEC_LEN; j++) {
+		if (!close_values(o0->lane_sum_sq[j], o1->lane_sum_sq[j], 1e-5))
+			return "sum_sq";
+	}
+
+	for (unsigned int r = 0; r < 2; r++) {
+		o = &test->out[r];
+		memset(o->lane_peak, 0, sizeof(o->lane_peak));
+		k[r]->peak_fir(test->f32,
+			       n / ADEF_VEC_LEN - (SELF_TEST_FIR_TAPS - 1),
+			       test->gains,
+			       SELF_TEST_FIR_PHASES,
+			       SELF_TEST_FIR_TAPS,
+			       o->lane_peak);
+	}
+	for (unsigned int j = 0; j < ADEF_VEC_LEN; j++) {
+		if (!close_values(o0->lane_peak[j], o1->lane_peak[j], 1e-5))
+			return "peak_fir";
+	}
+
+	return NULL;
+}
+
+
+int adef_pcm_simd_self_test(void)
+{
+	int ret = 0;
+	struct self_test *test;
+
+	test = calloc(1, sizeof(*test));
+	if (test == NULL)
+		return -ENOMEM;
+	test->rng = 0x12345678;
+
+	for (unsigned int i = 0; i < ADEF_PCM_SIMD_MAX; i++) {
+		const char *failed;
+		if (i == ADEF_PCM_SIMD_SCALAR || !s_supported[i])
+			continue;
+		self_test_fill(test);
+		failed = self_test_check(
+			test, &adef_pcm_kernels_scalar, kernels_map[i]);
+		if (failed == NULL)
+			continue;
+		ULOGE("%s: %s kernel of the %s level differs from the scalar "
+		      "reference",
+		      __func__,
+		      failed,
+		      adef_pcm_simd_to_str(i));
+		ret = -EPROTO;
+	}
+
+	free(test);
+	return ret;
+}
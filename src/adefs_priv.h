@@ -0,0 +1,460 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ADEFS_PRIV_H_
+#define _ADEFS_PRIV_H_
+
+#include <audio-defs/adefs.h>
+#include <audio-defs/adefs_pcm.h>
+#include <time.h>
+
+
+/* Number of frames processed at once by the PCM kernels working on
+ * intermediate sample arrays (small enough to stay in the L1 cache) */
+#define ADEF_PCM_BLOCK_FRAMES 256
+
+
+/* Generic SIMD vector types (GCC vector extensions, lowered to SSE/AVX on
+ * x86 and NEON on ARM, or to scalar code otherwise) */
+#define ADEF_VEC_LEN 8
+typedef int32_t adef_v8si __attribute__((vector_size(32)));
+typedef uint32_t adef_v8su __attribute__((vector_size(32)));
+typedef float adef_v8sf __attribute__((vector_size(32)));
+typedef int16_t adef_v8hi __attribute__((vector_size(16)));
+typedef double adef_v8df __attribute__((vector_size(64)));
+typedef int64_t adef_v8di __attribute__((vector_size(64)));
+
+
+/* Hot path statistics (see enum adef_stat); without ADEF_STATS the macros
+ * compile to nothing */
+#ifdef ADEF_STATS
+
+/* Per-thread counters block */
+struct adef_stats_block {
+	uint64_t counters[ADEF_STAT_MAX];
+	struct adef_stats_block *prev;
+	struct adef_stats_block *next;
+};
+
+extern __thread struct adef_stats_block *adef_stats_tls;
+
+struct adef_stats_block *adef_stats_block_get(void);
+
+
+static inline void adef_stats_add(enum adef_stat stat, uint64_t value)
+{
+	struct adef_stats_block *block = adef_stats_tls;
+	if (__builtin_expect(block == NULL, 0)) {
+		block = adef_stats_block_get();
+		if (block == NULL)
+			return;
+	}
+	/* Only the owner thread writes: relaxed load and store, no atomic
+	 * read-modify-write needed */
+	__atomic_store_n(&block->counters[stat],
+			 __atomic_load_n(&block->counters[stat],
+					 __ATOMIC_RELAXED) +
+				 value,
+			 __ATOMIC_RELAXED);
+}
+
+
+static inline uint64_t adef_stats_cycles(void)
+{
+#	if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#	elif defined(__aarch64__)
+	uint64_t v;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(v));
+	return v;
+#	else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#	endif
+}
+
+#	define ADEF_STATS_ADD(_stat, _value) adef_stats_add((_stat), (_value))
+#	define ADEF_STATS_CYCLES() adef_stats_cycles()
+
+#else /* !ADEF_STATS */
+
+#	define ADEF_STATS_ADD(_stat, _value)                                  \
+		do {                                                           \
+			(void)(_stat);                                         \
+			(void)(_value);                                        \
+		} while (0)
+#	define ADEF_STATS_CYCLES() ((uint64_t)0)
+
+#endif /* !ADEF_STATS */
+
+
+/* Host endianness */
+#define ADEF_HOST_LITTLE_ENDIAN (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+
+/* Lane-wise select: (mask ? a : b), mask lanes being 0 or -1 (macros
+ * rather than functions, as passing 256-bit vectors by value depends on
+ * the instruction set) */
+#define ADEF_VEC_SELECT(_mask, _a, _b) (((_a) & (_mask)) | ((_b) & ~(_mask)))
+
+/* Lane-wise select on float vectors */
+#define ADEF_V8SF_SELECT(_mask, _a, _b)                                        \
+	((adef_v8sf)ADEF_VEC_SELECT((_mask), (adef_v8si)(_a), (adef_v8si)(_b)))
+
+/* Lane-wise select on double vectors */
+#define ADEF_V8DF_SELECT(_mask, _a, _b)                                        \
+	((adef_v8df)ADEF_VEC_SELECT((_mask), (adef_v8di)(_a), (adef_v8di)(_b)))
+
+/* Lane-wise clamp of a signed integer vector (in place) */
+#define ADEF_V8SI_CLAMP(_v, _lo, _hi)                                          \
+	do {                                                                   \
+		(_v) = ADEF_VEC_SELECT((_v) < (_lo), (_v)*0 + (_lo), (_v));    \
+		(_v) = ADEF_VEC_SELECT((_v) > (_hi), (_v)*0 + (_hi), (_v));    \
+	} while (0)
+
+
+/* Xorshift pseudo-random number generator step */
+static inline uint32_t adef_xorshift32(uint32_t s)
+{
+	s ^= s << 13;
+	s ^= s >> 17;
+	s ^= s << 5;
+	return s;
+}
+
+
+/* TPDF value in ]-1, 1[ from a 32-bit random value: sum of two uniform
+ * 16-bit values */
+static inline float adef_tpdf(uint32_t r)
+{
+	return (float)((int32_t)(r & 0xffff) + (int32_t)(r >> 16) - 65535) *
+	       (1.f / 65536.f);
+}
+
+
+/* PCM processing kernels of an instruction set level (see
+ * enum adef_pcm_simd); the same sources are compiled once per level (see
+ * adefs_pcm_kernels.h), the processing functions get the current table
+ * once per call with adef_pcm_kernels_get() */
+struct adef_pcm_kernels {
+	/* Round (half away from zero) and saturate unnormalized samples to
+	 * signed 16-bit or 32-bit samples */
+	void (*store_s16_sat)(const float *src, int16_t *dst, size_t count);
+	void (*store_s32_sat)(const double *src, int32_t *dst, size_t count);
+
+	/* See adef_pcm_unpack_24le() and adef_pcm_pack_24le() */
+	void (*unpack_24le)(const uint8_t *src,
+			    uint32_t *dst,
+			    size_t count,
+			    bool signed_val);
+	void (*pack_24le)(const uint32_t *src, uint8_t *dst, size_t count);
+
+	/* Accumulate the levels of left-justified samples; clip_hi is the
+	 * left-justified maximum value of the format */
+	void (*level)(const int32_t *samples,
+		      size_t count,
+		      int32_t clip_hi,
+		      uint32_t *peak,
+		      double *sum_sq,
+		      uint64_t *clip_count);
+
+	/* Mix samples with a gain: acc += src * gain */
+	void (*mix_s16)(const int16_t *src,
+			float *acc,
+			size_t count,
+			float gain);
+	void (*mix_s32)(const int32_t *src,
+			double *acc,
+			size_t count,
+			double gain);
+	void (*mix_f32)(const float *src,
+			float *acc,
+			size_t count,
+			float gain);
+
+	/* Apply per-sample gains: dst = src * gains (in place for f32) */
+	void (*gain_s16)(const int16_t *src,
+			 const float *gains,
+			 float *dst,
+			 size_t count);
+	void (*gain_s32)(const int32_t *src,
+			 const float *gains,
+			 double *dst,
+			 size_t count);
+	void (*gain_f32)(float *samples, const float *gains, size_t count);
+
+	/* Requantize left-justified samples to 'bits' bits without error
+	 * feedback; rng is the TPDF dither generator state (one value per
+	 * vector lane, the remaining samples after the last full vector use
+	 * the first one) */
+	void (*requantize)(const int32_t *in,
+			   int32_t *out,
+			   size_t count,
+			   unsigned int bits,
+			   uint32_t rng[ADEF_VEC_LEN],
+			   bool dither);
+
+	/* Flush NaN and denormal values to 0 and clamp to [-limit, limit],
+	 * return the modified sample count */
+	size_t (*sanitize)(float *samples, size_t count, float limit);
+
+	/* Filter samples of ADEF_VEC_LEN channels interleaved in the vector
+	 * lanes (frame by frame) with a cascade of biquads in transposed
+	 * direct form II, in place; state holds z1 and z2 of each lane for
+	 * each stage */
+	void (*biquad)(float *samples,
+		       size_t frames,
+		       const struct adef_pcm_biquad_coefs *coefs,
+		       unsigned int stages,
+		       float state[][2][ADEF_VEC_LEN]);
+
+	/* Add the squares of the samples of ADEF_VEC_LEN channels
+	 * interleaved in the vector lanes to the sum of each lane */
+	void (*sum_sq)(const float *samples,
+		       size_t frames,
+		       double sum_sq[ADEF_VEC_LEN]);
+
+	/* Interpolate samples of ADEF_VEC_LEN channels interleaved in the
+	 * vector lanes with a polyphase FIR filter ('phases' output samples
+	 * per frame, coefs[p * taps + t] applying to the frame delayed by t
+	 * for phase p) and update the peak absolute interpolated value of
+	 * each lane; samples starts with the taps - 1 frames preceding the
+	 * first frame to interpolate */
+	void (*peak_fir)(const float *samples,
+			 size_t frames,
+			 const float *coefs,
+			 unsigned int phases,
+			 unsigned int taps,
+			 float peak[ADEF_VEC_LEN]);
+};
+
+
+/* The AVX2 kernels are built on x86 only */
+#if defined(__x86_64__) || defined(__i386__)
+#	define ADEF_PCM_HAVE_AVX2 1
+#else
+#	define ADEF_PCM_HAVE_AVX2 0
+#endif
+
+
+/* Kernel tables of each level */
+extern const struct adef_pcm_kernels adef_pcm_kernels_scalar;
+extern const struct adef_pcm_kernels adef_pcm_kernels_baseline;
+#if ADEF_PCM_HAVE_AVX2
+extern const struct adef_pcm_kernels adef_pcm_kernels_avx2;
+#endif
+
+
+/* Current kernel table (see adef_pcm_simd_set()) */
+extern const struct adef_pcm_kernels *adef_pcm_kernels_current;
+
+
+static inline const struct adef_pcm_kernels *adef_pcm_kernels_get(void)
+{
+	return __atomic_load_n(&adef_pcm_kernels_current, __ATOMIC_RELAXED);
+}
+
+
+/* PCM sample codec: functions converting 'count' samples between a
+ * buffer of a given PCM format, read or written every 'stride' bytes, and
+ * contiguous arrays of either left-justified signed 32-bit integers or
+ * normalized floats in [-1.0, 1.0) */
+struct adef_pcm_codec {
+	/* Sample size in bytes (container size) */
+	unsigned int sample_size;
+
+	/* Valid bits per sample */
+	unsigned int bits;
+
+	void (*load_s32)(const uint8_t *src,
+			 size_t stride,
+			 int32_t *dst,
+			 size_t count);
+
+	void (*store_s32)(const int32_t *src,
+			  uint8_t *dst,
+			  size_t stride,
+			  size_t count);
+
+	void (*load_f32)(const uint8_t *src,
+			 size_t stride,
+			 float *dst,
+			 size_t count);
+
+	void (*store_f32)(const float *src,
+			  uint8_t *dst,
+			  size_t stride,
+			  size_t count);
+};
+
+
+/**
+ * Get the sample codec of a PCM format.
+ * @param format: PCM format
+ * @param codec: codec to fill (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+int adef_pcm_codec_get(const struct adef_format *format,
+		       struct adef_pcm_codec *codec);
+
+
+/**
+ * Get the address of the first sample of a channel in a PCM buffer and the
+ * offset in bytes between two consecutive samples of this channel.
+ * @param buf: PCM buffer
+ * @param format: PCM format of the buffer
+ * @param sample_size: sample size in bytes
+ * @param channel: channel index
+ * @param stride: offset between two samples of the channel (output)
+ * @return the address of the first sample of the channel
+ */
+static inline uint8_t *
+adef_pcm_buffer_channel(const struct adef_pcm_buffer *buf,
+			const struct adef_format *format,
+			size_t sample_size,
+			unsigned int channel,
+			size_t *stride)
+{
+	uint8_t *data = buf->data;
+	size_t plane_stride;
+
+	if (format->pcm.interleaved) {
+		*stride = sample_size * format->channel_count;
+		return data + channel * sample_size;
+	}
+
+	plane_stride = buf->plane_stride ? buf->plane_stride
+					 : buf->frames * sample_size;
+	*stride = sample_size;
+	return data + channel * plane_stride;
+}
+
+
+/**
+ * Decode the samples of a group of ADEF_VEC_LEN consecutive channels of a
+ * PCM buffer to floats interleaved in the vector lanes (frame by frame);
+ * the lanes beyond the last channel are set to 0.
+ * @param codec: sample codec of the format
+ * @param format: PCM format of the buffer
+ * @param buf: PCM buffer
+ * @param first: index of the first channel of the group
+ * @param offset: index of the first frame to decode
+ * @param frames: frame count to decode
+ * @param tmp: temporary array of at least 'frames' samples
+ * @param lanes: interleaved samples, 'frames' * ADEF_VEC_LEN (output)
+ */
+void adef_pcm_lanes_load(const struct adef_pcm_codec *codec,
+			 const struct adef_format *format,
+			 const struct adef_pcm_buffer *buf,
+			 unsigned int first,
+			 size_t offset,
+			 size_t frames,
+			 float *tmp,
+			 float *lanes);
+
+
+/**
+ * Encode floats interleaved in the vector lanes to the samples of a group
+ * of ADEF_VEC_LEN consecutive channels of a PCM buffer (the lanes beyond
+ * the last channel are ignored).
+ * @param codec: sample codec of the format
+ * @param format: PCM format of the buffer
+ * @param buf: PCM buffer (output)
+ * @param first: index of the first channel of the group
+ * @param offset: index of the first frame to encode
+ * @param frames: frame count to encode
+ * @param tmp: temporary array of at least 'frames' samples
+ * @param lanes: interleaved samples, 'frames' * ADEF_VEC_LEN
+ */
+void adef_pcm_lanes_store(const struct adef_pcm_codec *codec,
+			  const struct adef_format *format,
+			  const struct adef_pcm_buffer *buf,
+			  unsigned int first,
+			  size_t offset,
+			  size_t frames,
+			  float *tmp,
+			  const float *lanes);
+
+
+/**
+ * Compute value * num / den (rounded down, without overflow on the
+ * intermediate product).
+ * @param value: value to rescale
+ * @param num: numerator
+ * @param den: denominator (non-zero)
+ * @return the rescaled value
+ */
+static inline uint64_t adef_rescale(uint64_t value, uint32_t num, uint32_t den)
+{
+	return value / den * num + value % den * num / den;
+}
+
+
+/**
+ * Convert the timestamp of a frame information to a position in samples
+ * (rounded down, without overflow on the intermediate product).
+ * @param info: frame information (with a non-zero time scale)
+ * @param sample_rate: sample rate
+ * @return the position in samples
+ */
+static inline uint64_t
+adef_frame_info_to_samples(const struct adef_frame_info *info,
+			   unsigned int sample_rate)
+{
+	return adef_rescale(info->timestamp, sample_rate, info->timescale);
+}
+
+
+/**
+ * Check whether a name is the name of a built-in format.
+ * The case is ignored.
+ * @param str: format name
+ * @return true if a built-in format has this name, false otherwise
+ */
+bool adef_format_is_builtin(const char *str);
+
+
+/**
+ * Find a runtime registered format by name (wait-free).
+ * The case is ignored.
+ * @param str: format name
+ * @param format: format to fill
+ * @return 0 on success, -ENOENT if no format is registered with this name
+ */
+int adef_registry_find_by_name(const char *str, struct adef_format *format);
+
+
+/**
+ * Find the name of a runtime registered format (wait-free).
+ * @param format: format to look for
+ * @return a copy of the registered name (to be freed after usage), or NULL
+ *         if the format is not registered
+ */
+char *adef_registry_find_by_format(const struct adef_format *format);
+
+
+#endif /* !_ADEFS_PRIV_H_ */
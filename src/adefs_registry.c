@@ -0,0 +1,314 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* Runtime registered formats are stored in immutable snapshots. Writers
+ * (serialized by a mutex) build a new snapshot, publish it with an atomic
+ * pointer swap, then wait for a grace period before freeing the previous
+ * one. Readers never block nor retry: they only announce themselves in one
+ * of two reader counters selected by the current epoch parity, which lets
+ * the writer know when no reader can still reference an old snapshot. */
+
+
+struct registry_entry {
+	char *name;
+	struct adef_format format;
+};
+
+
+struct registry_snapshot {
+	unsigned int count;
+	struct registry_entry entries[];
+};
+
+
+static struct {
+	_Atomic(struct registry_snapshot *) current;
+	atomic_uint epoch;
+	atomic_uint readers[2];
+	pthread_mutex_t lock;
+} registry = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+
+static unsigned int read_lock(void)
+{
+	unsigned int idx = atomic_load(&registry.epoch) & 1;
+	atomic_fetch_add(&registry.readers[idx], 1);
+	return idx;
+}
+
+
+static void read_unlock(unsigned int idx)
+{
+	atomic_fetch_sub_explicit(
+		&registry.readers[idx], 1, memory_order_release);
+}
+
+
+/* Must be called with the registry lock held */
+static void synchronize(void)
+{
+	/* Two epoch flips are needed: a reader may have sampled the epoch
+	 * just before the first flip and only registered itself after the
+	 * writer checked the corresponding counter */
+	for (unsigned int i = 0; i < 2; i++) {
+		unsigned int idx = atomic_fetch_add(&registry.epoch, 1) & 1;
+		while (atomic_load(&registry.readers[idx]) != 0)
+			sched_yield();
+	}
+}
+
+
+static void snapshot_destroy(struct registry_snapshot *snapshot)
+{
+	if (snapshot == NULL)
+		return;
+	for (unsigned int i = 0; i < snapshot->count; i++)
+		free(snapshot->entries[i].name);
+	free(snapshot);
+}
+
+
+/* Copy the current snapshot, leaving room for 'extra' more entries and
+ * skipping the entry at index 'skip' (if valid) */
+static struct registry_snapshot *
+snapshot_copy(const struct registry_snapshot *snapshot,
+	      unsigned int extra,
+	      unsigned int skip)
+{
+	struct registry_snapshot *copy;
+	unsigned int count = snapshot ? snapshot->count : 0;
+
+	copy = calloc(1,
+		      sizeof(*copy) +
+			      (count + extra) * sizeof(copy->entries[0]));
+	if (copy == NULL)
+		return NULL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct registry_entry *entry;
+		if (i == skip)
+			continue;
+		entry = &copy->entries[copy->count];
+		entry->name = strdup(snapshot->entries[i].name);
+		if (entry->name == NULL) {
+			snapshot_destroy(copy);
+			return NULL;
+		}
+		entry->format = snapshot->entries[i].format;
+		copy->count++;
+	}
+
+	return copy;
+}
+
+
+static int snapshot_find(const struct registry_snapshot *snapshot,
+			 const char *name)
+{
+	if (snapshot == NULL)
+		return -ENOENT;
+	for (unsigned int i = 0; i < snapshot->count; i++) {
+		if (strcasecmp(snapshot->entries[i].name, name) == 0)
+			return (int)i;
+	}
+	return -ENOENT;
+}
+
+
+static void snapshot_publish(struct registry_snapshot *snapshot)
+{
+	struct registry_snapshot *old;
+
+	old = atomic_exchange(&registry.current, snapshot);
+	synchronize();
+	snapshot_destroy(old);
+}
+
+
+int adef_format_register(const char *name, const struct adef_format *format)
+{
+	int ret;
+	struct registry_snapshot *current, *snapshot;
+	struct registry_entry *entry;
+
+	ULOG_ERRNO_RETURN_ERR_IF(name == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(name[0] == '\0', EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(strchr(name, '/') != NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!adef_is_format_valid(format), EINVAL);
+
+	/* The name must not shadow a built-in format */
+	if (adef_format_is_builtin(name)) {
+		ULOGE("%s: format '%s' already exists", __func__, name);
+		return -EEXIST;
+	}
+
+	pthread_mutex_lock(&registry.lock);
+
+	current = atomic_load(&registry.current);
+	if (snapshot_find(current, name) >= 0) {
+		ULOGE("%s: format '%s' already exists", __func__, name);
+		ret = -EEXIST;
+		goto out;
+	}
+
+	snapshot = snapshot_copy(current, 1, UINT_MAX);
+	if (snapshot == NULL) {
+		ret = -ENOMEM;
+		ULOG_ERRNO("snapshot_copy", -ret);
+		goto out;
+	}
+	entry = &snapshot->entries[snapshot->count];
+	entry->name = strdup(name);
+	if (entry->name == NULL) {
+		ret = -ENOMEM;
+		ULOG_ERRNO("strdup", -ret);
+		snapshot_destroy(snapshot);
+		goto out;
+	}
+	entry->format = *format;
+	snapshot->count++;
+
+	snapshot_publish(snapshot);
+	ret = 0;
+
+out:
+	pthread_mutex_unlock(&registry.lock);
+	return ret;
+}
+
+
+int adef_format_unregister(const char *name)
+{
+	int ret;
+	struct registry_snapshot *current, *snapshot;
+
+	ULOG_ERRNO_RETURN_ERR_IF(name == NULL, EINVAL);
+
+	pthread_mutex_lock(&registry.lock);
+
+	current = atomic_load(&registry.current);
+	ret = snapshot_find(current, name);
+	if (ret < 0)
+		goto out;
+
+	snapshot = snapshot_copy(current, 0, (unsigned int)ret);
+	if (snapshot == NULL) {
+		ret = -ENOMEM;
+		ULOG_ERRNO("snapshot_copy", -ret);
+		goto out;
+	}
+	if (snapshot->count == 0) {
+		/* Restore the readers fast path */
+		snapshot_destroy(snapshot);
+		snapshot = NULL;
+	}
+
+	snapshot_publish(snapshot);
+	ret = 0;
+
+out:
+	pthread_mutex_unlock(&registry.lock);
+	return ret;
+}
+
+
+int adef_registry_find_by_name(const char *str, struct adef_format *format)
+{
+	int ret = -ENOENT;
+	unsigned int idx;
+	const struct registry_snapshot *snapshot;
+
+	/* Fast path: nothing registered */
+	if (atomic_load_explicit(&registry.current, memory_order_relaxed) ==
+	    NULL)
+		return -ENOENT;
+
+	idx = read_lock();
+	snapshot = atomic_load(&registry.current);
+	if (snapshot != NULL) {
+		for (unsigned int i = 0; i < snapshot->count; i++) {
+			if (strcasecmp(snapshot->entries[i].name, str) == 0) {
+				*format = snapshot->entries[i].format;
+				ret = 0;
+				break;
+			}
+		}
+	}
+	read_unlock(idx);
+
+	return ret;
+}
+
+
+char *adef_registry_find_by_format(const struct adef_format *format)
+{
+	char *ret = NULL;
+	unsigned int idx;
+	const struct registry_snapshot *snapshot;
+
+	/* Fast path: nothing registered */
+	if (atomic_load_explicit(&registry.current, memory_order_relaxed) ==
+	    NULL)
+		return NULL;
+
+	idx = read_lock();
+	snapshot = atomic_load(&registry.current);
+	if (snapshot != NULL) {
+		for (unsigned int i = 0; i < snapshot->count; i++) {
+			if (adef_format_cmp(&snapshot->entries[i].format,
+					    format)) {
+				ret = strdup(snapshot->entries[i].name);
+				break;
+			}
+		}
+	}
+	read_unlock(idx);
+
+	return ret;
+}
+
+
+static __attribute__((destructor)) void registry_cleanup(void)
+{
+	snapshot_destroy(atomic_exchange(&registry.current, NULL));
+}
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+#ifdef ADEF_STATS
+
+
+__thread struct adef_stats_block *adef_stats_tls;
+
+
+static struct {
+	pthread_once_t once;
+	pthread_key_t key;
+	pthread_mutex_t mutex;
+	/* Blocks of the running threads */
+	struct adef_stats_block *blocks;
+	/* Counters of the terminated threads */
+	uint64_t retired[ADEF_STAT_MAX];
+} s_stats = {
+	.once = PTHREAD_ONCE_INIT,
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+
+/* Thread exit: fold the thread counters into the retired counters */
+static void block_release(void *data)
+{
+	struct adef_stats_block *block = data;
+
+	pthread_mutex_lock(&s_stats.mutex);
+	for (unsigned int i = 0; i < ADEF_STAT_MAX; i++)
+		s_stats.retired[i] += block->counters[i];
+	if (block->prev != NULL)
+		block->prev->next = block->next;
+	else
+		s_stats.blocks = block->next;
+	if (block->next != NULL)
+		block->next->prev = block->prev;
+	pthread_mutex_unlock(&s_stats.mutex);
+
+	adef_stats_tls = NULL;
+	free(block);
+}
+
+
+static void stats_init(void)
+{
+	int res = pthread_key_create(&s_stats.key, &block_release);
+	if (res != 0)
+		ULOG_ERRNO("pthread_key_create", res);
+}
+
+
+struct adef_stats_block *adef_stats_block_get(void)
+{
+	struct adef_stats_block *block;
+	int res;
+
+	pthread_once(&s_stats.once, &stats_init);
+
+	block = calloc(1, sizeof(*block));
+	if (block == NULL)
+		return NULL;
+
+	res = pthread_setspecific(s_stats.key, block);
+	if (res != 0) {
+		ULOG_ERRNO("pthread_setspecific", res);
+		free(block);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&s_stats.mutex);
+	block->next = s_stats.blocks;
+	if (block->next != NULL)
+		block->next->prev = block;
+	s_stats.blocks = block;
+	pthread_mutex_unlock(&s_stats.mutex);
+
+	adef_stats_tls = block;
+	return block;
+}
+
+
+int adef_stats_snapshot(struct adef_stats *stats)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(stats == NULL, EINVAL);
+
+	pthread_mutex_lock(&s_stats.mutex);
+	memcpy(stats->counters, s_stats.retired, sizeof(stats->counters));
+	for (struct adef_stats_block *block = s_stats.blocks; block != NULL;
+	     block = block->next) {
+		for (unsigned int i = 0; i < ADEF_STAT_MAX; i++) {
+			stats->counters[i] += __atomic_load_n(
+				&block->counters[i], __ATOMIC_RELAXED);
+		}
+	}
+	pthread_mutex_unlock(&s_stats.mutex);
+
+	return 0;
+}
+
+
+#else /* !ADEF_STATS */
+
+
+int adef_stats_snapshot(struct adef_stats *stats)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(stats == NULL, EINVAL);
+
+	return -ENOTSUP;
+}
+
+
+#endif /* !ADEF_STATS */
@@ -0,0 +1,524 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <audio-defs/adefs_wav.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "adefs_priv.h"
+
+#define ULOG_TAG adef
+#include <ulog.h>
+
+
+/* WAV format tags */
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xfffe
+
+/* Header sizes (RIFF, fmt and data chunk headers) */
+#define WAV_HEADER_SIZE 44
+#define WAV_HEADER_EXTENSIBLE_SIZE 68
+
+
+struct adef_wav_writer {
+	int fd;
+	struct adef_format format;
+	size_t sample_size;
+	size_t frame_size;
+	bool prealloc;
+
+	/* File header */
+	uint8_t header[WAV_HEADER_EXTENSIBLE_SIZE];
+	size_t header_size;
+
+	/* Write buffer */
+	uint8_t *buf;
+	size_t buf_size;
+	size_t buf_len;
+
+	/* Bytes written to the file (header included) */
+	uint64_t file_size;
+
+	/* Sample data bytes, buffered data included */
+	uint64_t data_size;
+
+	/* Periodic checkpoints */
+	uint64_t checkpoint_size;
+	uint64_t next_checkpoint;
+};
+
+
+static uint8_t *put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+	return p + 2;
+}
+
+
+static uint8_t *put_le32(uint8_t *p, uint32_t v)
+{
+	p = put_le16(p, v & 0xffff);
+	return put_le16(p, v >> 16);
+}
+
+
+static uint8_t *put_tag(uint8_t *p, const char *tag)
+{
+	memcpy(p, tag, 4);
+	return p + 4;
+}
+
+
+/* Maximum sample data size (RIFF chunk size limit, pad byte included) */
+static uint64_t max_data_size(const struct adef_wav_writer *writer)
+{
+	return UINT32_MAX - (writer->header_size - 8) - 1;
+}
+
+
+static void build_header(struct adef_wav_writer *writer, uint64_t data_size)
+{
+	const struct adef_format *format = &writer->format;
+	bool extensible = writer->header_size == WAV_HEADER_EXTENSIBLE_SIZE;
+	uint16_t tag = format->pcm.float_val ? WAVE_FORMAT_IEEE_FLOAT
+					     : WAVE_FORMAT_PCM;
+	uint8_t *p = writer->header;
+
+	p = put_tag(p, "RIFF");
+	p = put_le32(p,
+		     writer->header_size - 8 + data_size + (data_size & 1));
+	p = put_tag(p, "WAVE");
+
+	p = put_tag(p, "fmt ");
+	p = put_le32(p, extensible ? 40 : 16);
+	p = put_le16(p, extensible ? WAVE_FORMAT_EXTENSIBLE : tag);
+	p = put_le16(p, format->channel_count);
+	p = put_le32(p, format->sample_rate);
+	p = put_le32(p, format->sample_rate * writer->frame_size);
+	p = put_le16(p, writer->frame_size);
+	p = put_le16(p, writer->sample_size * 8);
+	if (extensible) {
+		/* Extension size, valid bits, channel mask (the channel
+		 * layout bits follow the WAV speaker positions) */
+		p = put_le16(p, 22);
+		p = put_le16(p, format->bit_depth);
+		p = put_le32(p, format->channel_layout);
+		/* Sub-format GUID */
+		p = put_le32(p, tag);
+		memcpy(p,
+		       "\x00\x00\x10\x00\x80\x00\x00\xaa\x00\x38\x9b\x71",
+		       12);
+		p += 12;
+	}
+
+	p = put_tag(p, "data");
+	put_le32(p, data_size);
+}
+
+
+static int write_vec(int fd, struct iovec *iov, int count)
+{
+	ssize_t res;
+
+	while (count > 0) {
+		res = writev(fd, iov, count);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			res = -errno;
+			ULOG_ERRNO("writev", (int)-res);
+			return res;
+		}
+		/* Partial write */
+		while (count > 0 && (size_t)res >= iov->iov_len) {
+			res -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0) {
+			iov->iov_base = (uint8_t *)iov->iov_base + res;
+			iov->iov_len -= res;
+		}
+	}
+	return 0;
+}
+
+
+static int flush_buffer(struct adef_wav_writer *writer)
+{
+	int ret;
+	struct iovec iov = {
+		.iov_base = writer->buf,
+		.iov_len = writer->buf_len,
+	};
+
+	if (writer->buf_len == 0)
+		return 0;
+	ret = write_vec(writer->fd, &iov, 1);
+	if (ret < 0)
+		return ret;
+	writer->file_size += writer->buf_len;
+	writer->buf_len = 0;
+	return 0;
+}
+
+
+/* Update the header sizes with the data written to the file, and
+ * synchronize the file */
+static int update_header(struct adef_wav_writer *writer, uint64_t data_size)
+{
+	ssize_t res;
+
+	build_header(writer, data_size);
+	res = pwrite(writer->fd, writer->header, writer->header_size, 0);
+	if (res < 0) {
+		res = -errno;
+		ULOG_ERRNO("pwrite", (int)-res);
+		return res;
+	}
+	if (fdatasync(writer->fd) < 0) {
+		res = -errno;
+		ULOG_ERRNO("fdatasync", (int)-res);
+		return res;
+	}
+	return 0;
+}
+
+
+int adef_wav_writer_new(const char *path,
+			const struct adef_format *format,
+			const struct adef_wav_writer_config *config,
+			struct adef_wav_writer **ret_obj)
+{
+	int ret;
+	struct adef_wav_writer *writer;
+	struct adef_pcm_codec codec;
+	size_t page_size, flush_size;
+	bool extensible;
+
+	ULOG_ERRNO_RETURN_ERR_IF(path == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!adef_is_format_valid(format), EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	if (format->encoding != ADEF_ENCODING_PCM ||
+	    !format->pcm.little_endian ||
+	    (!format->pcm.interleaved &&
+	     format->channel_count > ADEF_PCM_MAX_CHANNELS) ||
+	    format->channel_count > UINT16_MAX ||
+	    (!format->pcm.float_val &&
+	     format->pcm.signed_val != (format->bit_depth > 8))) {
+		ULOGE("%s: unsupported format " ADEF_FORMAT_TO_STR_FMT,
+		      __func__,
+		      ADEF_FORMAT_TO_STR_ARG(format));
+		return -ENOTSUP;
+	}
+	ret = adef_pcm_codec_get(format, &codec);
+	if (ret < 0)
+		return ret;
+
+	writer = calloc(1, sizeof(*writer));
+	if (writer == NULL)
+		return -ENOMEM;
+	writer->fd = -1;
+	writer->format = *format;
+	writer->sample_size = codec.sample_size;
+	writer->frame_size = codec.sample_size * format->channel_count;
+	extensible = format->channel_count > 2 ||
+		     format->bit_depth != codec.sample_size * 8 ||
+		     (format->channel_layout !=
+			      ADEF_CHANNEL_LAYOUT_UNSPECIFIED &&
+		      format->channel_layout !=
+			      adef_channel_layout_default(
+				      format->channel_count));
+	writer->header_size =
+		extensible ? WAV_HEADER_EXTENSIBLE_SIZE : WAV_HEADER_SIZE;
+
+	/* Page-aligned write buffer, starting with the header so that the
+	 * writes are aligned in the file */
+	page_size = sysconf(_SC_PAGESIZE);
+	flush_size = ADEF_WAV_WRITER_DEFAULT_FLUSH_SIZE;
+	if (config != NULL && config->flush_size != 0)
+		flush_size = config->flush_size;
+	writer->buf_size =
+		(flush_size + page_size - 1) / page_size * page_size;
+	ret = posix_memalign(
+		(void **)&writer->buf, page_size, writer->buf_size);
+	if (ret != 0) {
+		writer->buf = NULL;
+		ret = -ret;
+		goto error;
+	}
+	build_header(writer, 0);
+	memcpy(writer->buf, writer->header, writer->header_size);
+	writer->buf_len = writer->header_size;
+
+	if (config != NULL && config->checkpoint_size != 0) {
+		writer->checkpoint_size = config->checkpoint_size;
+		writer->next_checkpoint = config->checkpoint_size;
+	}
+
+	writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (writer->fd < 0) {
+		ret = -errno;
+		ULOG_ERRNO("open('%s')", -ret, path);
+		goto error;
+	}
+
+	/* Preallocation (optional, not supported by all file systems) */
+	if (config != NULL && config->prealloc_size != 0) {
+		if (fallocate(writer->fd,
+			      FALLOC_FL_KEEP_SIZE,
+			      0,
+			      config->prealloc_size) == 0)
+			writer->prealloc = true;
+		else
+			ULOGW("%s: fallocate: %s", __func__, strerror(errno));
+	}
+
+	*ret_obj = writer;
+	return 0;
+
+error:
+	if (writer->fd >= 0)
+		close(writer->fd);
+	free(writer->buf);
+	free(writer);
+	return ret;
+}
+
+
+int adef_wav_writer_destroy(struct adef_wav_writer *writer)
+{
+	int ret, err;
+
+	if (writer == NULL)
+		return 0;
+
+	ret = flush_buffer(writer);
+	/* Pad byte of odd-sized data chunks */
+	if (ret == 0 && (writer->data_size & 1)) {
+		writer->buf[writer->buf_len++] = 0;
+		ret = flush_buffer(writer);
+	}
+	if (ret == 0)
+		ret = update_header(writer, writer->data_size);
+	if (ret == 0 && writer->prealloc &&
+	    ftruncate(writer->fd, writer->file_size) < 0) {
+		ret = -errno;
+		ULOG_ERRNO("ftruncate", -ret);
+	}
+	if (close(writer->fd) < 0) {
+		err = -errno;
+		ULOG_ERRNO("close", -err);
+		if (ret == 0)
+			ret = err;
+	}
+	free(writer->buf);
+	free(writer);
+
+	return ret;
+}
+
+
+/* Copy interleaved data to the write buffer, writing the full buffer
+ * directly along with large data */
+static int write_interleaved(struct adef_wav_writer *writer,
+			     const uint8_t *data,
+			     size_t len)
+{
+	int ret;
+	size_t total, direct;
+	struct iovec iov[2];
+
+	total = writer->buf_len + len;
+	if (total >= writer->buf_size) {
+		/* Vectored write of a multiple of the buffer size */
+		direct = total - total % writer->buf_size;
+		iov[0].iov_base = writer->buf;
+		iov[0].iov_len = writer->buf_len;
+		iov[1].iov_base = (void *)data;
+		iov[1].iov_len = direct - writer->buf_len;
+		ret = write_vec(writer->fd, iov, 2);
+		if (ret < 0)
+			return ret;
+		writer->file_size += direct;
+		data += direct - writer->buf_len;
+		len -= direct - writer->buf_len;
+		writer->buf_len = 0;
+	}
+	memcpy(writer->buf + writer->buf_len, data, len);
+	writer->buf_len += len;
+	return 0;
+}
+
+
+/* Interleave planar data into the write buffer; a frame which does not
+ * fit in the buffer is split across the flush, so that only full buffers
+ * are written, as for interleaved data */
+static int write_planar(struct adef_wav_writer *writer,
+			const struct adef_pcm_buffer *buf)
+{
+	int ret;
+	const uint8_t *planes[ADEF_PCM_MAX_CHANNELS];
+	uint8_t frame[ADEF_PCM_MAX_CHANNELS * sizeof(uint32_t)];
+	size_t stride, frames, count, room, sample_size = writer->sample_size;
+	unsigned int channels = writer->format.channel_count;
+	uint8_t *dst;
+
+	for (unsigned int ch = 0; ch < channels; ch++) {
+		planes[ch] = adef_pcm_buffer_channel(
+			buf, &writer->format, sample_size, ch, &stride);
+	}
+
+	for (frames = buf->frames; frames > 0; frames -= count) {
+		room = writer->buf_size - writer->buf_len;
+		if (room < writer->frame_size) {
+			for (unsigned int ch = 0; ch < channels; ch++) {
+				memcpy(frame + ch * sample_size,
+				       planes[ch],
+				       sample_size);
+				planes[ch] += sample_size;
+			}
+			memcpy(writer->buf + writer->buf_len, frame, room);
+			writer->buf_len += room;
+			ret = flush_buffer(writer);
+			if (ret < 0)
+				return ret;
+			memcpy(writer->buf,
+			       frame + room,
+			       writer->frame_size - room);
+			writer->buf_len = writer->frame_size - room;
+			count = 1;
+			continue;
+		}
+		count = room / writer->frame_size;
+		if (count > frames)
+			count = frames;
+		dst = writer->buf + writer->buf_len;
+		for (unsigned int ch = 0; ch < channels; ch++) {
+			uint8_t *d = dst + ch * sample_size;
+			for (size_t i = 0; i < count; i++) {
+				memcpy(d, planes[ch], sample_size);
+				d += writer->frame_size;
+				planes[ch] += sample_size;
+			}
+		}
+		writer->buf_len += count * writer->frame_size;
+	}
+	return 0;
+}
+
+
+/* Data size of a checkpoint: the data on disk rounded down to whole
+ * frames, and to an even size (the pad byte of an odd data chunk is only
+ * written on destruction), so that the file is valid if it ends there */
+static uint64_t checkpoint_data_size(struct adef_wav_writer *writer)
+{
+	uint64_t written, unit;
+
+	written = writer->file_size > writer->header_size
+			  ? writer->file_size - writer->header_size
+			  : 0;
+	unit = (writer->frame_size & 1) ? 2 * writer->frame_size
+					: writer->frame_size;
+	return written - written % unit;
+}
+
+
+int adef_wav_writer_write(struct adef_wav_writer *writer,
+			  const struct adef_pcm_buffer *buf)
+{
+	int ret;
+	uint64_t len, written;
+
+	ULOG_ERRNO_RETURN_ERR_IF(writer == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(buf->data == NULL && buf->frames != 0,
+				 EINVAL);
+
+	len = (uint64_t)buf->frames * writer->frame_size;
+	if (len > max_data_size(writer) - writer->data_size)
+		return -EFBIG;
+
+	if (writer->format.pcm.interleaved)
+		ret = write_interleaved(writer, buf->data, len);
+	else
+		ret = write_planar(writer, buf);
+	if (ret < 0)
+		return ret;
+	writer->data_size += len;
+
+	/* Periodic checkpoint, on the data already written */
+	written = checkpoint_data_size(writer);
+	if (writer->checkpoint_size != 0 &&
+	    written >= writer->next_checkpoint) {
+		ret = update_header(writer, written);
+		if (ret < 0)
+			return ret;
+		writer->next_checkpoint = written + writer->checkpoint_size;
+	}
+
+	return 0;
+}
+
+
+int adef_wav_writer_checkpoint(struct adef_wav_writer *writer)
+{
+	int ret;
+	uint64_t written;
+
+	ULOG_ERRNO_RETURN_ERR_IF(writer == NULL, EINVAL);
+
+	ret = flush_buffer(writer);
+	if (ret < 0)
+		return ret;
+	written = checkpoint_data_size(writer);
+	ret = update_header(writer, written);
+	if (ret < 0)
+		return ret;
+	if (writer->checkpoint_size != 0)
+		writer->next_checkpoint = written + writer->checkpoint_size;
+
+	return 0;
+}
+
+
+int adef_wav_writer_get_frames(struct adef_wav_writer *writer,
+			       uint64_t *frames)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(writer == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(frames == NULL, EINVAL);
+
+	*frames = writer->data_size / writer->frame_size;
+
+	return 0;
+}
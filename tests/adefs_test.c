@@ -30,6 +30,26 @@
 static CU_SuiteInfo s_suites[] = {
 	{FN("str"), NULL, NULL, g_adef_test_str},
 	{FN("format"), NULL, NULL, g_adef_test_format},
+	{FN("registry"), NULL, NULL, g_adef_test_registry},
+	{FN("convert"), NULL, NULL, g_adef_test_convert},
+	{FN("meter"), NULL, NULL, g_adef_test_meter},
+	{FN("dither"), NULL, NULL, g_adef_test_dither},
+	{FN("mixer"), NULL, NULL, g_adef_test_mixer},
+	{FN("gain"), NULL, NULL, g_adef_test_gain},
+	{FN("float"), NULL, NULL, g_adef_test_float},
+	{FN("frame"), NULL, NULL, g_adef_test_frame},
+	{FN("clock"), NULL, NULL, g_adef_test_clock},
+	{FN("stats"), NULL, NULL, g_adef_test_stats},
+	{FN("caps"), NULL, NULL, g_adef_test_caps},
+	{FN("adts"), NULL, NULL, g_adef_test_adts},
+	{FN("wav"), NULL, NULL, g_adef_test_wav},
+	{FN("cpp"), NULL, NULL, g_adef_test_cpp},
+	{FN("rechunk"), NULL, NULL, g_adef_test_rechunk},
+	{FN("engine"), NULL, NULL, g_adef_test_engine},
+	{FN("alloc"), NULL, NULL, g_adef_test_alloc},
+	{FN("simd"), NULL, NULL, g_adef_test_simd},
+	{FN("biquad"), NULL, NULL, g_adef_test_biquad},
+	{FN("loudness"), NULL, NULL, g_adef_test_loudness},
 
 	CU_SUITE_INFO_NULL,
 };
@@ -28,20 +28,51 @@
 #define _ADEFS_TEST_H_
 
 #include <audio-defs/adefs.h>
+#include <audio-defs/adefs_pcm.h>
 
 #include <CUnit/Automated.h>
 #include <CUnit/Basic.h>
 #include <CUnit/CUnit.h>
 
 #include <errno.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define FN(_name) (char *)_name
 
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
 
+
+extern CU_TestInfo g_adef_test_convert[];
+extern CU_TestInfo g_adef_test_dither[];
+extern CU_TestInfo g_adef_test_float[];
+extern CU_TestInfo g_adef_test_frame[];
+extern CU_TestInfo g_adef_test_clock[];
+extern CU_TestInfo g_adef_test_stats[];
+extern CU_TestInfo g_adef_test_caps[];
+extern CU_TestInfo g_adef_test_adts[];
+extern CU_TestInfo g_adef_test_wav[];
+extern CU_TestInfo g_adef_test_cpp[];
+extern CU_TestInfo g_adef_test_rechunk[];
+extern CU_TestInfo g_adef_test_engine[];
+extern CU_TestInfo g_adef_test_alloc[];
+extern CU_TestInfo g_adef_test_simd[];
+extern CU_TestInfo g_adef_test_biquad[];
+extern CU_TestInfo g_adef_test_loudness[];
+extern CU_TestInfo g_adef_test_gain[];
+extern CU_TestInfo g_adef_test_meter[];
+extern CU_TestInfo g_adef_test_mixer[];
 extern CU_TestInfo g_adef_test_str[];
 extern CU_TestInfo g_adef_test_format[];
+extern CU_TestInfo g_adef_test_registry[];
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
 
 
 #endif /* _ADEFS_TEST_H_ */
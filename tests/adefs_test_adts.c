@@ -0,0 +1,203 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <audio-defs/adefs_adts.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "adefs_test.h"
+
+
+#define TEST_FRAMES 3000
+
+
+struct test_frame {
+	uint64_t offset;
+	uint64_t timestamp;
+	uint32_t samples;
+};
+
+
+static void write_header(uint8_t *p, unsigned int length, unsigned int blocks)
+{
+	/* MPEG-4, no CRC, AAC LC, 48000 Hz, stereo */
+	p[0] = 0xff;
+	p[1] = 0xf1;
+	p[2] = (1 << 6) | (3 << 2);
+	p[3] = (2 << 6) | (length >> 11);
+	p[4] = (length >> 3) & 0xff;
+	p[5] = ((length & 0x7) << 5) | 0x1f;
+	p[6] = 0xfc | (blocks - 1);
+}
+
+
+/* Generate an ADTS file with pseudo-random payloads (including fake
+ * syncwords), some invalid data between frames, and a truncated last
+ * frame */
+static size_t generate(int fd, struct test_frame *frames)
+{
+	uint8_t buf[1024];
+	uint32_t seed = 1;
+	uint64_t offset = 0, timestamp = 0;
+	unsigned int length, blocks;
+	ssize_t res;
+
+	for (unsigned int i = 0; i <= TEST_FRAMES; i++) {
+		seed = seed * 1664525 + 1013904223;
+		length = 100 + (seed >> 8) % 700;
+		blocks = i % 100 == 99 ? 2 : 1;
+		write_header(buf, length, blocks);
+		for (unsigned int j = 7; j < length; j++) {
+			seed = seed * 1664525 + 1013904223;
+			buf[j] = seed >> 24;
+		}
+		buf[length / 2] = 0xff;
+		buf[length / 2 + 1] = 0xf1;
+		if (i == TEST_FRAMES) {
+			/* Truncated frame */
+			length /= 2;
+		} else {
+			frames[i].offset = offset;
+			frames[i].timestamp = timestamp;
+			frames[i].samples = blocks * 1024;
+			timestamp += blocks * 1024;
+		}
+		if (i % 500 == 250) {
+			/* Invalid data (counted in the previous frame) */
+			memset(buf + length, 0x5a, 100);
+			length += 100;
+		}
+		res = write(fd, buf, length);
+		CU_ASSERT_EQUAL(res, length);
+		offset += length;
+	}
+
+	return offset;
+}
+
+
+static void test_adts_index(void)
+{
+	int ret, fd;
+	char path[] = "/tmp/adefs_test_XXXXXX";
+	char index_path[64], index1_path[64];
+	struct test_frame *frames;
+	struct adef_adts_index *index = NULL;
+	struct adef_adts_frame frame;
+	struct adef_format format;
+	uint64_t count, duration;
+	uint8_t header[7];
+	uint8_t buf1[4096], buf2[4096];
+	ssize_t len1, len2;
+	FILE *f1, *f2;
+
+	frames = calloc(TEST_FRAMES, sizeof(*frames));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(frames);
+	fd = mkstemp(path);
+	CU_ASSERT_FATAL(fd >= 0);
+	generate(fd, frames);
+	snprintf(index_path, sizeof(index_path), "%s.idx", path);
+	snprintf(index1_path, sizeof(index1_path), "%s.idx1", path);
+
+	/* Multithreaded and single-threaded scans give the same index */
+	ret = adef_adts_index_build(path, index_path, 4);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_adts_index_build(path, index1_path, 1);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	f1 = fopen(index_path, "rb");
+	f2 = fopen(index1_path, "rb");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(f1);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(f2);
+	do {
+		len1 = fread(buf1, 1, sizeof(buf1), f1);
+		len2 = fread(buf2, 1, sizeof(buf2), f2);
+		CU_ASSERT_EQUAL(len1, len2);
+		CU_ASSERT_EQUAL(memcmp(buf1, buf2, len1), 0);
+	} while (len1 > 0 && len1 == len2);
+	fclose(f1);
+	fclose(f2);
+
+	ret = adef_adts_index_open(index_path, path, &index);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_adts_index_get_info(index, &format, &count, &duration);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(
+		adef_format_cmp(&format, &adef_aac_lc_16b_48000hz_stereo_adts));
+	CU_ASSERT_EQUAL(count, TEST_FRAMES);
+	CU_ASSERT_EQUAL(duration,
+			frames[TEST_FRAMES - 1].timestamp +
+				frames[TEST_FRAMES - 1].samples);
+
+	/* Seeks */
+	for (unsigned int i = 0; i < TEST_FRAMES; i++) {
+		ret = adef_adts_index_seek(
+			index, frames[i].timestamp + (i % 3) * 500, &frame);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_EQUAL(frame.offset, frames[i].offset);
+		CU_ASSERT_EQUAL(frame.timestamp, frames[i].timestamp);
+		CU_ASSERT_EQUAL(frame.samples, frames[i].samples);
+		if (i < TEST_FRAMES - 1) {
+			CU_ASSERT_EQUAL(frame.size,
+					frames[i + 1].offset -
+						frames[i].offset);
+		}
+	}
+	ret = adef_adts_index_seek(index, 1000000, &frame);
+	CU_ASSERT_EQUAL(ret, 0);
+	len1 = pread(fd, header, sizeof(header), frame.offset);
+	CU_ASSERT_EQUAL(len1, sizeof(header));
+	CU_ASSERT_EQUAL(header[0], 0xff);
+	CU_ASSERT_EQUAL(header[1], 0xf1);
+	ret = adef_adts_index_seek(index, duration, &frame);
+	CU_ASSERT_EQUAL(ret, -ERANGE);
+	adef_adts_index_destroy(index);
+
+	/* Stale and invalid indexes */
+	len1 = write(fd, header, 1);
+	CU_ASSERT_EQUAL(len1, 1);
+	ret = adef_adts_index_open(index_path, path, &index);
+	CU_ASSERT_EQUAL(ret, -ESTALE);
+	ret = adef_adts_index_open(path, NULL, &index);
+	CU_ASSERT_EQUAL(ret, -EPROTO);
+	ret = adef_adts_index_build(index_path, index1_path, 2);
+	CU_ASSERT_EQUAL(ret, -EPROTO);
+	ret = adef_adts_index_open(NULL, NULL, &index);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	close(fd);
+	unlink(path);
+	unlink(index_path);
+	unlink(index1_path);
+	free(frames);
+}
+
+
+CU_TestInfo g_adef_test_adts[] = {
+	{FN("adts-index"), &test_adts_index},
+
+	CU_TEST_INFO_NULL,
+};
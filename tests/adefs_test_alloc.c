@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+static void check_layout(const struct adef_format *format,
+			 size_t frames,
+			 unsigned int flags)
+{
+	int ret;
+	struct adef_pcm_buffer buf;
+	size_t sample_size = adef_pcm_get_sample_size(format);
+	size_t plane_size, plane_stride;
+	unsigned int planes;
+	uint8_t *plane;
+	bool zero = true;
+
+	ret = adef_pcm_buffer_alloc(format, frames, flags, &buf);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(buf.frames, frames);
+	CU_ASSERT_EQUAL((uintptr_t)buf.data % ADEF_PCM_BUFFER_ALIGN, 0);
+
+	if (format->pcm.interleaved) {
+		CU_ASSERT_EQUAL(buf.plane_stride, 0);
+		planes = 1;
+		plane_size = frames * sample_size * format->channel_count;
+		plane_stride = 0;
+	} else {
+		planes = format->channel_count;
+		plane_size = frames * sample_size;
+		plane_stride = buf.plane_stride;
+		CU_ASSERT_EQUAL(plane_stride % ADEF_PCM_BUFFER_ALIGN, 0);
+		CU_ASSERT_TRUE(plane_stride >=
+			       plane_size + ADEF_PCM_BUFFER_PADDING);
+	}
+
+	/* Zero-filled, padding included, and writable */
+	for (unsigned int p = 0; p < planes; p++) {
+		plane = (uint8_t *)buf.data + p * plane_stride;
+		for (size_t i = 0; i < plane_size + ADEF_PCM_BUFFER_PADDING;
+		     i++) {
+			if (plane[i] != 0)
+				zero = false;
+		}
+		memset(plane, 0x5a, plane_size + ADEF_PCM_BUFFER_PADDING);
+	}
+	CU_ASSERT_TRUE(zero);
+
+	ret = adef_pcm_buffer_free(&buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_PTR_NULL(buf.data);
+	CU_ASSERT_EQUAL(buf.frames, 0);
+}
+
+
+static void test_alloc_layout(void)
+{
+	struct adef_format format = adef_pcm_16b_48000hz_stereo;
+
+	check_layout(&format, 1000, 0);
+	check_layout(&format, 0, 0);
+	format.pcm.interleaved = false;
+	check_layout(&format, 1000, 0);
+	check_layout(&format, 1, 0);
+	/* Packed 24-bit samples */
+	format.bit_depth = 24;
+	format.pcm.container_width = 24;
+	format.channel_count = 6;
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_5_1;
+	format.pcm.interleaved = false;
+	check_layout(&format, 1023, 0);
+	format = adef_pcm_f32_96000hz_stereo;
+	format.pcm.interleaved = false;
+	check_layout(&format, 480, 0);
+
+	/* Long ring buffer, on huge pages if available */
+	check_layout(&format, 96000 * 10, ADEF_PCM_ALLOC_HUGE_PAGES);
+}
+
+
+static void test_alloc_resize(void)
+{
+	int ret;
+	struct adef_format format = adef_pcm_16b_44100hz_stereo;
+	struct adef_pcm_buffer buf;
+	const int16_t *plane;
+	int16_t *data;
+	bool ok = true;
+
+	format.channel_count = 3;
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	format.pcm.interleaved = false;
+	ret = adef_pcm_buffer_alloc(&format, 100, 0, &buf);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	for (unsigned int c = 0; c < 3; c++) {
+		data = (int16_t *)((uint8_t *)buf.data + c * buf.plane_stride);
+		for (size_t i = 0; i < 100; i++)
+			data[i] = (int16_t)(c * 1000 + i);
+	}
+
+	/* Larger: samples kept, new samples zero-filled */
+	ret = adef_pcm_buffer_resize(&format, 3000, &buf);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(buf.frames, 3000);
+	CU_ASSERT_EQUAL((uintptr_t)buf.data % ADEF_PCM_BUFFER_ALIGN, 0);
+	CU_ASSERT_TRUE(buf.plane_stride >= 3000 * 2 + ADEF_PCM_BUFFER_PADDING);
+	for (unsigned int c = 0; c < 3; c++) {
+		plane = (const int16_t *)((const uint8_t *)buf.data +
+					  c * buf.plane_stride);
+		for (size_t i = 0; i < 3000; i++) {
+			if (plane[i] != ((i < 100) ? (int16_t)(c * 1000 + i)
+						   : 0))
+				ok = false;
+		}
+	}
+	CU_ASSERT_TRUE(ok);
+
+	/* Smaller */
+	ret = adef_pcm_buffer_resize(&format, 10, &buf);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(buf.frames, 10);
+	for (unsigned int c = 0; c < 3; c++) {
+		plane = (const int16_t *)((const uint8_t *)buf.data +
+					  c * buf.plane_stride);
+		for (size_t i = 0; i < 10; i++) {
+			if (plane[i] != (int16_t)(c * 1000 + i))
+				ok = false;
+		}
+	}
+	CU_ASSERT_TRUE(ok);
+
+	/* Other layout */
+	ret = adef_pcm_buffer_resize(&adef_pcm_16b_44100hz_stereo, 10, &buf);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	CU_ASSERT_EQUAL(buf.frames, 10);
+
+	ret = adef_pcm_buffer_free(&buf);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+static void test_alloc_invalid(void)
+{
+	int ret;
+	struct adef_pcm_buffer buf = {0};
+	uint8_t data[2 * ADEF_PCM_BUFFER_ALIGN];
+
+	ret = adef_pcm_buffer_alloc(NULL, 10, 0, &buf);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_buffer_alloc(&adef_pcm_16b_48000hz_stereo, 10, 0, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_buffer_alloc(
+		&adef_aac_lc_16b_48000hz_stereo_raw, 10, 0, &buf);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_buffer_alloc(
+		&adef_pcm_16b_48000hz_stereo, SIZE_MAX / 2, 0, &buf);
+	CU_ASSERT_EQUAL(ret, -ENOMEM);
+
+	/* Not allocated by adef_pcm_buffer_alloc() */
+	ret = adef_pcm_buffer_free(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_buffer_free(&buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	buf.data = data + 1;
+	buf.frames = 10;
+	ret = adef_pcm_buffer_free(&buf);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_buffer_resize(&adef_pcm_16b_48000hz_stereo, 20, &buf);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_buffer_resize(&adef_pcm_16b_48000hz_stereo, 20, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+CU_TestInfo g_adef_test_alloc[] = {
+	{FN("alloc-layout"), &test_alloc_layout},
+	{FN("alloc-resize"), &test_alloc_resize},
+	{FN("alloc-invalid"), &test_alloc_invalid},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,386 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+#define TEST_RATE 48000
+#define TEST_FRAMES 4801
+
+
+/* Magnitude response of a biquad filter at a frequency, in dB */
+static double response_db(const struct adef_pcm_biquad_coefs *c, double freq)
+{
+	double w = 2. * M_PI * freq / TEST_RATE;
+	double nr = c->b0 + c->b1 * cos(w) + c->b2 * cos(2. * w);
+	double ni = -c->b1 * sin(w) - c->b2 * sin(2. * w);
+	double dr = 1. + c->a1 * cos(w) + c->a2 * cos(2. * w);
+	double di = -c->a1 * sin(w) - c->a2 * sin(2. * w);
+
+	return 10. * log10((nr * nr + ni * ni) / (dr * dr + di * di));
+}
+
+
+static void random_s16(int16_t *samples, size_t count, uint32_t seed)
+{
+	for (size_t i = 0; i < count; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		samples[i] = (int16_t)seed;
+	}
+}
+
+
+static void test_biquad_design(void)
+{
+	int ret;
+	struct adef_pcm_biquad_coefs c;
+
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_HIGH_PASS, TEST_RATE, 100.f, 0.7071f, 0.f, &c);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 100.), -3.01, 0.05);
+	CU_ASSERT_TRUE(response_db(&c, 10.) < -35.);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 10000.), 0., 0.05);
+
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_LOW_PASS, TEST_RATE, 1000.f, 0.7071f, 0.f, &c);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 1000.), -3.01, 0.05);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 50.), 0., 0.05);
+	CU_ASSERT_TRUE(response_db(&c, 10000.) < -35.);
+
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_PEAKING, TEST_RATE, 1000.f, 1.f, 6.f, &c);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 1000.), 6., 0.01);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 20.), 0., 0.05);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 20000.), 0., 0.1);
+
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_LOW_SHELF, TEST_RATE, 200.f, 0.7071f, 6.f, &c);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 5.), 6., 0.05);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 200.), 3., 0.05);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 10000.), 0., 0.05);
+
+	ret = adef_pcm_biquad_design(ADEF_PCM_BIQUAD_HIGH_SHELF,
+				     TEST_RATE,
+				     5000.f,
+				     0.7071f,
+				     -6.f,
+				     &c);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 23000.), -6., 0.1);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 5000.), -3., 0.05);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 50.), 0., 0.05);
+
+	/* The quality factor is ignored */
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_DC_BLOCKER, TEST_RATE, 10.f, 0.f, 0.f, &c);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(c.b0 + c.b1, 0.f);
+	CU_ASSERT_EQUAL(c.b2, 0.f);
+	CU_ASSERT_EQUAL(c.a2, 0.f);
+	CU_ASSERT_TRUE(response_db(&c, 0.1) < -35.);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, 1000.), 0., 0.01);
+	CU_ASSERT_DOUBLE_EQUAL(response_db(&c, TEST_RATE / 2), 0., 0.001);
+
+	/* Invalid arguments */
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_LOW_PASS, 0, 1000.f, 0.7071f, 0.f, &c);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_LOW_PASS, TEST_RATE, 0.f, 0.7071f, 0.f, &c);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_design(ADEF_PCM_BIQUAD_LOW_PASS,
+				     TEST_RATE,
+				     TEST_RATE / 2,
+				     0.7071f,
+				     0.f,
+				     &c);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_LOW_PASS, TEST_RATE, 1000.f, 0.f, 0.f, &c);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_PEAKING, TEST_RATE, 1000.f, 1.f, NAN, &c);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_MAX, TEST_RATE, 1000.f, 1.f, 0.f, &c);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_LOW_PASS, TEST_RATE, 1000.f, 1.f, 0.f, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+static void test_biquad_args(void)
+{
+	int ret;
+	struct adef_pcm_biquad *biquad;
+	struct adef_pcm_biquad_coefs c[ADEF_PCM_BIQUAD_MAX_STAGES + 1] = {
+		{.b0 = 1.f},
+	};
+	int16_t samples[16];
+	struct adef_pcm_buffer in = {.data = samples, .frames = 8};
+	struct adef_pcm_buffer out = {.data = samples, .frames = 7};
+
+	ret = adef_pcm_biquad_new(NULL, c, 1, &biquad);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_new(
+		&adef_pcm_16b_48000hz_stereo, NULL, 1, &biquad);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_new(&adef_pcm_16b_48000hz_stereo, c, 0, &biquad);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_new(&adef_pcm_16b_48000hz_stereo,
+				  c,
+				  ADEF_PCM_BIQUAD_MAX_STAGES + 1,
+				  &biquad);
+	CU_ASSERT_EQUAL(ret, -E2BIG);
+	ret = adef_pcm_biquad_new(&adef_aac_lc_16b_48000hz_stereo_raw,
+				  c,
+				  1,
+				  &biquad);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_new(&adef_pcm_16b_48000hz_stereo, c, 1, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	c[1] = c[0];
+	c[1].a1 = INFINITY;
+	ret = adef_pcm_biquad_new(&adef_pcm_16b_48000hz_stereo, c, 2, &biquad);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_pcm_biquad_new(&adef_pcm_16b_48000hz_stereo, c, 1, &biquad);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_biquad_set_coefs(biquad, c, 2);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_set_coefs(biquad, c, 0);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_set_coefs(NULL, c, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_process(biquad, &in, &out);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+	ret = adef_pcm_biquad_process(biquad, NULL, &in);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_process(biquad, &in, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_process(NULL, &in, &in);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_biquad_reset(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Identity filter */
+	random_s16(samples, 16, 42);
+	memcpy(&samples[8], samples, 8 * sizeof(int16_t));
+	out.data = &samples[8];
+	out.frames = 4;
+	in.frames = 4;
+	ret = adef_pcm_biquad_process(biquad, &in, &in);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(memcmp(samples, &samples[8], 8 * sizeof(int16_t)), 0);
+
+	ret = adef_pcm_biquad_destroy(biquad);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_biquad_destroy(NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+/* DC removal and high-pass filtering of a 1 kHz tone with a DC offset */
+static void test_biquad_dc(void)
+{
+	int ret;
+	const struct adef_format *format = &adef_pcm_f32_48000hz_stereo;
+	struct adef_pcm_biquad *biquad;
+	struct adef_pcm_biquad_coefs c[2];
+	float *samples;
+	struct adef_pcm_buffer buf;
+	const size_t frames = TEST_RATE;
+	const size_t tail = TEST_RATE / 4;
+	double sum[2] = {0}, sum_sq[2] = {0};
+
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_DC_BLOCKER, TEST_RATE, 5.f, 0.f, 0.f, &c[0]);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_biquad_design(ADEF_PCM_BIQUAD_HIGH_PASS,
+				     TEST_RATE,
+				     80.f,
+				     0.7071f,
+				     0.f,
+				     &c[1]);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_biquad_new(format, c, 2, &biquad);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	samples = malloc(frames * 2 * sizeof(*samples));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(samples);
+	for (size_t i = 0; i < frames; i++) {
+		float s = 0.5f * sinf(2.f * (float)M_PI * 1000.f * i /
+				      TEST_RATE);
+		samples[2 * i] = 0.25f + s;
+		samples[2 * i + 1] = -0.1f + s;
+	}
+
+	/* Process in buffers of 10 ms */
+	for (size_t f = 0; f < frames; f += TEST_RATE / 100) {
+		buf.data = samples + 2 * f;
+		buf.frames = TEST_RATE / 100;
+		buf.plane_stride = 0;
+		ret = adef_pcm_biquad_process(biquad, &buf, &buf);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	for (size_t i = frames - tail; i < frames; i++) {
+		for (unsigned int c = 0; c < 2; c++) {
+			sum[c] += samples[2 * i + c];
+			sum_sq[c] += samples[2 * i + c] * samples[2 * i + c];
+		}
+	}
+	for (unsigned int c = 0; c < 2; c++) {
+		CU_ASSERT_DOUBLE_EQUAL(sum[c] / tail, 0., 1e-3);
+		CU_ASSERT_DOUBLE_EQUAL(
+			sqrt(sum_sq[c] / tail), 0.5 / sqrt(2.), 0.005);
+	}
+
+	free(samples);
+	ret = adef_pcm_biquad_destroy(biquad);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+/* Filtering in one call, in chunks, and with planar samples give the same
+ * result, for channels spanning several vector lane groups */
+static void test_biquad_state(void)
+{
+	int ret;
+	struct adef_format format = adef_pcm_16b_48000hz_stereo;
+	struct adef_format planar;
+	const unsigned int channels = 11;
+	struct adef_pcm_biquad *biquad[3];
+	struct adef_pcm_biquad_coefs c[3];
+	int16_t *in, *ref, *out, *tmp;
+	struct adef_pcm_buffer in_buf, ref_buf, buf;
+	size_t count = TEST_FRAMES * channels;
+	unsigned int mismatches = 0;
+
+	format.channel_count = channels;
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	planar = format;
+	planar.pcm.interleaved = false;
+
+	ret = adef_pcm_biquad_design(ADEF_PCM_BIQUAD_HIGH_PASS,
+				     TEST_RATE,
+				     100.f,
+				     0.7071f,
+				     0.f,
+				     &c[0]);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_biquad_design(
+		ADEF_PCM_BIQUAD_PEAKING, TEST_RATE, 3000.f, 2.f, 9.f, &c[1]);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_biquad_new(&format, c, 2, &biquad[0]);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_biquad_new(&format, c, 2, &biquad[1]);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_biquad_new(&planar, c, 2, &biquad[2]);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	in = malloc(count * sizeof(*in));
+	ref = malloc(count * sizeof(*ref));
+	out = malloc(count * sizeof(*out));
+	tmp = malloc(count * sizeof(*tmp));
+	CU_ASSERT_FATAL(in && ref && out && tmp);
+	random_s16(in, count, 1234);
+	for (size_t i = 0; i < count; i++)
+		in[i] /= 4;
+
+	/* Reference: one call */
+	in_buf = (struct adef_pcm_buffer){.data = in, .frames = TEST_FRAMES};
+	ref_buf = (struct adef_pcm_buffer){.data = ref, .frames = TEST_FRAMES};
+	ret = adef_pcm_biquad_process(biquad[0], &in_buf, &ref_buf);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* In place, in chunks of various sizes; setting the coefficients
+	 * keeps the state */
+	memcpy(out, in, count * sizeof(*out));
+	for (size_t f = 0, n = 1; f < TEST_FRAMES; f += n, n = n * 3 + 1) {
+		if (n > TEST_FRAMES - f)
+			n = TEST_FRAMES - f;
+		buf.data = out + f * channels;
+		buf.frames = n;
+		buf.plane_stride = 0;
+		if (f == 1) {
+			ret = adef_pcm_biquad_set_coefs(biquad[1], c, 2);
+			CU_ASSERT_EQUAL(ret, 0);
+		}
+		ret = adef_pcm_biquad_process(biquad[1], &buf, &buf);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	CU_ASSERT_EQUAL(memcmp(out, ref, count * sizeof(*out)), 0);
+
+	/* Planar */
+	for (size_t i = 0; i < TEST_FRAMES; i++) {
+		for (unsigned int ch = 0; ch < channels; ch++)
+			tmp[ch * TEST_FRAMES + i] = in[i * channels + ch];
+	}
+	buf = (struct adef_pcm_buffer){.data = tmp, .frames = TEST_FRAMES};
+	ret = adef_pcm_biquad_process(biquad[2], &buf, &buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (size_t i = 0; i < TEST_FRAMES; i++) {
+		for (unsigned int ch = 0; ch < channels; ch++) {
+			mismatches += tmp[ch * TEST_FRAMES + i] !=
+				      ref[i * channels + ch];
+		}
+	}
+	CU_ASSERT_EQUAL(mismatches, 0);
+
+	/* Reset: same output again */
+	ret = adef_pcm_biquad_reset(biquad[0]);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_biquad_process(biquad[0], &in_buf, &in_buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(memcmp(in, ref, count * sizeof(*in)), 0);
+
+	for (unsigned int i = 0; i < 3; i++) {
+		ret = adef_pcm_biquad_destroy(biquad[i]);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	free(in);
+	free(ref);
+	free(out);
+	free(tmp);
+}
+
+
+CU_TestInfo g_adef_test_biquad[] = {
+	{FN("biquad-design"), &test_biquad_design},
+	{FN("biquad-args"), &test_biquad_args},
+	{FN("biquad-dc"), &test_biquad_dc},
+	{FN("biquad-state"), &test_biquad_state},
+
+	CU_TEST_INFO_NULL,
+};
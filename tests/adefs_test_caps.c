@@ -0,0 +1,267 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+static void test_caps_from_str(void)
+{
+	int ret;
+	struct adef_caps caps;
+	const char *valid[] = {
+		"PCM",
+		"*",
+		"pcm/1-2/16/8000-48000/INTERLEAVED/SIGNED/LE/*",
+		"PCM/1,2,6/16,24-32/*/PLANAR/FLOAT,SIGNED/BE,LE/*/*/0,32",
+		"PCM/2/16/48000/INTERLEAVED/SIGNED/LE/RAW/STEREO,0x3/16",
+		"AAC_LC/1-8/16/*/*/*/*/ADTS,RAW",
+	};
+	const char *invalid[] = {
+		"",
+		"FOO",
+		"PCM/a",
+		"PCM/2-1",
+		"PCM/1-",
+		"PCM/-1",
+		"PCM/*/*/*/SIDEWAYS",
+		"PCM/*/*/*/*/*/*/*/5_1-7_1",
+		"PCM/*/*/*/*/*/*/*/*/*/*",
+		"PCM/1,2,3,4,5,6,7,8,9",
+		"AAC_LC/*/*/*/*/*/*/UNKNOWN",
+	};
+
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(valid); i++) {
+		ret = adef_caps_from_str(valid[i], &caps);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(invalid); i++) {
+		ret = adef_caps_from_str(invalid[i], &caps);
+		CU_ASSERT(ret < 0);
+	}
+	ret = adef_caps_from_str(NULL, &caps);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_caps_from_str("PCM", NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+static void test_caps_intersect(void)
+{
+	int ret;
+	struct adef_caps caps;
+	struct adef_format format;
+	struct adef_format list[24];
+	const unsigned int rates[] = {
+		8000, 11025, 12000, 16000, 22050, 24000,
+		32000, 44100, 48000, 64000, 88200, 96000};
+
+	/* Equivalent of a 24 entries caps array */
+	for (unsigned int i = 0; i < 12; i++) {
+		list[2 * i] = adef_pcm_16b_48000hz_mono;
+		list[2 * i].sample_rate = rates[i];
+		list[2 * i + 1] = adef_pcm_16b_48000hz_stereo;
+		list[2 * i + 1].sample_rate = rates[i];
+	}
+	ret = adef_caps_from_str("PCM/1-2/16/8000-48000/INTERLEAVED/SIGNED/LE",
+				 &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	for (unsigned int i = 0; i < 24; i++) {
+		CU_ASSERT_EQUAL(adef_caps_intersect(&list[i], &caps),
+				list[i].sample_rate <= 48000);
+	}
+	CU_ASSERT_FALSE(adef_caps_intersect(&adef_pcm_16b_48000hz_mono, NULL));
+	CU_ASSERT_FALSE(adef_caps_intersect(NULL, &caps));
+	format = adef_pcm_16b_48000hz_stereo;
+	format.pcm.little_endian = false;
+	CU_ASSERT_FALSE(adef_caps_intersect(&format, &caps));
+	format = adef_pcm_16b_48000hz_stereo;
+	format.bit_depth = 24;
+	CU_ASSERT_FALSE(adef_caps_intersect(&format, &caps));
+	CU_ASSERT_FALSE(adef_caps_intersect(&adef_aac_lc_16b_48000hz_stereo_raw,
+					    &caps));
+
+	/* Any format */
+	ret = adef_caps_from_str("*", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_TRUE(adef_caps_intersect(&adef_pcm_f32_96000hz_mono, &caps));
+	CU_ASSERT_TRUE(adef_caps_intersect(&adef_aac_lc_16b_48000hz_stereo_raw,
+					   &caps));
+
+	/* Containers: 0 matches packed samples */
+	ret = adef_caps_from_str("PCM/*/16,24/*/*/SIGNED/LE/*/*/0", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	format = adef_pcm_16b_48000hz_stereo;
+	CU_ASSERT_TRUE(adef_caps_intersect(&format, &caps));
+	format.pcm.container_width = 16;
+	CU_ASSERT_TRUE(adef_caps_intersect(&format, &caps));
+	format.bit_depth = 24;
+	format.pcm.container_width = 32;
+	CU_ASSERT_FALSE(adef_caps_intersect(&format, &caps));
+	ret = adef_caps_from_str("PCM/*/16,24/*/*/SIGNED/LE/*/*/32", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_TRUE(adef_caps_intersect(&format, &caps));
+
+	/* Layouts, and PCM fields ignored for AAC */
+	ret = adef_caps_from_str(
+		"AAC_LC/2/16/*/PLANAR/UNSIGNED/BE/ADTS/STEREO,0", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	format = adef_aac_lc_16b_48000hz_stereo_raw;
+	CU_ASSERT_FALSE(adef_caps_intersect(&format, &caps));
+	format.aac.data_format = ADEF_AAC_DATA_FORMAT_ADTS;
+	CU_ASSERT_TRUE(adef_caps_intersect(&format, &caps));
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_STEREO;
+	CU_ASSERT_TRUE(adef_caps_intersect(&format, &caps));
+
+	/* An unspecified layout is the default layout of the channel count,
+	 * on both sides: legacy format string without a layout */
+	ret = adef_caps_from_str(
+		"PCM/2/16/48000/INTERLEAVED/SIGNED/LE/*/STEREO", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_format_from_str(
+		"PCM/2/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", &format);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_EQUAL(format.channel_layout, ADEF_CHANNEL_LAYOUT_UNSPECIFIED);
+	CU_ASSERT_TRUE(adef_caps_intersect(&format, &caps));
+	format.channel_count = 1;
+	CU_ASSERT_FALSE(adef_caps_intersect(&format, &caps));
+
+	/* Unspecified layout caps and builtin format */
+	ret = adef_caps_from_str("PCM/*/*/*/*/*/*/*/0", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	CU_ASSERT_TRUE(
+		adef_caps_intersect(&adef_pcm_16b_48000hz_stereo, &caps));
+	format = adef_pcm_16b_48000hz_stereo;
+	format.channel_layout = ADEF_CHANNEL_FRONT_LEFT;
+	format.channel_count = 1;
+	CU_ASSERT_FALSE(adef_caps_intersect(&format, &caps));
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	CU_ASSERT_TRUE(adef_caps_intersect(&format, &caps));
+}
+
+
+static void test_caps_fixate(void)
+{
+	int ret;
+	struct adef_caps caps;
+	struct adef_format format, preferred;
+
+	/* Default preferred values */
+	ret = adef_caps_from_str("PCM", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_caps_fixate(&caps, NULL, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	preferred = adef_pcm_16b_48000hz_stereo;
+	preferred.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	CU_ASSERT_TRUE(adef_format_cmp(&format, &preferred));
+
+	/* Nearest value in the first range */
+	ret = adef_caps_from_str("PCM/1/16/8000-32000,48000", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_caps_fixate(&caps, NULL, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(format.channel_count, 1);
+	CU_ASSERT_EQUAL(format.sample_rate, 48000);
+	ret = adef_caps_from_str("PCM/1/16/8000-32000,44100", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_caps_fixate(&caps, NULL, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(format.sample_rate, 32000);
+
+	/* Preference order of lists */
+	ret = adef_caps_from_str("PCM/*/24,16/22050,44100/PLANAR,INTERLEAVED",
+				 &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_caps_fixate(&caps, NULL, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(format.bit_depth, 16);
+	CU_ASSERT_EQUAL(format.sample_rate, 22050);
+	CU_ASSERT_TRUE(format.pcm.interleaved);
+	CU_ASSERT_TRUE(adef_caps_intersect(&format, &caps));
+
+	/* Preferred format */
+	preferred = adef_pcm_16b_44100hz_mono;
+	ret = adef_caps_fixate(&caps, &preferred, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(format.channel_count, 1);
+	CU_ASSERT_EQUAL(format.sample_rate, 44100);
+
+	/* Floating-point samples and layouts */
+	ret = adef_caps_from_str("PCM/*/*/*/*/FLOAT/*/*/5_1", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_caps_fixate(&caps, NULL, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(format.pcm.float_val);
+	CU_ASSERT_EQUAL(format.bit_depth, 32);
+	CU_ASSERT_EQUAL(format.channel_count, 6);
+	CU_ASSERT_EQUAL(format.channel_layout, ADEF_CHANNEL_LAYOUT_5_1);
+
+	/* Equivalent unspecified and default layouts */
+	ret = adef_caps_from_str("PCM/*/*/*/*/*/*/*/STEREO", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	preferred = adef_pcm_16b_48000hz_stereo;
+	preferred.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	ret = adef_caps_fixate(&caps, &preferred, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(format.channel_layout, ADEF_CHANNEL_LAYOUT_STEREO);
+	CU_ASSERT_EQUAL(format.channel_count, 2);
+	ret = adef_caps_from_str("PCM/*/*/*/*/*/*/*/0", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_caps_fixate(&caps, &adef_pcm_16b_48000hz_stereo, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(format.channel_layout,
+			ADEF_CHANNEL_LAYOUT_UNSPECIFIED);
+	CU_ASSERT_EQUAL(format.channel_count, 2);
+
+	/* AAC */
+	ret = adef_caps_from_str("AAC_LC/*/*/*/*/*/*/ADTS,RAW", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_caps_fixate(&caps, &adef_pcm_16b_44100hz_mono, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(format.encoding, ADEF_ENCODING_AAC_LC);
+	CU_ASSERT_EQUAL(format.aac.data_format, ADEF_AAC_DATA_FORMAT_RAW);
+	CU_ASSERT_EQUAL(format.sample_rate, 44100);
+
+	/* Impossible formats */
+	ret = adef_caps_from_str("PCM/*/16/*/*/FLOAT", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_caps_fixate(&caps, NULL, &format);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_caps_from_str("PCM/1/*/*/*/*/*/*/STEREO", &caps);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_caps_fixate(&caps, NULL, &format);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_caps_fixate(NULL, NULL, &format);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+CU_TestInfo g_adef_test_caps[] = {
+	{FN("caps-from-str"), &test_caps_from_str},
+	{FN("caps-intersect"), &test_caps_intersect},
+	{FN("caps-fixate"), &test_caps_fixate},
+
+	CU_TEST_INFO_NULL,
+};
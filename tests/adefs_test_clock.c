@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+#define TEST_TIMESCALE 48000
+#define TEST_DURATION 1024
+#define TEST_START 5000000.
+#define TEST_DRIFT 1.00005
+
+
+/* Capture timestamp of a frame, with drift and pseudo-random jitter in
+ * the [-200, 200] microseconds range */
+static uint64_t capture_time(uint64_t timestamp, uint32_t *seed)
+{
+	double t = (double)timestamp * 1000000. / TEST_TIMESCALE;
+
+	*seed = *seed * 1664525 + 1013904223;
+	return llround(TEST_START + t * TEST_DRIFT +
+		       (double)(*seed >> 8) / (1 << 24) * 400. - 200.);
+}
+
+
+static void test_clock_mapper_fit(void)
+{
+	int ret;
+	struct adef_clock_mapper mapper;
+	struct adef_frame_info info = {.timescale = TEST_TIMESCALE};
+	uint32_t seed = 1;
+	unsigned int outliers = 0;
+	uint64_t monotonic, timestamp;
+	double expected;
+
+	ret = adef_clock_mapper_init(&mapper, 1000, 1000);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_clock_mapper_to_monotonic(
+		&mapper, 0, TEST_TIMESCALE, &monotonic);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+
+	for (unsigned int i = 0; i < 3000; i++) {
+		info.timestamp = (uint64_t)i * TEST_DURATION;
+		info.capture_timestamp = capture_time(info.timestamp, &seed);
+		info.index = i;
+		/* Isolated late samples (e.g. scheduling delays) */
+		if (i % 37 == 36) {
+			info.capture_timestamp += 20000;
+			outliers++;
+		}
+		ret = adef_clock_mapper_update(&mapper, &info);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	CU_ASSERT_EQUAL(mapper.accepted, 3000 - outliers);
+	CU_ASSERT_EQUAL(mapper.rejected, outliers);
+	CU_ASSERT_EQUAL(mapper.restarts, 0);
+	CU_ASSERT_DOUBLE_EQUAL(mapper.slope, TEST_DRIFT, 5e-6);
+
+	/* Conversions */
+	info.timestamp = 3000 * TEST_DURATION;
+	expected = TEST_START + 64000000. * TEST_DRIFT;
+	ret = adef_clock_mapper_to_monotonic(
+		&mapper, info.timestamp, TEST_TIMESCALE, &monotonic);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL((double)monotonic, expected, 50.);
+	ret = adef_clock_mapper_to_media(
+		&mapper, monotonic, TEST_TIMESCALE, &timestamp);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL((double)timestamp, (double)info.timestamp, 1.);
+
+	/* Other time scale */
+	ret = adef_clock_mapper_to_monotonic(
+		&mapper, 64000000, 1000000, &monotonic);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL((double)monotonic, expected, 50.);
+	ret = adef_clock_mapper_to_media(&mapper, monotonic, 90000, &timestamp);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL((double)timestamp, 64. * 90000, 2.);
+
+	/* Out of range */
+	ret = adef_clock_mapper_to_media(
+		&mapper, 0, TEST_TIMESCALE, &timestamp);
+	CU_ASSERT_EQUAL(ret, -ERANGE);
+}
+
+
+static void test_clock_mapper_step(void)
+{
+	int ret;
+	struct adef_clock_mapper mapper;
+	struct adef_frame_info info = {.timescale = TEST_TIMESCALE};
+	uint32_t seed = 1;
+	uint64_t monotonic;
+
+	ret = adef_clock_mapper_init(&mapper, 100, 1000);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	/* The monotonic clock steps by 100ms after 200 frames */
+	for (unsigned int i = 0; i < 300; i++) {
+		info.timestamp = (uint64_t)i * TEST_DURATION;
+		info.capture_timestamp = capture_time(info.timestamp, &seed);
+		if (i >= 200)
+			info.capture_timestamp += 100000;
+		ret = adef_clock_mapper_update(&mapper, &info);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	CU_ASSERT_EQUAL(mapper.restarts, 1);
+	CU_ASSERT_EQUAL(mapper.rejected, 7);
+
+	ret = adef_clock_mapper_to_monotonic(
+		&mapper, 300 * TEST_DURATION, TEST_TIMESCALE, &monotonic);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL((double)monotonic,
+			       TEST_START + 6400000. * TEST_DRIFT + 100000.,
+			       300.);
+
+	/* Invalid arguments */
+	ret = adef_clock_mapper_init(&mapper, 1, 0);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	info.capture_timestamp = 0;
+	ret = adef_clock_mapper_update(&mapper, &info);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	info.capture_timestamp = 1;
+	info.timescale = 0;
+	ret = adef_clock_mapper_update(&mapper, &info);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_clock_mapper_to_monotonic(&mapper, 0, 0, &monotonic);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+CU_TestInfo g_adef_test_clock[] = {
+	{FN("clock-mapper-fit"), &test_clock_mapper_fit},
+	{FN("clock-mapper-step"), &test_clock_mapper_step},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,452 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+static const struct adef_format s16le_stereo_44100 = {
+	.encoding = ADEF_ENCODING_PCM,
+	.channel_count = 2,
+	.channel_layout = ADEF_CHANNEL_LAYOUT_STEREO,
+	.bit_depth = 16,
+	.sample_rate = 44100,
+	.pcm =
+		{
+			.interleaved = true,
+			.signed_val = true,
+			.little_endian = true,
+		},
+};
+
+
+static void check_stages(const struct adef_format *src,
+			 const struct adef_format *dst,
+			 const enum adef_pcm_stage *expected,
+			 unsigned int expected_count)
+{
+	int ret;
+	struct adef_pcm_convert *conv = NULL;
+	enum adef_pcm_stage stages[ADEF_PCM_STAGE_MAX];
+	unsigned int count = ADEF_ARRAY_SIZE(stages);
+
+	ret = adef_pcm_convert_new(src, dst, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	ret = adef_pcm_convert_get_stages(conv, stages, &count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(count, expected_count);
+	for (unsigned int i = 0; i < count && i < expected_count; i++)
+		CU_ASSERT_EQUAL(stages[i], expected[i]);
+
+	adef_pcm_convert_destroy(conv);
+}
+
+
+static void test_convert_plan(void)
+{
+	int ret;
+	struct adef_format src = s16le_stereo_44100;
+	struct adef_format dst = s16le_stereo_44100;
+	struct adef_pcm_convert *conv = NULL;
+	enum adef_pcm_stage stages[2];
+	unsigned int count;
+
+	ret = adef_pcm_convert_new(NULL, &dst, &conv);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_convert_new(&src, NULL, &conv);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_convert_new(&src, &dst, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_convert_new(&adef_aac_lc_16b_44100hz_stereo_adts,
+				   &dst,
+				   &conv);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	src.bit_depth = 12;
+	ret = adef_pcm_convert_new(&src, &dst, &conv);
+	CU_ASSERT_EQUAL(ret, -ENOTSUP);
+	src.bit_depth = 16;
+
+	/* Identical formats */
+	check_stages(&src,
+		     &dst,
+		     (enum adef_pcm_stage[]){ADEF_PCM_STAGE_COPY},
+		     1);
+
+	/* Same rate and channels */
+	dst.pcm.interleaved = false;
+	dst.pcm.little_endian = false;
+	dst.bit_depth = 24;
+	check_stages(&src,
+		     &dst,
+		     (enum adef_pcm_stage[]){ADEF_PCM_STAGE_REPACK},
+		     1);
+
+	/* Downmix before resampling */
+	dst.channel_count = 1;
+	dst.channel_layout = ADEF_CHANNEL_LAYOUT_MONO;
+	dst.sample_rate = 48000;
+	check_stages(&src,
+		     &dst,
+		     (enum adef_pcm_stage[]){ADEF_PCM_STAGE_DECODE,
+					     ADEF_PCM_STAGE_REMIX,
+					     ADEF_PCM_STAGE_RESAMPLE,
+					     ADEF_PCM_STAGE_ENCODE},
+		     4);
+
+	/* Upmix after resampling */
+	check_stages(&dst,
+		     &src,
+		     (enum adef_pcm_stage[]){ADEF_PCM_STAGE_DECODE,
+					     ADEF_PCM_STAGE_RESAMPLE,
+					     ADEF_PCM_STAGE_REMIX,
+					     ADEF_PCM_STAGE_ENCODE},
+		     4);
+
+	ret = adef_pcm_convert_new(&src, &dst, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	count = ADEF_ARRAY_SIZE(stages);
+	ret = adef_pcm_convert_get_stages(conv, stages, &count);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+	CU_ASSERT_EQUAL(count, 4);
+	adef_pcm_convert_destroy(conv);
+
+	CU_ASSERT_STRING_EQUAL(adef_pcm_stage_to_str(ADEF_PCM_STAGE_REMIX),
+			       "REMIX");
+	CU_ASSERT_STRING_EQUAL(adef_pcm_stage_to_str(ADEF_PCM_STAGE_MAX),
+			       "UNKNOWN");
+}
+
+
+static void test_convert_repack(void)
+{
+	int ret;
+	struct adef_format dst = s16le_stereo_44100;
+	struct adef_pcm_convert *conv = NULL;
+	int16_t in_data[] = {0x1234, -2, 0x7fff, -0x8000};
+	uint8_t out_data[12];
+	struct adef_pcm_buffer in = {.data = in_data, .frames = 2};
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 2};
+	size_t frames = 0;
+
+	/* s16le interleaved to u24be planar */
+	dst.bit_depth = 24;
+	dst.pcm.interleaved = false;
+	dst.pcm.signed_val = false;
+	dst.pcm.little_endian = false;
+	ret = adef_pcm_convert_new(&s16le_stereo_44100, &dst, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	out.frames = 1;
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+
+	out.frames = 2;
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(frames, 2);
+	/* Left plane: 0x1234, 0x7fff */
+	CU_ASSERT_EQUAL(out_data[0], 0x92);
+	CU_ASSERT_EQUAL(out_data[1], 0x34);
+	CU_ASSERT_EQUAL(out_data[2], 0x00);
+	CU_ASSERT_EQUAL(out_data[3], 0xff);
+	CU_ASSERT_EQUAL(out_data[4], 0xff);
+	CU_ASSERT_EQUAL(out_data[5], 0x00);
+	/* Right plane: -2, -0x8000 */
+	CU_ASSERT_EQUAL(out_data[6], 0x7f);
+	CU_ASSERT_EQUAL(out_data[7], 0xfe);
+	CU_ASSERT_EQUAL(out_data[8], 0x00);
+	CU_ASSERT_EQUAL(out_data[9], 0x00);
+	CU_ASSERT_EQUAL(out_data[10], 0x00);
+	CU_ASSERT_EQUAL(out_data[11], 0x00);
+
+	adef_pcm_convert_destroy(conv);
+}
+
+
+static void test_convert_container(void)
+{
+	int ret;
+	struct adef_format src = s16le_stereo_44100;
+	struct adef_format dst;
+	struct adef_pcm_convert *conv = NULL;
+	/* 11 packed 24-bit little-endian samples */
+	uint8_t packed[33], repacked[33];
+	uint32_t unpacked[11];
+	uint8_t *u = (uint8_t *)unpacked;
+	struct adef_pcm_buffer in = {.data = packed, .frames = 5};
+	struct adef_pcm_buffer out = {.data = unpacked, .frames = 5};
+	size_t frames = 0;
+
+	for (unsigned int i = 0; i < sizeof(packed); i++)
+		packed[i] = (uint8_t)(i * 29 + 3);
+
+	/* Kernels */
+	ret = adef_pcm_unpack_24le(NULL, unpacked, 11, true);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_pack_24le(unpacked, NULL, 11);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_pcm_unpack_24le(packed, unpacked, 11, true);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 11; i++) {
+		CU_ASSERT_EQUAL(u[4 * i], packed[3 * i]);
+		CU_ASSERT_EQUAL(u[4 * i + 1], packed[3 * i + 1]);
+		CU_ASSERT_EQUAL(u[4 * i + 2], packed[3 * i + 2]);
+		CU_ASSERT_EQUAL(u[4 * i + 3],
+				packed[3 * i + 2] & 0x80 ? 0xff : 0x00);
+	}
+	ret = adef_pcm_unpack_24le(packed, unpacked, 11, false);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 11; i++)
+		CU_ASSERT_EQUAL(u[4 * i + 3], 0);
+	ret = adef_pcm_pack_24le(unpacked, repacked, 11);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(memcmp(packed, repacked, sizeof(packed)), 0);
+
+	/* Converter: s24le packed planar (5 frames, the 11th sample is
+	 * unused) to 4-byte containers, and back */
+	src.bit_depth = 24;
+	src.pcm.interleaved = false;
+	dst = src;
+	dst.pcm.container_width = 32;
+	ret = adef_pcm_convert_new(&src, &dst, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	memset(unpacked, 0, sizeof(unpacked));
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(frames, 5);
+	/* Left: 0x3d2003, right: 0xf0d3b6 (negative) */
+	CU_ASSERT_EQUAL(u[0], 0x03);
+	CU_ASSERT_EQUAL(u[2], 0x3d);
+	CU_ASSERT_EQUAL(u[3], 0x00);
+	CU_ASSERT_EQUAL(u[20], 0xb6);
+	CU_ASSERT_EQUAL(u[22], 0xf0);
+	CU_ASSERT_EQUAL(u[23], 0xff);
+	adef_pcm_convert_destroy(conv);
+
+	ret = adef_pcm_convert_new(&dst, &src, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	memset(repacked, 0, sizeof(repacked));
+	in.data = unpacked;
+	out.data = repacked;
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(memcmp(packed, repacked, 30), 0);
+	adef_pcm_convert_destroy(conv);
+
+	/* Generic path: to unsigned big-endian 4-byte containers */
+	dst.pcm.signed_val = false;
+	dst.pcm.little_endian = false;
+	dst.pcm.interleaved = true;
+	ret = adef_pcm_convert_new(&src, &dst, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	in.data = packed;
+	out.data = repacked;
+	in.frames = out.frames = 1;
+	in.plane_stride = 15;
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	/* Left: 0x3d2003 -> 0xbd2003, right: 0xf0d3b6 -> 0x70d3b6 */
+	CU_ASSERT_EQUAL(repacked[0], 0x00);
+	CU_ASSERT_EQUAL(repacked[1], 0xbd);
+	CU_ASSERT_EQUAL(repacked[2], 0x20);
+	CU_ASSERT_EQUAL(repacked[3], 0x03);
+	CU_ASSERT_EQUAL(repacked[4], 0x00);
+	CU_ASSERT_EQUAL(repacked[5], 0x70);
+	CU_ASSERT_EQUAL(repacked[6], 0xd3);
+	CU_ASSERT_EQUAL(repacked[7], 0xb6);
+	adef_pcm_convert_destroy(conv);
+}
+
+
+static void test_convert_remix(void)
+{
+	int ret;
+	struct adef_format dst = s16le_stereo_44100;
+	struct adef_pcm_convert *conv = NULL;
+	int16_t in_data[] = {1000, 3000, -1000, -3000, 32767, 32767};
+	int16_t out_data[6];
+	struct adef_pcm_buffer in = {.data = in_data, .frames = 3};
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 3};
+	size_t frames = 0;
+
+	/* Stereo to mono */
+	dst.channel_count = 1;
+	dst.channel_layout = ADEF_CHANNEL_LAYOUT_MONO;
+	ret = adef_pcm_convert_new(&s16le_stereo_44100, &dst, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(frames, 3);
+	CU_ASSERT_EQUAL(out_data[0], 2000);
+	CU_ASSERT_EQUAL(out_data[1], -2000);
+	CU_ASSERT_EQUAL(out_data[2], 32767);
+	adef_pcm_convert_destroy(conv);
+
+	/* Mono to stereo, unspecified layouts: duplicate */
+	dst.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	ret = adef_pcm_convert_new(&dst, &s16le_stereo_44100, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	in.frames = 2;
+	out.frames = 2;
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(frames, 2);
+	CU_ASSERT_EQUAL(out_data[0], 1000);
+	CU_ASSERT_EQUAL(out_data[1], 1000);
+	CU_ASSERT_EQUAL(out_data[2], 3000);
+	CU_ASSERT_EQUAL(out_data[3], 3000);
+	adef_pcm_convert_destroy(conv);
+}
+
+
+static void test_convert_resample(void)
+{
+	int ret;
+	struct adef_format dst = s16le_stereo_44100;
+	struct adef_pcm_convert *conv = NULL;
+	int16_t in_data[441 * 2];
+	int16_t out_data[500];
+	struct adef_pcm_buffer in = {.data = in_data, .frames = 441};
+	struct adef_pcm_buffer out = {.data = out_data};
+	size_t frames, total = 0;
+
+	/* 44100 Hz stereo interleaved to 48000 Hz mono planar */
+	dst.channel_count = 1;
+	dst.channel_layout = ADEF_CHANNEL_LAYOUT_MONO;
+	dst.sample_rate = 48000;
+	dst.pcm.interleaved = false;
+	ret = adef_pcm_convert_new(&s16le_stereo_44100, &dst, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	for (size_t i = 0; i < ADEF_ARRAY_SIZE(in_data); i++)
+		in_data[i] = 1000;
+	out.frames = adef_pcm_convert_get_max_output(conv, in.frames);
+	CU_ASSERT_TRUE(out.frames <= ADEF_ARRAY_SIZE(out_data));
+
+	for (unsigned int i = 0; i < 100; i++) {
+		frames = 0;
+		ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+		CU_ASSERT_EQUAL(ret, 0);
+		/* 10 ms of input gives 480 output frames, give or take one
+		 * held back frame */
+		CU_ASSERT_TRUE(frames >= 479 && frames <= 481);
+		for (size_t j = 0; j < frames; j++)
+			CU_ASSERT_EQUAL(out_data[j], 1000);
+		total += frames;
+	}
+	CU_ASSERT_TRUE(total >= 47999 && total <= 48000);
+
+	adef_pcm_convert_destroy(conv);
+}
+
+
+static void test_convert_buffer(void)
+{
+	int ret;
+	struct adef_format dst = s16le_stereo_44100;
+	int16_t in[2 * 1000];
+	float out[2][1000];
+	struct adef_pcm_buffer in_buf = {.data = in, .frames = 1000};
+	struct adef_pcm_buffer out_buf = {.data = out, .frames = 1000};
+	struct adef_pcm_array array;
+	size_t frames;
+
+	/* Interleaved 16-bit to planar float */
+	dst.bit_depth = 32;
+	dst.pcm.float_val = true;
+	dst.pcm.interleaved = false;
+	for (unsigned int i = 0; i < 1000; i++) {
+		in[2 * i] = i * 32;
+		in[2 * i + 1] = -(int)i * 32;
+	}
+	ret = adef_pcm_convert_buffer(
+		&s16le_stereo_44100, &dst, &in_buf, &out_buf, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(frames, 1000);
+	for (unsigned int i = 0; i < 1000; i++) {
+		CU_ASSERT_DOUBLE_EQUAL(out[0][i], i / 1024., 1e-6);
+		CU_ASSERT_DOUBLE_EQUAL(out[1][i], -(int)i / 1024., 1e-6);
+	}
+	out_buf.frames = 999;
+	ret = adef_pcm_convert_buffer(
+		&s16le_stereo_44100, &dst, &in_buf, &out_buf, &frames);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+	ret = adef_pcm_convert_buffer(
+		NULL, &dst, &in_buf, &out_buf, &frames);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Array descriptions */
+	ret = adef_pcm_buffer_to_array(&s16le_stereo_44100, &in_buf, &array);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_STRING_EQUAL(array.typestr, "<i2");
+	CU_ASSERT_PTR_EQUAL(array.data, in);
+	CU_ASSERT_EQUAL(array.shape[0], 1000);
+	CU_ASSERT_EQUAL(array.shape[1], 2);
+	CU_ASSERT_EQUAL(array.strides[0], 4);
+	CU_ASSERT_EQUAL(array.strides[1], 2);
+	CU_ASSERT_EQUAL(array.size, sizeof(in));
+	out_buf.frames = 500;
+	out_buf.plane_stride = sizeof(out[0]);
+	ret = adef_pcm_buffer_to_array(&dst, &out_buf, &array);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_STRING_EQUAL(array.typestr, "<f4");
+	CU_ASSERT_EQUAL(array.shape[0], 500);
+	CU_ASSERT_EQUAL(array.shape[1], 2);
+	CU_ASSERT_EQUAL(array.strides[0], 4);
+	CU_ASSERT_EQUAL(array.strides[1], sizeof(out[0]));
+	CU_ASSERT_EQUAL(array.size, sizeof(out[0]) + 500 * 4);
+	dst.bit_depth = 8;
+	dst.pcm.float_val = false;
+	dst.pcm.signed_val = false;
+	ret = adef_pcm_buffer_to_array(&dst, &out_buf, &array);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_STRING_EQUAL(array.typestr, "|u1");
+	dst.bit_depth = 24;
+	dst.pcm.signed_val = true;
+	dst.pcm.little_endian = false;
+	dst.pcm.container_width = 32;
+	ret = adef_pcm_buffer_to_array(&dst, &out_buf, &array);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_STRING_EQUAL(array.typestr, ">i4");
+	dst.pcm.container_width = 0;
+	ret = adef_pcm_buffer_to_array(&dst, &out_buf, &array);
+	CU_ASSERT_EQUAL(ret, -ENOTSUP);
+	ret = adef_pcm_buffer_to_array(&dst, NULL, &array);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+CU_TestInfo g_adef_test_convert[] = {
+	{FN("convert-plan"), &test_convert_plan},
+	{FN("convert-repack"), &test_convert_repack},
+	{FN("convert-container"), &test_convert_container},
+	{FN("convert-remix"), &test_convert_remix},
+	{FN("convert-resample"), &test_convert_resample},
+	{FN("convert-buffer"), &test_convert_buffer},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,343 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <audio-defs/adefs.hpp>
+#include <vector>
+
+#include "adefs_test.h"
+#include "adefs_test_format_corpus.h"
+
+using namespace adef::literals;
+
+
+/* The constexpr formats are usable at compile time */
+static_assert(adef::formats::pcm_16b_48000hz_stereo.bit_depth == 16,
+	      "bad builtin format");
+static_assert(adef::format_equal(adef::interleaved<adef::s16le>::format(
+						 2,
+						 48000,
+						 ADEF_CHANNEL_LAYOUT_STEREO),
+				 adef::formats::pcm_16b_48000hz_stereo),
+	      "bad layout format");
+static_assert(adef::format_equal(adef::interleaved<adef::s16le>::format(2,
+									48000),
+				 adef::formats::pcm_16b_48000hz_stereo),
+	      "bad unspecified layout comparison");
+static_assert(!adef::format_equal(adef::planar<adef::f32le>::format(2, 48000),
+				  adef::formats::pcm_f32_48000hz_stereo),
+	      "bad format comparison");
+
+
+/* Format literals are parsed at compile time */
+constexpr struct adef_format literal_builtin = "PCM_16b_48000hz_stereo"_adef;
+constexpr struct adef_format literal_generic =
+	"PCM/2/24/48000/PLANAR/SIGNED/LE/UNKNOWN/STEREO/32"_adef;
+static_assert(adef::format_equal(literal_builtin,
+				 adef::formats::pcm_16b_48000hz_stereo),
+	      "bad builtin format literal");
+static_assert(literal_generic.bit_depth == 24 &&
+		      literal_generic.pcm.container_width == 32 &&
+		      !literal_generic.pcm.interleaved &&
+		      literal_generic.channel_layout ==
+			      ADEF_CHANNEL_LAYOUT_STEREO,
+	      "bad generic format literal");
+
+
+static const struct {
+	const struct adef_format *c;
+	const struct adef_format *cpp;
+} builtin_formats[] = {
+	{&adef_pcm_16b_8000hz_mono, &adef::formats::pcm_16b_8000hz_mono},
+	{&adef_pcm_16b_44100hz_stereo, &adef::formats::pcm_16b_44100hz_stereo},
+	{&adef_pcm_16b_96000hz_stereo, &adef::formats::pcm_16b_96000hz_stereo},
+	{&adef_pcm_f32_11025hz_mono, &adef::formats::pcm_f32_11025hz_mono},
+	{&adef_pcm_f32_48000hz_stereo, &adef::formats::pcm_f32_48000hz_stereo},
+	{&adef_aac_lc_16b_22050hz_mono_raw,
+	 &adef::formats::aac_lc_16b_22050hz_mono_raw},
+	{&adef_aac_lc_16b_64000hz_stereo_raw,
+	 &adef::formats::aac_lc_16b_64000hz_stereo_raw},
+	{&adef_aac_lc_16b_12000hz_mono_adts,
+	 &adef::formats::aac_lc_16b_12000hz_mono_adts},
+	{&adef_aac_lc_16b_48000hz_stereo_adts,
+	 &adef::formats::aac_lc_16b_48000hz_stereo_adts},
+};
+
+
+static void test_cpp_formats(void)
+{
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(builtin_formats); i++) {
+		CU_ASSERT_TRUE(adef_format_cmp(builtin_formats[i].c,
+					       builtin_formats[i].cpp));
+		CU_ASSERT_TRUE(adef::format_equal(*builtin_formats[i].c,
+						  *builtin_formats[i].cpp));
+	}
+	CU_ASSERT_FALSE(adef::format_equal(adef::formats::pcm_16b_8000hz_mono,
+					   adef_pcm_16b_8000hz_stereo));
+}
+
+
+/* Fill a buffer with pseudo-random bytes; float samples are kept in
+ * [-1.5, 1.5] to also check the saturation */
+static void fill(std::vector<uint8_t> &data, bool float_val, uint32_t seed)
+{
+	for (size_t i = 0; i < data.size(); i++) {
+		seed = seed * 1664525 + 1013904223;
+		data[i] = seed >> 24;
+	}
+	if (!float_val)
+		return;
+	for (size_t i = 0; i + 4 <= data.size(); i += 4) {
+		seed = seed * 1664525 + 1013904223;
+		float f = ((float)(seed >> 8) / (1 << 24) - 0.5f) * 3.f;
+		memcpy(&data[i], &f, sizeof(f));
+	}
+}
+
+
+/* Check the typed and runtime conversions against the C library */
+template <class Src, class Dst>
+static void check_convert(unsigned int channels, size_t frames)
+{
+	int ret;
+	const struct adef_format src = Src::format(channels, 48000);
+	const struct adef_format dst = Dst::format(channels, 48000);
+	std::vector<uint8_t> in(frames * channels * Src::sample::size);
+	std::vector<uint8_t> out_c(frames * channels * Dst::sample::size);
+	std::vector<uint8_t> out_typed(out_c.size());
+	std::vector<uint8_t> out_runtime(out_c.size());
+	struct adef_pcm_buffer in_buf = {in.data(), frames, 0};
+	struct adef_pcm_buffer out_buf = {out_c.data(), frames, 0};
+	size_t out_frames;
+
+	fill(in, Src::sample::float_val, frames);
+	ret = adef_pcm_convert_buffer(
+		&src, &dst, &in_buf, &out_buf, &out_frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(out_frames, frames);
+
+	out_buf.data = out_typed.data();
+	adef::convert<Src, Dst>(in_buf, out_buf, channels);
+	CU_ASSERT_EQUAL(memcmp(out_typed.data(), out_c.data(), out_c.size()),
+			0);
+
+	out_buf.data = out_runtime.data();
+	ret = adef::convert(src, dst, in_buf, out_buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(memcmp(out_runtime.data(), out_c.data(), out_c.size()),
+			0);
+}
+
+
+static void test_cpp_convert(void)
+{
+	int ret;
+	uint8_t data[16];
+	struct adef_pcm_buffer buf = {data, 2, 0};
+
+	check_convert<adef::interleaved<adef::s16le>,
+		      adef::planar<adef::s24be>>(2, 1000);
+	check_convert<adef::planar<adef::u8>, adef::interleaved<adef::s32le>>(
+		3, 517);
+	check_convert<adef::interleaved<adef::s24le4>,
+		      adef::interleaved<adef::u16be>>(1, 300);
+	check_convert<adef::interleaved<adef::s16le>,
+		      adef::planar<adef::f32le>>(2, 700);
+	check_convert<adef::planar<adef::f32le>,
+		      adef::interleaved<adef::s24le>>(2, 700);
+	check_convert<adef::interleaved<adef::f32be>,
+		      adef::interleaved<adef::u24be4>>(4, 257);
+	check_convert<adef::interleaved<adef::f32le>,
+		      adef::planar<adef::f32be>>(2, 300);
+
+	/* Float overs are kept */
+	float f_in[4] = {1.5f, 0.25f, -2.f, 1.f}, f_typed[4], f_runtime[4];
+	using f32_interleaved = adef::interleaved<adef::f32le>;
+	using f32_planar = adef::planar<adef::f32le>;
+	adef::convert<f32_interleaved, f32_planar>(
+		{f_in, 2, 0}, {f_typed, 2, 0}, 2);
+	ret = adef::convert(f32_interleaved::format(2, 48000),
+			    f32_planar::format(2, 48000),
+			    {f_in, 2, 0},
+			    {f_runtime, 2, 0});
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 4; i++) {
+		CU_ASSERT_EQUAL(f_typed[i], f_in[(i % 2) * 2 + i / 2]);
+		CU_ASSERT_EQUAL(f_runtime[i], f_typed[i]);
+	}
+
+	/* Runtime conversion limits */
+	ret = adef::convert(adef::formats::pcm_16b_44100hz_stereo,
+			    adef::formats::pcm_16b_48000hz_stereo,
+			    buf,
+			    buf);
+	CU_ASSERT_EQUAL(ret, -ENOTSUP);
+	ret = adef::convert(adef::formats::aac_lc_16b_48000hz_stereo_raw,
+			    adef::formats::aac_lc_16b_48000hz_stereo_raw,
+			    buf,
+			    buf);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	buf.frames = 1;
+	ret = adef::convert(adef::formats::pcm_16b_48000hz_stereo,
+			    adef::formats::pcm_16b_48000hz_stereo,
+			    {data, 2, 0},
+			    buf);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+}
+
+
+template <class Layout>
+static void check_meter(unsigned int channels, size_t frames)
+{
+	int ret;
+	const struct adef_format format = Layout::format(channels, 48000);
+	std::vector<uint8_t> data(frames * channels * Layout::sample::size);
+	struct adef_pcm_buffer buf = {data.data(), frames, 0};
+	struct adef_pcm_level expected[4] = {}, levels[4] = {}, typed[4] = {};
+	adef::meter m1, m2;
+
+	fill(data, Layout::sample::float_val, frames + 1);
+	if (!Layout::sample::float_val) {
+		/* Clipped samples */
+		memset(data.data(), 0xff, Layout::sample::size);
+		memset(data.data() + data.size() - Layout::sample::size,
+		       0,
+		       Layout::sample::size);
+	}
+	ret = adef_pcm_get_levels(&format, &buf, expected, channels);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = m1.reset(format);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = m1.update(buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = m1.get_levels(levels, channels);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = m2.reset(format);
+	CU_ASSERT_EQUAL(ret, 0);
+	m2.update<Layout>(buf);
+	ret = m2.get_levels(typed, channels);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	for (unsigned int c = 0; c < channels; c++) {
+		CU_ASSERT_EQUAL(levels[c].peak, expected[c].peak);
+		CU_ASSERT_DOUBLE_EQUAL(levels[c].rms, expected[c].rms, 1e-5);
+		CU_ASSERT_EQUAL(levels[c].clip_count, expected[c].clip_count);
+		CU_ASSERT_EQUAL(typed[c].peak, levels[c].peak);
+		CU_ASSERT_EQUAL(typed[c].rms, levels[c].rms);
+		CU_ASSERT_EQUAL(typed[c].clip_count, levels[c].clip_count);
+	}
+}
+
+
+static void test_cpp_meter(void)
+{
+	int ret;
+	adef::meter m;
+	struct adef_pcm_buffer buf = {};
+
+	check_meter<adef::interleaved<adef::s16le>>(2, 1000);
+	check_meter<adef::planar<adef::u24be>>(3, 600);
+	check_meter<adef::interleaved<adef::s24le4>>(1, 300);
+	check_meter<adef::planar<adef::f32le>>(4, 777);
+
+	ret = m.update(buf);
+	CU_ASSERT_EQUAL(ret, -EPROTO);
+	ret = m.reset(adef::formats::aac_lc_16b_48000hz_stereo_adts);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+/* All the fields written by the parsers must be identical */
+static bool format_fields_equal(const struct adef_format &f1,
+				const struct adef_format &f2)
+{
+	return f1.encoding == f2.encoding &&
+	       f1.channel_count == f2.channel_count &&
+	       f1.channel_layout == f2.channel_layout &&
+	       f1.bit_depth == f2.bit_depth &&
+	       f1.sample_rate == f2.sample_rate &&
+	       f1.pcm.interleaved == f2.pcm.interleaved &&
+	       f1.pcm.signed_val == f2.pcm.signed_val &&
+	       f1.pcm.float_val == f2.pcm.float_val &&
+	       f1.pcm.little_endian == f2.pcm.little_endian &&
+	       f1.pcm.container_width == f2.pcm.container_width &&
+	       f1.aac.data_format == f2.aac.data_format;
+}
+
+
+static void test_cpp_parse(void)
+{
+#define CORPUS_ENTRY(_str, _ret) {_str, _ret},
+	static const struct {
+		const char *str;
+		int ret;
+	} corpus[] = {ADEF_TEST_FORMAT_CORPUS(CORPUS_ENTRY)};
+#undef CORPUS_ENTRY
+	int ret, cpp_ret;
+	struct adef_format fmt, cpp_fmt;
+	char *str;
+
+	/* Shared corpus */
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(corpus); i++) {
+		ret = adef_format_from_str(corpus[i].str, &fmt);
+		cpp_ret = adef::parse_format(
+			corpus[i].str, strlen(corpus[i].str), cpp_fmt);
+		CU_ASSERT_EQUAL(ret, corpus[i].ret);
+		CU_ASSERT_EQUAL(cpp_ret, ret);
+		if (ret == 0 && cpp_ret == 0)
+			CU_ASSERT_TRUE(format_fields_equal(fmt, cpp_fmt));
+	}
+
+	/* All builtin names, and the generic form of the builtin formats */
+	for (const auto &entry : adef::detail::builtin_formats) {
+		ret = adef_format_from_str(entry.name, &fmt);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_TRUE(format_fields_equal(fmt, entry.format));
+		str = adef_format_to_str(&entry.format);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(str);
+		CU_ASSERT_EQUAL(adef::parse_format(str, strlen(str), cpp_fmt),
+				0);
+		CU_ASSERT_TRUE(format_fields_equal(cpp_fmt, entry.format));
+		free(str);
+	}
+
+	/* Literals outside of constant expressions are parsed at compile
+	 * time too */
+	fmt = "pcm_16b_44100hz_mono"_adef;
+	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &adef_pcm_16b_44100hz_mono));
+	CU_ASSERT_EQUAL(adef::parse_format(nullptr, 0, fmt), -EINVAL);
+}
+
+
+CU_TestInfo g_adef_test_cpp[] = {
+	{FN("cpp-formats"), &test_cpp_formats},
+	{FN("cpp-convert"), &test_cpp_convert},
+	{FN("cpp-meter"), &test_cpp_meter},
+	{FN("cpp-parse"), &test_cpp_parse},
+
+	CU_TEST_INFO_NULL,
+};
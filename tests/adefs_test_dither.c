@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+#define COUNT 48000
+
+
+static struct adef_format s24le_mono(void)
+{
+	struct adef_format fmt = adef_pcm_16b_48000hz_mono;
+	fmt.bit_depth = 24;
+	return fmt;
+}
+
+
+/* Requantize a constant 24-bit signal to 16 bits and return the mean
+ * output value and the variance of the error on 16-sample averages (low
+ * frequency error) */
+static void requantize_constant(enum adef_pcm_dither dither,
+				bool noise_shaping,
+				int32_t value,
+				double *mean,
+				double *lf_var)
+{
+	int ret;
+	struct adef_format src = s24le_mono();
+	struct adef_pcm_requantize rq;
+	static uint8_t in_data[3 * COUNT];
+	static int16_t out_data[COUNT];
+	struct adef_pcm_buffer in = {.data = in_data, .frames = COUNT};
+	struct adef_pcm_buffer out = {.data = out_data, .frames = COUNT};
+	double sum = 0., var = 0.;
+
+	for (unsigned int i = 0; i < COUNT; i++) {
+		in_data[3 * i] = value & 0xff;
+		in_data[3 * i + 1] = (value >> 8) & 0xff;
+		in_data[3 * i + 2] = (value >> 16) & 0xff;
+	}
+
+	ret = adef_pcm_requantize_init(&rq,
+				       &src,
+				       &adef_pcm_16b_48000hz_mono,
+				       dither,
+				       noise_shaping,
+				       42);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_requantize_process(&rq, &in, &out);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	for (unsigned int i = 0; i < COUNT; i += 16) {
+		double avg = 0.;
+		for (unsigned int j = 0; j < 16; j++)
+			avg += out_data[i + j];
+		sum += avg;
+		avg = avg / 16. - value / 256.;
+		var += avg * avg;
+	}
+	*mean = sum / COUNT;
+	*lf_var = var / (COUNT / 16);
+}
+
+
+static void test_requantize_args(void)
+{
+	int ret;
+	struct adef_pcm_requantize rq;
+	struct adef_format src = s24le_mono();
+
+	ret = adef_pcm_requantize_init(NULL,
+				       &src,
+				       &adef_pcm_16b_48000hz_mono,
+				       ADEF_PCM_DITHER_TPDF,
+				       false,
+				       0);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_requantize_init(&rq,
+				       &src,
+				       &adef_pcm_16b_48000hz_stereo,
+				       ADEF_PCM_DITHER_TPDF,
+				       false,
+				       0);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_requantize_init(&rq,
+				       &src,
+				       &adef_pcm_16b_44100hz_mono,
+				       ADEF_PCM_DITHER_TPDF,
+				       false,
+				       0);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_requantize_init(&rq,
+				       &src,
+				       &adef_pcm_16b_48000hz_mono,
+				       ADEF_PCM_DITHER_MAX,
+				       false,
+				       0);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+static void test_requantize_round(void)
+{
+	int ret;
+	struct adef_format src = s24le_mono();
+	struct adef_pcm_requantize rq;
+	/* 0x000180 (1.5 LSB), 0x00017f, -0x000180, max, min */
+	uint8_t in_data[] = {
+		0x80, 0x01, 0x00, 0x7f, 0x01, 0x00, 0x80, 0xfe,
+		0xff, 0xff, 0xff, 0x7f, 0x00, 0x00, 0x80,
+	};
+	int16_t out_data[5];
+	struct adef_pcm_buffer in = {.data = in_data, .frames = 5};
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 5};
+
+	ret = adef_pcm_requantize_init(&rq,
+				       &src,
+				       &adef_pcm_16b_48000hz_mono,
+				       ADEF_PCM_DITHER_NONE,
+				       false,
+				       0);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_requantize_process(&rq, &in, &out);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(out_data[0], 2);
+	CU_ASSERT_EQUAL(out_data[1], 1);
+	CU_ASSERT_EQUAL(out_data[2], -1);
+	CU_ASSERT_EQUAL(out_data[3], INT16_MAX);
+	CU_ASSERT_EQUAL(out_data[4], INT16_MIN);
+
+	out.frames = 4;
+	ret = adef_pcm_requantize_process(&rq, &in, &out);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+}
+
+
+static void test_requantize_round_24(void)
+{
+	int ret;
+	struct adef_format src = adef_pcm_16b_48000hz_mono;
+	struct adef_format dst = s24le_mono();
+	struct adef_pcm_requantize rq;
+	/* Fractions of 0.496, 0.5 and 0.25 LSB, which are not all
+	 * representable in single precision at this magnitude */
+	const int32_t values[] = {0x3456787f, 0x34567880, -0x345678c0};
+	const int32_t expected[] = {0x345678, 0x345679, -0x345679};
+	int32_t in_data[20];
+	uint8_t out_data[3 * 20];
+	struct adef_pcm_buffer in = {.data = in_data, .frames = 20};
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 20};
+
+	src.bit_depth = 32;
+	for (unsigned int i = 0; i < 20; i++)
+		in_data[i] = values[i % 3];
+
+	ret = adef_pcm_requantize_init(
+		&rq, &src, &dst, ADEF_PCM_DITHER_NONE, false, 0);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_requantize_process(&rq, &in, &out);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 20; i++) {
+		const uint8_t *p = &out_data[3 * i];
+		int32_t v = (int32_t)(((uint32_t)p[0] << 8) |
+				      ((uint32_t)p[1] << 16) |
+				      ((uint32_t)p[2] << 24)) >>
+			    8;
+		CU_ASSERT_EQUAL(v, expected[i % 3]);
+	}
+}
+
+
+static void test_requantize_dither(void)
+{
+	double mean, lf_var, lf_var_shaped;
+
+	/* 0.3 LSB: rounding always gives 0 */
+	requantize_constant(ADEF_PCM_DITHER_NONE, false, 77, &mean, &lf_var);
+	CU_ASSERT_DOUBLE_EQUAL(mean, 0., 1e-9);
+
+	/* Dither linearizes the quantizer: the mean is preserved */
+	requantize_constant(ADEF_PCM_DITHER_TPDF, false, 77, &mean, &lf_var);
+	CU_ASSERT_DOUBLE_EQUAL(mean, 77. / 256., 0.02);
+
+	/* Noise shaping moves the error to high frequencies */
+	requantize_constant(
+		ADEF_PCM_DITHER_TPDF, true, 77, &mean, &lf_var_shaped);
+	CU_ASSERT_DOUBLE_EQUAL(mean, 77. / 256., 0.02);
+	CU_ASSERT_TRUE(lf_var_shaped < lf_var / 4);
+}
+
+
+CU_TestInfo g_adef_test_dither[] = {
+	{FN("requantize-args"), &test_requantize_args},
+	{FN("requantize-round"), &test_requantize_round},
+	{FN("requantize-round-24"), &test_requantize_round_24},
+	{FN("requantize-dither"), &test_requantize_dither},
+
+	CU_TEST_INFO_NULL,
+};
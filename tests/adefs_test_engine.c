@@ -0,0 +1,281 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <audio-defs/adefs_engine.h>
+#include <sched.h>
+
+#include "adefs_test.h"
+
+
+#define TEST_STREAMS 40
+#define TEST_JOBS 200
+#define TEST_FRAMES 480
+
+
+/* Per-stream test state (the processing functions run on the workers:
+ * errors are counted and checked by the main thread) */
+struct test_stream {
+	struct adef_engine_stream *stream;
+	int16_t data[2 * TEST_FRAMES];
+	uint32_t next_index;
+	unsigned int active;
+	unsigned int order_errors;
+	unsigned int concurrency_errors;
+	unsigned int forward_errors;
+	struct test_stream *forward;
+};
+
+
+static int process_job(struct adef_engine_stream *stream,
+		       const struct adef_engine_job *job,
+		       void *userdata)
+{
+	struct test_stream *ts = userdata;
+	struct adef_pcm_level levels[2];
+	int ret;
+
+	(void)stream;
+
+	if (__atomic_fetch_add(&ts->active, 1, __ATOMIC_SEQ_CST) != 0)
+		ts->concurrency_errors++;
+	if (job->info.index != ts->next_index)
+		ts->order_errors++;
+	ts->next_index = job->info.index + 1;
+
+	ret = adef_pcm_get_levels(&job->format, &job->in, levels, 2);
+
+	/* Forward every job to another stream (without waiting for room
+	 * in its queue, which could block all the workers) */
+	if (ts->forward != NULL &&
+	    adef_engine_stream_submit(ts->forward->stream, job) < 0)
+		ts->forward_errors++;
+
+	__atomic_fetch_sub(&ts->active, 1, __ATOMIC_SEQ_CST);
+	return (job->info.index % 50 == 49) ? -EPROTO : ret;
+}
+
+
+static void submit_jobs(struct test_stream *streams, unsigned int count)
+{
+	int ret;
+	struct adef_engine_job job = {
+		.format = adef_pcm_16b_48000hz_stereo,
+		.info.timescale = 48000,
+	};
+
+	for (uint32_t i = 0; i < TEST_JOBS; i++) {
+		for (unsigned int s = 0; s < count; s++) {
+			job.in.data = streams[s].data;
+			job.in.frames = TEST_FRAMES;
+			job.info.timestamp = (uint64_t)i * TEST_FRAMES;
+			job.info.index = i;
+			while ((ret = adef_engine_stream_submit(
+					streams[s].stream, &job)) == -EAGAIN)
+				sched_yield();
+			CU_ASSERT_EQUAL(ret, 0);
+		}
+	}
+}
+
+
+static void test_engine_args(void)
+{
+	int ret;
+	struct adef_engine *engine = NULL;
+	struct adef_engine_stream *streams[3];
+	struct adef_engine_config config = {
+		.thread_count = 1,
+		.max_streams = 2,
+	};
+	struct adef_engine_stats stats;
+	struct adef_engine_job job = {0};
+
+	ret = adef_engine_new(&config, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_engine_new(&config, &engine);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	ret = adef_engine_stream_new(NULL, &process_job, NULL, &streams[0]);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_engine_stream_new(engine, NULL, NULL, &streams[0]);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_engine_stream_new(engine, &process_job, NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_engine_stream_new(engine, &process_job, NULL, &streams[0]);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_engine_stream_new(engine, &process_job, NULL, &streams[1]);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_engine_stream_new(engine, &process_job, NULL, &streams[2]);
+	CU_ASSERT_EQUAL(ret, -ENOSPC);
+
+	ret = adef_engine_stream_submit(NULL, &job);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_engine_stream_submit(streams[0], NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_engine_stream_wait(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_engine_get_stats(NULL, &stats);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_engine_get_stats(engine, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_engine_stream_get_stats(NULL, &stats);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* A destroyed stream frees its slot */
+	ret = adef_engine_stream_destroy(streams[1]);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_engine_stream_new(engine, &process_job, NULL, &streams[1]);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_engine_stream_destroy(NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The remaining streams are destroyed with the engine */
+	ret = adef_engine_destroy(engine);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_engine_destroy(NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+static void check_engine(const struct adef_engine_config *config,
+			 bool forward)
+{
+	int ret;
+	struct adef_engine *engine = NULL;
+	struct test_stream *streams;
+	struct adef_engine_stats stats, stream_stats;
+	unsigned int count = forward ? TEST_STREAMS / 2 : TEST_STREAMS;
+	unsigned int max_depth = ADEF_ENGINE_DEFAULT_STREAM_QUEUE_SIZE;
+	uint64_t errors = 0;
+
+	if (config != NULL && config->stream_queue_size != 0)
+		max_depth = config->stream_queue_size;
+	streams = calloc(TEST_STREAMS, sizeof(*streams));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(streams);
+	ret = adef_engine_new(config, &engine);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	for (unsigned int s = 0; s < TEST_STREAMS; s++) {
+		for (unsigned int i = 0; i < 2 * TEST_FRAMES; i++)
+			streams[s].data[i] = (int16_t)(i * 31 + s);
+		if (forward && s < count)
+			streams[s].forward = &streams[s + count];
+		ret = adef_engine_stream_new(engine,
+					     &process_job,
+					     &streams[s],
+					     &streams[s].stream);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+	}
+
+	submit_jobs(streams, count);
+	for (unsigned int s = 0; s < count; s++) {
+		ret = adef_engine_stream_wait(streams[s].stream);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	for (unsigned int s = count; s < TEST_STREAMS; s++) {
+		ret = adef_engine_stream_wait(streams[s].stream);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	/* Jobs processed in order, one at a time per stream */
+	for (unsigned int s = 0; s < TEST_STREAMS; s++) {
+		CU_ASSERT_EQUAL(streams[s].next_index, TEST_JOBS);
+		CU_ASSERT_EQUAL(streams[s].order_errors, 0);
+		CU_ASSERT_EQUAL(streams[s].concurrency_errors, 0);
+		CU_ASSERT_EQUAL(streams[s].forward_errors, 0);
+		ret = adef_engine_stream_get_stats(streams[s].stream,
+						   &stream_stats);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_EQUAL(stream_stats.jobs, TEST_JOBS);
+		CU_ASSERT_EQUAL(stream_stats.errors, TEST_JOBS / 50);
+		CU_ASSERT_EQUAL(stream_stats.queue_depth, 0);
+		CU_ASSERT_TRUE(stream_stats.max_queue_depth >= 1);
+		CU_ASSERT_TRUE(stream_stats.max_queue_depth <= max_depth);
+		CU_ASSERT_TRUE(stream_stats.latency >= stream_stats.wait_time);
+		CU_ASSERT_TRUE(stream_stats.max_latency * TEST_JOBS >=
+			       stream_stats.latency);
+		errors += stream_stats.errors;
+	}
+
+	ret = adef_engine_get_stats(engine, &stats);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(stats.jobs, (uint64_t)TEST_STREAMS * TEST_JOBS);
+	CU_ASSERT_EQUAL(stats.errors, errors);
+	CU_ASSERT_EQUAL(stats.queue_depth, 0);
+	CU_ASSERT_TRUE(stats.max_queue_depth >= 1);
+	CU_ASSERT_TRUE(stats.latency >= stats.wait_time);
+
+	for (unsigned int s = 0; s < TEST_STREAMS / 2; s++) {
+		ret = adef_engine_stream_destroy(streams[s].stream);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	ret = adef_engine_destroy(engine);
+	CU_ASSERT_EQUAL(ret, 0);
+	free(streams);
+}
+
+
+static void test_engine_streams(void)
+{
+	struct adef_engine_config config = {
+		.thread_count = 4,
+	};
+
+	check_engine(&config, false);
+	check_engine(NULL, false);
+}
+
+
+static void test_engine_forward(void)
+{
+	struct adef_engine_config config = {
+		.thread_count = 3,
+		.stream_queue_size = TEST_JOBS,
+	};
+
+	/* Jobs submitted from the workers */
+	check_engine(&config, true);
+}
+
+
+static void test_engine_affinity(void)
+{
+	struct adef_engine_config config = {
+		.thread_count = 2,
+		.affinity = true,
+	};
+
+	check_engine(&config, false);
+}
+
+
+CU_TestInfo g_adef_test_engine[] = {
+	{FN("engine-args"), &test_engine_args},
+	{FN("engine-streams"), &test_engine_streams},
+	{FN("engine-forward"), &test_engine_forward},
+	{FN("engine-affinity"), &test_engine_affinity},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,313 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+static void test_float_convert(void)
+{
+	int ret;
+	struct adef_pcm_convert *conv = NULL;
+	int16_t in_data[] = {0x4000, -0x8000, 0x7fff, 1};
+	float f32_data[4];
+	int16_t out_data[4];
+	struct adef_pcm_buffer in = {.data = in_data, .frames = 2};
+	struct adef_pcm_buffer out = {.data = f32_data, .frames = 2};
+	size_t frames = 0;
+
+	/* s16 to f32 */
+	ret = adef_pcm_convert_new(&adef_pcm_16b_48000hz_stereo,
+				   &adef_pcm_f32_48000hz_stereo,
+				   &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(frames, 2);
+	CU_ASSERT_DOUBLE_EQUAL(f32_data[0], 0.5, 1e-9);
+	CU_ASSERT_DOUBLE_EQUAL(f32_data[1], -1.0, 1e-9);
+	CU_ASSERT_DOUBLE_EQUAL(f32_data[2], 32767. / 32768., 1e-9);
+	CU_ASSERT_DOUBLE_EQUAL(f32_data[3], 1. / 32768., 1e-9);
+	adef_pcm_convert_destroy(conv);
+
+	/* f32 to s16, with saturation of out of range values and NaN */
+	f32_data[0] = 2.f;
+	f32_data[1] = NAN;
+	ret = adef_pcm_convert_new(&adef_pcm_f32_48000hz_stereo,
+				   &adef_pcm_16b_48000hz_stereo,
+				   &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	in.data = f32_data;
+	out.data = out_data;
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(out_data[0], INT16_MAX);
+	CU_ASSERT_EQUAL(out_data[1], 0);
+	CU_ASSERT_EQUAL(out_data[2], 0x7fff);
+	CU_ASSERT_EQUAL(out_data[3], 1);
+	adef_pcm_convert_destroy(conv);
+}
+
+
+static void test_float_mix_gain(void)
+{
+	int ret;
+	struct adef_pcm_mixer mixer;
+	struct adef_pcm_mixer_input inputs[2];
+	struct adef_pcm_gain gain;
+	float in_data[2][20], out_data[20];
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 10};
+
+	memset(inputs, 0, sizeof(inputs));
+	for (unsigned int i = 0; i < 20; i++) {
+		in_data[0][i] = 0.75f;
+		in_data[1][i] = 0.5f;
+	}
+	for (unsigned int n = 0; n < 2; n++) {
+		inputs[n].buf.data = in_data[n];
+		inputs[n].buf.frames = 10;
+		inputs[n].gain = 1.f;
+	}
+
+	/* Floating-point sums are not clipped */
+	ret = adef_pcm_mixer_init(&mixer, &adef_pcm_f32_48000hz_stereo);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_mixer_process(&mixer, inputs, 2, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 20; i++)
+		CU_ASSERT_DOUBLE_EQUAL(out_data[i], 1.25, 1e-6);
+
+	ret = adef_pcm_gain_init(&gain, &adef_pcm_f32_48000hz_stereo, 0.5f);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_process(&gain, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 20; i++)
+		CU_ASSERT_DOUBLE_EQUAL(out_data[i], 0.625, 1e-6);
+}
+
+
+static void test_float_sanitize(void)
+{
+	int ret;
+	struct adef_format planar = adef_pcm_f32_48000hz_stereo;
+	float data[26];
+	struct adef_pcm_buffer buf = {.data = data, .frames = 13};
+
+	ret = adef_pcm_sanitize(&adef_pcm_16b_48000hz_stereo, &buf, 1.f);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_sanitize(&adef_pcm_f32_48000hz_stereo, NULL, 1.f);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_sanitize(&adef_pcm_f32_48000hz_stereo, &buf, 0.f);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	for (unsigned int i = 0; i < 26; i++)
+		data[i] = 0.25f;
+	/* In the vectorized part and in the tail */
+	for (unsigned int i = 0; i < 26; i += 22) {
+		data[i] = NAN;
+		data[i + 1] = 1e-40f;
+		data[i + 2] = -INFINITY;
+		data[i + 3] = 3.f;
+	}
+	data[4] = -1e-40f;
+	/* Negative zero becomes zero */
+	data[5] = -0.f;
+
+	ret = adef_pcm_sanitize(&adef_pcm_f32_48000hz_stereo, &buf, 1.f);
+	CU_ASSERT_EQUAL(ret, 10);
+	for (unsigned int i = 0; i < 26; i += 22) {
+		CU_ASSERT_EQUAL(data[i], 0.f);
+		CU_ASSERT_EQUAL(data[i + 1], 0.f);
+		CU_ASSERT_EQUAL(data[i + 2], -1.f);
+	}
+	CU_ASSERT_EQUAL(data[3], 1.f);
+	CU_ASSERT_EQUAL(data[4], 0.f);
+	CU_ASSERT_EQUAL(data[5], 0.f);
+	CU_ASSERT_EQUAL(data[6], 0.25f);
+
+	/* Idempotent */
+	ret = adef_pcm_sanitize(&adef_pcm_f32_48000hz_stereo, &buf, 1.f);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Planar */
+	planar.pcm.interleaved = false;
+	data[12] = 5.f;
+	data[25] = NAN;
+	ret = adef_pcm_sanitize(&planar, &buf, 1.f);
+	CU_ASSERT_EQUAL(ret, 2);
+	CU_ASSERT_EQUAL(data[12], 1.f);
+	CU_ASSERT_EQUAL(data[25], 0.f);
+}
+
+
+static void test_float_overs(void)
+{
+	int ret;
+	struct adef_pcm_convert *conv = NULL;
+	struct adef_format planar = adef_pcm_f32_48000hz_stereo;
+	struct adef_format mono = adef_pcm_f32_48000hz_stereo;
+	float in_data[] = {1.5f, -2.f, 0.25f, 1.f};
+	float out_data[4], back_data[4];
+	struct adef_pcm_buffer in = {.data = in_data, .frames = 2};
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 2};
+	size_t frames = 0;
+	float meter_data[] = {1.5f, 1.f, 0.5f, 2.f, -1.5f, -1.f, NAN, 0.f};
+	struct adef_pcm_buffer meter_buf = {.data = meter_data, .frames = 8};
+	struct adef_pcm_level level;
+	struct adef_pcm_meter meter;
+
+	/* Interleaving change (REPACK): the values over full scale are kept */
+	planar.pcm.interleaved = false;
+	ret = adef_pcm_convert_new(
+		&adef_pcm_f32_48000hz_stereo, &planar, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(frames, 2);
+	CU_ASSERT_EQUAL(out_data[0], 1.5f);
+	CU_ASSERT_EQUAL(out_data[1], 0.25f);
+	CU_ASSERT_EQUAL(out_data[2], -2.f);
+	CU_ASSERT_EQUAL(out_data[3], 1.f);
+	adef_pcm_convert_destroy(conv);
+
+	/* Endianness change (REPACK) */
+	planar.pcm.interleaved = true;
+	planar.pcm.little_endian = false;
+	ret = adef_pcm_convert_new(
+		&adef_pcm_f32_48000hz_stereo, &planar, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	adef_pcm_convert_destroy(conv);
+	ret = adef_pcm_convert_new(
+		&planar, &adef_pcm_f32_48000hz_stereo, &conv);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	in.data = out_data;
+	out.data = back_data;
+	ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 4; i++)
+		CU_ASSERT_EQUAL(back_data[i], in_data[i]);
+	adef_pcm_convert_destroy(conv);
+
+	/* Metering: not clamped, the samples of absolute value of at least
+	 * 1.0 are clips, NaN counts as 0 */
+	mono.channel_count = 1;
+	mono.channel_layout = ADEF_CHANNEL_LAYOUT_MONO;
+	ret = adef_pcm_get_levels(&mono, &meter_buf, &level, 1);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(level.peak, 2.0, 1e-6);
+	CU_ASSERT_DOUBLE_EQUAL(level.rms, sqrt(10.75 / 8), 1e-6);
+	CU_ASSERT_EQUAL(level.clip_count, 5);
+
+	ret = adef_pcm_meter_reset(&meter, &mono);
+	CU_ASSERT_EQUAL(ret, 0);
+	meter_buf.frames = 4;
+	ret = adef_pcm_meter_update(&meter, &meter_buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	meter_buf.data = &meter_data[4];
+	ret = adef_pcm_meter_update(&meter, &meter_buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_meter_get_levels(&meter, &level, 1);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(level.peak, 2.0, 1e-6);
+	CU_ASSERT_EQUAL(level.clip_count, 5);
+}
+
+
+/* The REPACK stage rounds the float samples as the DECODE and ENCODE
+ * stages do */
+static void test_float_round(void)
+{
+	int ret;
+	struct adef_format src = adef_pcm_f32_48000hz_mono;
+	struct adef_format dst = adef_pcm_16b_48000hz_mono;
+	struct adef_format dst_stereo = adef_pcm_16b_48000hz_stereo;
+	struct adef_pcm_convert *conv = NULL;
+	enum adef_pcm_stage stages[ADEF_PCM_STAGE_MAX];
+	unsigned int count;
+	float in_data[64];
+	uint8_t repack_data[64 * 4], encode_data[2 * 64 * 4];
+	struct adef_pcm_buffer in = {.data = in_data, .frames = 64};
+	struct adef_pcm_buffer out = {.data = repack_data, .frames = 64};
+	size_t frames = 0;
+
+	/* Unspecified layouts: the mono channel is duplicated as is */
+	src.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	dst.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	dst_stereo.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	for (unsigned int i = 0; i < 64; i++)
+		in_data[i] = ((float)i * 1021.7f - 32000.3f) / 32768.f;
+
+	for (unsigned int bits = 16; bits <= 24; bits += 8) {
+		size_t size = bits / 8;
+		dst.bit_depth = bits;
+		dst_stereo.bit_depth = bits;
+
+		/* Mono to mono: REPACK */
+		ret = adef_pcm_convert_new(&src, &dst, &conv);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		count = ADEF_ARRAY_SIZE(stages);
+		ret = adef_pcm_convert_get_stages(conv, stages, &count);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_EQUAL(stages[0], ADEF_PCM_STAGE_REPACK);
+		out.data = repack_data;
+		ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_EQUAL(frames, 64);
+		adef_pcm_convert_destroy(conv);
+
+		/* Mono to stereo: DECODE, REMIX, ENCODE */
+		ret = adef_pcm_convert_new(&src, &dst_stereo, &conv);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		count = ADEF_ARRAY_SIZE(stages);
+		ret = adef_pcm_convert_get_stages(conv, stages, &count);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_EQUAL(stages[0], ADEF_PCM_STAGE_DECODE);
+		out.data = encode_data;
+		ret = adef_pcm_convert_process(conv, &in, &out, &frames);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_EQUAL(frames, 64);
+		adef_pcm_convert_destroy(conv);
+
+		for (unsigned int i = 0; i < 64; i++) {
+			CU_ASSERT_EQUAL(memcmp(&repack_data[i * size],
+					       &encode_data[2 * i * size],
+					       size),
+					0);
+		}
+	}
+}
+
+
+CU_TestInfo g_adef_test_float[] = {
+	{FN("float-convert"), &test_float_convert},
+	{FN("float-mix-gain"), &test_float_mix_gain},
+	{FN("float-sanitize"), &test_float_sanitize},
+	{FN("float-overs"), &test_float_overs},
+	{FN("float-round"), &test_float_round},
+
+	CU_TEST_INFO_NULL,
+};
@@ -71,6 +71,60 @@ static void test_is_format_valid(void)
 	fmt.aac.data_format = ADEF_AAC_DATA_FORMAT_ADTS;
 	ret = adef_is_format_valid(&fmt);
 	CU_ASSERT_TRUE(ret);
+
+	/* Channel layout must match the channel count */
+	fmt.channel_layout = ADEF_CHANNEL_LAYOUT_MONO;
+	ret = adef_is_format_valid(&fmt);
+	CU_ASSERT_TRUE(ret);
+
+	fmt.channel_layout = ADEF_CHANNEL_LAYOUT_STEREO;
+	ret = adef_is_format_valid(&fmt);
+	CU_ASSERT_FALSE(ret);
+
+	fmt.channel_count = 2;
+	ret = adef_is_format_valid(&fmt);
+	CU_ASSERT_TRUE(ret);
+}
+
+
+static void test_channel_layout(void)
+{
+	CU_ASSERT_EQUAL(
+		adef_channel_layout_get_count(ADEF_CHANNEL_LAYOUT_UNSPECIFIED),
+		0);
+	CU_ASSERT_EQUAL(adef_channel_layout_get_count(ADEF_CHANNEL_LAYOUT_MONO),
+			1);
+	CU_ASSERT_EQUAL(
+		adef_channel_layout_get_count(ADEF_CHANNEL_LAYOUT_STEREO), 2);
+	CU_ASSERT_EQUAL(adef_channel_layout_get_count(ADEF_CHANNEL_LAYOUT_2_1),
+			3);
+	CU_ASSERT_EQUAL(adef_channel_layout_get_count(ADEF_CHANNEL_LAYOUT_QUAD),
+			4);
+	CU_ASSERT_EQUAL(adef_channel_layout_get_count(ADEF_CHANNEL_LAYOUT_5_1),
+			6);
+	CU_ASSERT_EQUAL(adef_channel_layout_get_count(ADEF_CHANNEL_LAYOUT_7_1),
+			8);
+
+	CU_ASSERT_EQUAL(adef_channel_layout_default(0),
+			ADEF_CHANNEL_LAYOUT_UNSPECIFIED);
+	CU_ASSERT_EQUAL(adef_channel_layout_default(1),
+			ADEF_CHANNEL_LAYOUT_MONO);
+	CU_ASSERT_EQUAL(adef_channel_layout_default(2),
+			ADEF_CHANNEL_LAYOUT_STEREO);
+	CU_ASSERT_EQUAL(adef_channel_layout_default(3),
+			ADEF_CHANNEL_LAYOUT_UNSPECIFIED);
+	CU_ASSERT_EQUAL(adef_channel_layout_default(6),
+			ADEF_CHANNEL_LAYOUT_5_1);
+	CU_ASSERT_EQUAL(adef_channel_layout_default(8),
+			ADEF_CHANNEL_LAYOUT_7_1);
+
+	/* Registered formats have a channel layout */
+	CU_ASSERT_EQUAL(adef_pcm_16b_48000hz_mono.channel_layout,
+			ADEF_CHANNEL_LAYOUT_MONO);
+	CU_ASSERT_EQUAL(adef_pcm_16b_48000hz_stereo.channel_layout,
+			ADEF_CHANNEL_LAYOUT_STEREO);
+	CU_ASSERT_EQUAL(adef_aac_lc_16b_48000hz_stereo_adts.channel_layout,
+			ADEF_CHANNEL_LAYOUT_STEREO);
 }
 
 
@@ -111,6 +165,36 @@ static void test_format_cmp(void)
 	ret = adef_format_cmp(&fmt1, &fmt2);
 	CU_ASSERT_FALSE(ret);
 
+	/* An unspecified layout is the default layout of the channel
+	 * count */
+	fmt1.channel_count = fmt2.channel_count = 6;
+	fmt1.channel_layout = ADEF_CHANNEL_LAYOUT_5_1;
+	fmt2.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	fmt2.pcm.interleaved = fmt1.pcm.interleaved;
+
+	ret = adef_format_cmp(&fmt1, &fmt2);
+	CU_ASSERT_TRUE(ret);
+
+	ret = adef_format_cmp(&fmt2, &fmt1);
+	CU_ASSERT_TRUE(ret);
+
+	/* 5.0 with side channels and LFE is not 5.1 */
+	fmt2.channel_layout = ADEF_CHANNEL_LAYOUT_STEREO |
+			      ADEF_CHANNEL_FRONT_CENTER |
+			      ADEF_CHANNEL_LOW_FREQUENCY |
+			      ADEF_CHANNEL_SIDE_LEFT | ADEF_CHANNEL_SIDE_RIGHT;
+
+	ret = adef_format_cmp(&fmt1, &fmt2);
+	CU_ASSERT_FALSE(ret);
+
+	/* No default layout for 3 channels */
+	fmt1.channel_count = fmt2.channel_count = 3;
+	fmt1.channel_layout = ADEF_CHANNEL_LAYOUT_2_1;
+	fmt2.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+
+	ret = adef_format_cmp(&fmt1, &fmt2);
+	CU_ASSERT_FALSE(ret);
+
 	/* AAC_LC checks */
 
 	fmt1 = fmt2 = adef_aac_lc_16b_48000hz_stereo_raw;
@@ -260,13 +344,109 @@ static void test_format_intersect(void)
 			ADEF_ARRAY_SIZE(supported_formats_pcm));
 		CU_ASSERT_TRUE(ret);
 	}
+
+	/* Channel layout: unspecified is the default layout */
+	fmt = adef_pcm_16b_48000hz_stereo;
+	fmt.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	ret = adef_format_intersect(&fmt,
+				    supported_formats_pcm,
+				    ADEF_ARRAY_SIZE(supported_formats_pcm));
+	CU_ASSERT_TRUE(ret);
+
+	fmt.channel_layout =
+		ADEF_CHANNEL_FRONT_LEFT | ADEF_CHANNEL_LOW_FREQUENCY;
+	ret = adef_format_intersect(&fmt,
+				    supported_formats_pcm,
+				    ADEF_ARRAY_SIZE(supported_formats_pcm));
+	CU_ASSERT_FALSE(ret);
+}
+
+
+static void test_container_width(void)
+{
+	bool ret;
+	struct adef_format fmt = adef_pcm_16b_48000hz_stereo;
+	struct adef_format caps[2];
+
+	fmt.bit_depth = 24;
+	ret = adef_is_format_valid(&fmt);
+	CU_ASSERT_TRUE(ret);
+
+	/* The container must be a multiple of 8 holding the samples */
+	fmt.pcm.container_width = 16;
+	ret = adef_is_format_valid(&fmt);
+	CU_ASSERT_FALSE(ret);
+
+	fmt.pcm.container_width = 28;
+	ret = adef_is_format_valid(&fmt);
+	CU_ASSERT_FALSE(ret);
+
+	fmt.pcm.container_width = 32;
+	ret = adef_is_format_valid(&fmt);
+	CU_ASSERT_TRUE(ret);
+	CU_ASSERT_EQUAL(adef_pcm_get_sample_size(&fmt), 4);
+
+	/* Packed is equivalent to the rounded up bit depth */
+	caps[0] = caps[1] = fmt;
+	caps[0].pcm.container_width = 0;
+	caps[1].pcm.container_width = 24;
+	CU_ASSERT_TRUE(adef_format_cmp(&caps[0], &caps[1]));
+	CU_ASSERT_FALSE(adef_format_cmp(&fmt, &caps[0]));
+	CU_ASSERT_EQUAL(adef_pcm_get_sample_size(&caps[0]), 3);
+
+	ret = adef_format_intersect(&fmt, caps, 2);
+	CU_ASSERT_FALSE(ret);
+	caps[1].pcm.container_width = 32;
+	ret = adef_format_intersect(&fmt, caps, 2);
+	CU_ASSERT_TRUE(ret);
+
+	/* Not significant for AAC */
+	caps[0] = caps[1] = adef_aac_lc_16b_48000hz_stereo_raw;
+	caps[1].pcm.container_width = 17;
+	CU_ASSERT_TRUE(adef_is_format_valid(&caps[1]));
+	CU_ASSERT_TRUE(adef_format_cmp(&caps[0], &caps[1]));
+}
+
+
+static void test_float_format(void)
+{
+	struct adef_format fmt = adef_pcm_f32_48000hz_stereo;
+	struct adef_format fmt2;
+
+	CU_ASSERT_TRUE(adef_is_format_valid(&fmt));
+	CU_ASSERT_EQUAL(adef_pcm_get_sample_size(&fmt), 4);
+
+	/* Single precision only */
+	fmt.bit_depth = 16;
+	CU_ASSERT_FALSE(adef_is_format_valid(&fmt));
+	fmt.bit_depth = 32;
+	fmt.pcm.container_width = 64;
+	CU_ASSERT_FALSE(adef_is_format_valid(&fmt));
+	fmt.pcm.container_width = 32;
+	CU_ASSERT_TRUE(adef_is_format_valid(&fmt));
+
+	/* The sign is not significant for floating-point formats */
+	fmt2 = fmt;
+	fmt2.pcm.signed_val = false;
+	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &fmt2));
+
+	/* 32-bit integer is not 32-bit float */
+	fmt2.pcm.signed_val = true;
+	fmt2.pcm.float_val = false;
+	CU_ASSERT_FALSE(adef_format_cmp(&fmt, &fmt2));
+	CU_ASSERT_FALSE(adef_format_intersect(&fmt, &fmt2, 1));
+	CU_ASSERT_FALSE(
+		adef_format_intersect(&fmt2, &adef_pcm_f32_48000hz_stereo, 1));
 }
 
 
 CU_TestInfo g_adef_test_format[] = {
 	{FN("is-format-valid"), &test_is_format_valid},
+	{FN("channel-layout"), &test_channel_layout},
 	{FN("format-cmp"), &test_format_cmp},
 	{FN("format-intersect"), &test_format_intersect},
+	{FN("container-width"), &test_container_width},
+	{FN("float-format"), &test_float_format},
 
 	CU_TEST_INFO_NULL,
 };
@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ADEFS_TEST_FORMAT_CORPUS_H_
+#define _ADEFS_TEST_FORMAT_CORPUS_H_
+
+/* Format strings shared by the C and C++ format parser tests, with the
+ * expected adef_format_from_str() return value */
+#define ADEF_TEST_FORMAT_CORPUS(_)                                             \
+	/* Builtin names */                                                    \
+	_("pcm_16b_48000hz_stereo", 0)                                         \
+	_("PCM_16B_8000HZ_MONO", 0)                                            \
+	_("Pcm_F32_96000hz_Stereo", 0)                                         \
+	_("aac_lc_16b_44100hz_mono_raw", 0)                                    \
+	_("aac_lc_16b_22050hz_stereo_adts", 0)                                 \
+	_("pcm_16b_48000hz_stereo ", -EINVAL)                                  \
+	_("pcm_16b_47999hz_stereo", -EINVAL)                                   \
+	/* Generic form */                                                     \
+	_("PCM/2/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", 0)                   \
+	_("pcm/2/16/48000/interleaved/signed/le/unknown", 0)                   \
+	_("AAC_LC/1/24/44100/PLANAR/UNSIGNED/BE/RAW", 0)                       \
+	_("aac_lc/2/16/48000/PLANAR/UNSIGNED/BE/adts", 0)                      \
+	_("UNKNOWN/0/0/0/PLANAR/UNSIGNED/BE/UNKNOWN", 0)                       \
+	_("MP3/2/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", 0)                   \
+	_("PCM/2/32/48000/INTERLEAVED/FLOAT/LE/UNKNOWN/STEREO", 0)             \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/0x3f", 0)              \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/0X3F", 0)              \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/077", 0)               \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/63", 0)                \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/5_1", 0)               \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/quad", 0)              \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/0", 0)                 \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/5_1/32", 0)            \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/5_1/32/extra", 0)      \
+	_("PCM/2/24/48000/PLANAR/SIGNED/LE/UNKNOWN/STEREO/ 32", 0)             \
+	_("PCM/+2/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", 0)                  \
+	_("PCM/ 2/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", 0)                  \
+	_("PCM/-0/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", 0)                  \
+	_("PCM/002/016/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", 0)                \
+	_("/PCM//2/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN/", 0)                \
+	_("PCM/2/16/48000/Interleaved/Signed/le/UNKNOWN", 0)                   \
+	_("PCM/2/16/48000/INTERLEAVED/float/LE/UNKNOWN", 0)                    \
+	_("PCM/2/16/4294967295/INTERLEAVED/SIGNED/LE/UNKNOWN", 0)              \
+	_("PCM/2/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN/-0", 0)                \
+	/* Errors */                                                           \
+	_("", -EINVAL)                                                         \
+	_("ABCDE", -EINVAL)                                                    \
+	_("A/B/C/D/E//", -EINVAL)                                              \
+	_("PCM/2/16/48000/INTERLEAVED/SIGNED/LE", -EINVAL)                     \
+	_("PCM/2/16/48000/INTERLEAVED/SIGNED/LE/", -EINVAL)                    \
+	_("PCM/2 /16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", -EINVAL)            \
+	_("PCM/-2/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", -EINVAL)            \
+	_("PCM/+/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", -EINVAL)             \
+	_("PCM/0x2/16/48000/INTERLEAVED/SIGNED/LE/UNKNOWN", -EINVAL)           \
+	_("PCM/2/16/4294967296/INTERLEAVED/SIGNED/LE/UNKNOWN", -EINVAL)        \
+	_("PCM/2/16/99999999999999999999/INTERLEAVED/SIGNED/LE/UNKNOWN",       \
+	  -EINVAL)                                                             \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/SURROUND", -EINVAL)    \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/0x", -EINVAL)          \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/08", -EINVAL)          \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/0x100000000", -EINVAL) \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/5_1/x", -EINVAL)       \
+	_("PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/5_1/32 ", -EINVAL)
+
+#endif /* !_ADEFS_TEST_FORMAT_CORPUS_H_ */
@@ -0,0 +1,443 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+#define TEST_DURATION 1024
+
+
+static void fill_stream(struct adef_frame_info *infos,
+			size_t count,
+			uint32_t timescale,
+			uint64_t duration)
+{
+	for (size_t i = 0; i < count; i++) {
+		infos[i].timestamp = 1000 + i * duration;
+		infos[i].timescale = timescale;
+		infos[i].capture_timestamp = 0;
+		infos[i].index = i;
+	}
+}
+
+
+static void test_frame_analyzer_events(void)
+{
+	int ret;
+	struct adef_frame_analyzer analyzer;
+	struct adef_frame_info infos[50];
+	struct adef_frame_event events[10];
+	size_t event_count = 0;
+
+	fill_stream(infos, 50, 48000, TEST_DURATION);
+	/* Missing frame at offset 10 */
+	for (size_t i = 10; i < 50; i++) {
+		infos[i].timestamp += TEST_DURATION;
+		infos[i].index++;
+	}
+	/* Half frame overlap at offset 20 */
+	for (size_t i = 20; i < 50; i++)
+		infos[i].timestamp -= TEST_DURATION / 2;
+	/* Backward index jump at offset 25 */
+	for (size_t i = 25; i < 50; i++)
+		infos[i].index -= 3;
+	/* Continuous time scale change at offset 30 */
+	for (size_t i = 30; i < 50; i++) {
+		infos[i].timestamp *= 2;
+		infos[i].timescale = 96000;
+	}
+	/* Small jitter (within tolerance) at offset 40 */
+	infos[40].timestamp += 4;
+
+	ret = adef_frame_analyzer_init(&analyzer, TEST_DURATION, 2);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_frame_analyzer_process(
+		&analyzer, infos, 50, events, 10, &event_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL_FATAL(event_count, 5);
+
+	CU_ASSERT_EQUAL(events[0].type, ADEF_FRAME_EVENT_INDEX_JUMP);
+	CU_ASSERT_EQUAL(events[0].offset, 10);
+	CU_ASSERT_EQUAL(events[0].value, 1);
+	CU_ASSERT_EQUAL(events[1].type, ADEF_FRAME_EVENT_GAP);
+	CU_ASSERT_EQUAL(events[1].offset, 10);
+	CU_ASSERT_EQUAL(events[1].value, TEST_DURATION);
+	CU_ASSERT_EQUAL(events[2].type, ADEF_FRAME_EVENT_OVERLAP);
+	CU_ASSERT_EQUAL(events[2].offset, 20);
+	CU_ASSERT_EQUAL(events[2].value, -TEST_DURATION / 2);
+	CU_ASSERT_EQUAL(events[3].type, ADEF_FRAME_EVENT_INDEX_JUMP);
+	CU_ASSERT_EQUAL(events[3].offset, 25);
+	CU_ASSERT_EQUAL(events[3].value, -3);
+	CU_ASSERT_EQUAL(events[4].type, ADEF_FRAME_EVENT_TIMESCALE_CHANGE);
+	CU_ASSERT_EQUAL(events[4].offset, 30);
+	CU_ASSERT_EQUAL(events[4].value, 96000);
+
+	CU_ASSERT_EQUAL(analyzer.counts[ADEF_FRAME_EVENT_GAP], 1);
+	CU_ASSERT_EQUAL(analyzer.counts[ADEF_FRAME_EVENT_OVERLAP], 1);
+	CU_ASSERT_EQUAL(analyzer.counts[ADEF_FRAME_EVENT_INDEX_JUMP], 2);
+	CU_ASSERT_EQUAL(analyzer.counts[ADEF_FRAME_EVENT_TIMESCALE_CHANGE], 1);
+	CU_ASSERT_EQUAL(analyzer.duration, 2 * TEST_DURATION);
+	CU_ASSERT_EQUAL(analyzer.tolerance, 4);
+
+	CU_ASSERT_STRING_EQUAL(
+		adef_frame_event_type_to_str(ADEF_FRAME_EVENT_GAP), "GAP");
+	CU_ASSERT_STRING_EQUAL(
+		adef_frame_event_type_to_str(ADEF_FRAME_EVENT_MAX), "UNKNOWN");
+}
+
+
+/* A time scale change before the nominal duration is learned does not
+ * give a gap or an overlap */
+static void test_frame_analyzer_learn(void)
+{
+	int ret;
+	struct adef_frame_analyzer analyzer;
+	struct adef_frame_info infos[20];
+	struct adef_frame_event events[10];
+	size_t event_count = 0;
+
+	fill_stream(infos, 20, 48000, TEST_DURATION);
+	for (size_t i = 1; i < 20; i++) {
+		infos[i].timestamp *= 2;
+		infos[i].timescale = 96000;
+	}
+	/* Gap after the duration is learned */
+	for (size_t i = 10; i < 20; i++)
+		infos[i].timestamp += 2 * TEST_DURATION;
+
+	ret = adef_frame_analyzer_init(&analyzer, 0, 2);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_frame_analyzer_process(
+		&analyzer, infos, 20, events, 10, &event_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL_FATAL(event_count, 2);
+
+	CU_ASSERT_EQUAL(events[0].type, ADEF_FRAME_EVENT_TIMESCALE_CHANGE);
+	CU_ASSERT_EQUAL(events[0].offset, 1);
+	CU_ASSERT_EQUAL(events[1].type, ADEF_FRAME_EVENT_GAP);
+	CU_ASSERT_EQUAL(events[1].offset, 10);
+	CU_ASSERT_EQUAL(events[1].value, 2 * TEST_DURATION);
+	CU_ASSERT_EQUAL(analyzer.duration, 2 * TEST_DURATION);
+	CU_ASSERT_EQUAL(analyzer.tolerance, 4);
+}
+
+
+static void test_frame_analyzer_stream(void)
+{
+	int ret;
+	struct adef_frame_analyzer analyzer;
+	struct adef_frame_info infos[100];
+	struct adef_frame_event events[2];
+	size_t event_count = 0;
+
+	/* Microsecond timestamps with alternate rounding, learned duration */
+	for (size_t i = 0; i < 100; i++) {
+		infos[i].timestamp =
+			(i * TEST_DURATION * 1000000 + 24000) / 48000;
+		infos[i].timescale = 1000000;
+		infos[i].capture_timestamp = 0;
+		infos[i].index = UINT32_MAX - 50 + i;
+	}
+	/* Gaps at offsets 30 and 60 and 90 */
+	for (size_t i = 30; i < 100; i++)
+		infos[i].timestamp += 100;
+	for (size_t i = 60; i < 100; i++)
+		infos[i].timestamp += 100;
+	for (size_t i = 90; i < 100; i++)
+		infos[i].timestamp += 100;
+
+	ret = adef_frame_analyzer_init(&analyzer, 0, 1);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	/* Analyze in chunks, with a too small events array; the index wraps
+	 * without index jumps */
+	for (size_t i = 0; i < 100; i += 25) {
+		ret = adef_frame_analyzer_process(
+			&analyzer, &infos[i], 25, events, 1, &event_count);
+		CU_ASSERT_EQUAL(ret, 0);
+		if (i == 25 || i == 50) {
+			CU_ASSERT_EQUAL(event_count, 1);
+			CU_ASSERT_EQUAL(events[0].type, ADEF_FRAME_EVENT_GAP);
+			CU_ASSERT_EQUAL(events[0].offset, i == 25 ? 30 : 60);
+			CU_ASSERT_DOUBLE_EQUAL(events[0].value, 100, 1);
+		} else if (i == 75) {
+			CU_ASSERT_EQUAL(event_count, 1);
+			CU_ASSERT_EQUAL(events[0].offset, 90);
+		} else {
+			CU_ASSERT_EQUAL(event_count, 0);
+		}
+	}
+	CU_ASSERT_EQUAL(analyzer.counts[ADEF_FRAME_EVENT_GAP], 3);
+	CU_ASSERT_EQUAL(analyzer.counts[ADEF_FRAME_EVENT_INDEX_JUMP], 0);
+	CU_ASSERT_EQUAL(analyzer.offset, 100);
+
+	/* Events are counted beyond the array size, and the array is
+	 * optional */
+	ret = adef_frame_analyzer_init(&analyzer, 0, 1);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_frame_analyzer_process(
+		&analyzer, infos, 100, events, 2, &event_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(event_count, 2);
+	CU_ASSERT_EQUAL(analyzer.counts[ADEF_FRAME_EVENT_GAP], 3);
+	ret = adef_frame_analyzer_init(&analyzer, 0, 1);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_frame_analyzer_process(&analyzer, infos, 100, NULL, 0, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(analyzer.counts[ADEF_FRAME_EVENT_GAP], 3);
+
+	/* Invalid arguments */
+	ret = adef_frame_analyzer_init(NULL, 0, 0);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_frame_analyzer_process(&analyzer, NULL, 1, NULL, 0, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_frame_analyzer_process(&analyzer, infos, 1, NULL, 1, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+static void test_frame_analyzer_large(void)
+{
+	int ret;
+	struct adef_frame_analyzer analyzer;
+	const size_t count = 1000000;
+	struct adef_frame_info *infos;
+	struct adef_frame_event events[4];
+	size_t event_count = 0;
+
+	infos = calloc(count, sizeof(*infos));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(infos);
+	fill_stream(infos, count, 48000, TEST_DURATION);
+	infos[count / 2].timescale = 0;
+
+	ret = adef_frame_analyzer_init(&analyzer, TEST_DURATION, 0);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_frame_analyzer_process(
+		&analyzer, infos, count, events, 4, &event_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	/* Timestamps are not checked when the time scale is 0 */
+	CU_ASSERT_EQUAL(event_count, 2);
+	CU_ASSERT_EQUAL(events[0].type, ADEF_FRAME_EVENT_TIMESCALE_CHANGE);
+	CU_ASSERT_EQUAL(events[0].offset, count / 2);
+	CU_ASSERT_EQUAL(events[0].value, 0);
+	CU_ASSERT_EQUAL(events[1].type, ADEF_FRAME_EVENT_TIMESCALE_CHANGE);
+	CU_ASSERT_EQUAL(events[1].offset, count / 2 + 1);
+	CU_ASSERT_EQUAL(events[1].value, 48000);
+	CU_ASSERT_EQUAL(analyzer.offset, count);
+
+	free(infos);
+}
+
+
+static bool frame_infos_equal(const struct adef_frame_info *infos1,
+			      const struct adef_frame_info *infos2,
+			      size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (infos1[i].timestamp != infos2[i].timestamp ||
+		    infos1[i].timescale != infos2[i].timescale ||
+		    infos1[i].capture_timestamp !=
+			    infos2[i].capture_timestamp ||
+		    infos1[i].index != infos2[i].index)
+			return false;
+	}
+	return true;
+}
+
+
+static void test_frame_recorder(void)
+{
+	int ret;
+	struct adef_frame_recorder *recorder = NULL;
+	const size_t count = 10000;
+	struct adef_frame_info *infos, *decoded;
+	const void *data;
+	size_t size, decoded_count = 0;
+	uint32_t seed = 1;
+
+	infos = calloc(count, sizeof(*infos));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(infos);
+	decoded = calloc(count, sizeof(*decoded));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(decoded);
+
+	/* Regular stream with capture timestamp jitter, a gap and a time
+	 * scale change */
+	fill_stream(infos, count, 48000, TEST_DURATION);
+	for (size_t i = 0; i < count; i++) {
+		seed = seed * 1103515245 + 12345;
+		infos[i].capture_timestamp =
+			5000000000 + i * 21333 + (seed >> 16) % 61;
+		if (i >= 5000) {
+			infos[i].timestamp += 3 * TEST_DURATION;
+			infos[i].index += 3;
+		}
+		if (i >= 8000) {
+			infos[i].timescale = 44100;
+			infos[i].timestamp = i * TEST_DURATION;
+		}
+	}
+
+	ret = adef_frame_recorder_new(0, &recorder);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	for (size_t i = 0; i < count; i += 777) {
+		size_t n = (count - i < 777) ? count - i : 777;
+		ret = adef_frame_recorder_append(recorder, &infos[i], n);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	ret = adef_frame_recorder_flush(recorder);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_frame_recorder_get_data(recorder, &data, &size);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	/* Around one byte per record for the capture timestamp jitter */
+	CU_ASSERT_TRUE(size < count * 5 / 4);
+
+	ret = adef_frame_info_decode_count(data, size, &decoded_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(decoded_count, count);
+	ret = adef_frame_info_decode(
+		data, size, decoded, count - 1, &decoded_count);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+	ret = adef_frame_info_decode(
+		data, size, decoded, count, &decoded_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(decoded_count, count);
+	CU_ASSERT_TRUE(frame_infos_equal(infos, decoded, count));
+
+	/* Truncated data */
+	ret = adef_frame_info_decode(
+		data, size - 1, decoded, count, &decoded_count);
+	CU_ASSERT_EQUAL(ret, -EPROTO);
+	ret = adef_frame_info_decode_count(data, size - 1, &decoded_count);
+	CU_ASSERT_EQUAL(ret, -EPROTO);
+
+	/* Cleared data, pending records kept until flushed */
+	ret = adef_frame_recorder_clear(recorder);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_frame_recorder_append(recorder, infos, 10);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_frame_recorder_get_data(recorder, &data, &size);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(size, 0);
+	ret = adef_frame_recorder_flush(recorder);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_frame_recorder_get_data(recorder, &data, &size);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_frame_info_decode(
+		data, size, decoded, count, &decoded_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(decoded_count, 10);
+	CU_ASSERT_TRUE(frame_infos_equal(infos, decoded, 10));
+
+	ret = adef_frame_recorder_destroy(recorder);
+	CU_ASSERT_EQUAL(ret, 0);
+	free(infos);
+	free(decoded);
+}
+
+
+static void test_frame_recorder_values(void)
+{
+	int ret;
+	struct adef_frame_recorder *recorder = NULL;
+	struct adef_frame_info infos[200], decoded[200];
+	const void *data;
+	size_t size, decoded_count = 0;
+	uint64_t seed = 1;
+
+	/* Arbitrary values: full-width residuals and wrap-arounds */
+	for (size_t i = 0; i < 200; i++) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		infos[i].timestamp = (i % 3 == 0) ? UINT64_MAX - i : seed;
+		infos[i].timescale = (uint32_t)(seed >> 32);
+		infos[i].capture_timestamp = (i % 2 == 0) ? 0 : ~seed;
+		infos[i].index = UINT32_MAX - 100 + i;
+	}
+
+	/* Block sizes not multiple of the packing group size */
+	ret = adef_frame_recorder_new(7, &recorder);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_frame_recorder_append(recorder, infos, 200);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_frame_recorder_flush(recorder);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_frame_recorder_get_data(recorder, &data, &size);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_frame_info_decode(data, size, decoded, 200, &decoded_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(decoded_count, 200);
+	CU_ASSERT_TRUE(frame_infos_equal(infos, decoded, 200));
+	ret = adef_frame_recorder_destroy(recorder);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = adef_frame_recorder_new(100, &recorder);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_frame_recorder_append(recorder, infos, 200);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_frame_recorder_get_data(recorder, &data, &size);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_frame_info_decode(data, size, decoded, 200, &decoded_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(decoded_count, 200);
+	CU_ASSERT_TRUE(frame_infos_equal(infos, decoded, 200));
+
+	/* Empty data */
+	ret = adef_frame_info_decode(NULL, 0, NULL, 0, &decoded_count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(decoded_count, 0);
+
+	/* Invalid arguments */
+	ret = adef_frame_recorder_new(0, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_frame_recorder_append(NULL, infos, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_frame_recorder_append(recorder, NULL, 1);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_frame_recorder_flush(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_frame_recorder_get_data(recorder, NULL, &size);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_frame_info_decode(data, size, NULL, 200, &decoded_count);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_frame_info_decode_count(data, size, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_frame_recorder_destroy(recorder);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_frame_recorder_destroy(NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+CU_TestInfo g_adef_test_frame[] = {
+	{FN("frame-analyzer-events"), &test_frame_analyzer_events},
+	{FN("frame-analyzer-learn"), &test_frame_analyzer_learn},
+	{FN("frame-analyzer-stream"), &test_frame_analyzer_stream},
+	{FN("frame-analyzer-large"), &test_frame_analyzer_large},
+	{FN("frame-recorder"), &test_frame_recorder},
+	{FN("frame-recorder-values"), &test_frame_recorder_values},
+
+	CU_TEST_INFO_NULL,
+};
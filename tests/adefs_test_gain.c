@@ -0,0 +1,215 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+#define FRAMES 300
+
+
+static int16_t s_data[2 * FRAMES];
+
+
+static void fill(int16_t value)
+{
+	for (unsigned int i = 0; i < 2 * FRAMES; i++)
+		s_data[i] = value;
+}
+
+
+static void test_gain_args(void)
+{
+	int ret;
+	struct adef_pcm_gain gain;
+	struct adef_pcm_buffer buf = {.data = s_data, .frames = FRAMES};
+	struct adef_frame_info info = {.timestamp = 0};
+
+	ret = adef_pcm_gain_init(NULL, &adef_pcm_16b_48000hz_stereo, 1.f);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_gain_init(
+		&gain, &adef_aac_lc_16b_48000hz_stereo_raw, 1.f);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_gain_init(&gain, &adef_pcm_16b_48000hz_stereo, NAN);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_gain_init(&gain, &adef_pcm_16b_48000hz_stereo, 1.f);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = adef_pcm_gain_set_ramp(
+		&gain, 0.f, ADEF_PCM_RAMP_MAX, NULL, 10);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_gain_set_ramp(
+		&gain, -1.f, ADEF_PCM_RAMP_EXPONENTIAL, NULL, 10);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_gain_set_ramp(
+		&gain, 0.f, ADEF_PCM_RAMP_LINEAR, &info, 10);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_pcm_gain_process(&gain, NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	buf.data = NULL;
+	ret = adef_pcm_gain_process(&gain, &buf, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+static void test_gain_constant(void)
+{
+	int ret;
+	struct adef_pcm_gain gain;
+	struct adef_pcm_buffer buf = {.data = s_data, .frames = FRAMES};
+
+	/* Unity gain */
+	fill(12345);
+	ret = adef_pcm_gain_init(&gain, &adef_pcm_16b_48000hz_stereo, 1.f);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_process(&gain, &buf, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 2 * FRAMES; i++)
+		CU_ASSERT_EQUAL(s_data[i], 12345);
+
+	/* Attenuation, with rounding */
+	ret = adef_pcm_gain_init(&gain, &adef_pcm_16b_48000hz_stereo, 0.5f);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_process(&gain, &buf, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 2 * FRAMES; i++)
+		CU_ASSERT_EQUAL(s_data[i], 6173);
+
+	/* Saturation */
+	fill(-20000);
+	ret = adef_pcm_gain_init(&gain, &adef_pcm_16b_48000hz_stereo, 2.f);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_process(&gain, &buf, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 2 * FRAMES; i++)
+		CU_ASSERT_EQUAL(s_data[i], INT16_MIN);
+}
+
+
+static void test_gain_linear(void)
+{
+	int ret;
+	struct adef_pcm_gain gain;
+	struct adef_pcm_buffer buf = {.data = s_data, .frames = 100};
+	/* Fade-in on frame 48050 (96 kHz time scale) over 100 frames */
+	struct adef_frame_info start = {
+		.timestamp = 2 * 48050,
+		.timescale = 96000,
+	};
+	struct adef_frame_info info = {
+		.timestamp = 48000,
+		.timescale = 48000,
+	};
+
+	fill(10000);
+	ret = adef_pcm_gain_init(&gain, &adef_pcm_16b_48000hz_stereo, 0.f);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_set_ramp(
+		&gain, 1.f, ADEF_PCM_RAMP_LINEAR, &start, 100);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Three consecutive buffers of 100 frames from frame 48000 */
+	for (unsigned int b = 0; b < 3; b++) {
+		buf.data = s_data + 2 * 100 * b;
+		ret = adef_pcm_gain_process(&gain, &buf, b == 0 ? &info : NULL);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	for (unsigned int i = 0; i < FRAMES; i++) {
+		double expected = i < 50 ? 0. : (i - 50) * 100.;
+		if (i >= 150)
+			expected = 10000.;
+		CU_ASSERT_DOUBLE_EQUAL(s_data[2 * i], expected, 1.);
+		CU_ASSERT_EQUAL(s_data[2 * i], s_data[2 * i + 1]);
+	}
+	CU_ASSERT_EQUAL(s_data[2 * 49], 0);
+	CU_ASSERT_EQUAL(s_data[2 * 150], 10000);
+}
+
+
+static void test_gain_exponential(void)
+{
+	int ret;
+	struct adef_pcm_gain gain;
+	struct adef_pcm_buffer buf = {.data = s_data, .frames = FRAMES};
+	struct adef_frame_info info = {
+		.timestamp = 1000,
+		.timescale = 48000,
+	};
+
+	/* Fade-out starting on the next buffer */
+	fill(10000);
+	ret = adef_pcm_gain_init(&gain, &adef_pcm_16b_48000hz_stereo, 1.f);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_set_ramp(
+		&gain, 0.f, ADEF_PCM_RAMP_EXPONENTIAL, NULL, 200);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_process(&gain, &buf, &info);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	CU_ASSERT_EQUAL(s_data[0], 10000);
+	/* -40 dB at half the ramp, -80 dB floor then 0 */
+	CU_ASSERT_DOUBLE_EQUAL(s_data[2 * 100], 100., 1.);
+	for (unsigned int i = 1; i < 200; i++)
+		CU_ASSERT_TRUE(s_data[2 * i] <= s_data[2 * i - 2]);
+	for (unsigned int i = 200; i < FRAMES; i++)
+		CU_ASSERT_EQUAL(s_data[2 * i], 0);
+}
+
+
+static void test_gain_generic_planar(void)
+{
+	int ret;
+	struct adef_format format = adef_pcm_16b_48000hz_stereo;
+	struct adef_pcm_gain gain;
+	/* 24-bit little-endian planar, 2 frames: 0x200000, -0x200000 */
+	uint8_t data[12] = {
+		0x00, 0x00, 0x20, 0x00, 0x00, 0x20,
+		0x00, 0x00, 0xe0, 0x00, 0x00, 0xe0,
+	};
+	struct adef_pcm_buffer buf = {.data = data, .frames = 2};
+
+	format.bit_depth = 24;
+	format.pcm.interleaved = false;
+	ret = adef_pcm_gain_init(&gain, &format, 0.25f);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_process(&gain, &buf, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(data[2], 0x08);
+	CU_ASSERT_EQUAL(data[5], 0x08);
+	CU_ASSERT_EQUAL(data[8], 0xf8);
+	CU_ASSERT_EQUAL(data[11], 0xf8);
+}
+
+
+CU_TestInfo g_adef_test_gain[] = {
+	{FN("gain-args"), &test_gain_args},
+	{FN("gain-constant"), &test_gain_constant},
+	{FN("gain-linear"), &test_gain_linear},
+	{FN("gain-exponential"), &test_gain_exponential},
+	{FN("gain-generic-planar"), &test_gain_generic_planar},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,396 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+/* Chunk size of the test signals, not a multiple of the block sizes */
+#define TEST_CHUNK 1000
+
+
+/* Sine test signal, on some of the channels (the others are silent) */
+struct test_signal {
+	const struct adef_format *format;
+	uint32_t channels;
+	double frequency;
+	double phase;
+	uint64_t position;
+};
+
+
+/* Feed a loudness meter with a duration of the test signal at a peak
+ * level in dBFS, in chunks of 'chunk' frames; return the first error */
+static int feed(struct adef_pcm_loudness *loudness,
+		struct test_signal *sig,
+		double level,
+		double duration,
+		size_t chunk)
+{
+	int ret = 0;
+	const struct adef_format *format = sig->format;
+	unsigned int count = format->channel_count;
+	size_t frames = (size_t)(duration * format->sample_rate);
+	double a = pow(10., level / 20.);
+	float *f32;
+	int16_t *s16;
+	struct adef_pcm_buffer buf;
+
+	f32 = calloc(chunk * count, sizeof(float));
+	if (f32 == NULL)
+		return -ENOMEM;
+	s16 = (int16_t *)f32;
+
+	for (size_t f = 0; f < frames && ret == 0; f += buf.frames) {
+		buf.data = f32;
+		buf.frames = frames - f < chunk ? frames - f : chunk;
+		buf.plane_stride = 0;
+		for (size_t i = 0; i < buf.frames; i++, sig->position++) {
+			double v = a * sin(2. * M_PI * sig->frequency *
+						   sig->position /
+						   format->sample_rate +
+					   sig->phase);
+			for (unsigned int c = 0; c < count; c++) {
+				double x = (sig->channels & (1u << c)) ? v : 0.;
+				size_t j = format->pcm.interleaved
+						   ? i * count + c
+						   : c * buf.frames + i;
+				if (format->pcm.float_val)
+					f32[j] = (float)x;
+				else
+					s16[j] = (int16_t)lrint(x * 32767.);
+			}
+		}
+		ret = adef_pcm_loudness_update(loudness, &buf);
+	}
+
+	free(f32);
+	return ret;
+}
+
+
+static void test_loudness_args(void)
+{
+	int ret;
+	struct adef_pcm_loudness *loudness;
+	struct adef_pcm_loudness_values values;
+	struct adef_pcm_buffer buf = {.data = NULL, .frames = 1};
+
+	ret = adef_pcm_loudness_new(NULL, &loudness);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_loudness_new(&adef_pcm_16b_48000hz_stereo, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_loudness_new(&adef_aac_lc_16b_48000hz_stereo_raw,
+				    &loudness);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_loudness_new(&adef_pcm_16b_8000hz_stereo, &loudness);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_loudness_destroy(loudness);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = adef_pcm_loudness_new(&adef_pcm_16b_48000hz_stereo, &loudness);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	ret = adef_pcm_loudness_update(loudness, &buf);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_loudness_update(loudness, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_loudness_update(NULL, &buf);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_loudness_get_values(loudness, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_loudness_get_values(NULL, &values);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_loudness_reset(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Empty buffer, no measurement */
+	buf.frames = 0;
+	ret = adef_pcm_loudness_update(loudness, &buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_loudness_get_values(loudness, &values);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(isinf(values.momentary) && values.momentary < 0.f);
+	CU_ASSERT_TRUE(isinf(values.integrated) && values.integrated < 0.f);
+	CU_ASSERT_TRUE(isinf(values.true_peak) && values.true_peak < 0.f);
+	CU_ASSERT_EQUAL(values.range, 0.f);
+	CU_ASSERT_EQUAL(values.frames, 0);
+
+	ret = adef_pcm_loudness_destroy(loudness);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_loudness_destroy(NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+/* EBU Tech 3341 test cases 1 and 2: 1 kHz stereo sine at -23 and -33 dBFS
+ * (shortened), at several sample rates and sample formats */
+static void test_loudness_sine(void)
+{
+	int ret;
+	struct adef_format formats[3] = {
+		adef_pcm_16b_48000hz_stereo,
+		adef_pcm_f32_48000hz_stereo,
+		adef_pcm_f32_48000hz_stereo,
+	};
+	struct adef_pcm_loudness *loudness;
+	struct adef_pcm_loudness_values values;
+
+	formats[1].sample_rate = 44100;
+	formats[1].pcm.interleaved = false;
+	formats[2].sample_rate = 96000;
+
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(formats); i++) {
+		struct test_signal sig = {
+			.format = &formats[i],
+			.channels = 0x3,
+			.frequency = 1000.,
+		};
+
+		ret = adef_pcm_loudness_new(&formats[i], &loudness);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+		ret = feed(loudness, &sig, -23., 5., TEST_CHUNK);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = adef_pcm_loudness_get_values(loudness, &values);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_DOUBLE_EQUAL(values.momentary, -23., 0.1);
+		CU_ASSERT_DOUBLE_EQUAL(values.momentary_max, -23., 0.1);
+		CU_ASSERT_DOUBLE_EQUAL(values.short_term, -23., 0.1);
+		CU_ASSERT_DOUBLE_EQUAL(values.short_term_max, -23., 0.1);
+		CU_ASSERT_DOUBLE_EQUAL(values.integrated, -23., 0.1);
+		CU_ASSERT_DOUBLE_EQUAL(values.range, 0., 0.1);
+		CU_ASSERT_DOUBLE_EQUAL(values.true_peak, -23., 0.2);
+		CU_ASSERT_EQUAL(values.frames, 5 * formats[i].sample_rate);
+
+		ret = adef_pcm_loudness_reset(loudness);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = adef_pcm_loudness_get_values(loudness, &values);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_TRUE(isinf(values.momentary_max));
+		CU_ASSERT_TRUE(isinf(values.integrated));
+		CU_ASSERT_EQUAL(values.frames, 0);
+
+		ret = feed(loudness, &sig, -33., 4., TEST_CHUNK);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = adef_pcm_loudness_get_values(loudness, &values);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_DOUBLE_EQUAL(values.momentary, -33., 0.1);
+		CU_ASSERT_DOUBLE_EQUAL(values.short_term, -33., 0.1);
+		CU_ASSERT_DOUBLE_EQUAL(values.integrated, -33., 0.1);
+		CU_ASSERT_DOUBLE_EQUAL(values.true_peak, -33., 0.2);
+
+		ret = adef_pcm_loudness_destroy(loudness);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+}
+
+
+/* Gating: EBU Tech 3341 test case 3, and EBU Tech 3342 test case 1 with
+ * 10 s parts */
+static void test_loudness_gating(void)
+{
+	int ret;
+	struct adef_pcm_loudness *loudness;
+	struct adef_pcm_loudness_values values;
+	struct test_signal sig = {
+		.format = &adef_pcm_f32_48000hz_stereo,
+		.channels = 0x3,
+		.frequency = 1000.,
+	};
+
+	ret = adef_pcm_loudness_new(sig.format, &loudness);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	/* The quiet parts are below the relative gate */
+	ret = feed(loudness, &sig, -36., 10., TEST_CHUNK);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = feed(loudness, &sig, -23., 60., TEST_CHUNK);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = feed(loudness, &sig, -36., 10., TEST_CHUNK);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_loudness_get_values(loudness, &values);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(values.integrated, -23., 0.1);
+	CU_ASSERT_DOUBLE_EQUAL(values.momentary, -36., 0.1);
+	CU_ASSERT_DOUBLE_EQUAL(values.momentary_max, -23., 0.1);
+
+	/* Silence is below the absolute gate */
+	ret = feed(loudness, &sig, -INFINITY, 5., TEST_CHUNK);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_loudness_get_values(loudness, &values);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(values.integrated, -23., 0.1);
+	CU_ASSERT_TRUE(isinf(values.momentary));
+	CU_ASSERT_TRUE(isinf(values.short_term));
+
+	/* Loudness range of 10 LU */
+	ret = adef_pcm_loudness_reset(loudness);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = feed(loudness, &sig, -20., 10., TEST_CHUNK);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = feed(loudness, &sig, -30., 10., TEST_CHUNK);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_loudness_get_values(loudness, &values);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(values.range, 10., 1.);
+	CU_ASSERT_DOUBLE_EQUAL(values.short_term_max, -20., 0.1);
+
+	ret = adef_pcm_loudness_destroy(loudness);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+/* True peak of a sine at a quarter of the sample rate, sampled 45 degrees
+ * off its peaks (the sample peak is 3 dB below the true peak) */
+static void test_loudness_true_peak(void)
+{
+	int ret;
+	struct adef_pcm_loudness *loudness;
+	struct adef_pcm_loudness_values values;
+	struct test_signal sig = {
+		.format = &adef_pcm_16b_48000hz_stereo,
+		.channels = 0x2,
+		.frequency = 12000.,
+		.phase = M_PI / 4.,
+	};
+
+	ret = adef_pcm_loudness_new(sig.format, &loudness);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	ret = feed(loudness, &sig, -6., 1., TEST_CHUNK);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_loudness_get_values(loudness, &values);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(values.true_peak, -6., 0.3);
+
+	ret = adef_pcm_loudness_destroy(loudness);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+/* Channel weights, with two channel groups */
+static void test_loudness_channels(void)
+{
+	int ret;
+	struct adef_format format = adef_pcm_f32_48000hz_stereo;
+	struct adef_pcm_loudness *loudness;
+	struct adef_pcm_loudness_values values;
+	struct test_signal sig = {
+		.format = &format,
+		.frequency = 1000.,
+	};
+	static const struct {
+		unsigned int channel_count;
+		uint32_t channel_layout;
+		uint32_t channels;
+		double expected;
+	} cases[] = {
+		/* Front left: a mono sine is 3 dB below the stereo sine */
+		{6, ADEF_CHANNEL_LAYOUT_5_1, 0x01, -26.01},
+		/* Low frequency effects: ignored */
+		{6, ADEF_CHANNEL_LAYOUT_5_1, 0x08, -INFINITY},
+		/* Back left: +1.5 dB */
+		{6, ADEF_CHANNEL_LAYOUT_5_1, 0x10, -24.52},
+		/* Side right: +1.5 dB */
+		{8, ADEF_CHANNEL_LAYOUT_7_1, 0x80, -24.52},
+		/* Unspecified layout: default layout of the channel count
+		 * (5.1), or unit weights without default layout */
+		{6, ADEF_CHANNEL_LAYOUT_UNSPECIFIED, 0x01, -26.01},
+		{6, ADEF_CHANNEL_LAYOUT_UNSPECIFIED, 0x08, -INFINITY},
+		{6, ADEF_CHANNEL_LAYOUT_UNSPECIFIED, 0x10, -24.52},
+		{11, ADEF_CHANNEL_LAYOUT_UNSPECIFIED, 0x401, -23.},
+	};
+
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(cases); i++) {
+		format.channel_count = cases[i].channel_count;
+		format.channel_layout = cases[i].channel_layout;
+		sig.channels = cases[i].channels;
+		sig.position = 0;
+
+		ret = adef_pcm_loudness_new(&format, &loudness);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		ret = feed(loudness, &sig, -23., 1., TEST_CHUNK);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = adef_pcm_loudness_get_values(loudness, &values);
+		CU_ASSERT_EQUAL(ret, 0);
+		if (isinf(cases[i].expected))
+			CU_ASSERT_TRUE(isinf(values.integrated));
+		else
+			CU_ASSERT_DOUBLE_EQUAL(
+				values.integrated, cases[i].expected, 0.1);
+		/* The true peak ignores the channel weights */
+		CU_ASSERT_DOUBLE_EQUAL(values.true_peak, -23., 0.2);
+		ret = adef_pcm_loudness_destroy(loudness);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+}
+
+
+/* The measurement does not depend on the buffer sizes */
+static void test_loudness_chunks(void)
+{
+	int ret;
+	struct adef_pcm_loudness *loudness[2];
+	struct adef_pcm_loudness_values values[2];
+	static const size_t chunks[2] = {48000, 77};
+
+	for (unsigned int i = 0; i < 2; i++) {
+		struct test_signal sig = {
+			.format = &adef_pcm_16b_48000hz_stereo,
+			.channels = 0x1,
+			.frequency = 440.,
+		};
+		ret = adef_pcm_loudness_new(sig.format, &loudness[i]);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+		ret = feed(loudness[i], &sig, -18., 2., chunks[i]);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = feed(loudness[i], &sig, -28., 2.05, chunks[i]);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = adef_pcm_loudness_get_values(loudness[i], &values[i]);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = adef_pcm_loudness_destroy(loudness[i]);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	CU_ASSERT_DOUBLE_EQUAL(values[0].momentary, values[1].momentary, 1e-3);
+	CU_ASSERT_DOUBLE_EQUAL(
+		values[0].short_term, values[1].short_term, 1e-3);
+	CU_ASSERT_DOUBLE_EQUAL(
+		values[0].integrated, values[1].integrated, 1e-3);
+	CU_ASSERT_DOUBLE_EQUAL(values[0].true_peak, values[1].true_peak, 1e-3);
+	CU_ASSERT_EQUAL(values[0].frames, values[1].frames);
+}
+
+
+CU_TestInfo g_adef_test_loudness[] = {
+	{FN("loudness-args"), &test_loudness_args},
+	{FN("loudness-sine"), &test_loudness_sine},
+	{FN("loudness-gating"), &test_loudness_gating},
+	{FN("loudness-true-peak"), &test_loudness_true_peak},
+	{FN("loudness-channels"), &test_loudness_channels},
+	{FN("loudness-chunks"), &test_loudness_chunks},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+static void test_meter_s16(void)
+{
+	int ret;
+	int16_t data[2 * 100];
+	struct adef_pcm_buffer buf = {.data = data, .frames = 100};
+	struct adef_pcm_level levels[2];
+
+	/* Left: constant half scale; right: full scale square wave */
+	for (unsigned int i = 0; i < 100; i++) {
+		data[2 * i] = 16384;
+		data[2 * i + 1] = (i & 1) ? INT16_MIN : INT16_MAX;
+	}
+
+	ret = adef_pcm_get_levels(NULL, &buf, levels, 2);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_get_levels(&adef_aac_lc_16b_48000hz_stereo_raw,
+				  &buf,
+				  levels,
+				  2);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_get_levels(
+		&adef_pcm_16b_48000hz_stereo, NULL, levels, 2);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_pcm_get_levels(
+		&adef_pcm_16b_48000hz_stereo, &buf, levels, 2);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(levels[0].peak, 0.5, 1e-4);
+	CU_ASSERT_DOUBLE_EQUAL(levels[0].rms, 0.5, 1e-4);
+	CU_ASSERT_EQUAL(levels[0].clip_count, 0);
+	CU_ASSERT_DOUBLE_EQUAL(levels[1].peak, 1.0, 1e-4);
+	CU_ASSERT_DOUBLE_EQUAL(levels[1].rms, 1.0, 1e-4);
+	CU_ASSERT_EQUAL(levels[1].clip_count, 100);
+}
+
+
+static void test_meter_formats(void)
+{
+	int ret;
+	struct adef_format fmt = adef_pcm_16b_48000hz_mono;
+	uint8_t data[3 * 37];
+	struct adef_pcm_buffer buf = {.data = data, .frames = 37};
+	struct adef_pcm_level level;
+
+	/* 24-bit big-endian unsigned, quarter scale negative peak */
+	fmt.bit_depth = 24;
+	fmt.pcm.signed_val = false;
+	fmt.pcm.little_endian = false;
+	for (unsigned int i = 0; i < 37; i++) {
+		/* 0x800000 is zero, 0x600000 is -0.25 */
+		data[3 * i] = (i == 20) ? 0x60 : 0x80;
+		data[3 * i + 1] = 0;
+		data[3 * i + 2] = 0;
+	}
+	ret = adef_pcm_get_levels(&fmt, &buf, &level, 1);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(level.peak, 0.25, 1e-6);
+	CU_ASSERT_DOUBLE_EQUAL(level.rms, sqrt(0.0625 / 37), 1e-6);
+	CU_ASSERT_EQUAL(level.clip_count, 0);
+
+	/* Clipping at the minimum value */
+	data[0] = 0;
+	ret = adef_pcm_get_levels(&fmt, &buf, &level, 1);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(level.peak, 1.0, 1e-6);
+	CU_ASSERT_EQUAL(level.clip_count, 1);
+}
+
+
+static void test_meter_accumulate(void)
+{
+	int ret;
+	struct adef_format fmt = adef_pcm_16b_48000hz_stereo;
+	int16_t data[2 * 1000];
+	struct adef_pcm_buffer buf = {.data = data, .frames = 1000};
+	struct adef_pcm_meter meter;
+	struct adef_pcm_level levels[2];
+
+	/* Planar: left at 0.25, right at -0.5 */
+	fmt.pcm.interleaved = false;
+	for (unsigned int i = 0; i < 1000; i++) {
+		data[i] = 8192;
+		data[1000 + i] = -16384;
+	}
+
+	ret = adef_pcm_meter_reset(&meter, &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_meter_update(&meter, &buf);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Second window part: silence */
+	memset(data, 0, sizeof(data));
+	ret = adef_pcm_meter_update(&meter, &buf);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = adef_pcm_meter_get_levels(&meter, levels, 2);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_DOUBLE_EQUAL(levels[0].peak, 0.25, 1e-4);
+	CU_ASSERT_DOUBLE_EQUAL(levels[0].rms, 0.25 / sqrt(2), 1e-4);
+	CU_ASSERT_DOUBLE_EQUAL(levels[1].peak, 0.5, 1e-4);
+	CU_ASSERT_DOUBLE_EQUAL(levels[1].rms, 0.5 / sqrt(2), 1e-4);
+
+	ret = adef_pcm_meter_reset(&meter, &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_meter_get_levels(&meter, levels, 2);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(levels[0].peak, 0.f);
+	CU_ASSERT_EQUAL(levels[0].rms, 0.f);
+}
+
+
+static void test_meter_windows(void)
+{
+	int ret;
+	struct adef_format fmt = adef_pcm_16b_48000hz_stereo;
+	int16_t data[2][250];
+	struct adef_pcm_buffer buf = {.data = data, .frames = 250};
+	struct adef_pcm_level levels[2 * 3];
+	size_t windows;
+
+	/* Planar, one window per level step, the last one partial */
+	fmt.pcm.interleaved = false;
+	for (unsigned int i = 0; i < 250; i++) {
+		data[0][i] = (i / 100 + 1) * 4096;
+		data[1][i] = -(int)(i / 100 + 1) * 8192;
+	}
+	ret = adef_pcm_get_window_levels(&fmt, &buf, 100, levels, 6, &windows);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(windows, 3);
+	for (unsigned int w = 0; w < 3; w++) {
+		CU_ASSERT_DOUBLE_EQUAL(
+			levels[2 * w].peak, (w + 1) / 8., 1e-4);
+		CU_ASSERT_DOUBLE_EQUAL(levels[2 * w].rms, (w + 1) / 8., 1e-4);
+		CU_ASSERT_DOUBLE_EQUAL(
+			levels[2 * w + 1].peak, (w + 1) / 4., 1e-4);
+	}
+
+	ret = adef_pcm_get_window_levels(&fmt, &buf, 100, levels, 5, &windows);
+	CU_ASSERT_EQUAL(ret, -ENOBUFS);
+	CU_ASSERT_EQUAL(windows, 3);
+	ret = adef_pcm_get_window_levels(&fmt, &buf, 0, levels, 6, &windows);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_get_window_levels(NULL, &buf, 100, levels, 6, &windows);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+CU_TestInfo g_adef_test_meter[] = {
+	{FN("meter-s16"), &test_meter_s16},
+	{FN("meter-formats"), &test_meter_formats},
+	{FN("meter-accumulate"), &test_meter_accumulate},
+	{FN("meter-windows"), &test_meter_windows},
+
+	CU_TEST_INFO_NULL,
+};
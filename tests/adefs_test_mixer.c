@@ -0,0 +1,262 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+static void test_mixer_args(void)
+{
+	int ret;
+	struct adef_pcm_mixer mixer;
+	struct adef_pcm_mixer_input inputs[ADEF_PCM_MIXER_MAX_INPUTS + 1];
+	int16_t data[4];
+	struct adef_pcm_buffer out = {.data = data, .frames = 2};
+
+	ret = adef_pcm_mixer_init(NULL, &adef_pcm_16b_48000hz_stereo);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_mixer_init(&mixer, &adef_aac_lc_16b_48000hz_stereo_raw);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_mixer_init(&mixer, &adef_pcm_16b_48000hz_stereo);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	memset(inputs, 0, sizeof(inputs));
+	ret = adef_pcm_mixer_process(&mixer, NULL, 1, &out, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_mixer_process(&mixer, inputs, 1, NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_mixer_process(
+		&mixer, inputs, ADEF_PCM_MIXER_MAX_INPUTS + 1, &out, NULL);
+	CU_ASSERT_EQUAL(ret, -E2BIG);
+
+	/* No input: silence */
+	memset(data, 0x55, sizeof(data));
+	ret = adef_pcm_mixer_process(&mixer, NULL, 0, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 4; i++)
+		CU_ASSERT_EQUAL(data[i], 0);
+}
+
+
+static void test_mixer_s16(void)
+{
+	int ret;
+	struct adef_pcm_mixer mixer;
+	struct adef_pcm_mixer_input inputs[ADEF_PCM_MIXER_MAX_INPUTS];
+	static int16_t in_data[ADEF_PCM_MIXER_MAX_INPUTS][2 * 1000];
+	static int16_t out_data[2 * 1000];
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 1000};
+
+	ret = adef_pcm_mixer_init(&mixer, &adef_pcm_16b_48000hz_stereo);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	memset(inputs, 0, sizeof(inputs));
+	for (unsigned int n = 0; n < ADEF_PCM_MIXER_MAX_INPUTS; n++) {
+		for (unsigned int i = 0; i < 2 * 1000; i++)
+			in_data[n][i] = (int16_t)((int)(i * 37 + n * 11) %
+							  2001 -
+						  1000);
+		inputs[n].buf.data = in_data[n];
+		inputs[n].buf.frames = 1000;
+		inputs[n].gain = n & 1 ? -0.5f : 1.f;
+	}
+
+	/* Single input at unity gain: bit exact */
+	ret = adef_pcm_mixer_process(&mixer, inputs, 1, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(memcmp(out_data, in_data[0], sizeof(out_data)), 0);
+
+	/* All inputs */
+	ret = adef_pcm_mixer_process(
+		&mixer, inputs, ADEF_PCM_MIXER_MAX_INPUTS, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 2 * 1000; i++) {
+		double sum = 0.;
+		for (unsigned int n = 0; n < ADEF_PCM_MIXER_MAX_INPUTS; n++)
+			sum += in_data[n][i] * (double)inputs[n].gain;
+		CU_ASSERT_DOUBLE_EQUAL(out_data[i], sum, 0.5 + 1e-3);
+	}
+
+	/* Saturation */
+	for (unsigned int i = 0; i < 2 * 1000; i++) {
+		in_data[0][i] = i & 1 ? INT16_MIN : INT16_MAX;
+		in_data[1][i] = i & 1 ? -20000 : 20000;
+	}
+	inputs[1].gain = 1.f;
+	ret = adef_pcm_mixer_process(&mixer, inputs, 2, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 2 * 1000; i++)
+		CU_ASSERT_EQUAL(out_data[i], i & 1 ? INT16_MIN : INT16_MAX);
+}
+
+
+static void test_mixer_s32_planar(void)
+{
+	int ret;
+	struct adef_format format = adef_pcm_16b_48000hz_stereo;
+	struct adef_pcm_mixer mixer;
+	struct adef_pcm_mixer_input inputs[2];
+	int32_t in_data[2][2 * 300];
+	int32_t out_data[2 * 300];
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 300};
+
+	format.bit_depth = 32;
+	format.pcm.interleaved = false;
+	ret = adef_pcm_mixer_init(&mixer, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	memset(inputs, 0, sizeof(inputs));
+	for (unsigned int i = 0; i < 2 * 300; i++) {
+		/* Left plane positive, right plane negative */
+		in_data[0][i] = i < 300 ? 0x7fff0001 : -0x12345;
+		in_data[1][i] = i < 300 ? 0x10000 : -0x7fffffff;
+	}
+	for (unsigned int n = 0; n < 2; n++) {
+		inputs[n].buf.data = in_data[n];
+		inputs[n].buf.frames = 300;
+		inputs[n].gain = 1.f;
+	}
+
+	/* Single input at unity gain: bit exact */
+	ret = adef_pcm_mixer_process(&mixer, inputs, 1, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(memcmp(out_data, in_data[0], sizeof(out_data)), 0);
+
+	ret = adef_pcm_mixer_process(&mixer, inputs, 2, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	for (unsigned int i = 0; i < 2 * 300; i++)
+		CU_ASSERT_EQUAL(out_data[i], i < 300 ? INT32_MAX : INT32_MIN);
+
+	/* Half gain */
+	inputs[1].gain = 0.5f;
+	ret = adef_pcm_mixer_process(&mixer, inputs + 1, 1, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(out_data[0], 0x8000);
+	CU_ASSERT_EQUAL(out_data[300], -0x40000000);
+}
+
+
+static void test_mixer_generic(void)
+{
+	int ret;
+	struct adef_format format = adef_pcm_16b_48000hz_mono;
+	struct adef_pcm_mixer mixer;
+	struct adef_pcm_mixer_input inputs[2];
+	/* 24-bit little-endian: 0x100000 and 0x200000 */
+	uint8_t in_data[2][3] = {{0x00, 0x00, 0x10}, {0x00, 0x00, 0x20}};
+	uint8_t out_data[3];
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 1};
+
+	format.bit_depth = 24;
+	ret = adef_pcm_mixer_init(&mixer, &format);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	memset(inputs, 0, sizeof(inputs));
+	for (unsigned int n = 0; n < 2; n++) {
+		inputs[n].buf.data = in_data[n];
+		inputs[n].buf.frames = 1;
+		inputs[n].gain = 1.f;
+	}
+	ret = adef_pcm_mixer_process(&mixer, inputs, 2, &out, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(out_data[0], 0x00);
+	CU_ASSERT_EQUAL(out_data[1], 0x00);
+	CU_ASSERT_EQUAL(out_data[2], 0x30);
+}
+
+
+static void test_mixer_timestamps(void)
+{
+	int ret;
+	struct adef_pcm_mixer mixer;
+	struct adef_pcm_mixer_input inputs[2];
+	int16_t in_data[2][8];
+	int16_t out_data[8];
+	struct adef_pcm_buffer out = {.data = out_data, .frames = 8};
+	struct adef_frame_info info;
+
+	ret = adef_pcm_mixer_init(&mixer, &adef_pcm_16b_48000hz_mono);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	memset(inputs, 0, sizeof(inputs));
+	for (unsigned int i = 0; i < 8; i++) {
+		in_data[0][i] = 1;
+		in_data[1][i] = 100;
+	}
+	for (unsigned int n = 0; n < 2; n++) {
+		inputs[n].buf.data = in_data[n];
+		inputs[n].buf.frames = 8;
+		inputs[n].gain = 1.f;
+	}
+	/* Input 0 at 1 s (microseconds), input 1 three samples later (96 kHz
+	 * time scale), with a capture timestamp */
+	inputs[0].info.timestamp = 1000000;
+	inputs[0].info.timescale = 1000000;
+	inputs[1].info.timestamp = 96000 + 6;
+	inputs[1].info.timescale = 96000;
+	inputs[1].info.capture_timestamp = 5000000;
+
+	/* The timeline starts at the earliest input */
+	ret = adef_pcm_mixer_process(&mixer, inputs, 2, &out, &info);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(info.timestamp, 48000);
+	CU_ASSERT_EQUAL(info.timescale, 48000);
+	CU_ASSERT_EQUAL(info.index, 0);
+	CU_ASSERT_EQUAL(info.capture_timestamp, 5000000 - 3 * 1000000 / 48000);
+	for (unsigned int i = 0; i < 8; i++)
+		CU_ASSERT_EQUAL(out_data[i], i < 3 ? 1 : 101);
+
+	/* Next output window: the remainder of input 1 only */
+	inputs[1].buf.data = in_data[1] + 5;
+	inputs[1].buf.frames = 3;
+	inputs[1].info.timestamp = 96000 + 16;
+	inputs[1].info.capture_timestamp = 0;
+	ret = adef_pcm_mixer_process(&mixer, inputs + 1, 1, &out, &info);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(info.timestamp, 48008);
+	CU_ASSERT_EQUAL(info.index, 1);
+	CU_ASSERT_EQUAL(info.capture_timestamp, 0);
+	for (unsigned int i = 0; i < 8; i++)
+		CU_ASSERT_EQUAL(out_data[i], i < 3 ? 100 : 0);
+
+	/* Late input: only the part inside the window is mixed */
+	inputs[0].info.timestamp = 1000000 + 14 * 1000000 / 48000 + 1;
+	ret = adef_pcm_mixer_process(&mixer, inputs, 1, &out, &info);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(info.timestamp, 48016);
+	for (unsigned int i = 0; i < 8; i++)
+		CU_ASSERT_EQUAL(out_data[i], i < 6 ? 1 : 0);
+}
+
+
+CU_TestInfo g_adef_test_mixer[] = {
+	{FN("mixer-args"), &test_mixer_args},
+	{FN("mixer-s16"), &test_mixer_s16},
+	{FN("mixer-s32-planar"), &test_mixer_s32_planar},
+	{FN("mixer-generic"), &test_mixer_generic},
+	{FN("mixer-timestamps"), &test_mixer_timestamps},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,309 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+#define TEST_FRAME_SIZE 1024
+
+
+/* Sample value of a frame and channel of the test streams */
+static int16_t sample_value(uint64_t frame, unsigned int channel)
+{
+	return (int16_t)((frame * 7 + channel * 1000) % 30011);
+}
+
+
+static void test_rechunk_args(void)
+{
+	int ret;
+	struct adef_pcm_rechunk *rechunk = NULL;
+	int16_t data[2 * 100];
+	struct adef_pcm_buffer in = {.data = data, .frames = 100};
+	struct adef_pcm_buffer out;
+
+	ret = adef_pcm_rechunk_new(NULL, TEST_FRAME_SIZE, &rechunk);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_rechunk_new(&adef_pcm_16b_48000hz_stereo, 0, &rechunk);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_rechunk_new(
+		&adef_pcm_16b_48000hz_stereo, TEST_FRAME_SIZE, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_rechunk_new(
+		&adef_aac_lc_16b_48000hz_stereo_raw, TEST_FRAME_SIZE, &rechunk);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_rechunk_new(
+		&adef_pcm_16b_48000hz_stereo, TEST_FRAME_SIZE, &rechunk);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	ret = adef_pcm_rechunk_push(NULL, &in, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_rechunk_push(rechunk, NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_rechunk_pull(NULL, &out, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_rechunk_pull(rechunk, NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_pcm_rechunk_flush(rechunk, NULL, NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* No input, then an input not consumed */
+	ret = adef_pcm_rechunk_pull(rechunk, &out, NULL);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	ret = adef_pcm_rechunk_flush(rechunk, &out, NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	ret = adef_pcm_rechunk_push(rechunk, &in, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_rechunk_push(rechunk, &in, NULL);
+	CU_ASSERT_EQUAL(ret, -EBUSY);
+	ret = adef_pcm_rechunk_flush(rechunk, &out, NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EBUSY);
+	ret = adef_pcm_rechunk_pull(rechunk, &out, NULL);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	ret = adef_pcm_rechunk_push(rechunk, &in, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = adef_pcm_rechunk_destroy(rechunk);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_rechunk_destroy(NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+/* Re-chunk a stream of input buffers of the given sizes and check the
+ * samples and information of the output frames */
+static void check_rechunk(const struct adef_format *format,
+			  const size_t *sizes,
+			  unsigned int size_count,
+			  size_t plane_padding,
+			  unsigned int *copy_count)
+{
+	int ret;
+	struct adef_pcm_rechunk *rechunk = NULL;
+	unsigned int channels = format->channel_count;
+	struct adef_pcm_buffer in, out;
+	struct adef_frame_info info, out_info;
+	uint64_t position = 0, out_position = 0;
+	uint64_t starts[100], anchors[100], captures[100];
+	uint32_t out_index = 0;
+	unsigned int j;
+	int16_t *data;
+	size_t data_size, plane_stride, stride;
+	const int16_t *src;
+	bool ok = true;
+
+	*copy_count = 0;
+	data_size = (4 * TEST_FRAME_SIZE + plane_padding) * channels *
+		    sizeof(*data);
+	data = malloc(data_size);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(data);
+	ret = adef_pcm_rechunk_new(format, TEST_FRAME_SIZE, &rechunk);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	for (unsigned int k = 0; k < 100; k++) {
+		/* Input buffer */
+		in.data = data;
+		in.frames = sizes[k % size_count];
+		plane_stride = (in.frames + plane_padding) * sizeof(*data);
+		in.plane_stride = plane_padding ? plane_stride : 0;
+		for (size_t i = 0; i < in.frames; i++) {
+			for (unsigned int c = 0; c < channels; c++) {
+				int16_t v = sample_value(position + i, c);
+				if (format->pcm.interleaved)
+					data[i * channels + c] = v;
+				else
+					data[c * plane_stride / 2 + i] = v;
+			}
+		}
+		/* Time stamps in a time scale which is a multiple of the
+		 * sample rate, capture timestamps extrapolated from the last
+		 * given information */
+		info.timestamp = position * 2;
+		info.timescale = format->sample_rate * 2;
+		info.capture_timestamp =
+			1000000000 + position * 1000000 / format->sample_rate;
+		info.index = k;
+		ret = adef_pcm_rechunk_push(
+			rechunk, &in, (k % 3 == 2) ? NULL : &info);
+		CU_ASSERT_EQUAL(ret, 0);
+		starts[k] = position;
+		if (k % 3 != 2) {
+			anchors[k] = position;
+			captures[k] = info.capture_timestamp;
+		} else {
+			anchors[k] = anchors[k - 1];
+			captures[k] = captures[k - 1];
+		}
+		position += in.frames;
+
+		/* Output frames */
+		while ((ret = adef_pcm_rechunk_pull(
+				rechunk, &out, &out_info)) == 0) {
+			CU_ASSERT_EQUAL(out.frames, TEST_FRAME_SIZE);
+			CU_ASSERT_EQUAL(out_info.timestamp, out_position);
+			CU_ASSERT_EQUAL(out_info.timescale,
+					format->sample_rate);
+			for (j = k; starts[j] > out_position; j--)
+				;
+			CU_ASSERT_EQUAL(out_info.capture_timestamp,
+					captures[j] +
+						(out_position - anchors[j]) *
+							1000000 /
+							format->sample_rate);
+			CU_ASSERT_EQUAL(out_info.index, out_index);
+			if ((uint8_t *)out.data < (uint8_t *)data ||
+			    (uint8_t *)out.data >= (uint8_t *)data + data_size)
+				(*copy_count)++;
+			for (unsigned int c = 0; c < channels; c++) {
+				src = out.data;
+				if (format->pcm.interleaved) {
+					src += c;
+					stride = channels;
+				} else {
+					src += c * (out.plane_stride
+							    ? out.plane_stride
+							    : out.frames * 2) /
+					       2;
+					stride = 1;
+				}
+				for (size_t i = 0; i < out.frames; i++) {
+					if (src[i * stride] !=
+					    sample_value(out_position + i, c))
+						ok = false;
+				}
+			}
+			out_position += TEST_FRAME_SIZE;
+			out_index++;
+		}
+		CU_ASSERT_EQUAL(ret, -EAGAIN);
+	}
+	CU_ASSERT_TRUE(ok);
+	CU_ASSERT_EQUAL(out_position, position / TEST_FRAME_SIZE *
+					      TEST_FRAME_SIZE);
+
+	ret = adef_pcm_rechunk_destroy(rechunk);
+	CU_ASSERT_EQUAL(ret, 0);
+	free(data);
+}
+
+
+static void test_rechunk_interleaved(void)
+{
+	static const size_t sizes[] = {240, 441, 480, 2048, 1024, 100};
+	static const size_t aligned[] = {1024, 2048, 3072};
+	unsigned int copy_count;
+
+	check_rechunk(&adef_pcm_16b_48000hz_stereo, sizes, 6, 0, &copy_count);
+	CU_ASSERT_NOT_EQUAL(copy_count, 0);
+
+	/* Aligned inputs: no copy */
+	check_rechunk(&adef_pcm_16b_48000hz_stereo, aligned, 3, 0, &copy_count);
+	CU_ASSERT_EQUAL(copy_count, 0);
+}
+
+
+static void test_rechunk_planar(void)
+{
+	static const size_t sizes[] = {441, 240, 3000, 480};
+	static const size_t aligned[] = {2048, 1024};
+	struct adef_format format = adef_pcm_16b_44100hz_stereo;
+	unsigned int copy_count;
+
+	format.pcm.interleaved = false;
+	format.channel_count = 3;
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	check_rechunk(&format, sizes, 4, 0, &copy_count);
+	CU_ASSERT_NOT_EQUAL(copy_count, 0);
+	check_rechunk(&format, sizes, 4, 13, &copy_count);
+	CU_ASSERT_NOT_EQUAL(copy_count, 0);
+	/* Aligned inputs: no copy */
+	check_rechunk(&format, aligned, 2, 13, &copy_count);
+	CU_ASSERT_EQUAL(copy_count, 0);
+}
+
+
+static void test_rechunk_flush(void)
+{
+	int ret;
+	struct adef_pcm_rechunk *rechunk = NULL;
+	uint8_t data[100];
+	struct adef_pcm_buffer in = {.data = data, .frames = 100};
+	struct adef_pcm_buffer out;
+	struct adef_frame_info info = {
+		.timestamp = 4800,
+		.timescale = 48000,
+	};
+	struct adef_frame_info out_info;
+	size_t valid_frames = 0;
+	struct adef_format format = adef_pcm_16b_48000hz_mono;
+	const uint8_t *samples;
+
+	/* Unsigned 8-bit: silence is 0x80 */
+	format.bit_depth = 8;
+	format.pcm.container_width = 8;
+	format.pcm.signed_val = false;
+	memset(data, 0x11, sizeof(data));
+	ret = adef_pcm_rechunk_new(&format, 160, &rechunk);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	ret = adef_pcm_rechunk_push(rechunk, &in, &info);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_rechunk_pull(rechunk, &out, &out_info);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+	ret = adef_pcm_rechunk_push(rechunk, &in, NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_rechunk_pull(rechunk, &out, &out_info);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(out_info.timestamp, 4800);
+	CU_ASSERT_EQUAL(out_info.capture_timestamp, 0);
+	ret = adef_pcm_rechunk_pull(rechunk, &out, &out_info);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+
+	ret = adef_pcm_rechunk_flush(rechunk, &out, &out_info, &valid_frames);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(valid_frames, 40);
+	CU_ASSERT_EQUAL(out.frames, 160);
+	CU_ASSERT_EQUAL(out_info.timestamp, 4960);
+	CU_ASSERT_EQUAL(out_info.index, 1);
+	samples = out.data;
+	for (size_t i = 0; i < 160; i++)
+		CU_ASSERT_EQUAL(samples[i], (i < 40) ? 0x11 : 0x80);
+	ret = adef_pcm_rechunk_flush(rechunk, &out, &out_info, &valid_frames);
+	CU_ASSERT_EQUAL(ret, -EAGAIN);
+
+	ret = adef_pcm_rechunk_destroy(rechunk);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+CU_TestInfo g_adef_test_rechunk[] = {
+	{FN("rechunk-args"), &test_rechunk_args},
+	{FN("rechunk-interleaved"), &test_rechunk_interleaved},
+	{FN("rechunk-planar"), &test_rechunk_planar},
+	{FN("rechunk-flush"), &test_rechunk_flush},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,177 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+
+static struct adef_format array_mic_format = {
+	.encoding = ADEF_ENCODING_PCM,
+	.channel_count = 4,
+	.bit_depth = 24,
+	.sample_rate = 48000,
+	.pcm =
+		{
+			.interleaved = true,
+			.signed_val = true,
+			.little_endian = true,
+		},
+};
+
+
+static void test_format_register(void)
+{
+	int ret;
+	char *str;
+	struct adef_format fmt = {0};
+
+	ret = adef_format_register(NULL, &array_mic_format);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_format_register("", &array_mic_format);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_format_register("array/mic", &array_mic_format);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_format_register("array_mic", NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_format_register("array_mic", &fmt);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Built-in names cannot be shadowed */
+	ret = adef_format_register("PCM_16B_48000HZ_STEREO", &array_mic_format);
+	CU_ASSERT_EQUAL(ret, -EEXIST);
+
+	/* Not registered yet */
+	ret = adef_format_from_str("array_mic", &fmt);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	str = adef_format_to_str(&array_mic_format);
+	CU_ASSERT_STRING_EQUAL(
+		str, "PCM/4/24/48000/INTERLEAVED/SIGNED/LE/UNKNOWN/0x0/0");
+	free(str);
+
+	ret = adef_format_register("array_mic", &array_mic_format);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = adef_format_register("ARRAY_MIC", &array_mic_format);
+	CU_ASSERT_EQUAL(ret, -EEXIST);
+
+	ret = adef_format_from_str("Array_Mic", &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &array_mic_format));
+	str = adef_format_to_str(&array_mic_format);
+	CU_ASSERT_STRING_EQUAL(str, "array_mic");
+	free(str);
+
+	/* Built-in formats are still found first */
+	str = adef_format_to_str(&adef_pcm_16b_48000hz_stereo);
+	CU_ASSERT_STRING_EQUAL(str, "pcm_16b_48000hz_stereo");
+	free(str);
+
+	ret = adef_format_unregister(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_format_unregister("array_mic");
+	CU_ASSERT_EQUAL(ret, 0);
+
+	ret = adef_format_unregister("array_mic");
+	CU_ASSERT_EQUAL(ret, -ENOENT);
+
+	ret = adef_format_from_str("array_mic", &fmt);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+}
+
+
+struct reader_ctx {
+	atomic_bool stop;
+	unsigned int errors;
+};
+
+
+static void *reader_thread(void *userdata)
+{
+	struct reader_ctx *ctx = userdata;
+	struct adef_format fmt;
+	char *str;
+
+	while (!atomic_load(&ctx->stop)) {
+		/* The registered format may or may not be there, but a
+		 * lookup must never return a corrupted format */
+		if (adef_format_from_str("array_mic", &fmt) == 0 &&
+		    !adef_format_cmp(&fmt, &array_mic_format))
+			ctx->errors++;
+		str = adef_format_to_str(&array_mic_format);
+		if (str == NULL)
+			ctx->errors++;
+		free(str);
+	}
+
+	return NULL;
+}
+
+
+static void test_format_register_concurrent(void)
+{
+	int ret;
+	pthread_t threads[4];
+	struct reader_ctx ctx[4];
+
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(threads); i++) {
+		atomic_init(&ctx[i].stop, false);
+		ctx[i].errors = 0;
+		ret = pthread_create(&threads[i], NULL, reader_thread, &ctx[i]);
+		CU_ASSERT_EQUAL_FATAL(ret, 0);
+	}
+
+	for (unsigned int i = 0; i < 500; i++) {
+		ret = adef_format_register("array_mic", &array_mic_format);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = adef_format_register("array_mic_2", &array_mic_format);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = adef_format_unregister("array_mic");
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = adef_format_unregister("array_mic_2");
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(threads); i++) {
+		atomic_store(&ctx[i].stop, true);
+		pthread_join(threads[i], NULL);
+		CU_ASSERT_EQUAL(ctx[i].errors, 0);
+	}
+}
+
+
+CU_TestInfo g_adef_test_registry[] = {
+	{FN("format-register"), &test_format_register},
+	{FN("format-register-concurrent"), &test_format_register_concurrent},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "adefs_test.h"
+
+
+#define TEST_FRAMES 1001
+
+
+static void test_simd_str(void)
+{
+	for (unsigned int i = 0; i < ADEF_PCM_SIMD_MAX; i++) {
+		const char *str = adef_pcm_simd_to_str(i);
+		CU_ASSERT_EQUAL(adef_pcm_simd_from_str(str), i);
+	}
+	CU_ASSERT_EQUAL(adef_pcm_simd_from_str("avx2"), ADEF_PCM_SIMD_AVX2);
+	CU_ASSERT_EQUAL(adef_pcm_simd_from_str("avx512"), ADEF_PCM_SIMD_MAX);
+	CU_ASSERT_EQUAL(adef_pcm_simd_from_str(NULL), ADEF_PCM_SIMD_MAX);
+	CU_ASSERT_STRING_EQUAL(adef_pcm_simd_to_str(ADEF_PCM_SIMD_MAX),
+			       "UNKNOWN");
+}
+
+
+static void test_simd_set(void)
+{
+	int ret;
+	enum adef_pcm_simd orig = adef_pcm_simd_get();
+
+	CU_ASSERT_TRUE(adef_pcm_simd_is_supported(orig));
+	CU_ASSERT_TRUE(adef_pcm_simd_is_supported(ADEF_PCM_SIMD_SCALAR));
+	CU_ASSERT_TRUE(adef_pcm_simd_is_supported(ADEF_PCM_SIMD_BASELINE));
+	CU_ASSERT_FALSE(adef_pcm_simd_is_supported(ADEF_PCM_SIMD_MAX));
+
+	for (unsigned int i = 0; i < ADEF_PCM_SIMD_MAX; i++) {
+		ret = adef_pcm_simd_set(i);
+		if (!adef_pcm_simd_is_supported(i)) {
+			CU_ASSERT_EQUAL(ret, -ENOTSUP);
+			continue;
+		}
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_EQUAL(adef_pcm_simd_get(), i);
+	}
+	ret = adef_pcm_simd_set(ADEF_PCM_SIMD_MAX);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	ret = adef_pcm_simd_set(orig);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(adef_pcm_simd_get(), orig);
+}
+
+
+/* Apply a gain ramp and measure the levels of a buffer with the current
+ * level of the kernels */
+static void process(int16_t *samples, struct adef_pcm_level *levels)
+{
+	int ret;
+	const struct adef_format *format = &adef_pcm_16b_48000hz_stereo;
+	struct adef_pcm_buffer buf = {
+		.data = samples,
+		.frames = TEST_FRAMES,
+	};
+	struct adef_frame_info info = {
+		.timestamp = 0,
+		.timescale = format->sample_rate,
+	};
+	struct adef_pcm_gain gain;
+	uint32_t rng = 0x2545f491;
+
+	for (size_t i = 0; i < TEST_FRAMES * 2; i++) {
+		rng ^= rng << 13;
+		rng ^= rng >> 17;
+		rng ^= rng << 5;
+		samples[i] = (int16_t)rng;
+	}
+
+	ret = adef_pcm_gain_init(&gain, format, 0.2f);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_set_ramp(
+		&gain, 1.7f, ADEF_PCM_RAMP_LINEAR, &info, TEST_FRAMES / 2);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_gain_process(&gain, &buf, &info);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_pcm_get_levels(format, &buf, levels, 2);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+static void test_simd_process(void)
+{
+	int ret;
+	enum adef_pcm_simd orig = adef_pcm_simd_get();
+	int16_t ref[TEST_FRAMES * 2], samples[TEST_FRAMES * 2];
+	struct adef_pcm_level ref_levels[2], levels[2];
+
+	ret = adef_pcm_simd_set(ADEF_PCM_SIMD_SCALAR);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	process(ref, ref_levels);
+
+	for (unsigned int i = 0; i < ADEF_PCM_SIMD_MAX; i++) {
+		if (!adef_pcm_simd_is_supported(i))
+			continue;
+		ret = adef_pcm_simd_set(i);
+		CU_ASSERT_EQUAL(ret, 0);
+		process(samples, levels);
+		CU_ASSERT_EQUAL(memcmp(samples, ref, sizeof(ref)), 0);
+		for (unsigned int c = 0; c < 2; c++) {
+			CU_ASSERT_DOUBLE_EQUAL(
+				levels[c].peak, ref_levels[c].peak, 1e-9);
+			CU_ASSERT_DOUBLE_EQUAL(
+				levels[c].rms, ref_levels[c].rms, 1e-6);
+			CU_ASSERT_EQUAL(levels[c].clip_count,
+					ref_levels[c].clip_count);
+		}
+	}
+
+	ret = adef_pcm_simd_set(orig);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+static void test_simd_self_test(void)
+{
+	int ret;
+
+	ret = adef_pcm_simd_self_test();
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+CU_TestInfo g_adef_test_simd[] = {
+	{FN("simd-str"), &test_simd_str},
+	{FN("simd-set"), &test_simd_set},
+	{FN("simd-process"), &test_simd_process},
+	{FN("simd-self-test"), &test_simd_self_test},
+
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+
+#include "adefs_test.h"
+
+
+static void *stats_thread(void *arg)
+{
+	struct adef_format format;
+
+	(void)arg;
+
+	/* Counted after the thread termination */
+	for (unsigned int i = 0; i < 10; i++)
+		adef_format_from_str("pcm_16b_48000hz_mono", &format);
+
+	return NULL;
+}
+
+
+static void test_stats(void)
+{
+	int ret;
+	struct adef_stats before, after;
+	struct adef_format format;
+	const struct adef_format caps[] = {
+		adef_pcm_16b_44100hz_mono,
+		adef_pcm_16b_48000hz_mono,
+		adef_pcm_16b_48000hz_stereo,
+	};
+	pthread_t thread;
+
+	ret = adef_stats_snapshot(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_stats_snapshot(&before);
+	if (ret == -ENOTSUP)
+		return;
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	/* Lookups */
+	ret = adef_format_from_str("pcm_16b_48000hz_stereo", &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_format_from_str(
+		"PCM/1/16/48000/INTERLEAVED/SIGNED/LE/RAW", &format);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_format_from_str("FOO/1/16/48000", &format);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Intersections */
+	CU_ASSERT_TRUE(adef_format_intersect(
+		&adef_pcm_16b_48000hz_mono, caps, ADEF_ARRAY_SIZE(caps)));
+	CU_ASSERT_FALSE(adef_format_intersect(
+		&adef_pcm_16b_8000hz_mono, caps, ADEF_ARRAY_SIZE(caps)));
+
+	ret = pthread_create(&thread, NULL, &stats_thread, NULL);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	pthread_join(thread, NULL);
+
+	ret = adef_stats_snapshot(&after);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+#define DELTA(_stat) (after.counters[_stat] - before.counters[_stat])
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_FORMAT_FROM_STR), 13);
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_FORMAT_FROM_STR_BUILTIN), 11);
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_FORMAT_FROM_STR_REGISTRY), 0);
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_FORMAT_FROM_STR_GENERIC), 1);
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_FORMAT_FROM_STR_ERROR), 1);
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_ENCODING_FROM_STR), 2);
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_ENCODING_UNKNOWN), 1);
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_FORMAT_INTERSECT), 2);
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_FORMAT_INTERSECT_MATCH), 1);
+	CU_ASSERT_EQUAL(DELTA(ADEF_STAT_FORMAT_INTERSECT_SCANNED), 5);
+	CU_ASSERT(DELTA(ADEF_STAT_FORMAT_FROM_STR_CYCLES) > 0);
+#undef DELTA
+}
+
+
+CU_TestInfo g_adef_test_stats[] = {
+	{FN("stats"), &test_stats},
+
+	CU_TEST_INFO_NULL,
+};
@@ -25,6 +25,7 @@
  */
 
 #include "adefs_test.h"
+#include "adefs_test_format_corpus.h"
 
 
 static void test_aac_data_format_from_str(void)
@@ -155,6 +156,70 @@ static void test_encoding_to_str(void)
 }
 
 
+static void test_channel_layout_from_str(void)
+{
+	uint32_t value;
+
+	value = adef_channel_layout_from_str(NULL);
+	CU_ASSERT_EQUAL(value, ADEF_CHANNEL_LAYOUT_UNSPECIFIED);
+
+	value = adef_channel_layout_from_str("?");
+	CU_ASSERT_EQUAL(value, ADEF_CHANNEL_LAYOUT_UNSPECIFIED);
+
+	value = adef_channel_layout_from_str("UNSPECIFIED");
+	CU_ASSERT_EQUAL(value, ADEF_CHANNEL_LAYOUT_UNSPECIFIED);
+
+	value = adef_channel_layout_from_str("mono");
+	CU_ASSERT_EQUAL(value, ADEF_CHANNEL_LAYOUT_MONO);
+
+	value = adef_channel_layout_from_str("STEREO");
+	CU_ASSERT_EQUAL(value, ADEF_CHANNEL_LAYOUT_STEREO);
+
+	value = adef_channel_layout_from_str("2_1");
+	CU_ASSERT_EQUAL(value, ADEF_CHANNEL_LAYOUT_2_1);
+
+	value = adef_channel_layout_from_str("QUAD");
+	CU_ASSERT_EQUAL(value, ADEF_CHANNEL_LAYOUT_QUAD);
+
+	value = adef_channel_layout_from_str("5_1");
+	CU_ASSERT_EQUAL(value, ADEF_CHANNEL_LAYOUT_5_1);
+
+	value = adef_channel_layout_from_str("7_1");
+	CU_ASSERT_EQUAL(value, ADEF_CHANNEL_LAYOUT_7_1);
+}
+
+
+static void test_channel_layout_to_str(void)
+{
+	const char *value;
+
+	value = adef_channel_layout_to_str(ADEF_CHANNEL_LAYOUT_UNSPECIFIED);
+	CU_ASSERT_STRING_EQUAL(value, "UNSPECIFIED");
+
+	value = adef_channel_layout_to_str(ADEF_CHANNEL_LAYOUT_MONO);
+	CU_ASSERT_STRING_EQUAL(value, "MONO");
+
+	value = adef_channel_layout_to_str(ADEF_CHANNEL_LAYOUT_STEREO);
+	CU_ASSERT_STRING_EQUAL(value, "STEREO");
+
+	value = adef_channel_layout_to_str(ADEF_CHANNEL_LAYOUT_2_1);
+	CU_ASSERT_STRING_EQUAL(value, "2_1");
+
+	value = adef_channel_layout_to_str(ADEF_CHANNEL_LAYOUT_QUAD);
+	CU_ASSERT_STRING_EQUAL(value, "QUAD");
+
+	value = adef_channel_layout_to_str(ADEF_CHANNEL_LAYOUT_5_1);
+	CU_ASSERT_STRING_EQUAL(value, "5_1");
+
+	value = adef_channel_layout_to_str(ADEF_CHANNEL_LAYOUT_7_1);
+	CU_ASSERT_STRING_EQUAL(value, "7_1");
+
+	value = adef_channel_layout_to_str(ADEF_CHANNEL_FRONT_LEFT |
+					   ADEF_CHANNEL_BACK_CENTER);
+	CU_ASSERT_STRING_EQUAL(value, "CUSTOM");
+}
+
+
 static void test_format_from_str(void)
 {
 	int ret;
@@ -201,6 +266,56 @@ static void test_format_from_str(void)
 	CU_ASSERT_EQUAL(ret, 0);
 	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &cmp_fmt));
 
+	/* Channel layout */
+	cmp_fmt.channel_count = 6;
+	cmp_fmt.channel_layout = ADEF_CHANNEL_LAYOUT_5_1;
+	ret = adef_format_from_str(
+		"PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/0x3f", &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &cmp_fmt));
+
+	ret = adef_format_from_str(
+		"PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/5_1", &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &cmp_fmt));
+
+	ret = adef_format_from_str(
+		"PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/0", &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(fmt.channel_layout, ADEF_CHANNEL_LAYOUT_UNSPECIFIED);
+	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &cmp_fmt));
+
+	ret = adef_format_from_str(
+		"PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/SURROUND", &fmt);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
+	/* Floating-point */
+	ret = adef_format_from_str(
+		"PCM/2/32/48000/INTERLEAVED/FLOAT/LE/UNKNOWN/STEREO", &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &adef_pcm_f32_48000hz_stereo));
+
+	ret = adef_format_from_str("pcm_f32_44100hz_mono", &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &adef_pcm_f32_44100hz_mono));
+	CU_ASSERT_TRUE(fmt.pcm.float_val);
+
+	/* Container width */
+	ret = adef_format_from_str(
+		"PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/5_1/24", &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_TRUE(adef_format_cmp(&fmt, &cmp_fmt));
+
+	ret = adef_format_from_str(
+		"PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/5_1/32", &fmt);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(fmt.pcm.container_width, 32);
+	CU_ASSERT_FALSE(adef_format_cmp(&fmt, &cmp_fmt));
+
+	ret = adef_format_from_str(
+		"PCM/6/24/44100/INTERLEAVED/SIGNED/LE/UNKNOWN/5_1/x", &fmt);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+
 	/* Known format */
 	ret = adef_format_from_str("aac_lc_16b_44100hz_mono_raw", &fmt);
 	CU_ASSERT_EQUAL(ret, 0);
@@ -225,6 +340,24 @@ static void test_format_from_str(void)
 }
 
 
+static void test_format_from_str_corpus(void)
+{
+#define CORPUS_ENTRY(_str, _ret) {_str, _ret},
+	static const struct {
+		const char *str;
+		int ret;
+	} corpus[] = {ADEF_TEST_FORMAT_CORPUS(CORPUS_ENTRY)};
+#undef CORPUS_ENTRY
+	int ret;
+	struct adef_format fmt;
+
+	for (unsigned int i = 0; i < ADEF_ARRAY_SIZE(corpus); i++) {
+		ret = adef_format_from_str(corpus[i].str, &fmt);
+		CU_ASSERT_EQUAL(ret, corpus[i].ret);
+	}
+}
+
+
 static void test_format_to_str(void)
 {
 	char *value;
@@ -234,31 +367,32 @@ static void test_format_to_str(void)
 	CU_ASSERT_PTR_EQUAL(value, NULL);
 
 	value = adef_format_to_str(&fmt);
-	CU_ASSERT_STRING_EQUAL(value,
-			       "UNKNOWN/0/0/0/PLANAR/UNSIGNED/BE/UNKNOWN");
+	CU_ASSERT_STRING_EQUAL(
+		value, "UNKNOWN/0/0/0/PLANAR/UNSIGNED/BE/UNKNOWN/0x0/0");
 	free(value);
 
 	fmt.encoding = ADEF_ENCODING_AAC_LC;
 	value = adef_format_to_str(&fmt);
 	CU_ASSERT_STRING_EQUAL(value,
-			       "AAC_LC/0/0/0/PLANAR/UNSIGNED/BE/UNKNOWN");
+			       "AAC_LC/0/0/0/PLANAR/UNSIGNED/BE/UNKNOWN/0x0/0");
 	free(value);
 
 	fmt.channel_count = 1;
 	value = adef_format_to_str(&fmt);
 	CU_ASSERT_STRING_EQUAL(value,
-			       "AAC_LC/1/0/0/PLANAR/UNSIGNED/BE/UNKNOWN");
+			       "AAC_LC/1/0/0/PLANAR/UNSIGNED/BE/UNKNOWN/0x0/0");
 	free(value);
 
 	fmt.bit_depth = 16;
 	value = adef_format_to_str(&fmt);
-	CU_ASSERT_STRING_EQUAL(value,
-			       "AAC_LC/1/16/0/PLANAR/UNSIGNED/BE/UNKNOWN");
+	CU_ASSERT_STRING_EQUAL(
+		value, "AAC_LC/1/16/0/PLANAR/UNSIGNED/BE/UNKNOWN/0x0/0");
 	free(value);
 
 	fmt.aac.data_format = ADEF_AAC_DATA_FORMAT_ADTS;
 	value = adef_format_to_str(&fmt);
-	CU_ASSERT_STRING_EQUAL(value, "AAC_LC/1/16/0/PLANAR/UNSIGNED/BE/ADTS");
+	CU_ASSERT_STRING_EQUAL(value,
+			       "AAC_LC/1/16/0/PLANAR/UNSIGNED/BE/ADTS/0x0/0");
 	free(value);
 
 	/* Known format */
@@ -269,19 +403,20 @@ static void test_format_to_str(void)
 
 	fmt.encoding = ADEF_ENCODING_PCM;
 	value = adef_format_to_str(&fmt);
-	CU_ASSERT_STRING_EQUAL(value, "PCM/1/16/44100/PLANAR/UNSIGNED/BE/ADTS");
+	CU_ASSERT_STRING_EQUAL(value,
+			       "PCM/1/16/44100/PLANAR/UNSIGNED/BE/ADTS/0x0/0");
 	free(value);
 
 	fmt.pcm.interleaved = true;
 	value = adef_format_to_str(&fmt);
-	CU_ASSERT_STRING_EQUAL(value,
-			       "PCM/1/16/44100/INTERLEAVED/UNSIGNED/BE/ADTS");
+	CU_ASSERT_STRING_EQUAL(
+		value, "PCM/1/16/44100/INTERLEAVED/UNSIGNED/BE/ADTS/0x0/0");
 	free(value);
 
 	fmt.pcm.signed_val = true;
 	value = adef_format_to_str(&fmt);
-	CU_ASSERT_STRING_EQUAL(value,
-			       "PCM/1/16/44100/INTERLEAVED/SIGNED/BE/ADTS");
+	CU_ASSERT_STRING_EQUAL(
+		value, "PCM/1/16/44100/INTERLEAVED/SIGNED/BE/ADTS/0x0/0");
 	free(value);
 
 	/* Known format */
@@ -301,6 +436,32 @@ static void test_format_to_str(void)
 	value = adef_format_to_str(&fmt);
 	CU_ASSERT_STRING_EQUAL(value, "pcm_16b_96000hz_stereo");
 	free(value);
+
+	fmt.channel_count = 6;
+	fmt.channel_layout = ADEF_CHANNEL_LAYOUT_5_1;
+	value = adef_format_to_str(&fmt);
+	CU_ASSERT_STRING_EQUAL(
+		value, "PCM/6/16/96000/INTERLEAVED/SIGNED/LE/ADTS/0x3f/0");
+	free(value);
+
+	fmt.bit_depth = 24;
+	fmt.pcm.container_width = 32;
+	value = adef_format_to_str(&fmt);
+	CU_ASSERT_STRING_EQUAL(
+		value, "PCM/6/24/96000/INTERLEAVED/SIGNED/LE/ADTS/0x3f/32");
+	free(value);
+
+	fmt.bit_depth = 32;
+	fmt.pcm.float_val = true;
+	value = adef_format_to_str(&fmt);
+	CU_ASSERT_STRING_EQUAL(
+		value, "PCM/6/32/96000/INTERLEAVED/FLOAT/LE/ADTS/0x3f/32");
+	free(value);
+
+	/* Known format */
+	value = adef_format_to_str(&adef_pcm_f32_96000hz_stereo);
+	CU_ASSERT_STRING_EQUAL(value, "pcm_f32_96000hz_stereo");
+	free(value);
 }
 
 
@@ -309,7 +470,10 @@ CU_TestInfo g_adef_test_str[] = {
 	{FN("aac-data-format-to-str"), &test_aac_data_format_to_str},
 	{FN("encoding-from-str"), &test_encoding_from_str},
 	{FN("encoding-to-str"), &test_encoding_to_str},
+	{FN("channel-layout-from-str"), &test_channel_layout_from_str},
+	{FN("channel-layout-to-str"), &test_channel_layout_to_str},
 	{FN("format-from-str"), &test_format_from_str},
+	{FN("format-from-str-corpus"), &test_format_from_str_corpus},
 	{FN("format-to-str"), &test_format_to_str},
 
 	CU_TEST_INFO_NULL,
@@ -0,0 +1,562 @@
+/**
+ * Copyright (c) 2021 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <audio-defs/adefs_wav.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "adefs_test.h"
+
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+	FILE *f;
+	uint8_t *data;
+	long len;
+
+	*size = 0;
+	f = fopen(path, "rb");
+	CU_ASSERT_PTR_NOT_NULL(f);
+	if (f == NULL)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = malloc(len > 0 ? len : 1);
+	CU_ASSERT_PTR_NOT_NULL(data);
+	if (data == NULL) {
+		fclose(f);
+		return NULL;
+	}
+	CU_ASSERT_EQUAL(fread(data, 1, len, f), (size_t)len);
+	fclose(f);
+	*size = len;
+	return data;
+}
+
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+
+/* Check the WAV header and return the data size */
+static uint32_t check_header(const uint8_t *p,
+			     size_t size,
+			     size_t header_size,
+			     uint16_t tag,
+			     const struct adef_format *format,
+			     unsigned int container_bits)
+{
+	uint32_t data_size;
+
+	CU_ASSERT(size >= header_size);
+	if (p == NULL || size < header_size)
+		return 0;
+	CU_ASSERT_EQUAL(memcmp(p, "RIFF", 4), 0);
+	CU_ASSERT_EQUAL(memcmp(p + 8, "WAVE", 4), 0);
+	CU_ASSERT_EQUAL(memcmp(p + 12, "fmt ", 4), 0);
+	CU_ASSERT_EQUAL(get_le32(p + 16), header_size - 28);
+	CU_ASSERT_EQUAL(get_le16(p + 22), format->channel_count);
+	CU_ASSERT_EQUAL(get_le32(p + 24), format->sample_rate);
+	CU_ASSERT_EQUAL(get_le32(p + 28),
+			format->sample_rate * format->channel_count *
+				container_bits / 8);
+	CU_ASSERT_EQUAL(get_le16(p + 32),
+			format->channel_count * container_bits / 8);
+	CU_ASSERT_EQUAL(get_le16(p + 34), container_bits);
+	if (header_size == 44) {
+		CU_ASSERT_EQUAL(get_le16(p + 20), tag);
+	} else {
+		CU_ASSERT_EQUAL(get_le16(p + 20), 0xfffe);
+		CU_ASSERT_EQUAL(get_le16(p + 36), 22);
+		CU_ASSERT_EQUAL(get_le16(p + 38), format->bit_depth);
+		CU_ASSERT_EQUAL(get_le32(p + 44), tag);
+	}
+	CU_ASSERT_EQUAL(memcmp(p + header_size - 8, "data", 4), 0);
+	data_size = get_le32(p + header_size - 4);
+	CU_ASSERT_EQUAL(get_le32(p + 4),
+			header_size - 8 + data_size + (data_size & 1));
+	return data_size;
+}
+
+
+static void test_wav_interleaved(void)
+{
+	int ret;
+	char path[] = "/tmp/adefs_test_XXXXXX";
+	struct adef_wav_writer *writer;
+	struct adef_wav_writer_config config = {
+		.flush_size = 4096,
+	};
+	struct adef_pcm_buffer buf = {0};
+	const size_t frames = 30000;
+	int16_t *samples;
+	uint8_t *data;
+	size_t size, offset = 0, chunk;
+	uint32_t seed = 1;
+	uint64_t count;
+
+	ret = mkstemp(path);
+	CU_ASSERT_FATAL(ret >= 0);
+	close(ret);
+	samples = malloc(frames * 2 * sizeof(*samples));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(samples);
+	for (size_t i = 0; i < frames * 2; i++) {
+		seed = seed * 1664525 + 1013904223;
+		samples[i] = seed >> 16;
+	}
+
+	ret = adef_wav_writer_new(
+		path, &adef_pcm_16b_48000hz_stereo, &config, &writer);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+
+	/* Small chunks (buffered) and large chunks (direct writes) */
+	while (offset < frames) {
+		seed = seed * 1664525 + 1013904223;
+		chunk = (seed >> 8) % 8 == 0 ? 5000 : (seed >> 8) % 300;
+		if (chunk > frames - offset)
+			chunk = frames - offset;
+		buf.data = samples + offset * 2;
+		buf.frames = chunk;
+		ret = adef_wav_writer_write(writer, &buf);
+		CU_ASSERT_EQUAL(ret, 0);
+		offset += chunk;
+	}
+	ret = adef_wav_writer_get_frames(writer, &count);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(count, frames);
+	ret = adef_wav_writer_destroy(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	data = read_file(path, &size);
+	CU_ASSERT_EQUAL(size, 44 + frames * 4);
+	CU_ASSERT_EQUAL(
+		check_header(
+			data, size, 44, 1, &adef_pcm_16b_48000hz_stereo, 16),
+		frames * 4);
+	CU_ASSERT_EQUAL(memcmp(data + 44, samples, frames * 4), 0);
+
+	free(data);
+	free(samples);
+	unlink(path);
+}
+
+
+static void test_wav_planar(void)
+{
+	int ret;
+	char path[] = "/tmp/adefs_test_XXXXXX";
+	struct adef_wav_writer *writer;
+	struct adef_format format = adef_pcm_16b_48000hz_stereo;
+	struct adef_pcm_buffer buf = {0};
+	const size_t frames = 1000;
+	float planes[2][1000];
+	const float *samples;
+	uint8_t *data;
+	size_t size;
+
+	ret = mkstemp(path);
+	CU_ASSERT_FATAL(ret >= 0);
+	close(ret);
+	format.bit_depth = 32;
+	format.pcm.float_val = true;
+	format.pcm.interleaved = false;
+	for (size_t i = 0; i < frames; i++) {
+		planes[0][i] = (float)i / frames;
+		planes[1][i] = -(float)i / frames;
+	}
+
+	ret = adef_wav_writer_new(path, &format, NULL, &writer);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	/* Two buffers with a plane stride */
+	buf.data = &planes[0][0];
+	buf.frames = 400;
+	buf.plane_stride = sizeof(planes[0]);
+	ret = adef_wav_writer_write(writer, &buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	buf.data = &planes[0][400];
+	buf.frames = frames - 400;
+	ret = adef_wav_writer_write(writer, &buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_wav_writer_destroy(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	data = read_file(path, &size);
+	CU_ASSERT_EQUAL(size, 44 + frames * 8);
+	CU_ASSERT_EQUAL(check_header(data, size, 44, 3, &format, 32),
+			frames * 8);
+	samples = (const float *)(data + 44);
+	for (size_t i = 0; i < frames; i++) {
+		CU_ASSERT_EQUAL(samples[2 * i], planes[0][i]);
+		CU_ASSERT_EQUAL(samples[2 * i + 1], planes[1][i]);
+	}
+
+	free(data);
+	unlink(path);
+}
+
+
+/* Planar data with a frame size which does not divide the flush size:
+ * only full buffers are written */
+static void test_wav_planar_flush(void)
+{
+	int ret;
+	char path[] = "/tmp/adefs_test_XXXXXX";
+	struct adef_wav_writer *writer;
+	struct adef_wav_writer_config config = {
+		.flush_size = 4096,
+	};
+	struct adef_format format = adef_pcm_16b_48000hz_stereo;
+	struct adef_pcm_buffer buf = {0};
+	const size_t frames = 3000;
+	int16_t planes[3][3000];
+	const int16_t *samples;
+	uint8_t *data;
+	size_t size;
+	struct stat st;
+
+	ret = mkstemp(path);
+	CU_ASSERT_FATAL(ret >= 0);
+	close(ret);
+	format.channel_count = 3;
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	format.pcm.interleaved = false;
+	for (size_t i = 0; i < frames; i++) {
+		for (unsigned int ch = 0; ch < 3; ch++)
+			planes[ch][i] = (int16_t)(i * 3 + ch);
+	}
+
+	ret = adef_wav_writer_new(path, &format, &config, &writer);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	buf.plane_stride = sizeof(planes[0]);
+	for (size_t i = 0; i < frames; i += 500) {
+		buf.data = &planes[0][i];
+		buf.frames = 500;
+		ret = adef_wav_writer_write(writer, &buf);
+		CU_ASSERT_EQUAL(ret, 0);
+		ret = stat(path, &st);
+		CU_ASSERT_EQUAL(ret, 0);
+		CU_ASSERT_EQUAL(st.st_size % config.flush_size, 0);
+	}
+	ret = adef_wav_writer_destroy(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	data = read_file(path, &size);
+	/* More than 2 channels: extensible header */
+	CU_ASSERT_EQUAL(size, 68 + frames * 6);
+	CU_ASSERT_EQUAL(check_header(data, size, 68, 1, &format, 16),
+			frames * 6);
+	samples = (const int16_t *)(data + 68);
+	for (size_t i = 0; i < frames * 3; i++)
+		CU_ASSERT_EQUAL(samples[i], (int16_t)i);
+
+	free(data);
+	unlink(path);
+}
+
+
+static void test_wav_extensible(void)
+{
+	int ret;
+	char path[] = "/tmp/adefs_test_XXXXXX";
+	struct adef_wav_writer *writer;
+	struct adef_format format = adef_pcm_16b_48000hz_stereo;
+	struct adef_pcm_buffer buf = {0};
+	int32_t samples[3 * 10];
+	uint8_t *data;
+	size_t size;
+
+	ret = mkstemp(path);
+	CU_ASSERT_FATAL(ret >= 0);
+	close(ret);
+	/* 24-bit samples in 32-bit containers, 3 channels */
+	format.channel_count = 3;
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_UNSPECIFIED;
+	format.bit_depth = 24;
+	format.pcm.container_width = 32;
+	for (size_t i = 0; i < 30; i++)
+		samples[i] = (int32_t)(i * 100000) - 1500000;
+
+	ret = adef_wav_writer_new(path, &format, NULL, &writer);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	buf.data = samples;
+	buf.frames = 10;
+	ret = adef_wav_writer_write(writer, &buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_wav_writer_destroy(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	data = read_file(path, &size);
+	CU_ASSERT_EQUAL(size, 68 + sizeof(samples));
+	CU_ASSERT_EQUAL(check_header(data, size, 68, 1, &format, 32),
+			sizeof(samples));
+	CU_ASSERT_EQUAL(get_le32(data + 40), 0);
+	CU_ASSERT_EQUAL(memcmp(data + 68, samples, sizeof(samples)), 0);
+
+	free(data);
+	unlink(path);
+}
+
+
+static void test_wav_checkpoint(void)
+{
+	int ret;
+	char path[] = "/tmp/adefs_test_XXXXXX";
+	struct adef_wav_writer *writer;
+	struct adef_wav_writer_config config = {
+		.flush_size = 4096,
+		.checkpoint_size = 16384,
+	};
+	struct adef_pcm_buffer buf = {0};
+	int16_t samples[2 * 1000] = {0};
+	uint8_t *data;
+	size_t size;
+	uint32_t data_size;
+
+	ret = mkstemp(path);
+	CU_ASSERT_FATAL(ret >= 0);
+	close(ret);
+
+	ret = adef_wav_writer_new(
+		path, &adef_pcm_16b_48000hz_stereo, &config, &writer);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	buf.data = samples;
+	buf.frames = 1000;
+	for (unsigned int i = 0; i < 10; i++) {
+		ret = adef_wav_writer_write(writer, &buf);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+
+	/* Periodic checkpoint: the header describes the data on disk */
+	data = read_file(path, &size);
+	data_size = check_header(
+		data, size, 44, 1, &adef_pcm_16b_48000hz_stereo, 16);
+	CU_ASSERT(data_size >= config.checkpoint_size);
+	CU_ASSERT(data_size <= size - 44);
+	free(data);
+
+	/* Explicit checkpoint: all the data is written */
+	ret = adef_wav_writer_checkpoint(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+	data = read_file(path, &size);
+	CU_ASSERT_EQUAL(size, 44 + 10 * sizeof(samples));
+	CU_ASSERT_EQUAL(
+		check_header(
+			data, size, 44, 1, &adef_pcm_16b_48000hz_stereo, 16),
+		10 * sizeof(samples));
+	free(data);
+
+	ret = adef_wav_writer_destroy(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+	unlink(path);
+}
+
+
+/* The checkpoints only count whole frames, and an even data size */
+static void test_wav_checkpoint_frames(void)
+{
+	int ret;
+	char path[] = "/tmp/adefs_test_XXXXXX";
+	struct adef_wav_writer *writer;
+	struct adef_wav_writer_config config = {
+		.flush_size = 4096,
+		.checkpoint_size = 4096,
+	};
+	struct adef_format format = adef_pcm_16b_48000hz_stereo;
+	struct adef_pcm_buffer buf = {0};
+	uint8_t samples[6 * 1000] = {0};
+	uint8_t *data;
+	size_t size;
+	uint32_t data_size;
+
+	ret = mkstemp(path);
+	CU_ASSERT_FATAL(ret >= 0);
+	close(ret);
+
+	/* Packed 24-bit stereo: 6-byte frames */
+	format.bit_depth = 24;
+	ret = adef_wav_writer_new(path, &format, &config, &writer);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	buf.data = samples;
+	buf.frames = 1000;
+	for (unsigned int i = 0; i < 3; i++) {
+		ret = adef_wav_writer_write(writer, &buf);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	data = read_file(path, &size);
+	data_size = check_header(data, size, 44, 1, &format, 24);
+	CU_ASSERT(data_size > 0);
+	CU_ASSERT_EQUAL(data_size % 6, 0);
+	CU_ASSERT(data_size <= size - 44);
+	free(data);
+	ret = adef_wav_writer_destroy(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* Packed 24-bit mono, odd frame count: even data size */
+	format.channel_count = 1;
+	format.channel_layout = ADEF_CHANNEL_LAYOUT_MONO;
+	ret = adef_wav_writer_new(path, &format, &config, &writer);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	for (unsigned int i = 0; i < 4; i++) {
+		ret = adef_wav_writer_write(writer, &buf);
+		CU_ASSERT_EQUAL(ret, 0);
+	}
+	buf.frames = 1;
+	ret = adef_wav_writer_write(writer, &buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	data = read_file(path, &size);
+	data_size = check_header(data, size, 44, 1, &format, 24);
+	CU_ASSERT(data_size > 0);
+	CU_ASSERT_EQUAL(data_size % 6, 0);
+	CU_ASSERT(data_size <= size - 44);
+	free(data);
+	ret = adef_wav_writer_checkpoint(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+	data = read_file(path, &size);
+	CU_ASSERT_EQUAL(size, 44 + 4001 * 3);
+	CU_ASSERT_EQUAL(check_header(data, size, 44, 1, &format, 24),
+			4000 * 3);
+	free(data);
+	ret = adef_wav_writer_destroy(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+	data = read_file(path, &size);
+	CU_ASSERT_EQUAL(size, 44 + 4001 * 3 + 1);
+	CU_ASSERT_EQUAL(check_header(data, size, 44, 1, &format, 24),
+			4001 * 3);
+	free(data);
+	unlink(path);
+}
+
+
+static void test_wav_prealloc(void)
+{
+	int ret;
+	char path[] = "/tmp/adefs_test_XXXXXX";
+	struct adef_wav_writer *writer;
+	struct adef_wav_writer_config config = {
+		.prealloc_size = 1024 * 1024,
+	};
+	struct adef_format format = adef_pcm_16b_8000hz_mono;
+	struct adef_pcm_buffer buf = {0};
+	uint8_t samples[1001];
+	uint8_t *data;
+	size_t size;
+	struct stat st;
+
+	ret = mkstemp(path);
+	CU_ASSERT_FATAL(ret >= 0);
+	close(ret);
+	/* Unsigned 8-bit samples, odd data size (pad byte) */
+	format.bit_depth = 8;
+	format.pcm.signed_val = false;
+	memset(samples, 0x80, sizeof(samples));
+
+	ret = adef_wav_writer_new(path, &format, &config, &writer);
+	CU_ASSERT_EQUAL_FATAL(ret, 0);
+	buf.data = samples;
+	buf.frames = sizeof(samples);
+	ret = adef_wav_writer_write(writer, &buf);
+	CU_ASSERT_EQUAL(ret, 0);
+	ret = adef_wav_writer_destroy(writer);
+	CU_ASSERT_EQUAL(ret, 0);
+
+	/* The unused preallocated space is released */
+	ret = stat(path, &st);
+	CU_ASSERT_EQUAL(ret, 0);
+	CU_ASSERT_EQUAL(st.st_size, 44 + sizeof(samples) + 1);
+	data = read_file(path, &size);
+	CU_ASSERT_EQUAL(check_header(data, size, 44, 1, &format, 8),
+			sizeof(samples));
+	CU_ASSERT_EQUAL(data[size - 1], 0);
+	free(data);
+	unlink(path);
+}
+
+
+static void test_wav_invalid(void)
+{
+	int ret;
+	const char *path = "/tmp/adefs_test_wav_invalid";
+	struct adef_wav_writer *writer;
+	struct adef_format format = adef_pcm_16b_48000hz_stereo;
+	uint64_t count;
+
+	ret = adef_wav_writer_new(
+		NULL, &adef_pcm_16b_48000hz_stereo, NULL, &writer);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_wav_writer_new(path, NULL, NULL, &writer);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_wav_writer_new(
+		path, &adef_pcm_16b_48000hz_stereo, NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_wav_writer_new(
+		path, &adef_aac_lc_16b_48000hz_stereo_raw, NULL, &writer);
+	CU_ASSERT_EQUAL(ret, -ENOTSUP);
+	format.pcm.little_endian = false;
+	ret = adef_wav_writer_new(path, &format, NULL, &writer);
+	CU_ASSERT_EQUAL(ret, -ENOTSUP);
+	format.pcm.little_endian = true;
+	format.pcm.signed_val = false;
+	ret = adef_wav_writer_new(path, &format, NULL, &writer);
+	CU_ASSERT_EQUAL(ret, -ENOTSUP);
+	ret = adef_wav_writer_new("/nonexistent/adefs_test.wav",
+				  &adef_pcm_16b_48000hz_stereo,
+				  NULL,
+				  &writer);
+	CU_ASSERT_EQUAL(ret, -ENOENT);
+
+	ret = adef_wav_writer_write(NULL, NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_wav_writer_get_frames(NULL, &count);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_wav_writer_checkpoint(NULL);
+	CU_ASSERT_EQUAL(ret, -EINVAL);
+	ret = adef_wav_writer_destroy(NULL);
+	CU_ASSERT_EQUAL(ret, 0);
+}
+
+
+CU_TestInfo g_adef_test_wav[] = {
+	{FN("wav-interleaved"), &test_wav_interleaved},
+	{FN("wav-planar"), &test_wav_planar},
+	{FN("wav-planar-flush"), &test_wav_planar_flush},
+	{FN("wav-extensible"), &test_wav_extensible},
+	{FN("wav-checkpoint"), &test_wav_checkpoint},
+	{FN("wav-checkpoint-frames"), &test_wav_checkpoint_frames},
+	{FN("wav-prealloc"), &test_wav_prealloc},
+	{FN("wav-invalid"), &test_wav_invalid},
+
+	CU_TEST_INFO_NULL,
+};